@@ -22,8 +22,10 @@
 
 package com.untouchableapps.android.geodashboard;
 
+import java.io.BufferedInputStream;
 import java.io.BufferedReader;
 import java.io.ByteArrayOutputStream;
+import java.io.DataInputStream;
 import java.io.DataOutputStream;
 import java.io.File;
 import java.io.FileReader;
@@ -40,6 +42,8 @@ import java.net.UnknownHostException;
 import java.nio.ByteOrder;
 import java.util.Arrays;
 import java.util.Enumeration;
+import java.util.zip.DataFormatException;
+import java.util.zip.Inflater;
 
 import android.accessibilityservice.AccessibilityService;
 import android.annotation.TargetApi;
@@ -227,6 +231,16 @@ public class ViewDashboard extends Activity implements NsdManager.RegistrationLi
   static final int NET_CMD_PLAY_SOUND_DOG = 3;
   static final int NET_CMD_PLAY_SOUND_SHIP = 4;
   static final int NET_CMD_PLAY_SOUND_CAR = 5;
+  static final int NET_CMD_DISPLAY_FRAMES = 6;
+
+  // Version of the frame stream protocol
+  static final int FRAME_STREAM_VERSION = 1;
+  static final int FRAME_FLAG_KEY_FRAME = 1;
+
+  /**
+   * Connection that currently streams frames
+   */
+  Socket frameStreamClient = null;
 
   // Checks if accessibility service is enabled
   public boolean isAccessibilityEnabled() {
@@ -429,6 +443,88 @@ public class ViewDashboard extends Activity implements NsdManager.RegistrationLi
     }
   }
 
+  /**
+   * Receives frames that only contain the changed tiles of the screen
+   */
+  private void receiveFrames(Socket client) {
+    int[] pixels = null;
+    int frameWidth = 0;
+    int frameHeight = 0;
+    Inflater inflater = new Inflater();
+    try {
+      DataInputStream dis = new DataInputStream(new BufferedInputStream(client.getInputStream()));
+      DataOutputStream dos = new DataOutputStream(client.getOutputStream());
+      dos.writeInt(FRAME_STREAM_VERSION);
+      dos.flush();
+      while (!quitServerThread) {
+
+        // Read the header and the compressed tiles
+        int frameNumber = dis.readInt();
+        int flags = dis.readInt();
+        int w = dis.readInt();
+        int h = dis.readInt();
+        int tileSize = dis.readInt();
+        int tileCount = dis.readInt();
+        int uncompressedSize = dis.readInt();
+        int compressedSize = dis.readInt();
+        byte[] compressed = new byte[compressedSize];
+        dis.readFully(compressed);
+
+        // Changes can only be applied to a frame of the same dimension
+        if ((flags & FRAME_FLAG_KEY_FRAME) != 0) {
+          if ((pixels == null) || (w != frameWidth) || (h != frameHeight))
+            pixels = new int[w * h];
+          frameWidth = w;
+          frameHeight = h;
+        } else if ((pixels == null) || (w != frameWidth) || (h != frameHeight)) {
+          throw new IOException("frame does not match previous frame");
+        }
+
+        // Copy the tiles into the frame
+        byte[] data = new byte[uncompressedSize];
+        inflater.reset();
+        inflater.setInput(compressed);
+        if (inflater.inflate(data) != uncompressedSize)
+          throw new IOException("frame is incomplete");
+        int pos = 0;
+        for (int i = 0; i < tileCount; i++) {
+          int x0 = (((data[pos] & 0xFF) << 8) | (data[pos + 1] & 0xFF)) * tileSize;
+          int y0 = (((data[pos + 2] & 0xFF) << 8) | (data[pos + 3] & 0xFF)) * tileSize;
+          pos += 4;
+          int x1 = Math.min(x0 + tileSize, w);
+          int y1 = Math.min(y0 + tileSize, h);
+          for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+              pixels[y * w + x] = 0xFF000000 | ((data[pos] & 0xFF) << 16) | ((data[pos + 1] & 0xFF) << 8) | (data[pos + 2] & 0xFF);
+              pos += 3;
+            }
+          }
+        }
+
+        // Display the frame and confirm it
+        if (dashboardBitmap!=null) {
+          Log.d("GeoDashboard","previous image has not been consumed, overriding it");
+        }
+        dashboardBitmap = Bitmap.createBitmap(pixels, w, h, Bitmap.Config.ARGB_8888);
+        Message msg = serverThreadHandler.obtainMessage(ACTION_DISPLAY_BITMAP);
+        msg.sendToTarget();
+        dos.writeInt(frameNumber);
+        dos.flush();
+      }
+    }
+    catch (IOException|DataFormatException|ArrayIndexOutOfBoundsException e) {
+      Log.d("GeoDashboard","frame stream closed: " + e.getMessage());
+    }
+    finally {
+      inflater.end();
+      try {
+        client.close();
+      }
+      catch (IOException e) {
+      }
+    }
+  }
+
   /**
    * Starts the network service
    */
@@ -484,6 +580,24 @@ public class ViewDashboard extends Activity implements NsdManager.RegistrationLi
             lastClientAddress = client.getInetAddress().getHostAddress();
             int cmd = client.getInputStream().read();
             switch(cmd) {
+              case NET_CMD_DISPLAY_FRAMES:
+
+                // Keep the connection open and handle it in its own thread
+                // Only one client can stream frames at a time
+                if (frameStreamClient!=null) {
+                  frameStreamClient.close();
+                }
+                frameStreamClient = client;
+                final Socket frameClient = client;
+                Thread frameThread = new Thread(new Runnable() {
+                  @Override
+                  public void run() {
+                    receiveFrames(frameClient);
+                  }
+                });
+                frameThread.start();
+                client = null;
+                break;
               case NET_CMD_GET_INFO:
                 ByteArrayOutputStream baos = new ByteArrayOutputStream();
                 DataOutputStream dos = new DataOutputStream(baos);
@@ -505,7 +619,8 @@ public class ViewDashboard extends Activity implements NsdManager.RegistrationLi
                 msg.sendToTarget();
                 break;
             }
-            client.close();
+            if (client!=null)
+              client.close();
           }
           catch (IOException e) {
             msg = serverThreadHandler.obtainMessage(ACTION_DISPLAY_TOAST,e.getMessage());
@@ -551,6 +666,10 @@ public class ViewDashboard extends Activity implements NsdManager.RegistrationLi
           clientSocket.getOutputStream().write(255);
           clientSocket.close();
           serverThread.join();
+          if (frameStreamClient!=null) {
+            frameStreamClient.close();
+            frameStreamClient=null;
+          }
         }
         catch (Exception e) {
         }
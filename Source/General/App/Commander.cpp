@@ -785,9 +785,9 @@ std::string Commander::execute(std::string cmd) {
     NavigationPoint point;
     bool found=true;
     if (args[0]=="") {
-      GraphicPosition visPos=*(core->getDefaultGraphicEngine()->lockPos(__FILE__, __LINE__));
-      core->getDefaultGraphicEngine()->unlockPos();
-      if (!core->getNavigationEngine()->getAddressPoint(visPos,point)) {
+      MapPosition mapPos=*(core->getMapEngine()->lockMapPos(__FILE__, __LINE__));
+      core->getMapEngine()->unlockMapPos();
+      if (!core->getNavigationEngine()->getAddressPoint(mapPos,point)) {
         WARNING("no address point near to the current map center found",NULL);
         found=false;
       }
@@ -931,10 +931,10 @@ std::string Commander::execute(std::string cmd) {
     cmdExecuted=true;
   }
   if (cmdName=="trashAddressPoint") {
-    GraphicPosition visPos=*(core->getDefaultGraphicEngine()->lockPos(__FILE__, __LINE__));
-    core->getDefaultGraphicEngine()->unlockPos();
+    MapPosition mapPos=*(core->getMapEngine()->lockMapPos(__FILE__, __LINE__));
+    core->getMapEngine()->unlockMapPos();
     NavigationPoint addressPoint;
-    if (core->getNavigationEngine()->getAddressPoint(visPos,addressPoint)) {
+    if (core->getNavigationEngine()->getAddressPoint(mapPos,addressPoint)) {
       core->getNavigationEngine()->removeAddressPoint(addressPoint.getName());
     } else {
       WARNING("no address point near to the current map center found",NULL);
@@ -808,6 +808,12 @@ void Core::maintenance(bool endlessLoop) {
     core->getDefaultGraphicEngine()->outputStats();
 #endif
 
+    // Output the cache statistics
+    if ((mapCache)&&(mapCache->getIsInitialized()))
+      mapCache->outputStats();
+    if ((elevationEngine)&&(elevationEngine->getIsInitialized()))
+      elevationEngine->outputStats();
+
     // Call the maintenance in the map source
     if ((!quitCore)&&(mapSource)&&(mapSource->getIsInitialized())) {
       mapSource->maintenance();
@@ -38,9 +38,12 @@
 #include <sys/time.h>
 #include <utime.h>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <list>
 #include <vector>
+#include <queue>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -49,6 +52,7 @@
 #include <limits>
 #include <unistd.h>
 #include <algorithm>
+#include <atomic>
 #include <signal.h>
 #include <errno.h>
 #ifdef TARGET_ANDROID
@@ -98,7 +102,7 @@ class NavigationPath;
 class NavigationPoint;
 
 // Error types for downloads
-typedef enum { DownloadResultSuccess, DownloadResultFileNotFound, DownloadResultOtherFail } DownloadResult;
+typedef enum { DownloadResultSuccess, DownloadResultFileNotFound, DownloadResultOtherFail, DownloadResultNotModified } DownloadResult;
 
 // Types of changes to a navigation path object
 typedef enum { NavigationPathChangeTypeEndPositionAdded, NavigationPathChangeTypeFlagSet, NavigationPathChangeTypeWillBeRemoved, NavigationPathChangeTypeWidgetEngineInit } NavigationPathChangeType;
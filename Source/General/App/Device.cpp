@@ -51,6 +51,10 @@ Device::Device(std::string name, bool whiteBackround, bool animationFriendly) {
   socketfd=-1;
   orientation=GraphicScreenOrientationProtrait;
   initDone=false;
+  frameEncoder=NULL;
+  frameVerifier=NULL;
+  frameStreamSupported=true;
+  frameStreamOpen=false;
   if (name=="Watch")
     isWatch=true;
   else
@@ -72,6 +76,8 @@ Device::~Device() {
 
   // Close socket
   closeSocket();
+  if (frameEncoder) delete frameEncoder;
+  if (frameVerifier) delete frameVerifier;
 }
 
 // Creates the components
@@ -150,7 +156,7 @@ bool Device::draw() {
   screen->setAllowAllocation(true);
   bool result=graphicEngine->draw(false);
   screen->setAllowAllocation(false);
-  if (socketfd>=0)
+  if ((socketfd>=0)&&(!frameStreamOpen))
     closeSocket();
 
   return result;
@@ -22,6 +22,8 @@
 
 #include <GraphicObject.h>
 #include <Screen.h>
+#include <DeviceFrameEncoder.h>
+#include <DeviceFrameDecoder.h>
 
 #ifndef DEVICE_H_
 #define DEVICE_H_
@@ -85,6 +87,24 @@ protected:
   // Indicates if this device is a watch
   bool isWatch;
 
+  // Encodes the frames sent to a network device
+  DeviceFrameEncoder *frameEncoder;
+
+  // Reconstructs the sent frames to verify them (NULL if disabled)
+  DeviceFrameDecoder *frameVerifier;
+
+  // Indicates if the network device understands frame streams
+  bool frameStreamSupported;
+
+  // Indicates if the socket is used for a frame stream
+  bool frameStreamOpen;
+
+  // Opens a persistent connection for sending frames
+  bool openFrameStream();
+
+  // Reads data from a network device
+  bool receive(UByte *buffer, Int length);
+
 public:
 
   // Constructor
@@ -114,6 +134,9 @@ public:
   // Informs the device that a PNG is sent
   bool announcePNGImage();
 
+  // Sends the changes of the screen to a network device
+  bool sendFrame(ImagePixel *pixels, Int width, Int height, UInt pixelSize, bool inverseRows);
+
   // Sends data to a network device
   bool send(UByte *buffer, Int length);
 
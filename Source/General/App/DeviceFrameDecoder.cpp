@@ -0,0 +1,97 @@
+//============================================================================
+// Name        : DeviceFrameDecoder.cpp
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <Core.h>
+#include <DeviceFrameDecoder.h>
+#include <zlib.h>
+
+namespace GEODISCOVERER {
+
+// Constructor
+DeviceFrameDecoder::DeviceFrameDecoder() {
+  width=0;
+  height=0;
+}
+
+// Destructor
+DeviceFrameDecoder::~DeviceFrameDecoder() {
+}
+
+// Applies the encoded frame and returns false if it is malformed
+bool DeviceFrameDecoder::decode(const UByte *packet, Int packetSize, UInt &frameNumber) {
+
+  // Read the header
+  if (packetSize<DeviceFrameEncoder::headerSize)
+    return false;
+  frameNumber=readUInt(&packet[0]);
+  UInt flags=readUInt(&packet[4]);
+  Int width=readUInt(&packet[8]);
+  Int height=readUInt(&packet[12]);
+  Int tileSize=readUInt(&packet[16]);
+  Int tileCount=readUInt(&packet[20]);
+  uLongf uncompressedSize=readUInt(&packet[24]);
+  Int compressedSize=readUInt(&packet[28]);
+  if ((tileSize<=0)||(compressedSize!=packetSize-DeviceFrameEncoder::headerSize))
+    return false;
+
+  // Changes can only be applied to a frame of the same dimension
+  if (flags&DeviceFrameFlagKeyFrame) {
+    this->width=width;
+    this->height=height;
+    frame.assign(width*height*3,0);
+  } else if ((width!=this->width)||(height!=this->height)) {
+    return false;
+  }
+
+  // Uncompress the tiles
+  tiles.resize(uncompressedSize);
+  if ((uncompressedSize>0)&&(uncompress(&tiles[0],&uncompressedSize,&packet[DeviceFrameEncoder::headerSize],compressedSize)!=Z_OK))
+    return false;
+  if (uncompressedSize!=tiles.size())
+    return false;
+
+  // Copy the tiles into the frame
+  Int pos=0;
+  for (Int i=0;i<tileCount;i++) {
+    if (pos+4>tiles.size())
+      return false;
+    Int column=(((Int)tiles[pos])<<8)|tiles[pos+1];
+    Int row=(((Int)tiles[pos+2])<<8)|tiles[pos+3];
+    pos+=4;
+    Int x0=column*tileSize;
+    Int y0=row*tileSize;
+    if ((x0>=width)||(y0>=height))
+      return false;
+    Int x1=x0+tileSize<width ? x0+tileSize : width;
+    Int y1=y0+tileSize<height ? y0+tileSize : height;
+    Int rowSize=(x1-x0)*3;
+    if (pos+rowSize*(y1-y0)>tiles.size())
+      return false;
+    for (Int y=y0;y<y1;y++) {
+      memcpy(&frame[(y*width+x0)*3],&tiles[pos],rowSize);
+      pos+=rowSize;
+    }
+  }
+  return pos==tiles.size();
+}
+
+} /* namespace GEODISCOVERER */
@@ -0,0 +1,65 @@
+//============================================================================
+// Name        : DeviceFrameDecoder.h
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <DeviceFrameEncoder.h>
+
+#ifndef DEVICEFRAMEDECODER_H_
+#define DEVICEFRAMEDECODER_H_
+
+namespace GEODISCOVERER {
+
+// Reconstructs frames from the output of the frame encoder
+// Does the same as the dashboard app and is used to verify the encoded frames
+class DeviceFrameDecoder {
+
+protected:
+
+  std::vector<UByte> frame;               // Reconstructed frame (RGB, top to bottom)
+  std::vector<UByte> tiles;               // Uncompressed tiles of the current frame
+  Int width;                              // Width of the frame
+  Int height;                             // Height of the frame
+
+  // Reads a big endian 32 bit value
+  static UInt readUInt(const UByte *buffer) {
+    return (((UInt)buffer[0])<<24)|(((UInt)buffer[1])<<16)|(((UInt)buffer[2])<<8)|((UInt)buffer[3]);
+  }
+
+public:
+
+  // Constructor
+  DeviceFrameDecoder();
+
+  // Destructor
+  virtual ~DeviceFrameDecoder();
+
+  // Applies the encoded frame and returns false if it is malformed
+  bool decode(const UByte *packet, Int packetSize, UInt &frameNumber);
+
+  // Getters and setters
+  const std::vector<UByte> &getFrame() const {
+    return frame;
+  }
+};
+
+} /* namespace GEODISCOVERER */
+
+#endif /* DEVICEFRAMEDECODER_H_ */
@@ -0,0 +1,153 @@
+//============================================================================
+// Name        : DeviceFrameEncoder.cpp
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <Core.h>
+#include <DeviceFrameEncoder.h>
+#include <zlib.h>
+
+namespace GEODISCOVERER {
+
+const Int DeviceFrameEncoder::headerSize = 8*4;
+
+// Appends a big endian 32 bit value
+static void appendUInt(std::vector<UByte> &buffer, UInt value) {
+  buffer.push_back((value>>24)&0xFF);
+  buffer.push_back((value>>16)&0xFF);
+  buffer.push_back((value>>8)&0xFF);
+  buffer.push_back(value&0xFF);
+}
+
+// Constructor
+DeviceFrameEncoder::DeviceFrameEncoder(Int tileSize, Int compressionLevel) {
+  this->tileSize=tileSize;
+  this->compressionLevel=compressionLevel;
+  width=0;
+  height=0;
+  hasReference=false;
+  frameNumber=0;
+  tileCount=0;
+}
+
+// Destructor
+DeviceFrameEncoder::~DeviceFrameEncoder() {
+}
+
+// Indicates if the tile differs from the reference frame
+bool DeviceFrameEncoder::tileHasChanged(Int x0, Int y0, Int x1, Int y1) const {
+  Int rowSize=(x1-x0)*3;
+  for (Int y=y0;y<y1;y++) {
+    Int offset=(y*width+x0)*3;
+    if (memcmp(&pending[offset],&reference[offset],rowSize)!=0)
+      return true;
+  }
+  return false;
+}
+
+// Encodes the frame and returns false if nothing has changed
+bool DeviceFrameEncoder::encode(const ImagePixel *pixels, Int width, Int height, UInt pixelSize, bool inverseRows) {
+
+  // A changed dimension requires a key frame
+  if ((width!=this->width)||(height!=this->height)) {
+    this->width=width;
+    this->height=height;
+    hasReference=false;
+  }
+
+  // Copy the frame as RGB from top to bottom
+  pending.resize(width*height*3);
+  for (Int y=0;y<height;y++) {
+    Int y2=inverseRows ? height-1-y : y;
+    const ImagePixel *src=&pixels[y2*width*pixelSize];
+    UByte *dst=&pending[y*width*3];
+    if (pixelSize==3) {
+      memcpy(dst,src,width*3);
+    } else {
+      for (Int x=0;x<width;x++) {
+        dst[x*3+0]=src[x*pixelSize+0];
+        dst[x*3+1]=src[x*pixelSize+1];
+        dst[x*3+2]=src[x*pixelSize+2];
+      }
+    }
+  }
+
+  // Collect all tiles that differ from the acknowledged frame
+  bool keyFrame=!hasReference;
+  tiles.clear();
+  tileCount=0;
+  Int columns=(width+tileSize-1)/tileSize;
+  Int rows=(height+tileSize-1)/tileSize;
+  for (Int row=0;row<rows;row++) {
+    for (Int column=0;column<columns;column++) {
+      Int x0=column*tileSize;
+      Int y0=row*tileSize;
+      Int x1=x0+tileSize<width ? x0+tileSize : width;
+      Int y1=y0+tileSize<height ? y0+tileSize : height;
+      if ((!keyFrame)&&(!tileHasChanged(x0,y0,x1,y1)))
+        continue;
+      tiles.push_back((column>>8)&0xFF);
+      tiles.push_back(column&0xFF);
+      tiles.push_back((row>>8)&0xFF);
+      tiles.push_back(row&0xFF);
+      for (Int y=y0;y<y1;y++) {
+        const UByte *src=&pending[(y*width+x0)*3];
+        tiles.insert(tiles.end(),src,src+(x1-x0)*3);
+      }
+      tileCount++;
+    }
+  }
+  if (tileCount==0)
+    return false;
+
+  // Compress the tiles and create the packet
+  uLongf compressedSize=compressBound(tiles.size());
+  packet.resize(headerSize+compressedSize);
+  if (compress2(&packet[headerSize],&compressedSize,&tiles[0],tiles.size(),compressionLevel)!=Z_OK) {
+    FATAL("can not compress frame",NULL);
+    return false;
+  }
+  packet.resize(headerSize+compressedSize);
+  std::vector<UByte> header;
+  frameNumber++;
+  appendUInt(header,frameNumber);
+  appendUInt(header,keyFrame ? DeviceFrameFlagKeyFrame : 0);
+  appendUInt(header,width);
+  appendUInt(header,height);
+  appendUInt(header,tileSize);
+  appendUInt(header,tileCount);
+  appendUInt(header,tiles.size());
+  appendUInt(header,compressedSize);
+  memcpy(&packet[0],&header[0],headerSize);
+  return true;
+}
+
+// Makes the last encoded frame the reference for the next one
+void DeviceFrameEncoder::acknowledge() {
+  reference.swap(pending);
+  hasReference=true;
+}
+
+// Forces a key frame as the next frame
+void DeviceFrameEncoder::reset() {
+  hasReference=false;
+}
+
+} /* namespace GEODISCOVERER */
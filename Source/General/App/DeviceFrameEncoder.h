@@ -0,0 +1,103 @@
+//============================================================================
+// Name        : DeviceFrameEncoder.h
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <Image.h>
+
+#ifndef DEVICEFRAMEENCODER_H_
+#define DEVICEFRAMEENCODER_H_
+
+namespace GEODISCOVERER {
+
+// Flags of a frame
+enum { DeviceFrameFlagKeyFrame = 1 };
+
+// Encodes screen frames as changes against the last acknowledged frame
+//
+// A frame consists of a header with big endian 32 bit values
+//   frame number, flags, width, height, tile size, tile count, uncompressed size, compressed size
+// followed by the zlib compressed tiles. Each tile starts with its big endian
+// 16 bit column and row, followed by its RGB pixels from top to bottom, clipped
+// at the right and bottom border of the frame. Key frames contain all tiles.
+class DeviceFrameEncoder {
+
+protected:
+
+  std::vector<UByte> reference;           // Last acknowledged frame (RGB, top to bottom)
+  std::vector<UByte> pending;             // Frame that waits for its acknowledgement
+  std::vector<UByte> tiles;               // Uncompressed tiles of the current frame
+  std::vector<UByte> packet;              // Encoded frame
+  Int width;                              // Width of the frames
+  Int height;                             // Height of the frames
+  bool hasReference;                      // Indicates if the receiver has a frame to apply changes to
+  UInt frameNumber;                       // Number of the last encoded frame
+  Int tileSize;                           // Width and height of a tile in pixels
+  Int compressionLevel;                   // zlib compression level
+  Int tileCount;                          // Number of tiles in the last encoded frame
+
+  // Indicates if the tile differs from the reference frame
+  bool tileHasChanged(Int x0, Int y0, Int x1, Int y1) const;
+
+public:
+
+  // Size of the frame header in bytes
+  static const Int headerSize;
+
+  // Constructor
+  DeviceFrameEncoder(Int tileSize, Int compressionLevel);
+
+  // Destructor
+  virtual ~DeviceFrameEncoder();
+
+  // Encodes the frame and returns false if nothing has changed
+  bool encode(const ImagePixel *pixels, Int width, Int height, UInt pixelSize, bool inverseRows);
+
+  // Makes the last encoded frame the reference for the next one
+  void acknowledge();
+
+  // Forces a key frame as the next frame
+  void reset();
+
+  // Getters and setters
+  const UByte *getPacket() const {
+    return &packet[0];
+  }
+
+  Int getPacketSize() const {
+    return packet.size();
+  }
+
+  UInt getFrameNumber() const {
+    return frameNumber;
+  }
+
+  Int getTileCount() const {
+    return tileCount;
+  }
+
+  const std::vector<UByte> &getPendingFrame() const {
+    return pending;
+  }
+};
+
+} /* namespace GEODISCOVERER */
+
+#endif /* DEVICEFRAMEENCODER_H_ */
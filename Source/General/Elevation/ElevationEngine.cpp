@@ -40,6 +40,15 @@ ElevationEngine::ElevationEngine() {
   hSrcSRS=NULL;
   hCT=NULL;
   hBand=NULL;
+  hCTFullRes=NULL;
+  hCTLowRes=NULL;
+  nativeHillshadeRendering=core->getConfigStore()->getIntValue("MapTileServer","nativeHillshadeRendering",__FILE__,__LINE__);
+  compareHillshadeRenderers=core->getConfigStore()->getIntValue("MapTileServer","compareHillshadeRenderers",__FILE__,__LINE__);
+  demBlockCacheMutex=core->getThread()->createMutex("elevation engine dem block cache mutex");
+  demBlockCacheSize=0;
+  demBlockCacheMaxSize=(Long)core->getConfigStore()->getIntValue("MapTileServer","demBlockCacheSize",__FILE__,__LINE__)*1024*1024;
+  demBlockCacheHits=0;
+  demBlockCacheMisses=0;
   
   // Create the DEM directory (if it does not exist)
   struct stat st;
@@ -68,12 +77,353 @@ ElevationEngine::ElevationEngine() {
     }
   }
   closedir(dfd);
+
+#ifdef DEBUG_CHECKS_ENABLED
+  // Check the hillshade kernels
+  checkHillshadeKernels();
+#endif
 }
 
 // Destructor
 ElevationEngine::~ElevationEngine() {
   deinit();
+  core->getThread()->destroyMutex(demBlockCacheMutex);
   core->getThread()->destroyMutex(accessMutex);
 }
 
+// Copies a window of the DEM (in pixels of the given decimation level) using the block cache
+bool ElevationEngine::copyDEMWindow(DEMDataset *demDataset, bool lowRes, Int decimationLevel, Int demWidth, Int demHeight, Int x1, Int y1, Int x2, Int y2, float *window) {
+  Int decimation=1<<decimationLevel;
+  Int decimatedWidth=(demWidth+decimation-1)/decimation;
+  Int decimatedHeight=(demHeight+decimation-1)/decimation;
+  if ((x1<0)||(y1<0)||(x2>decimatedWidth)||(y2>decimatedHeight)||(x1>=x2)||(y1>=y2))
+    return false;
+  Int windowWidth=x2-x1;
+
+  // Go through all blocks that overlap the window
+  for (Int blockY=y1/demBlockLength;blockY<=(y2-1)/demBlockLength;blockY++) {
+    for (Int blockX=x1/demBlockLength;blockX<=(x2-1)/demBlockLength;blockX++) {
+
+      // Read the block if it is not cached
+      ULong key=getDEMBlockKey(lowRes,decimationLevel,blockX,blockY);
+      core->getThread()->lockMutex(demBlockCacheMutex,__FILE__,__LINE__);
+      std::unordered_map<ULong, DEMBlock>::iterator i=demBlocks.find(key);
+      if (i==demBlocks.end()) {
+        demBlockCacheMisses++;
+        core->getThread()->unlockMutex(demBlockCacheMutex);
+        DEMBlock block;
+        if (!(block.elevations=readDEMBlock(demDataset,decimationLevel,blockX,blockY,block.width,block.height)))
+          return false;
+        core->getThread()->lockMutex(demBlockCacheMutex,__FILE__,__LINE__);
+
+        // Another worker might have read the same block in the meantime
+        i=demBlocks.find(key);
+        if (i==demBlocks.end()) {
+          demBlocksByUse.push_front(key);
+          block.usePos=demBlocksByUse.begin();
+          i=demBlocks.insert(std::pair<ULong, DEMBlock>(key,block)).first;
+          demBlockCacheSize+=block.width*block.height*sizeof(float);
+        } else {
+          free(block.elevations);
+        }
+      } else {
+        demBlockCacheHits++;
+        demBlocksByUse.splice(demBlocksByUse.begin(),demBlocksByUse,i->second.usePos);
+      }
+
+      // Copy the overlapping part
+      DEMBlock &block=i->second;
+      Int blockX1=blockX*demBlockLength;
+      Int blockY1=blockY*demBlockLength;
+      Int copyX1=std::max(x1,blockX1);
+      Int copyX2=std::min(x2,blockX1+block.width);
+      Int copyY1=std::max(y1,blockY1);
+      Int copyY2=std::min(y2,blockY1+block.height);
+      for (Int y=copyY1;y<copyY2;y++) {
+        memcpy(&window[(y-y1)*windowWidth+copyX1-x1],&block.elevations[(y-blockY1)*block.width+copyX1-blockX1],(copyX2-copyX1)*sizeof(float));
+      }
+
+      // Remove the least recently used blocks if the cache is full
+      // The block just used is kept in any case
+      while ((demBlockCacheSize>demBlockCacheMaxSize)&&(demBlocksByUse.size()>1)) {
+        std::unordered_map<ULong, DEMBlock>::iterator j=demBlocks.find(demBlocksByUse.back());
+        demBlockCacheSize-=j->second.width*j->second.height*sizeof(float);
+        free(j->second.elevations);
+        demBlocks.erase(j);
+        demBlocksByUse.pop_back();
+      }
+      core->getThread()->unlockMutex(demBlockCacheMutex);
+    }
+  }
+  return true;
+}
+
+// Removes all blocks from the DEM block cache
+void ElevationEngine::clearDEMBlockCache() {
+  core->getThread()->lockMutex(demBlockCacheMutex,__FILE__,__LINE__);
+  for (std::unordered_map<ULong, DEMBlock>::iterator i=demBlocks.begin();i!=demBlocks.end();i++) {
+    free(i->second.elevations);
+  }
+  demBlocks.clear();
+  demBlocksByUse.clear();
+  demBlockCacheSize=0;
+  core->getThread()->unlockMutex(demBlockCacheMutex);
+}
+
+// Outputs the statistics of the DEM block cache
+void ElevationEngine::outputStats() {
+  core->getThread()->lockMutex(demBlockCacheMutex,__FILE__,__LINE__);
+  Int requests=demBlockCacheHits+demBlockCacheMisses;
+  double hitRate=(requests>0) ? (double)demBlockCacheHits/(double)requests*100.0 : 0;
+  DEBUG("DEM block cache: hits=%d misses=%d hitRate=%.1f%% size=%.1f MB",demBlockCacheHits,demBlockCacheMisses,hitRate,(double)demBlockCacheSize/1024.0/1024.0);
+  core->getThread()->unlockMutex(demBlockCacheMutex);
+}
+
+// Interpolates the DEM at the given pixel positions with cubic convolution
+// Positions outside the DEM area are marked as missing (NAN) like GDAL's warper does
+void ElevationEngine::resampleDEM(const float *dem, Int demWidth, Int demHeight, float validX1, float validY1, float validX2, float validY2, const double *demX, const double *demY, Int count, float *elevations) {
+  const float a=-0.5; // same kernel as GDAL's cubic resampling
+  const Int blockLength=256;
+  Int x0[blockLength],y0[blockLength];
+  float wx[4][blockLength],wy[4][blockLength];
+  Int outside[blockLength];
+  for (Int start=0;start<count;start+=blockLength) {
+    Int n=std::min(blockLength,count-start);
+
+    // Compute the sample positions and the kernel weights of the whole block
+    // This loop is branch free to allow the compiler to vectorize it
+    for (Int i=0;i<n;i++) {
+      float x=demX[start+i];
+      float y=demY[start+i];
+      outside[i]=(x<validX1)|(x>=validX2)|(y<validY1)|(y>=validY2);
+
+      // Positions refer to the pixel corner, samples to the pixel center
+      x-=0.5f;
+      y-=0.5f;
+      float fx=floorf(x);
+      float fy=floorf(y);
+      x0[i]=(Int)fx;
+      y0[i]=(Int)fy;
+      float tx=x-fx;
+      float ty=y-fy;
+      float sx=1-tx;
+      float sy=1-ty;
+      wx[0][i]=a*tx*sx*sx;
+      wx[1][i]=((a+2)*tx-(a+3))*tx*tx+1;
+      wx[2][i]=((a+2)*sx-(a+3))*sx*sx+1;
+      wx[3][i]=a*sx*tx*tx;
+      wy[0][i]=a*ty*sy*sy;
+      wy[1][i]=((a+2)*ty-(a+3))*ty*ty+1;
+      wy[2][i]=((a+2)*sy-(a+3))*sy*sy+1;
+      wy[3][i]=a*sy*ty*ty;
+    }
+
+    // Sum up the neighbors (clamped at the border of the DEM block)
+    // Missing data (NAN) spreads to all affected pixels
+    for (Int i=0;i<n;i++) {
+      if (outside[i]) {
+        elevations[start+i]=NAN;
+        continue;
+      }
+      Int cx[4];
+      for (Int k=0;k<4;k++) {
+        cx[k]=std::min(std::max(x0[i]-1+k,0),demWidth-1);
+      }
+      float sum=0;
+      for (Int l=0;l<4;l++) {
+        const float *row=&dem[std::min(std::max(y0[i]-1+l,0),demHeight-1)*demWidth];
+        sum+=wy[l][i]*(wx[0][i]*row[cx[0]]+wx[1][i]*row[cx[1]]+wx[2][i]*row[cx[2]]+wx[3][i]*row[cx[3]]);
+      }
+      elevations[start+i]=sum;
+    }
+  }
+}
+
+// Computes the hillshade of the elevations (Horn or Zevenbergen-Thorne like gdaldem)
+void ElevationEngine::computeHillshade(const float *elevations, Int width, Int height, double resolution, bool zevenbergenThorne, ImagePixel *hillshade) {
+
+  // Prepare the constants for an azimuth of 315 deg, an altitude of 45 deg and a z factor of 2
+  const double degreesToRadians=M_PI/180.0;
+  const double z=2.0/((zevenbergenThorne ? 2 : 8)*1.0);
+  const double azimuth=315.0*degreesToRadians;
+  const double altitude=45.0*degreesToRadians;
+  const float invEWRes=1.0/resolution;
+  const float invNSRes=-1.0/resolution;
+  const float sinAltitude254=254.0*sin(altitude);
+  const float cosAzimuthCosAltitudeZ254=254.0*cos(azimuth)*cos(altitude)*z;
+  const float sinAzimuthCosAltitudeZ254=254.0*sin(azimuth)*cos(altitude)*z;
+  const float squareZ=z*z;
+
+  // Reserve memory for the intermediate results of one row
+  float *gx=(float*)malloc(3*width*sizeof(float));
+  if (!gx) {
+    FATAL("can not reserve memory",NULL);
+    return;
+  }
+  float *gy=&gx[width];
+  float *shade=&gx[2*width];
+
+  // Border pixels have no neighbors and are marked as missing like gdaldem does
+  memset(hillshade,0,width);
+  memset(&hillshade[(height-1)*width],0,width);
+  for (Int y=1;y<height-1;y++) {
+    const float *r0=&elevations[(y-1)*width];
+    const float *r1=&elevations[y*width];
+    const float *r2=&elevations[(y+1)*width];
+    ImagePixel *out=&hillshade[y*width];
+    out[0]=0;
+    out[width-1]=0;
+
+    // Compute the gradient of the row
+    // The loops are split into simple float operations to allow the compiler to vectorize them
+    if (zevenbergenThorne) {
+      for (Int x=1;x<width-1;x++) {
+        gx[x]=(r1[x-1]-r1[x+1])*invEWRes;
+        gy[x]=(r2[x]-r0[x])*invNSRes;
+      }
+    } else {
+      for (Int x=1;x<width-1;x++) {
+        gx[x]=((r0[x-1]+2*r1[x-1]+r2[x-1])-(r0[x+1]+2*r1[x+1]+r2[x+1]))*invEWRes;
+        gy[x]=((r2[x-1]+2*r2[x]+r2[x+1])-(r0[x-1]+2*r0[x]+r0[x+1]))*invNSRes;
+      }
+    }
+
+    // Compute the shade of the row
+    for (Int x=1;x<width-1;x++) {
+      float s=(sinAltitude254-(gy[x]*cosAzimuthCosAltitudeZ254-gx[x]*sinAzimuthCosAltitudeZ254))/sqrtf(1+squareZ*(gx[x]*gx[x]+gy[x]*gy[x]));
+      shade[x]=1.0f+std::max(s,0.0f);
+    }
+
+    // Any missing elevation in the window results in a missing shade
+    for (Int x=1;x<width-1;x++) {
+      float sum=r0[x-1]+r0[x]+r0[x+1]+r1[x-1]+r1[x]+r1[x+1]+r2[x-1]+r2[x]+r2[x+1];
+      shade[x]=(sum!=sum) ? 0.0f : shade[x]+0.5f;
+    }
+    for (Int x=1;x<width-1;x++) {
+      out[x]=(ImagePixel)shade[x];
+    }
+  }
+  free(gx);
+}
+
+#ifdef DEBUG_CHECKS_ENABLED
+
+// Compares the hillshade kernels against a straightforward implementation on a synthetic DEM
+void ElevationEngine::checkHillshadeKernels() {
+
+  // Create a DEM with slopes in all directions and a hole of missing data
+  const Int demWidth=64;
+  const Int demHeight=48;
+  const Int width=80;
+  const Int height=70;
+  const Int count=width*height;
+  float *dem=(float*)malloc(demWidth*demHeight*sizeof(float));
+  double *demX=(double*)malloc(count*sizeof(double));
+  double *demY=(double*)malloc(count*sizeof(double));
+  float *elevations=(float*)malloc(count*sizeof(float));
+  ImagePixel *hillshade=(ImagePixel*)malloc(count);
+  if ((!dem)||(!demX)||(!demY)||(!elevations)||(!hillshade)) {
+    FATAL("can not reserve memory",NULL);
+    return;
+  }
+  for (Int y=0;y<demHeight;y++) {
+    for (Int x=0;x<demWidth;x++) {
+      dem[y*demWidth+x]=500+300*sin(x*0.21)*cos(y*0.17)+7*x-3*y;
+    }
+  }
+  dem[20*demWidth+30]=NAN;
+
+  // Sample positions that partly lie outside of the DEM
+  for (Int y=0;y<height;y++) {
+    for (Int x=0;x<width;x++) {
+      demX[y*width+x]=-6.3+x*0.93+y*0.02;
+      demY[y*width+x]=-4.7+y*0.81-x*0.03;
+    }
+  }
+
+  // Check the resampling
+  const float a=-0.5;
+  bool failed=false;
+  resampleDEM(dem,demWidth,demHeight,0,0,demWidth,demHeight,demX,demY,count,elevations);
+  for (Int i=0;(i<count)&&(!failed);i++) {
+    double expected=NAN;
+    if ((demX[i]>=0)&&(demX[i]<demWidth)&&(demY[i]>=0)&&(demY[i]<demHeight)) {
+      double x=demX[i]-0.5;
+      double y=demY[i]-0.5;
+      Int x0=floor(x);
+      Int y0=floor(y);
+      expected=0;
+      for (Int l=0;l<4;l++) {
+        double t=fabs(y-(y0-1+l));
+        double w=(t<=1) ? ((a+2)*t-(a+3))*t*t+1 : a*t*t*t-5*a*t*t+8*a*t-4*a;
+        for (Int k=0;k<4;k++) {
+          double s=fabs(x-(x0-1+k));
+          double v=(s<=1) ? ((a+2)*s-(a+3))*s*s+1 : a*s*s*s-5*a*s*s+8*a*s-4*a;
+          Int cx=std::min(std::max(x0-1+k,0),demWidth-1);
+          Int cy=std::min(std::max(y0-1+l,0),demHeight-1);
+          expected+=w*v*dem[cy*demWidth+cx];
+        }
+      }
+    }
+    if ((expected!=expected)!=(elevations[i]!=elevations[i])) {
+      ERROR("resampled elevation %d is %f instead of %f",i,elevations[i],expected);
+      failed=true;
+    } else if ((expected==expected)&&(fabs(expected-elevations[i])>0.01)) {
+      ERROR("resampled elevation %d is %f instead of %f",i,elevations[i],expected);
+      failed=true;
+    }
+  }
+
+  // Check the hillshade
+  for (Int zevenbergenThorne=0;zevenbergenThorne<=1;zevenbergenThorne++) {
+    const double resolution=8.5;
+    computeHillshade(elevations,width,height,resolution,zevenbergenThorne,hillshade);
+    const double z=2.0/((zevenbergenThorne ? 2 : 8)*1.0);
+    const double azimuth=315.0*M_PI/180.0;
+    const double altitude=45.0*M_PI/180.0;
+    for (Int y=0;(y<height)&&(!failed);y++) {
+      for (Int x=0;(x<width)&&(!failed);x++) {
+        Int expected=0;
+        if ((x>0)&&(y>0)&&(x<width-1)&&(y<height-1)) {
+          const float *e=&elevations[(y-1)*width+x-1];
+          double n[3][3];
+          bool missing=false;
+          for (Int j=0;j<3;j++) {
+            for (Int i=0;i<3;i++) {
+              n[j][i]=e[j*width+i];
+              if (e[j*width+i]!=e[j*width+i])
+                missing=true;
+            }
+          }
+          if (!missing) {
+            double gx,gy;
+            if (zevenbergenThorne) {
+              gx=(n[1][0]-n[1][2])/resolution;
+              gy=-(n[2][1]-n[0][1])/resolution;
+            } else {
+              gx=((n[0][0]+2*n[1][0]+n[2][0])-(n[0][2]+2*n[1][2]+n[2][2]))/resolution;
+              gy=-((n[2][0]+2*n[2][1]+n[2][2])-(n[0][0]+2*n[0][1]+n[0][2]))/resolution;
+            }
+            double shade=254.0*(sin(altitude)-(gy*cos(azimuth)*cos(altitude)*z-gx*sin(azimuth)*cos(altitude)*z))/sqrt(1+z*z*(gx*gx+gy*gy));
+            expected=(shade<=0.0) ? 1 : (Int)(1.0+shade+0.5);
+          }
+        }
+        if (abs(expected-(Int)hillshade[y*width+x])>1) {
+          ERROR("hillshade pixel (%d,%d) is %d instead of %d",x,y,hillshade[y*width+x],expected);
+          failed=true;
+        }
+      }
+    }
+  }
+  if (!failed)
+    DEBUG("hillshade kernels match the reference implementation",NULL);
+  free(hillshade);
+  free(elevations);
+  free(demY);
+  free(demX);
+  free(dem);
+}
+
+#endif
+
 }
@@ -22,12 +22,21 @@
 
 #include <MapArea.h>
 #include <ElevationEnginePlatform.h>
+#include <Image.h>
 
 #ifndef ELEVATIONENGINE_H_
 #define ELEVATIONENGINE_H_
 
 namespace GEODISCOVERER {
 
+// Block of elevations read from a DEM dataset
+typedef struct DEMBlock {
+  Int width;                                      // Number of columns
+  Int height;                                     // Number of rows
+  float *elevations;                              // Elevations (NAN if missing)
+  std::list<ULong>::iterator usePos;              // Position in the list of recently used blocks
+} DEMBlock;
+
 class ElevationEngine {
 
 protected:
@@ -42,6 +51,16 @@ protected:
   bool *demDatasetBusy;                           // Indicates if the given dataset is in use
   ThreadSignalInfo *demDatasetReadySignal;        // Indicates that one of the datasets is not busy anymore
   Int tileNumber;                                 // Continous number for creating a unique filename for hillshading
+  bool nativeHillshadeRendering;                  // Indicates if hillshades are computed directly from the DEM data instead of using GDAL's tools
+  bool compareHillshadeRenderers;                 // Indicates if the native hillshade shall be compared against the one from GDAL's tools
+  static const Int demBlockLength=256;            // Width and height of a cached DEM block
+  std::unordered_map<ULong, DEMBlock> demBlocks;  // Cached DEM blocks shared by all workers
+  std::list<ULong> demBlocksByUse;                // Keys of the cached DEM blocks (most recently used first)
+  ThreadMutexInfo *demBlockCacheMutex;            // Mutex for accessing the DEM block cache
+  Long demBlockCacheSize;                         // Memory used by the cached DEM blocks in bytes
+  Long demBlockCacheMaxSize;                      // Maximum memory for the cached DEM blocks in bytes
+  Int demBlockCacheHits;                          // Number of DEM blocks found in the cache
+  Int demBlockCacheMisses;                        // Number of DEM blocks that had to be read
 
   // For querying altitude from a coordinate
   char *pszSourceSRS;
@@ -51,6 +70,11 @@ protected:
   double adfInvGeoTransform[6] = {};
   GDALRasterBandH hBand;
 
+  // For rendering hillshades natively (one per worker)
+  DEMCoordinateTransformation *hCTFullRes;
+  DEMCoordinateTransformation *hCTLowRes;
+  double adfInvGeoTransformLowRes[6] = {};
+
   // Converts a tile y number into latitude
   double tiley2lat(Int y, Int worldRes);
 
@@ -60,6 +84,37 @@ protected:
   // Resets dem dataset busy indicator for the given worker number
   void resetDemDatasetBusy(Int workerNr);
 
+  // Renders the hillshade of the given mercator area with GDAL's warp and DEM processing tools
+  ImagePixel *renderHillshadeWithGDAL(DEMDataset *demDataset, Int z, double mercatorX1, double mercatorY1, double mercatorX2, double mercatorY2, Int width, Int height);
+
+  // Renders the hillshade of the given mercator area directly from the DEM data
+  ImagePixel *renderHillshadeNatively(DEMDataset *demDataset, bool lowRes, DEMCoordinateTransformation demTransform, double *demInvGeoTransform, Int z, double mercatorX1, double mercatorY1, double mercatorX2, double mercatorY2, Int width, Int height);
+
+  // Returns the key of a DEM block
+  static ULong getDEMBlockKey(bool lowRes, Int decimationLevel, Int blockX, Int blockY) {
+    return ((ULong)lowRes<<63)|((ULong)decimationLevel<<58)|((ULong)blockY<<29)|(ULong)blockX;
+  }
+
+  // Reads a block from the DEM dataset (each value is the average of 2^decimationLevel x 2^decimationLevel pixels)
+  float *readDEMBlock(DEMDataset *demDataset, Int decimationLevel, Int blockX, Int blockY, Int &width, Int &height);
+
+  // Copies a window of the DEM (in pixels of the given decimation level) using the block cache
+  bool copyDEMWindow(DEMDataset *demDataset, bool lowRes, Int decimationLevel, Int demWidth, Int demHeight, Int x1, Int y1, Int x2, Int y2, float *window);
+
+  // Removes all blocks from the DEM block cache
+  void clearDEMBlockCache();
+
+  // Interpolates the DEM at the given pixel positions with cubic convolution
+  static void resampleDEM(const float *dem, Int demWidth, Int demHeight, float validX1, float validY1, float validX2, float validY2, const double *demX, const double *demY, Int count, float *elevations);
+
+  // Computes the hillshade of the elevations (Horn or Zevenbergen-Thorne like gdaldem)
+  static void computeHillshade(const float *elevations, Int width, Int height, double resolution, bool zevenbergenThorne, ImagePixel *hillshade);
+
+#ifdef DEBUG_CHECKS_ENABLED
+  // Compares the hillshade kernels against a straightforward implementation on a synthetic DEM
+  static void checkHillshadeKernels();
+#endif
+
 public:
 
   // Constructurs and destructor
@@ -78,6 +133,9 @@ public:
   // Returns the altitude of the given position
   bool getElevation(MapPosition *pos);
 
+  // Outputs the statistics of the DEM block cache
+  void outputStats();
+
   // Getters and setters
   bool getIsInitialized() const
   {
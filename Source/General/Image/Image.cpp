@@ -27,9 +27,9 @@ namespace GEODISCOVERER {
 
 Image::Image() {
   iconFolder=core->getHomePath() + "/Icon";
-  abortLoad=false;
   initJPEG();
   initPNG();
+  initKernels();
 }
 
 Image::~Image() {
@@ -266,7 +266,7 @@ void Image::hsvFilter(ImagePixel *image, Int width, Int height, UInt pixelSize,
 UByte *Image::hsvFilter(UByte *pngData, UInt &pngSize, double hOffset, double sOffset, double vOffset) {
 	Int width,height;
 	UInt pixelSize;
-  ImagePixel *pixels=loadPNG(pngData,pngSize,width,height,pixelSize,false);
+  ImagePixel *pixels=loadPNG(pngData,pngSize,width,height,pixelSize,NULL);
   if (!pixels) {
     DEBUG("can not read png image data",NULL);
     return NULL;		
@@ -282,7 +282,7 @@ UByte *Image::hsvFilter(UByte *pngData, UInt &pngSize, double hOffset, double sO
 bool Image::brightnessFilter(std::string pngFilename, Int brightnessOffset) {
 	Int width,height;
 	UInt pixelSize;
-  ImagePixel *pixels=loadPNG(pngFilename,width,height,pixelSize,false);
+  ImagePixel *pixels=loadPNG(pngFilename,width,height,pixelSize,NULL);
   if (!pixels) {
     DEBUG("can not read <%s>",pngFilename.c_str());
     return false;		
@@ -44,8 +44,14 @@ protected:
   // Size of a RGBA pixel
   static const UInt RGBAPixelSize = 4;
 
-  // Indicates that the current load operation shall be aborted
-  bool abortLoad;
+  // Indicates that the cpu supports SSSE3 instructions
+  bool ssse3Supported;
+
+  // Selects the pixel conversion kernels supported by the cpu
+  void initKernels();
+
+  // Compares the pixel conversion kernels with the per-pixel path and measures their speed
+  void benchmarkKernels();
 
   // Inits the jpeg part
   void initJPEG();
@@ -54,16 +60,16 @@ protected:
   void initPNG();
 
   // Writes a png
-  bool writePNG(ImagePixel *image, ImageOutputTargetType targetType, void *target, Int width, Int height, UInt pixelSize, bool inverseRows);
+  bool writePNG(ImagePixel *image, ImageOutputTargetType targetType, void *target, Int width, Int height, UInt pixelSize, bool inverseRows, Int compressionLevel=-1, Int rowFilter=-1);
 
   // Inits the reading of a PNG file
   bool initPNGRead(png_structp &png_ptr, png_infop &info_ptr);
 
   // Loads a png after the library has been prepared
-  ImagePixel *loadPNG(png_structp png_ptr, png_infop info_ptr, std::string imageDescription, Int &width, Int &height, UInt &pixelSize, bool calledByMapUpdateThread);
+  ImagePixel *loadPNG(png_structp png_ptr, png_infop info_ptr, std::string imageDescription, Int &width, Int &height, UInt &pixelSize, const std::atomic<bool> *abortLoad);
 
   // Loads a jpg after the library has been prepared
-  ImagePixel *loadJPEG(struct jpeg_decompress_struct *cinfo, std::string imageDescription, Int &width, Int &height, UInt &pixelSize, bool calledByMapUpdateThread);
+  ImagePixel *loadJPEG(struct jpeg_decompress_struct *cinfo, std::string imageDescription, Int &width, Int &height, UInt &pixelSize, const std::atomic<bool> *abortLoad);
 
 public:
 
@@ -76,16 +82,18 @@ public:
   bool queryJPEG(std::string filepath, Int &width, Int &height);
 
   // Loads a jpeg
-  ImagePixel *loadJPEG(UByte *imageData, UInt imageSize, Int &width, Int &height, UInt &pixelSize, bool calledByMapUpdateThread);
-  ImagePixel *loadJPEG(std::string filepath, Int &width, Int &height, UInt &pixelSize, bool calledByMapUpdateThread);
+  // The decoding stops and NULL is returned as soon as abortLoad (if given) is set
+  ImagePixel *loadJPEG(UByte *imageData, UInt imageSize, Int &width, Int &height, UInt &pixelSize, const std::atomic<bool> *abortLoad);
+  ImagePixel *loadJPEG(std::string filepath, Int &width, Int &height, UInt &pixelSize, const std::atomic<bool> *abortLoad);
 
   // Queries the dimension of the png without loading it
   bool queryPNG(std::string filepath, Int &width, Int &height);
-  bool queryPNG(UByte *imageData, UInt imageSize, Int &width, Int &height);
+  bool queryPNG(UByte *imageData, UInt imageSize, Int &width, Int &height, bool *hasAlpha=NULL);
 
   // Loads a png
-  ImagePixel *loadPNG(std::string filepath, Int &width, Int &height,UInt &pixelSize, bool calledByMapUpdateThread);
-  ImagePixel *loadPNG(UByte *imageData, UInt imageSize, Int &width, Int &height, UInt &pixelSize, bool calledByMapUpdateThread);
+  // The decoding stops and NULL is returned as soon as abortLoad (if given) is set
+  ImagePixel *loadPNG(std::string filepath, Int &width, Int &height,UInt &pixelSize, const std::atomic<bool> *abortLoad);
+  ImagePixel *loadPNG(UByte *imageData, UInt imageSize, Int &width, Int &height, UInt &pixelSize, const std::atomic<bool> *abortLoad);
 
   // Loads an PNG based icon
   // The correct file is determined from the screen dpi
@@ -98,13 +106,26 @@ public:
   bool writePNG(ImagePixel *image, Device *device, Int width, Int height, UInt pixelSize, bool inverseRows=false);
 
   // Writes a png to memory
-  UByte *writePNG(ImagePixel *image, Int width, Int height, UInt pixelSize, UInt &imageSize, bool inverseRows=false);
+  // The compression level (0-9) and the row filter (0=none, 1=sub, 2=up, 3=average, 4=paeth, 5=adaptive) use the library defaults if set to -1
+  UByte *writePNG(ImagePixel *image, Int width, Int height, UInt pixelSize, UInt &imageSize, bool inverseRows=false, Int compressionLevel=-1, Int rowFilter=-1);
 
-  // Aborts the current jpeg image loading
-  void setAbortLoad()
-  {
-      this->abortLoad = true;
-  }
+  // Converts a row of RGB or RGBA pixels into RGB
+  void convertToRGB888(const ImagePixel *src, UInt srcPixelSize, ImagePixel *dst, Int count);
+
+  // Converts a row of RGB or RGBA pixels into RGB565
+  void convertToRGB565(const ImagePixel *src, UInt srcPixelSize, UShort *dst, Int count);
+
+  // Expands a row of alpha values into black RGBA pixels
+  void convertAlphaToRGBA(const ImagePixel *src, ImagePixel *dst, Int count);
+
+  // Blends a row of RGB or RGBA pixels atop of RGB pixels (alpha is given in 1/256 units)
+  void blendToRGB888(ImagePixel *dst, const ImagePixel *src, UInt srcPixelSize, Int count, UInt alpha);
+
+  // Cuts out a rectangle and stores it as RGB
+  void cropToRGB888(const ImagePixel *src, Int srcWidth, UInt srcPixelSize, Int x, Int y, Int width, Int height, ImagePixel *dst);
+
+  // Cuts out a rectangle and stores it as RGB565
+  void cropToRGB565(const ImagePixel *src, Int srcWidth, UInt srcPixelSize, Int x, Int y, Int width, Int height, UShort *dst);
 
   // Computes a gaussion blur
   bool iirGaussFilter(ImagePixel *image, Int width, Int height, UInt pixelSize, float sigma);
@@ -0,0 +1,450 @@
+//============================================================================
+// Name        : ImageKernel.cpp
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <Core.h>
+#include <Image.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define IMAGE_KERNEL_X86
+#include <tmmintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define IMAGE_KERNEL_NEON
+#include <arm_neon.h>
+#endif
+
+namespace GEODISCOVERER {
+
+// Converts one RGB pixel into RGB565
+static inline UShort convertPixelToRGB565(const ImagePixel *p) {
+  return ((p[0]>>3)<<11) | ((p[1]>>2)<<5) | (p[2]>>3);
+}
+
+// Blends one RGB or RGBA pixel atop of a RGB pixel (alpha is given in 1/256 units)
+static inline void blendPixel(ImagePixel *dst, const ImagePixel *src, UInt srcPixelSize, UInt alpha) {
+  if (srcPixelSize==4) {
+    UInt srcAlpha=src[3]+(src[3]>>7);
+    alpha=(srcAlpha*alpha)>>8;
+  }
+  dst[0]=(dst[0]*(256-alpha)+src[0]*alpha)>>8;
+  dst[1]=(dst[1]*(256-alpha)+src[1]*alpha)>>8;
+  dst[2]=(dst[2]*(256-alpha)+src[2]*alpha)>>8;
+}
+
+#ifdef IMAGE_KERNEL_X86
+
+// Converts four pixels stored as 0x00BBGGRR in 32 bit lanes into RGB565
+__attribute__((target("ssse3")))
+static inline __m128i convertLanesToRGB565(__m128i p) {
+  __m128i r=_mm_slli_epi32(_mm_and_si128(p,_mm_set1_epi32(0x000000F8)),8);
+  __m128i g=_mm_srli_epi32(_mm_and_si128(p,_mm_set1_epi32(0x0000FC00)),5);
+  __m128i b=_mm_srli_epi32(_mm_and_si128(p,_mm_set1_epi32(0x00F80000)),19);
+  return _mm_or_si128(_mm_or_si128(r,g),b);
+}
+
+// Converts a row of RGBA pixels into RGB (SSSE3)
+__attribute__((target("ssse3")))
+static Int convertRGBAToRGBSSSE3(const ImagePixel *src, ImagePixel *dst, Int count) {
+  const __m128i shuffle=_mm_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1);
+  Int i=0;
+  for (;i+4<=count;i+=4) {
+    __m128i p=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[i*4]),shuffle);
+    _mm_storel_epi64((__m128i*)&dst[i*3],p);
+    int tail=_mm_cvtsi128_si32(_mm_srli_si128(p,8));
+    memcpy(&dst[i*3+8],&tail,sizeof(tail));
+  }
+  return i;
+}
+
+// Converts a row of RGB or RGBA pixels into RGB565 (SSSE3)
+__attribute__((target("ssse3")))
+static Int convertToRGB565SSSE3(const ImagePixel *src, UInt srcPixelSize, UShort *dst, Int count) {
+  const __m128i expand=_mm_setr_epi8(0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,-1);
+  const __m128i pack=_mm_setr_epi8(0,1,4,5,8,9,12,13,-1,-1,-1,-1,-1,-1,-1,-1);
+  Int i=0;
+  if (srcPixelSize==4) {
+    for (;i+8<=count;i+=8) {
+      __m128i p0=convertLanesToRGB565(_mm_loadu_si128((const __m128i*)&src[i*4]));
+      __m128i p1=convertLanesToRGB565(_mm_loadu_si128((const __m128i*)&src[i*4+16]));
+      _mm_storeu_si128((__m128i*)&dst[i],_mm_unpacklo_epi64(_mm_shuffle_epi8(p0,pack),_mm_shuffle_epi8(p1,pack)));
+    }
+  } else {
+    // The second load reads 4 bytes beyond the 8 pixels, so stop early enough
+    for (;i+10<=count;i+=8) {
+      __m128i p0=convertLanesToRGB565(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[i*3]),expand));
+      __m128i p1=convertLanesToRGB565(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[i*3+12]),expand));
+      _mm_storeu_si128((__m128i*)&dst[i],_mm_unpacklo_epi64(_mm_shuffle_epi8(p0,pack),_mm_shuffle_epi8(p1,pack)));
+    }
+  }
+  return i;
+}
+
+// Expands a row of alpha values into black RGBA pixels (SSE2)
+static Int convertAlphaToRGBASSE2(const ImagePixel *src, ImagePixel *dst, Int count) {
+  const __m128i zero=_mm_setzero_si128();
+  Int i=0;
+  for (;i+16<=count;i+=16) {
+    __m128i a=_mm_loadu_si128((const __m128i*)&src[i]);
+    __m128i lo=_mm_unpacklo_epi8(zero,a);
+    __m128i hi=_mm_unpackhi_epi8(zero,a);
+    _mm_storeu_si128((__m128i*)&dst[i*4+0],_mm_unpacklo_epi16(zero,lo));
+    _mm_storeu_si128((__m128i*)&dst[i*4+16],_mm_unpackhi_epi16(zero,lo));
+    _mm_storeu_si128((__m128i*)&dst[i*4+32],_mm_unpacklo_epi16(zero,hi));
+    _mm_storeu_si128((__m128i*)&dst[i*4+48],_mm_unpackhi_epi16(zero,hi));
+  }
+  return i;
+}
+
+// Blends 8 bytes atop of 8 bytes given as 16 bit lanes (alpha is given in 1/256 units per lane)
+static inline __m128i blendLanes(__m128i dst, __m128i src, __m128i alpha) {
+  __m128i inverseAlpha=_mm_sub_epi16(_mm_set1_epi16(256),alpha);
+  return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(dst,inverseAlpha),_mm_mullo_epi16(src,alpha)),8);
+}
+
+// Blends a row of RGB pixels atop of RGB pixels with a constant alpha (SSE2)
+static Int blendRGBSSE2(ImagePixel *dst, const ImagePixel *src, Int count, UInt alpha) {
+  const __m128i zero=_mm_setzero_si128();
+  const __m128i a=_mm_set1_epi16(alpha);
+  Int bytes=count*3;
+  Int i=0;
+  for (;i+16<=bytes;i+=16) {
+    __m128i d=_mm_loadu_si128((const __m128i*)&dst[i]);
+    __m128i p=_mm_loadu_si128((const __m128i*)&src[i]);
+    __m128i lo=blendLanes(_mm_unpacklo_epi8(d,zero),_mm_unpacklo_epi8(p,zero),a);
+    __m128i hi=blendLanes(_mm_unpackhi_epi8(d,zero),_mm_unpackhi_epi8(p,zero),a);
+    _mm_storeu_si128((__m128i*)&dst[i],_mm_packus_epi16(lo,hi));
+  }
+  for (;i<bytes;i++) {
+    dst[i]=(dst[i]*(256-alpha)+src[i]*alpha)>>8;
+  }
+  return count;
+}
+
+// Blends a row of RGBA pixels atop of RGB pixels (SSSE3)
+__attribute__((target("ssse3")))
+static Int blendRGBASSSE3(ImagePixel *dst, const ImagePixel *src, Int count, UInt alpha) {
+  const __m128i zero=_mm_setzero_si128();
+  const __m128i color=_mm_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1);
+  const __m128i colorAlpha=_mm_setr_epi8(3,3,3,7,7,7,11,11,11,15,15,15,-1,-1,-1,-1);
+  const __m128i a=_mm_set1_epi16(alpha<<1);
+  Int i=0;
+  for (;i+4<=count;i+=4) {
+    __m128i p=_mm_loadu_si128((const __m128i*)&src[i*4]);
+    int tail;
+    memcpy(&tail,&dst[i*3+8],sizeof(tail));
+    __m128i d=_mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)&dst[i*3]),_mm_cvtsi32_si128(tail));
+    __m128i c=_mm_shuffle_epi8(p,color);
+    __m128i srcAlpha=_mm_shuffle_epi8(p,colorAlpha);
+    __m128i srcAlphaLo=_mm_unpacklo_epi8(srcAlpha,zero);
+    __m128i srcAlphaHi=_mm_unpackhi_epi8(srcAlpha,zero);
+    srcAlphaLo=_mm_add_epi16(srcAlphaLo,_mm_srli_epi16(srcAlphaLo,7));
+    srcAlphaHi=_mm_add_epi16(srcAlphaHi,_mm_srli_epi16(srcAlphaHi,7));
+    __m128i alphaLo=_mm_mulhi_epu16(_mm_slli_epi16(srcAlphaLo,7),a);
+    __m128i alphaHi=_mm_mulhi_epu16(_mm_slli_epi16(srcAlphaHi,7),a);
+    __m128i lo=blendLanes(_mm_unpacklo_epi8(d,zero),_mm_unpacklo_epi8(c,zero),alphaLo);
+    __m128i hi=blendLanes(_mm_unpackhi_epi8(d,zero),_mm_unpackhi_epi8(c,zero),alphaHi);
+    __m128i r=_mm_packus_epi16(lo,hi);
+    _mm_storel_epi64((__m128i*)&dst[i*3],r);
+    tail=_mm_cvtsi128_si32(_mm_srli_si128(r,8));
+    memcpy(&dst[i*3+8],&tail,sizeof(tail));
+  }
+  return i;
+}
+
+#endif
+
+#ifdef IMAGE_KERNEL_NEON
+
+// Packs 8 pixels given as separate channels into RGB565
+static inline uint16x8_t convertChannelsToRGB565(uint8x8_t r, uint8x8_t g, uint8x8_t b) {
+  uint16x8_t p=vshll_n_u8(r,8);
+  p=vsriq_n_u16(p,vshll_n_u8(g,8),5);
+  return vsriq_n_u16(p,vshll_n_u8(b,8),11);
+}
+
+// Converts a row of RGBA pixels into RGB (NEON)
+static Int convertRGBAToRGBNEON(const ImagePixel *src, ImagePixel *dst, Int count) {
+  Int i=0;
+  for (;i+16<=count;i+=16) {
+    uint8x16x4_t p=vld4q_u8(&src[i*4]);
+    uint8x16x3_t q;
+    q.val[0]=p.val[0];
+    q.val[1]=p.val[1];
+    q.val[2]=p.val[2];
+    vst3q_u8(&dst[i*3],q);
+  }
+  return i;
+}
+
+// Converts a row of RGB or RGBA pixels into RGB565 (NEON)
+static Int convertToRGB565NEON(const ImagePixel *src, UInt srcPixelSize, UShort *dst, Int count) {
+  Int i=0;
+  if (srcPixelSize==4) {
+    for (;i+8<=count;i+=8) {
+      uint8x8x4_t p=vld4_u8(&src[i*4]);
+      vst1q_u16(&dst[i],convertChannelsToRGB565(p.val[0],p.val[1],p.val[2]));
+    }
+  } else {
+    for (;i+8<=count;i+=8) {
+      uint8x8x3_t p=vld3_u8(&src[i*3]);
+      vst1q_u16(&dst[i],convertChannelsToRGB565(p.val[0],p.val[1],p.val[2]));
+    }
+  }
+  return i;
+}
+
+// Expands a row of alpha values into black RGBA pixels (NEON)
+static Int convertAlphaToRGBANEON(const ImagePixel *src, ImagePixel *dst, Int count) {
+  Int i=0;
+  uint8x16x4_t p;
+  p.val[0]=vdupq_n_u8(0);
+  p.val[1]=p.val[0];
+  p.val[2]=p.val[0];
+  for (;i+16<=count;i+=16) {
+    p.val[3]=vld1q_u8(&src[i]);
+    vst4q_u8(&dst[i*4],p);
+  }
+  return i;
+}
+
+// Blends 8 channel values atop of 8 channel values (alpha is given in 1/256 units per lane)
+static inline uint8x8_t blendChannels(uint8x8_t dst, uint8x8_t src, uint16x8_t alpha) {
+  uint16x8_t inverseAlpha=vsubq_u16(vdupq_n_u16(256),alpha);
+  return vshrn_n_u16(vaddq_u16(vmulq_u16(vmovl_u8(dst),inverseAlpha),vmulq_u16(vmovl_u8(src),alpha)),8);
+}
+
+// Blends a row of RGB or RGBA pixels atop of RGB pixels (NEON)
+static Int blendNEON(ImagePixel *dst, const ImagePixel *src, UInt srcPixelSize, Int count, UInt alpha) {
+  Int i=0;
+  if (srcPixelSize==4) {
+    for (;i+8<=count;i+=8) {
+      uint8x8x4_t p=vld4_u8(&src[i*4]);
+      uint8x8x3_t d=vld3_u8(&dst[i*3]);
+      uint16x8_t srcAlpha=vmovl_u8(p.val[3]);
+      srcAlpha=vaddq_u16(srcAlpha,vshrq_n_u16(srcAlpha,7));
+      uint32x4_t alphaLo=vmull_n_u16(vget_low_u16(srcAlpha),alpha);
+      uint32x4_t alphaHi=vmull_n_u16(vget_high_u16(srcAlpha),alpha);
+      uint16x8_t a=vcombine_u16(vshrn_n_u32(alphaLo,8),vshrn_n_u32(alphaHi,8));
+      d.val[0]=blendChannels(d.val[0],p.val[0],a);
+      d.val[1]=blendChannels(d.val[1],p.val[1],a);
+      d.val[2]=blendChannels(d.val[2],p.val[2],a);
+      vst3_u8(&dst[i*3],d);
+    }
+  } else {
+    uint16x8_t a=vdupq_n_u16(alpha);
+    for (;i+8<=count;i+=8) {
+      uint8x8x3_t p=vld3_u8(&src[i*3]);
+      uint8x8x3_t d=vld3_u8(&dst[i*3]);
+      d.val[0]=blendChannels(d.val[0],p.val[0],a);
+      d.val[1]=blendChannels(d.val[1],p.val[1],a);
+      d.val[2]=blendChannels(d.val[2],p.val[2],a);
+      vst3_u8(&dst[i*3],d);
+    }
+  }
+  return i;
+}
+
+#endif
+
+// Selects the kernels supported by the cpu
+void Image::initKernels() {
+  ssse3Supported=false;
+#ifdef IMAGE_KERNEL_X86
+  __builtin_cpu_init();
+  ssse3Supported=__builtin_cpu_supports("ssse3");
+#endif
+#ifdef DEBUG_CHECKS_ENABLED
+  benchmarkKernels();
+#endif
+}
+
+// Compares the pixel conversion kernels with the per-pixel path and measures their speed
+void Image::benchmarkKernels() {
+
+  // Fill a tile sized row set with reproducible pixel values
+  const Int count=256*256;
+  const Int rounds=20;
+  ImagePixel *rgba=(ImagePixel*)malloc(count*RGBAPixelSize);
+  ImagePixel *rgb=(ImagePixel*)malloc(count*RGBPixelSize);
+  ImagePixel *dstKernel=(ImagePixel*)malloc(count*RGBAPixelSize);
+  ImagePixel *dstReference=(ImagePixel*)malloc(count*RGBAPixelSize);
+  if ((!rgba)||(!rgb)||(!dstKernel)||(!dstReference)) {
+    FATAL("can not reserve memory for kernel benchmark",NULL);
+    return;
+  }
+  UInt seed=12345;
+  for (Int i=0;i<count*(Int)RGBAPixelSize;i++) {
+    seed=seed*1103515245+12345;
+    rgba[i]=seed>>24;
+  }
+  for (Int i=0;i<count;i++)
+    memcpy(&rgb[i*RGBPixelSize],&rgba[i*RGBAPixelSize],RGBPixelSize);
+
+  // Run every kernel against the per-pixel reference
+  for (Int test=0;test<6;test++) {
+    std::string name;
+    TimestampInMicroseconds kernelTime=0, referenceTime=0;
+    Int size=0;
+    for (Int round=0;round<rounds;round++) {
+      memcpy(dstKernel,rgb,count*RGBPixelSize);
+      memcpy(dstReference,rgb,count*RGBPixelSize);
+      TimestampInMicroseconds t0=core->getClock()->getMicrosecondsSinceStart();
+      switch(test) {
+        case 0: convertToRGB888(rgba,RGBAPixelSize,dstKernel,count); break;
+        case 1: convertToRGB565(rgb,RGBPixelSize,(UShort*)dstKernel,count); break;
+        case 2: convertToRGB565(rgba,RGBAPixelSize,(UShort*)dstKernel,count); break;
+        case 3: convertAlphaToRGBA(rgba,dstKernel,count); break;
+        case 4: blendToRGB888(dstKernel,rgb,RGBPixelSize,count,100); break;
+        case 5: blendToRGB888(dstKernel,rgba,RGBAPixelSize,count,100); break;
+      }
+      TimestampInMicroseconds t1=core->getClock()->getMicrosecondsSinceStart();
+      for (Int i=0;i<count;i++) {
+        switch(test) {
+          case 0:
+            memcpy(&dstReference[i*RGBPixelSize],&rgba[i*RGBAPixelSize],RGBPixelSize);
+            break;
+          case 1:
+            ((UShort*)dstReference)[i]=convertPixelToRGB565(&rgb[i*RGBPixelSize]);
+            break;
+          case 2:
+            ((UShort*)dstReference)[i]=convertPixelToRGB565(&rgba[i*RGBAPixelSize]);
+            break;
+          case 3:
+            memset(&dstReference[i*RGBAPixelSize],0,RGBPixelSize);
+            dstReference[i*RGBAPixelSize+3]=rgba[i];
+            break;
+          case 4:
+            blendPixel(&dstReference[i*RGBPixelSize],&rgb[i*RGBPixelSize],RGBPixelSize,100);
+            break;
+          case 5:
+            blendPixel(&dstReference[i*RGBPixelSize],&rgba[i*RGBAPixelSize],RGBAPixelSize,100);
+            break;
+        }
+      }
+      TimestampInMicroseconds t2=core->getClock()->getMicrosecondsSinceStart();
+      kernelTime+=t1-t0;
+      referenceTime+=t2-t1;
+    }
+    switch(test) {
+      case 0: name="RGBA to RGB888"; size=count*RGBPixelSize; break;
+      case 1: name="RGB to RGB565"; size=count*sizeof(UShort); break;
+      case 2: name="RGBA to RGB565"; size=count*sizeof(UShort); break;
+      case 3: name="alpha to RGBA"; size=count*RGBAPixelSize; break;
+      case 4: name="RGB blend"; size=count*RGBPixelSize; break;
+      case 5: name="RGBA blend"; size=count*RGBPixelSize; break;
+    }
+    if (memcmp(dstKernel,dstReference,size)!=0) {
+      ERROR("kernel <%s> does not match the per-pixel path",name.c_str());
+    }
+    DEBUG("kernel <%s>: %.1f us per tile (per-pixel path: %.1f us)",name.c_str(),(double)kernelTime/rounds,(double)referenceTime/rounds);
+  }
+  free(rgba);
+  free(rgb);
+  free(dstKernel);
+  free(dstReference);
+}
+
+// Converts a row of RGB or RGBA pixels into RGB
+void Image::convertToRGB888(const ImagePixel *src, UInt srcPixelSize, ImagePixel *dst, Int count) {
+  if (srcPixelSize==RGBPixelSize) {
+    memcpy(dst,src,count*RGBPixelSize);
+    return;
+  }
+  Int i=0;
+#ifdef IMAGE_KERNEL_X86
+  if (ssse3Supported)
+    i=convertRGBAToRGBSSSE3(src,dst,count);
+#endif
+#ifdef IMAGE_KERNEL_NEON
+  i=convertRGBAToRGBNEON(src,dst,count);
+#endif
+  for (;i<count;i++) {
+    dst[i*3+0]=src[i*srcPixelSize+0];
+    dst[i*3+1]=src[i*srcPixelSize+1];
+    dst[i*3+2]=src[i*srcPixelSize+2];
+  }
+}
+
+// Converts a row of RGB or RGBA pixels into RGB565
+void Image::convertToRGB565(const ImagePixel *src, UInt srcPixelSize, UShort *dst, Int count) {
+  Int i=0;
+#ifdef IMAGE_KERNEL_X86
+  if (ssse3Supported)
+    i=convertToRGB565SSSE3(src,srcPixelSize,dst,count);
+#endif
+#ifdef IMAGE_KERNEL_NEON
+  i=convertToRGB565NEON(src,srcPixelSize,dst,count);
+#endif
+  for (;i<count;i++) {
+    dst[i]=convertPixelToRGB565(&src[i*srcPixelSize]);
+  }
+}
+
+// Expands a row of alpha values into black RGBA pixels
+void Image::convertAlphaToRGBA(const ImagePixel *src, ImagePixel *dst, Int count) {
+  Int i=0;
+#ifdef IMAGE_KERNEL_X86
+  i=convertAlphaToRGBASSE2(src,dst,count);
+#endif
+#ifdef IMAGE_KERNEL_NEON
+  i=convertAlphaToRGBANEON(src,dst,count);
+#endif
+  for (;i<count;i++) {
+    dst[i*4+0]=0;
+    dst[i*4+1]=0;
+    dst[i*4+2]=0;
+    dst[i*4+3]=src[i];
+  }
+}
+
+// Cuts out a rectangle and stores it as RGB
+void Image::cropToRGB888(const ImagePixel *src, Int srcWidth, UInt srcPixelSize, Int x, Int y, Int width, Int height, ImagePixel *dst) {
+  for (Int row=0;row<height;row++) {
+    convertToRGB888(&src[((y+row)*srcWidth+x)*srcPixelSize],srcPixelSize,&dst[row*width*RGBPixelSize],width);
+  }
+}
+
+// Cuts out a rectangle and stores it as RGB565
+void Image::cropToRGB565(const ImagePixel *src, Int srcWidth, UInt srcPixelSize, Int x, Int y, Int width, Int height, UShort *dst) {
+  for (Int row=0;row<height;row++) {
+    convertToRGB565(&src[((y+row)*srcWidth+x)*srcPixelSize],srcPixelSize,&dst[row*width],width);
+  }
+}
+
+// Blends a row of RGB or RGBA pixels atop of RGB pixels (alpha is given in 1/256 units)
+void Image::blendToRGB888(ImagePixel *dst, const ImagePixel *src, UInt srcPixelSize, Int count, UInt alpha) {
+  Int i=0;
+#ifdef IMAGE_KERNEL_X86
+  if (srcPixelSize==RGBPixelSize)
+    i=blendRGBSSE2(dst,src,count,alpha);
+  else if (ssse3Supported)
+    i=blendRGBASSSE3(dst,src,count,alpha);
+#endif
+#ifdef IMAGE_KERNEL_NEON
+  i=blendNEON(dst,src,srcPixelSize,count,alpha);
+#endif
+  for (;i<count;i++) {
+    blendPixel(&dst[i*RGBPixelSize],&src[i*srcPixelSize],srcPixelSize,alpha);
+  }
+}
+
+}
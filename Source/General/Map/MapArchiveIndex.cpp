@@ -0,0 +1,235 @@
+//============================================================================
+// Name        : MapArchiveIndex.cpp
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2022 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <Core.h>
+#include <MapArchiveIndex.h>
+#include <ZipArchiveReader.h>
+#include <Storage.h>
+#include <fcntl.h>
+#include <zlib.h>
+
+namespace GEODISCOVERER {
+
+// Constructor
+MapArchiveIndex::MapArchiveIndex() {
+  changed=false;
+}
+
+// Destructor
+MapArchiveIndex::~MapArchiveIndex() {
+}
+
+// Adds the entries of the archive if it has changed since it was indexed
+void MapArchiveIndex::updateArchive(std::string archiveFilePath) {
+
+  // Skip the archive if it is unchanged
+  struct stat stats;
+  if (core->statFile(archiveFilePath,&stats)!=0) {
+    removeArchive(archiveFilePath);
+    return;
+  }
+  std::unordered_map<std::string, MapArchiveIndexArchive>::iterator i=archives.find(archiveFilePath);
+  if ((i!=archives.end())&&(i->second.modificationTime==(Int)stats.st_mtime)&&(i->second.diskUsage==(Int)stats.st_size))
+    return;
+
+  // Read the entries of the archive
+  removeArchive(archiveFilePath);
+  std::string archiveFolder=".";
+  std::string archiveName=archiveFilePath;
+  size_t pos=archiveFilePath.find_last_of("/");
+  if (pos!=std::string::npos) {
+    archiveFolder=archiveFilePath.substr(0,pos);
+    archiveName=archiveFilePath.substr(pos+1);
+  }
+  ZipArchiveReader reader(archiveFolder,archiveName);
+  if (!reader.init())
+    return;
+  MapArchiveIndexArchive archive;
+  archive.modificationTime=stats.st_mtime;
+  archive.diskUsage=stats.st_size;
+  archive.entryPaths=reader.getEntryFilenames();
+  for (std::list<std::string>::iterator j=archive.entryPaths.begin();j!=archive.entryPaths.end();j++) {
+    entries[*j]=archiveFilePath;
+  }
+  archives[archiveFilePath]=archive;
+  changed=true;
+}
+
+// Removes the entries of the archive
+void MapArchiveIndex::removeArchive(std::string archiveFilePath) {
+  std::unordered_map<std::string, MapArchiveIndexArchive>::iterator i=archives.find(archiveFilePath);
+  if (i==archives.end())
+    return;
+  for (std::list<std::string>::iterator j=i->second.entryPaths.begin();j!=i->second.entryPaths.end();j++) {
+    std::unordered_map<std::string, std::string>::iterator k=entries.find(*j);
+    if ((k!=entries.end())&&(k->second==archiveFilePath))
+      entries.erase(k);
+  }
+  archives.erase(i);
+  changed=true;
+}
+
+// Returns the path of the archive that contains the entry
+std::string MapArchiveIndex::findArchive(std::string entryPath) const {
+  std::unordered_map<std::string, std::string>::const_iterator i=entries.find(entryPath);
+  if (i==entries.end())
+    return "";
+  return i->second;
+}
+
+// Removes all entries
+void MapArchiveIndex::clear() {
+  entries.clear();
+  archives.clear();
+  changed=false;
+}
+
+// Writes the index into a file
+void MapArchiveIndex::store(std::string filePath) {
+
+  // Write the archives behind a header that is filled in later
+  std::string tempFilePath=filePath+"+";
+  std::ofstream ofs;
+  ofs.open(tempFilePath.c_str(),std::ios::binary);
+  if (ofs.fail()) {
+    WARNING("can not open <%s> for writing",tempFilePath.c_str());
+    return;
+  }
+  Storage::storeInt(&ofs,version);
+  Storage::storeInt(&ofs,0);
+  Storage::storeInt(&ofs,0);
+  Storage::storeInt(&ofs,archives.size());
+  for (std::unordered_map<std::string, MapArchiveIndexArchive>::iterator i=archives.begin();i!=archives.end();i++) {
+    Storage::storeString(&ofs,i->first);
+    Storage::storeInt(&ofs,i->second.modificationTime);
+    Storage::storeInt(&ofs,i->second.diskUsage);
+    Storage::storeInt(&ofs,i->second.entryPaths.size());
+    for (std::list<std::string>::iterator j=i->second.entryPaths.begin();j!=i->second.entryPaths.end();j++) {
+      Storage::storeString(&ofs,*j);
+    }
+  }
+  bool failed=ofs.bad();
+  ofs.close();
+
+  // Compute the checksum of the stored archives and complete the header
+  if (!failed) {
+    std::fstream fs;
+    fs.open(tempFilePath.c_str(),std::ios::binary|std::ios::in|std::ios::out);
+    fs.seekg(0,std::ios::end);
+    Int size=(Int)fs.tellg()-headerSize;
+    char *data=NULL;
+    if ((size<0)||(!(data=(char*)malloc(size+1)))) {
+      failed=true;
+    } else {
+      fs.seekg(headerSize,std::ios::beg);
+      fs.read(data,size);
+      UInt checksum=adler32(adler32(0,Z_NULL,0),(const Bytef*)data,size);
+      free(data);
+      fs.seekp(sizeof(Int),std::ios::beg);
+      fs.write((char*)&size,sizeof(size));
+      fs.write((char*)&checksum,sizeof(checksum));
+      failed=fs.fail();
+    }
+    fs.close();
+  }
+
+  // Sync the file and replace the old index
+  if (!failed) {
+    int fd=open(tempFilePath.c_str(),O_RDONLY);
+    if ((fd==-1)||(fsync(fd)!=0))
+      failed=true;
+    if (fd!=-1)
+      close(fd);
+  }
+  if ((failed)||(rename(tempFilePath.c_str(),filePath.c_str())!=0)) {
+    WARNING("can not store map archive index into <%s>",filePath.c_str());
+    remove(tempFilePath.c_str());
+    return;
+  }
+  changed=false;
+}
+
+// Reads the index from a file
+bool MapArchiveIndex::retrieve(std::string filePath) {
+
+  // Load the complete file into memory
+  struct stat stats;
+  if (core->statFile(filePath,&stats)!=0)
+    return false;
+  std::ifstream ifs;
+  ifs.open(filePath.c_str(),std::ios::binary);
+  if (ifs.fail())
+    return false;
+  char *data;
+  if (!(data=(char*)malloc(stats.st_size+1))) {
+    FATAL("can not allocate memory for map archive index",NULL);
+    return false;
+  }
+  ifs.read(data,stats.st_size);
+  bool failed=ifs.fail();
+  ifs.close();
+  data[stats.st_size]=0; // to prevent that strings never end
+
+  // Retrieve the archives
+  clear();
+  char *cacheData=data;
+  Int cacheSize=stats.st_size;
+  Int storedVersion=0,storedSize=0,storedChecksum=0,archiveCount=0;
+  Storage::retrieveInt(cacheData,cacheSize,storedVersion);
+  Storage::retrieveInt(cacheData,cacheSize,storedSize);
+  Storage::retrieveInt(cacheData,cacheSize,storedChecksum);
+  if ((failed)||(cacheSize<0)||(storedVersion!=version)||(storedSize!=cacheSize)||
+      ((UInt)storedChecksum!=adler32(adler32(0,Z_NULL,0),(const Bytef*)cacheData,cacheSize)))
+    cacheSize=-1;
+  else
+    Storage::retrieveInt(cacheData,cacheSize,archiveCount);
+  for (Int i=0;(i<archiveCount)&&(cacheSize>0);i++) {
+    char *archiveFilePath;
+    MapArchiveIndexArchive archive;
+    Int entryCount=0;
+    Storage::retrieveString(cacheData,cacheSize,&archiveFilePath);
+    Storage::retrieveInt(cacheData,cacheSize,archive.modificationTime);
+    Storage::retrieveInt(cacheData,cacheSize,archive.diskUsage);
+    Storage::retrieveInt(cacheData,cacheSize,entryCount);
+    if ((archiveFilePath==NULL)||(cacheSize<0))
+      break;
+    for (Int j=0;(j<entryCount)&&(cacheSize>0);j++) {
+      char *entryPath;
+      Storage::retrieveString(cacheData,cacheSize,&entryPath);
+      if (entryPath) {
+        archive.entryPaths.push_back(entryPath);
+        entries[entryPath]=archiveFilePath;
+      }
+    }
+    archives[archiveFilePath]=archive;
+  }
+  free(data);
+  if (cacheSize!=0) {
+    WARNING("map archive index <%s> is corrupted",filePath.c_str());
+    clear();
+    return false;
+  }
+  changed=false;
+  return true;
+}
+
+}
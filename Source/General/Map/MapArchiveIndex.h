@@ -0,0 +1,88 @@
+//============================================================================
+// Name        : MapArchiveIndex.h
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2022 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#ifndef MAPARCHIVEINDEX_H_
+#define MAPARCHIVEINDEX_H_
+
+namespace GEODISCOVERER {
+
+// State of an archive when it was indexed
+typedef struct MapArchiveIndexArchive {
+  Int modificationTime;                  // Last time the archive was modified
+  Int diskUsage;                         // Size of the archive in bytes
+  std::list<std::string> entryPaths;     // Entries contained in the archive
+} MapArchiveIndexArchive;
+
+// Remembers which map archive contains which entry
+class MapArchiveIndex {
+
+protected:
+
+  // Version of the stored index
+  static const Int version = 2;
+
+  // Size of the header that precedes the stored archives (version, size and checksum of the rest)
+  static const Int headerSize = 3*sizeof(Int);
+
+  std::unordered_map<std::string, std::string> entries;              // Path of the archive indexed by the entry path
+  std::unordered_map<std::string, MapArchiveIndexArchive> archives;  // Indexed archives by their path
+  bool changed;                                                      // Indicates that the index differs from the stored one
+
+public:
+
+  // Constructor and destructor
+  MapArchiveIndex();
+  virtual ~MapArchiveIndex();
+
+  // Adds the entries of the archive if it has changed since it was indexed
+  void updateArchive(std::string archiveFilePath);
+
+  // Removes the entries of the archive
+  void removeArchive(std::string archiveFilePath);
+
+  // Returns the path of the archive that contains the entry
+  std::string findArchive(std::string entryPath) const;
+
+  // Removes all entries
+  void clear();
+
+  // Writes the index into a file
+  // The file is written under a temporary name and then renamed such that a crash never leaves a partial index behind
+  void store(std::string filePath);
+
+  // Reads the index from a file
+  // Files whose size or checksum does not match the header are rejected
+  bool retrieve(std::string filePath);
+
+  // Getters and setters
+  bool getChanged() const {
+    return changed;
+  }
+
+  Int getEntryCount() const {
+    return entries.size();
+  }
+};
+
+}
+
+#endif /* MAPARCHIVEINDEX_H_ */
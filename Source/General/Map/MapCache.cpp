@@ -28,6 +28,16 @@
 
 namespace GEODISCOVERER {
 
+// Tile image decode thread
+void *mapCacheDecodeThread(void *args) {
+  UByte *argsBytes = (UByte *)args;
+  MapCache *mapCache = *((MapCache**)&argsBytes[0]);
+  Int threadNr = *((Int*)&argsBytes[sizeof(MapCache*)]);
+  free(args);
+  mapCache->decodeTileImages(threadNr);
+  return NULL;
+}
+
 // Constructor
 MapCache::MapCache() {
 
@@ -35,26 +45,77 @@ MapCache::MapCache() {
   size=0;
   abortUpdate=false;
   accessMutex=core->getThread()->createMutex("map cache access mutex");
-
-  // Reserve the memory for preparing a tile image
-  //DEBUG("sizeof(*tileImageScratch)=%d",sizeof(*tileImageScratch));
-  tileImageScratch=(UByte *)malloc(core->getImage()->getRGBAPixelSize()*core->getMapSource()->getMapTileWidth()*core->getMapSource()->getMapTileHeight());
-  if (!tileImageScratch) {
-    FATAL("could not reserve memory for the tile image",NULL);
-    return;
+  decodeMutex=core->getThread()->createMutex("map cache decode mutex");
+  numberOfDecodeThreads=core->getConfigStore()->getIntValue("Map","numberOfTileDecodeThreads",__FILE__, __LINE__);
+  Int tileImageQueueMaxSize=core->getConfigStore()->getIntValue("Map","tileImageQueueMaxSize",__FILE__, __LINE__);
+
+  // Reserve the memory for preparing the tile images
+  for (Int i=0;i<tileImageQueueMaxSize;i++) {
+    UByte *tileImage=(UByte *)malloc(core->getImage()->getRGBPixelSize()*core->getMapSource()->getMapTileWidth()*core->getMapSource()->getMapTileHeight());
+    if (!tileImage) {
+      FATAL("could not reserve memory for the tile image",NULL);
+      return;
+    }
+    tileImages.push_back(tileImage);
+    unusedTileImages.push_back(tileImage);
   }
 
   // Init variables
   tileTextureAvailable=false;
   updateInProgress=false;
   isInitialized=false;
+  activeDecodeJobs=0;
+  hits=0;
+  misses=0;
+  requestRound=0;
+  evictions=0;
+  currentTexture=Screen::getTextureNotDefined();
+  quitDecodeThreads=false;
+  currentTileImage.mapTile=NULL;
+  currentTileImage.image=NULL;
+
+  // Start the threads that decode the tile images
+  decodeResultSignal=core->getThread()->createSignal();
+  decodeStartSignals.resize(numberOfDecodeThreads);
+  decodeThreadInfos.resize(numberOfDecodeThreads);
+  for (Int i=0;i<numberOfDecodeThreads;i++) {
+    decodeStartSignals[i]=core->getThread()->createSignal();
+    UByte *args = (UByte *)malloc(sizeof(this)+sizeof(Int));
+    if (!args) {
+      FATAL("can not create args for map cache decode thread",NULL);
+      break;
+    }
+    *((MapCache**)&args[0])=this;
+    *((Int*)&args[sizeof(this)])=i;
+    std::stringstream threadName;
+    threadName << "map cache decode thread " << i;
+    decodeThreadInfos[i]=core->getThread()->createThread(threadName.str(),mapCacheDecodeThread,(void*)args);
+  }
 }
 
 // Destructor
 MapCache::~MapCache() {
   deinit();
-  if (tileImageScratch)
-    free(tileImageScratch);
+
+  // Stop the decode threads
+  quitDecodeThreads=true;
+  for (Int i=0;i<numberOfDecodeThreads;i++) {
+    core->getThread()->issueSignal(decodeStartSignals[i]);
+  }
+  for (Int i=0;i<numberOfDecodeThreads;i++) {
+    if (decodeThreadInfos[i]) {
+      core->getThread()->waitForThread(decodeThreadInfos[i]);
+      core->getThread()->destroyThread(decodeThreadInfos[i]);
+    }
+    core->getThread()->destroySignal(decodeStartSignals[i]);
+  }
+  core->getThread()->destroySignal(decodeResultSignal);
+
+  // Free the remaining memory
+  for (std::list<UByte*>::iterator i=tileImages.begin();i!=tileImages.end();i++) {
+    free(*i);
+  }
+  core->getThread()->destroyMutex(decodeMutex);
   core->getThread()->destroyMutex(accessMutex);
 }
 
@@ -98,7 +159,10 @@ void MapCache::createGraphic() {
       MapTile *t=*j;
       //DEBUG("adding tile at position <%d,%d> to uncached tile list",t->getMapX(),t->getMapY());
       t->setIsCached(false,Screen::getTextureNotDefined(),false);
-      uncachedTiles.push_back(t);
+      MapCacheTilePos &tilePos=tileIndex[t];
+      tilePos.cached=false;
+      tilePos.pos=uncachedTiles.insert(uncachedTiles.end(),t);
+      tilePos.lastRequest=-2;
     }
   }
   core->getMapSource()->unlockAccess();
@@ -127,11 +191,12 @@ void MapCache::deinit() {
     core->getDefaultScreen()->destroyTextureInfo(*i,"MapCache (unused texture)");
   }
   unusedTextures.clear();
-  for(std::list<GraphicTextureInfo>::iterator i=usedTextures.begin();i!=usedTextures.end();i++) {
+  for(std::unordered_set<GraphicTextureInfo>::iterator i=usedTextures.begin();i!=usedTextures.end();i++) {
     core->getDefaultScreen()->destroyTextureInfo(*i,"MapCache (used texture)");
   }
   usedTextures.clear();
   uncachedTiles.clear();
+  tileIndex.clear();
 
   // Object is not initialized anymore
   isInitialized=false;
@@ -144,8 +209,15 @@ void MapCache::deinit() {
 // Adds a new tile to the cache
 void MapCache::addTile(MapTile *tile) {
   core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+  if (tileIndex.find(tile)!=tileIndex.end()) {
+    core->getThread()->unlockMutex(accessMutex);
+    return;
+  }
   tile->setIsCached(false);
-  uncachedTiles.push_back(tile);
+  MapCacheTilePos &tilePos=tileIndex[tile];
+  tilePos.cached=false;
+  tilePos.pos=uncachedTiles.insert(uncachedTiles.end(),tile);
+  tilePos.lastRequest=-2;
   core->getThread()->unlockMutex(accessMutex);
 }
 
@@ -155,9 +227,12 @@ void MapCache::removeTile(MapTile *tile) {
     FATAL("can not remove tile because it is currently drawn",NULL);
   }
   core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
-  std::list<MapTile*>::iterator i = std::find(cachedTiles.begin(), cachedTiles.end(), tile);
-  if (i==cachedTiles.end()) {
-    uncachedTiles.remove(tile);
+  MapCacheTileIndex::iterator i=tileIndex.find(tile);
+  if (i==tileIndex.end()) {
+    core->getThread()->unlockMutex(accessMutex);
+  } else if (!i->second.cached) {
+    uncachedTiles.erase(i->second.pos);
+    tileIndex.erase(i);
     core->getThread()->unlockMutex(accessMutex);
   } else {
     if (!tile->getIsCached()) {
@@ -180,229 +255,400 @@ void MapCache::removeTile(MapTile *tile) {
     r->setZ(0);
     core->getDefaultGraphicEngine()->unlockDrawing();
     core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
-    usedTextures.remove(tile->getEndTexture());
+    usedTextures.erase(tile->getEndTexture());
     unusedTextures.push_back(tile->getEndTexture());
     //DEBUG("removing tile 0x%08x",*i);
-    cachedTiles.erase(i);
+    i=tileIndex.find(tile);
+    cachedTiles.erase(i->second.pos);
+    tileIndex.erase(i);
     tile->setIsCached(false);
     core->getThread()->unlockMutex(accessMutex);
   }
 }
 
-// Updates the map images of tiles
-void MapCache::updateMapTileImages() {
+// Marks the visible tiles as recently used
+void MapCache::touchTiles(std::list<MapTile*> &tiles) {
+  core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+  requestRound++;
+  for (std::list<MapTile*>::iterator i=tiles.begin();i!=tiles.end();i++) {
+    MapCacheTileIndex::iterator j=tileIndex.find(*i);
+    if (j==tileIndex.end())
+      continue;
+    MapCacheTilePos &tilePos=j->second;
+
+    // Only count tiles that were not visible in the previous round
+    bool newRequest=(tilePos.lastRequest<requestRound-1);
+    tilePos.lastRequest=requestRound;
+    if (tilePos.cached) {
+      cachedTiles.splice(cachedTiles.end(),cachedTiles,tilePos.pos);
+      if (newRequest)
+        hits++;
+    } else {
+      if (newRequest)
+        misses++;
+    }
+  }
+  core->getThread()->unlockMutex(accessMutex);
+}
 
-  // Ensure that only one thread is executing this
+// Outputs statistical infos
+void MapCache::outputStats() {
   core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+  Int requests=hits+misses;
+  double hitRate=(requests>0) ? (double)hits/(double)requests*100.0 : 0;
+  DEBUG("map cache: hits=%d misses=%d hitRate=%.1f%% evictions=%d",hits,misses,hitRate,evictions);
+  core->getThread()->unlockMutex(accessMutex);
+}
 
-  // Check that all visible tile are cached
-  // If not, add them to the load list
-  std::list<MapTile *> mapTileLoadList;
-  for (std::list<MapTile*>::const_iterator i=uncachedTiles.begin();i!=uncachedTiles.end();i++) {
+// Moves the least recently used tile to the uncached list
+void MapCache::evictTile() {
+  core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+  MapTile *t=cachedTiles.front();
+  uncachedTiles.splice(uncachedTiles.end(),cachedTiles,cachedTiles.begin());
+  tileIndex[t].cached=false;
+  evictions++;
+  core->getThread()->unlockMutex(accessMutex);
+  GraphicTextureInfo m=t->getEndTexture();
+  core->getDefaultGraphicEngine()->lockDrawing(__FILE__, __LINE__);
+  GraphicRectangle *r=t->getRectangle();
+  r->setZ(0);
+  core->getDefaultGraphicEngine()->unlockDrawing();
+  core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+  t->setIsCached(false);
+  usedTextures.erase(m);
+  unusedTextures.push_back(m);
+  core->getThread()->unlockMutex(accessMutex);
+}
+
+// Checks the consistency of the cache lists
+void MapCache::checkConsistency() {
+  if (tileIndex.size()!=cachedTiles.size()+uncachedTiles.size()) {
+    FATAL("tile index does not match the cache lists",NULL);
+  }
+  for(std::list<MapTile*>::iterator i=cachedTiles.begin();i!=cachedTiles.end();i++) {
     MapTile *t=*i;
-    if ((t->isDrawn())&&(t->getParentMapContainer()->getDownloadComplete())) {
-      mapTileLoadList.push_back(t);
+    MapCacheTileIndex::iterator j=tileIndex.find(t);
+    if ((j==tileIndex.end())||(!j->second.cached)||(j->second.pos!=i)) {
+      FATAL("cached tile has a wrong index entry",NULL);
+    }
+    if (usedTextures.find(t->getEndTexture())==usedTextures.end()) {
+      FATAL("cached tile uses texture that is not marked as used",NULL);
     }
   }
-  core->getThread()->unlockMutex(accessMutex);
-  //return;
-  if (mapTileLoadList.size()==0) {
-    return; // Nothing to do
+}
+
+// Reads the image data of the map container from its archive
+UByte *MapCache::readMapContainerImage(MapContainer *mapContainer, Int &imageSize, bool &imageDataCopied, ZipArchiveReader *&mapArchiveReader) {
+
+  // Find the archive that holds the image
+  UByte *imageData=NULL;
+  ZipArchiveReader *reader;
+  core->getMapSource()->lockMapArchives(__FILE__, __LINE__);
+  reader=core->getMapSource()->findMapArchiveReader(mapContainer->getArchiveFilePath(),mapContainer->getImageFilePath(),mapArchiveReader);
+  core->getMapSource()->unlockMapArchives();
+  imageDataCopied=false;
+  if (!reader)
+    return NULL;
+  imageData=reader->readEntry(mapContainer->getImageFilePath(),imageSize,imageDataCopied);
+  if ((!imageData)&&(mapArchiveReader)) {
+    delete mapArchiveReader;
+    mapArchiveReader=NULL;
   }
+  return imageData;
+}
 
-  // Update has started
-  updateInProgress=true;
+// Decodes the image of a map container and cuts out the requested tiles
+void MapCache::processDecodeJob(MapCacheDecodeJob *job, Int threadNr) {
 
-  // Go through the list
-  MapContainer *currentContainer=NULL;
-  ImagePixel *currentImage=NULL;
-  Int currentImageWidth,currentImageHeight;
-  UInt currentImagePixelSize;
-  MapPosition mapPos=*(core->getMapEngine()->lockMapPos(__FILE__,__LINE__));
-  core->getMapEngine()->unlockMapPos();
-  while ((!mapTileLoadList.empty())&&(!abortUpdate)) {
-
-    // Find the tile nearest to the visible map center
-    double minDistance=std::numeric_limits<double>::max();
-    MapTile *selectedMapTile=NULL;
-    for (std::list<MapTile*>::const_iterator i=mapTileLoadList.begin();i!=mapTileLoadList.end();i++) {
-      MapTile *t=*i;
-      double d=mapPos.computeDistance(t->getMapPosCenter());
-      if (d<minDistance) {
-        minDistance=d;
-        selectedMapTile=t;
-      }
-    }
-    if (selectedMapTile==NULL) {
-      FATAL("no map tile found but expected one",NULL);
+  // Read the image from the archive
+  Int imageSize;
+  bool imageDataCopied;
+  ZipArchiveReader *mapArchiveReader;
+  UByte *imageData=readMapContainerImage(job->mapContainer,imageSize,imageDataCopied,mapArchiveReader);
+  if (!imageData)
+    return;
+
+  // Decode the image
+  // The stored format may differ from the container if the downloaded image was stored as it is
+  ImagePixel *image=NULL;
+  Int imageWidth,imageHeight;
+  UInt imagePixelSize;
+  ImageType imageType=job->mapContainer->getImageType();
+  if ((imageSize>=4)&&(memcmp(imageData,"\x89PNG",4)==0))
+    imageType=ImageTypePNG;
+  else if ((imageSize>=2)&&(imageData[0]==0xFF)&&(imageData[1]==0xD8))
+    imageType=ImageTypeJPEG;
+  switch(imageType) {
+    case ImageTypeJPEG:
+      image=core->getImage()->loadJPEG(imageData,imageSize,imageWidth,imageHeight,imagePixelSize,&abortUpdate);
+      break;
+    case ImageTypePNG:
+      image=core->getImage()->loadPNG(imageData,imageSize,imageWidth,imageHeight,imagePixelSize,&abortUpdate);
+      break;
+    default:
+      FATAL("unsupported image type",NULL);
+      break;
+  }
+  if (imageDataCopied)
+    free(imageData);
+  if (mapArchiveReader)
+    delete mapArchiveReader;
+  if (!image)
+    return;
+
+  // Cut out the tiles in the order of their distance to the map center
+  bool textureFormatRGB888Supported=core->getDefaultScreen()->isTextureFormatRGB888Supported();
+  for (std::list<std::pair<double, MapTile*> >::iterator i=job->mapTiles.begin();(i!=job->mapTiles.end())&&(!abortUpdate);i++) {
+    MapTile *t=i->second;
+
+    // Do some sanity checks
+    if ((t->getWidth()!=core->getMapSource()->getMapTileWidth())||(t->getHeight()!=core->getMapSource()->getMapTileHeight())) {
+      FATAL("tiles whose width or height does not match the default are not supported",NULL);
+      break;
     }
-    mapTileLoadList.remove(selectedMapTile);
-
-    // Load the map image 
-    currentContainer=selectedMapTile->getParentMapContainer();
-    //DEBUG("loading tiles from image <%s>",currentContainer->getImageFileName().c_str());
-
-    // Check if the image exists in the map archive
-    ZipArchive *mapArchive=NULL;
-    bool newMapArchive=false;
-    std::list<ZipArchive*> *mapArchives = core->getMapSource()->lockMapArchives(__FILE__, __LINE__);
-    for (std::list<ZipArchive*>::iterator i=mapArchives->begin();i!=mapArchives->end();i++) {
-      if ((*i)->getEntrySize(currentContainer->getImageFilePath())>0) {
-        mapArchive=*i;
-        break;
+
+    // Wait until a tile image is free
+    UByte *tileImage=NULL;
+    while (true) {
+      core->getThread()->lockMutex(decodeMutex,__FILE__, __LINE__);
+      if (!unusedTileImages.empty()) {
+        tileImage=unusedTileImages.front();
+        unusedTileImages.pop_front();
       }
+      core->getThread()->unlockMutex(decodeMutex);
+      if ((tileImage)||(abortUpdate)||(quitDecodeThreads))
+        break;
+      core->getThread()->waitForSignal(decodeStartSignals[threadNr]);
     }
-    if (!mapArchive) {
-      std::string path = currentContainer->getArchiveFilePath();
-      if (access(path.c_str(),F_OK)!=-1) {
-        mapArchive=new ZipArchive(currentContainer->getArchiveFileFolder(), currentContainer->getArchiveFileName());
-        if ((mapArchive==NULL)||(!mapArchive->init()))
-          FATAL("can not create zip archive object",NULL);
-        newMapArchive=true;
-      }
+    if (!tileImage)
+      break;
+
+    // Do the image conversion depending on the supported texture format
+    if (textureFormatRGB888Supported) {
+      core->getImage()->cropToRGB888(image,imageWidth,imagePixelSize,t->getMapX(),t->getMapY(),t->getWidth(),t->getHeight(),tileImage);
+    } else {
+      core->getImage()->cropToRGB565(image,imageWidth,imagePixelSize,t->getMapX(),t->getMapY(),t->getWidth(),t->getHeight(),(UShort*)tileImage);
     }
-    if (mapArchive) {
-
-      // Create a temporary file that contains the image data
-      UByte *imageData;
-      Int imageSize;
-      imageData=mapArchive->exportEntry(currentContainer->getImageFilePath(),imageSize);
-      if (imageData==NULL) {
-        currentImage=NULL; 
-      } else {
-
-        // Get the image from the temporary file
-        switch(currentContainer->getImageType()) {
-          case ImageTypeJPEG:
-            currentImage=core->getImage()->loadJPEG(imageData,imageSize,currentImageWidth,currentImageHeight,currentImagePixelSize,true);
-            break;
-          case ImageTypePNG:
-            currentImage=core->getImage()->loadPNG(imageData,imageSize,currentImageWidth,currentImageHeight,currentImagePixelSize,true);
-            break;
-          default:
-            FATAL("unsupported image type",NULL);
-            currentImage=NULL;
-            break;
-        }
-        free(imageData);
+
+    // Queue the tile image for the texture handover
+    MapCacheTileImage result;
+    result.mapTile=t;
+    result.image=tileImage;
+    core->getThread()->lockMutex(decodeMutex,__FILE__, __LINE__);
+    tileImageQueue.insert(MapCacheTileImageQueuePair(i->first,result));
+    core->getThread()->unlockMutex(decodeMutex);
+    core->getThread()->issueSignal(decodeResultSignal);
+  }
+  free(image);
+}
+
+// Processes the queued decode jobs (called by the decode threads)
+void MapCache::decodeTileImages(Int threadNr) {
+
+  // Set the priority
+  core->getThread()->setThreadPriority(threadPriorityForegroundLow);
+
+  // Process jobs until the cache is destroyed
+  while (true) {
+
+    // Wait until there is work
+    core->getThread()->waitForSignal(decodeStartSignals[threadNr]);
+    if (quitDecodeThreads)
+      core->getThread()->exitThread();
+
+    // Take the job with the nearest tile until the queue is empty
+    while (true) {
+      MapCacheDecodeJob *job=NULL;
+      core->getThread()->lockMutex(decodeMutex,__FILE__, __LINE__);
+      if ((!abortUpdate)&&(!decodeQueue.empty())) {
+        job=decodeQueue.begin()->second;
+        decodeQueue.erase(decodeQueue.begin());
+        activeDecodeJobs++;
       }
+      core->getThread()->unlockMutex(decodeMutex);
+      if (!job)
+        break;
+      processDecodeJob(job,threadNr);
+      delete job;
+      core->getThread()->lockMutex(decodeMutex,__FILE__, __LINE__);
+      activeDecodeJobs--;
+      core->getThread()->unlockMutex(decodeMutex);
+      core->getThread()->issueSignal(decodeResultSignal);
+      if (quitDecodeThreads)
+        core->getThread()->exitThread();
     }
-    core->getMapSource()->unlockMapArchives();
-    if (newMapArchive) {
-      delete mapArchive;
-      mapArchive=NULL;
+  }
+}
+
+// Hands over a decoded tile image to the graphic thread
+void MapCache::handoverTileImage(MapCacheTileImage tileImage) {
+  MapTile *t=tileImage.mapTile;
+
+  // Skip the tile if it has been removed or cached while it was decoded
+  core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+  MapCacheTileIndex::iterator tilePos=tileIndex.find(t);
+  if ((tilePos==tileIndex.end())||(tilePos->second.cached)) {
+    core->getThread()->unlockMutex(accessMutex);
+    return;
+  }
+
+  // Remove the oldest tile from the cached list if it has already its max length
+  bool cacheFull=(cachedTiles.size()>=size);
+  core->getThread()->unlockMutex(accessMutex);
+  if (cacheFull) {
+    evictTile();
+  }
+
+  // Update the texture
+  core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+  GraphicTextureInfo m=unusedTextures.front();
+  unusedTextures.pop_front();
+#ifdef DEBUG_CHECKS_ENABLED
+  for(std::list<MapTile*>::iterator i=cachedTiles.begin();i!=cachedTiles.end();i++) {
+    MapTile *t=*i;
+    if (t->getRectangle()->getTexture()==m) {
+      FATAL("cached tile uses textures that is marked as unused",NULL);
     }
-    if (currentImage) {
-
-      // Now find all map tiles with the same map container
-      std::list<MapTile*> mapTilesInSameContainer;
-      mapTilesInSameContainer.push_back(selectedMapTile);
-      for (std::list<MapTile*>::const_iterator i=mapTileLoadList.begin();i!=mapTileLoadList.end();i++) {
-        MapTile *t=*i;
-        if (t->getParentMapContainer()==selectedMapTile->getParentMapContainer()) {
-          mapTilesInSameContainer.push_back(t);          
-        }
-      }
-      //DEBUG("tiles in same counter: %d",mapTilesInSameContainer.size());
-
-      // And load them
-      for (std::list<MapTile*>::const_iterator i=mapTilesInSameContainer.begin();i!=mapTilesInSameContainer.end()&&!abortUpdate;i++) {
-        MapTile *t=*i;
-        //DEBUG("distance=%f",mapPos.computeDistance(t->getMapPosCenter()));
-
-        // Remove the oldest tile from the cached list if it has already its max length
-        if (cachedTiles.size()>=size) {
-          core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
-          cachedTiles.sort(MapTile::lastAccessSortPredicate);
-          MapTile *t=cachedTiles.front();
-          cachedTiles.pop_front();
-          uncachedTiles.push_back(t);
-          core->getThread()->unlockMutex(accessMutex);
-          GraphicTextureInfo m=t->getEndTexture();
-          core->getDefaultGraphicEngine()->lockDrawing(__FILE__, __LINE__);
-          GraphicRectangle *r=t->getRectangle();
-          r->setZ(0);
-          core->getDefaultGraphicEngine()->unlockDrawing();
-          core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
-          t->setIsCached(false);
-          usedTextures.remove(m);
-          unusedTextures.push_back(m);
-          core->getThread()->unlockMutex(accessMutex);
-        }
+  }
+  checkConsistency();
+#endif
+  usedTextures.insert(m);
+  currentTexture=m;
+  core->getThread()->unlockMutex(accessMutex);
+  currentTileImage=tileImage;
+  tileTextureAvailable=true;
+  core->tileTextureAvailable(__FILE__, __LINE__);
+  tileTextureAvailable=false;
 
-        // Do some sanity checks
-        if ((t->getWidth()!=core->getMapSource()->getMapTileWidth())||(t->getHeight()!=core->getMapSource()->getMapTileHeight())) {
-          FATAL("tiles whose width or height does not match the default are not supported",NULL);
-          break;
-        }
+  // Remove the tile from the uncached list and add it to the cached
+  // The tile may have been removed while the texture was updated, then the texture is not needed anymore
+  core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+  tilePos=tileIndex.find(t);
+  if ((tilePos==tileIndex.end())||(tilePos->second.cached)) {
+    usedTextures.erase(m);
+    unusedTextures.push_back(m);
+  } else {
+    t->setIsCached(true,m);
+    cachedTiles.splice(cachedTiles.end(),uncachedTiles,tilePos->second.pos);
+    tilePos->second.cached=true;
+  }
+  core->getThread()->unlockMutex(accessMutex);
+}
 
-        // Do the image conversion depending on the supported texture format
-        if (core->getDefaultScreen()->isTextureFormatRGB888Supported()) {
-          // Copy the image of the map tile from the map image
-          for (Int y=0;y<t->getHeight();y++) {
-            for (Int x=0;x<t->getWidth();x++) {
-              Int imagePos=((t->getMapY()+y)*currentImageWidth+(t->getMapX()+x))*currentImagePixelSize;
-              Int scratchPos=(y*t->getWidth()+x)*3;
-              tileImageScratch[scratchPos+0]=currentImage[imagePos+0];
-              tileImageScratch[scratchPos+1]=currentImage[imagePos+1];
-              tileImageScratch[scratchPos+2]=currentImage[imagePos+2];
-            }
-          }
-        } else {
-          // Copy the image of the map tile from the map image
-          // Do the conversion to RGB565
-          UShort *scratch=(UShort*)tileImageScratch;
-          for (Int y=0;y<t->getHeight();y++) {
-            for (Int x=0;x<t->getWidth();x++) {
-              Int imagePos=((t->getMapY()+y)*currentImageWidth+(t->getMapX()+x))*currentImagePixelSize;
-              Int scratchPos=(y*t->getWidth()+x);
-              scratch[scratchPos]=((currentImage[imagePos]>>3)<<11 | (currentImage[imagePos+1]>>2)<<5 | (currentImage[imagePos+2]>>3));
-            }
-          }
-        }
+// Returns a tile image to the pool and wakes up waiting decode threads
+void MapCache::releaseTileImage(UByte *tileImage) {
+  core->getThread()->lockMutex(decodeMutex,__FILE__, __LINE__);
+  unusedTileImages.push_back(tileImage);
+  core->getThread()->unlockMutex(decodeMutex);
+  for (Int i=0;i<numberOfDecodeThreads;i++)
+    core->getThread()->issueSignal(decodeStartSignals[i]);
+}
+
+// Drops all pending decode jobs and waits until the decode threads are idle
+void MapCache::cancelDecodeJobs() {
+
+  // Remove all jobs that have not been started yet
+  core->getThread()->lockMutex(decodeMutex,__FILE__, __LINE__);
+  for (MapCacheDecodeQueue::iterator i=decodeQueue.begin();i!=decodeQueue.end();i++) {
+    delete i->second;
+  }
+  decodeQueue.clear();
+  core->getThread()->unlockMutex(decodeMutex);
+
+  // Wake up threads waiting for a free tile image and wait until they have finished
+  for (Int i=0;i<numberOfDecodeThreads;i++)
+    core->getThread()->issueSignal(decodeStartSignals[i]);
+  while (true) {
+    core->getThread()->lockMutex(decodeMutex,__FILE__, __LINE__);
+    Int jobs=activeDecodeJobs;
+    core->getThread()->unlockMutex(decodeMutex);
+    if (jobs==0)
+      break;
+    core->getThread()->waitForSignal(decodeResultSignal);
+  }
+
+  // Return the tile images that have not been handed over
+  core->getThread()->lockMutex(decodeMutex,__FILE__, __LINE__);
+  for (MapCacheTileImageQueue::iterator i=tileImageQueue.begin();i!=tileImageQueue.end();i++) {
+    unusedTileImages.push_back(i->second.image);
+  }
+  tileImageQueue.clear();
+  core->getThread()->unlockMutex(decodeMutex);
+}
+
+// Updates the map images of tiles
+void MapCache::updateMapTileImages() {
+
+  // Get the current map position
+  MapPosition mapPos=*(core->getMapEngine()->lockMapPos(__FILE__,__LINE__));
+  core->getMapEngine()->unlockMapPos();
+
+  // Ensure that only one thread is executing this
+  core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
 
-        // Ensure that the tile is drawn first
-        //t->getVisualization()->setZ(1);
-
-        // Update the texture
-        /*std::list<std::string> names = t->getVisName();
-        std::string firstName = names.front();
-        names.pop_front();
-        std::string secondName = names.front();
-        DEBUG("updating texture for tile %s (%s)",firstName.c_str(),secondName.c_str());*/
-        core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
-        GraphicTextureInfo m=unusedTextures.front();
-        unusedTextures.pop_front();
-        usedTextures.push_back(m);
-        for(std::list<MapTile*>::iterator i=cachedTiles.begin();i!=cachedTiles.end();i++) {
-          MapTile *t=*i;
-          if (t->getRectangle()->getTexture()==m) {
-            FATAL("cached tile uses textures that is marked as unused",NULL);
-          }
+  // Check that all visible tile are cached
+  // If not, add them to the decode job of their map container
+  std::map<MapContainer*, MapCacheDecodeJob*> jobs;
+  for (std::list<MapTile*>::const_iterator i=uncachedTiles.begin();i!=uncachedTiles.end();i++) {
+    MapTile *t=*i;
+    if ((t->isDrawn())&&(t->getParentMapContainer()->getDownloadComplete())) {
+      MapCacheDecodeJob *&job=jobs[t->getParentMapContainer()];
+      if (!job) {
+        job=new MapCacheDecodeJob();
+        if (!job) {
+          FATAL("can not create decode job",NULL);
+          break;
         }
-        core->getThread()->unlockMutex(accessMutex);
-        currentTile=t;
-        tileTextureAvailable=true;
-        core->tileTextureAvailable(__FILE__, __LINE__);
-        tileTextureAvailable=false;
-
-        // Remove the tile from the uncached list and add it to the cached
-        //DEBUG("before setIsCached",NULL);
-        t->setIsCached(true,usedTextures.back());
-        //DEBUG("after setIsCached",NULL);
-        core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
-        uncachedTiles.remove(t);
-        cachedTiles.push_back(t);
-        core->getThread()->unlockMutex(accessMutex);
-        if (t!=selectedMapTile)
-          mapTileLoadList.remove(t);
+        job->mapContainer=t->getParentMapContainer();
       }
+      job->mapTiles.push_back(std::pair<double, MapTile*>(mapPos.computeDistance(t->getMapPosCenter()),t));
+    }
+  }
+  core->getThread()->unlockMutex(accessMutex);
+  if (jobs.size()==0) {
+    return; // Nothing to do
+  }
+
+  // Update has started
+  updateInProgress=true;
+
+  // Queue the jobs ordered by the distance of their nearest tile
+  core->getThread()->lockMutex(decodeMutex,__FILE__, __LINE__);
+  for (std::map<MapContainer*, MapCacheDecodeJob*>::iterator i=jobs.begin();i!=jobs.end();i++) {
+    MapCacheDecodeJob *job=i->second;
+    job->mapTiles.sort();
+    decodeQueue.insert(MapCacheDecodeQueuePair(job->mapTiles.front().first,job));
+  }
+  core->getThread()->unlockMutex(decodeMutex);
+  for (Int i=0;i<numberOfDecodeThreads;i++)
+    core->getThread()->issueSignal(decodeStartSignals[i]);
+
+  // Hand over the decoded tiles nearest first while the threads continue decoding
+  while (!abortUpdate) {
+    bool tileImageAvailable=false;
+    bool decodeFinished=false;
+    MapCacheTileImage tileImage;
+    core->getThread()->lockMutex(decodeMutex,__FILE__, __LINE__);
+    if (!tileImageQueue.empty()) {
+      tileImage=tileImageQueue.begin()->second;
+      tileImageQueue.erase(tileImageQueue.begin());
+      tileImageAvailable=true;
+    } else if ((decodeQueue.empty())&&(activeDecodeJobs==0)) {
+      decodeFinished=true;
+    }
+    core->getThread()->unlockMutex(decodeMutex);
+    if (tileImageAvailable) {
+      handoverTileImage(tileImage);
+      releaseTileImage(tileImage.image);
+    } else if (decodeFinished) {
+      break;
+    } else {
+      core->getThread()->waitForSignal(decodeResultSignal);
     }
-    free(currentImage);
-    currentImage=NULL;
   }
 
   // Clean up
+  cancelDecodeJobs();
   updateInProgress=false;
   abortUpdate=false;
 }
@@ -410,13 +656,14 @@ void MapCache::updateMapTileImages() {
 // Updates the currently waiting texture
 void MapCache::setNextTileTexture()
 {
-  GraphicTextureInfo m=usedTextures.back();
+  GraphicTextureInfo m=currentTexture;
+  MapTile *t=currentTileImage.mapTile;
   if (core->getDefaultScreen()->isTextureFormatRGB888Supported()) {
-    if (!(core->getDefaultScreen()->setTextureImage(m,(UByte*)tileImageScratch,currentTile->getWidth(),currentTile->getHeight(),GraphicTextureFormatRGB888))) {
+    if (!(core->getDefaultScreen()->setTextureImage(m,currentTileImage.image,t->getWidth(),t->getHeight(),GraphicTextureFormatRGB888))) {
       FATAL("can not update texture image",NULL);
     }
   } else {
-    if (!(core->getDefaultScreen()->setTextureImage(m,(UByte*)tileImageScratch,currentTile->getWidth(),currentTile->getHeight(),GraphicTextureFormatRGB565))) {
+    if (!(core->getDefaultScreen()->setTextureImage(m,currentTileImage.image,t->getWidth(),t->getHeight(),GraphicTextureFormatRGB565))) {
       FATAL("can not update texture image",NULL);
     }
   }
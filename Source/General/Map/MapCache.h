@@ -28,26 +28,93 @@
 
 namespace GEODISCOVERER {
 
+class MapContainer;
+class ZipArchiveReader;
+
+// Tiles of one map container that must be decoded together
+struct MapCacheDecodeJob {
+  MapContainer *mapContainer;                             // Container whose image holds the tiles
+  std::list<std::pair<double, MapTile*> > mapTiles;       // Tiles to cut out together with their distance to the map center
+};
+
+// Image of a tile that is ready for handover to the graphic system
+struct MapCacheTileImage {
+  MapTile *mapTile;                                       // Tile the image belongs to
+  UByte *image;                                           // Pixels in the texture format of the screen
+};
+
+typedef std::multimap<double, MapCacheDecodeJob*> MapCacheDecodeQueue;
+typedef std::pair<double, MapCacheDecodeJob*> MapCacheDecodeQueuePair;
+typedef std::multimap<double, MapCacheTileImage> MapCacheTileImageQueue;
+typedef std::pair<double, MapCacheTileImage> MapCacheTileImageQueuePair;
+
+// Position of a tile in the cached or uncached list
+struct MapCacheTilePos {
+  bool cached;                                            // Indicates if the tile is in the cached list
+  std::list<MapTile*>::iterator pos;                      // Position of the tile within its list
+  Int lastRequest;                                        // Number of the tile request round in which the tile was last visible
+};
+
+typedef std::unordered_map<MapTile*, MapCacheTilePos> MapCacheTileIndex;
+
 class MapCache {
 
 protected:
 
   Int size;                                       // Number of tiles to cache
-  UByte *tileImageScratch;                        // Holds the image of one tile for handover to the graphic system
-  MapTile *currentTile;                           // Tile that is currently processed
-  std::list<MapTile *> cachedTiles;               // List of tiles that are currently cached
+  MapCacheTileImage currentTileImage;             // Tile image that is currently handed over to the graphic system
+  std::list<MapTile *> cachedTiles;               // List of tiles that are currently cached (least recently used first)
   std::list<MapTile *> uncachedTiles;             // List of tiles that are currently not cached
-  std::list<GraphicTextureInfo> usedTextures;     // List of used texture infos
+  MapCacheTileIndex tileIndex;                    // Position of every known tile in the cached or uncached list
+  std::unordered_set<GraphicTextureInfo> usedTextures; // Set of used texture infos
   std::list<GraphicTextureInfo> unusedTextures;   // List of tiles that are currently not cached
+  GraphicTextureInfo currentTexture;              // Texture that receives the current tile image
+  Int hits;                                       // Number of tiles that were found in the cache when they became visible
+  Int misses;                                     // Number of tiles that were not found in the cache when they became visible
+  Int requestRound;                               // Number of times the visible tiles have been requested
+  Int evictions;                                  // Number of tiles that were removed to make room for others
   bool tileTextureAvailable;                      // Indicates that a new map textue is available
-  bool abortUpdate;                               // Indicates that the current cache update shall be stopped
+  std::atomic<bool> abortUpdate;                  // Indicates that the current cache update shall be stopped
   bool updateInProgress;                          // Indicates if an update is currently ongoing
   bool isInitialized;                             // Indicates if the map cache is initialized
   ThreadMutexInfo *accessMutex;                   // Mutex for modifying the object
+  Int numberOfDecodeThreads;                      // Number of threads that decode tile images
+  std::vector<ThreadInfo *> decodeThreadInfos;    // Threads that decode tile images
+  std::vector<ThreadSignalInfo *> decodeStartSignals; // Signals that trigger the decode threads
+  ThreadSignalInfo *decodeResultSignal;           // Signal that indicates that a decode thread has produced something
+  ThreadMutexInfo *decodeMutex;                   // Mutex for accessing the decode queues
+  MapCacheDecodeQueue decodeQueue;                // Containers to decode ordered by their distance to the map center
+  MapCacheTileImageQueue tileImageQueue;          // Decoded tiles ordered by their distance to the map center
+  std::list<UByte*> unusedTileImages;             // Tile image buffers that can be filled by the decode threads
+  std::list<UByte*> tileImages;                   // All tile image buffers
+  Int activeDecodeJobs;                           // Number of decode jobs that are currently processed
+  bool quitDecodeThreads;                         // Indicates that the decode threads shall exit
 
   // Updates the map images of tiles
   void updateMapTileImages();
 
+  // Reads the image of the map container from its archive
+  // The data may point into the archive reader which must then be deleted after use if it is returned in mapArchiveReader
+  UByte *readMapContainerImage(MapContainer *mapContainer, Int &imageSize, bool &imageDataCopied, ZipArchiveReader *&mapArchiveReader);
+
+  // Decodes the image of a map container and cuts out the requested tiles
+  void processDecodeJob(MapCacheDecodeJob *job, Int threadNr);
+
+  // Hands over a decoded tile image to the graphic system
+  void handoverTileImage(MapCacheTileImage tileImage);
+
+  // Returns a tile image buffer to the pool
+  void releaseTileImage(UByte *image);
+
+  // Removes all pending jobs and waits until the decode threads are idle
+  void cancelDecodeJobs();
+
+  // Moves the least recently used tile to the uncached list
+  void evictTile();
+
+  // Checks the consistency of the cache lists
+  void checkConsistency();
+
 public:
 
   // Constructors and destructor
@@ -75,9 +142,18 @@ public:
   // Removes a tile from the cache
   void removeTile(MapTile *tile);
 
+  // Marks the visible tiles as recently used
+  void touchTiles(std::list<MapTile*> &tiles);
+
+  // Outputs statistical infos
+  void outputStats();
+
   // Updates the currently waiting texture
   void setNextTileTexture();
 
+  // Decodes tile images in the background
+  void decodeTileImages(Int threadNr);
+
   // Getters and setters
   bool getTileTextureAvailable() const
   {
@@ -88,7 +164,6 @@ public:
   {
       if (updateInProgress) {
         this->abortUpdate = true;
-        core->getImage()->setAbortLoad();
       }
   }
 
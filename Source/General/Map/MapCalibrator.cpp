@@ -23,7 +23,7 @@
 #include <Core.h>
 #include <MapCalibrator.h>
 #include <MapPosition.h>
-#include <Storage.h>
+#include <MapIndex.h>
 #include <MapCalibratorLinear.h>
 #include <MapCalibratorProj.h>
 #include <MapCalibratorSphericalNormalMercator.h>
@@ -31,12 +31,12 @@
 namespace GEODISCOVERER {
 
 // Constructor
-MapCalibrator::MapCalibrator(bool doNotDelete) {
-  this->doNotDelete=doNotDelete;
+MapCalibrator::MapCalibrator() {
   args=NULL;
-  if (doNotDelete) {
-    new(&this->calibrationPoints) std::list<MapPosition*>();
-  }
+  points=NULL;
+  pointCount=0;
+  cartesianToPicture.valid=false;
+  pictureToCartesian=NULL;
   this->accessMutex=core->getThread()->createMutex("map calibrator access mutex");
 }
 
@@ -51,9 +51,9 @@ MapCalibrator::~MapCalibrator() {
     MapPosition *t=*i;
     MapPosition::destruct(t);
   }
-  if (!doNotDelete) {
-    if (args) free(args);
-  }
+  if (points) free(points);
+  if (pictureToCartesian) free(pictureToCartesian);
+  if (args) free(args);
   core->getThread()->destroyMutex(this->accessMutex);
 }
 
@@ -77,151 +77,181 @@ void MapCalibrator::addCalibrationPoint(MapPosition pos) {
   // Put it into the list
   calibrationPoints.push_back(t);
 
+  // Update the transforms used for the conversion
+  updateTransforms();
+
   core->getThread()->unlockMutex(accessMutex);
 }
 
-// Finds the nearest n calibration points
-void MapCalibrator::sortCalibrationPoints(MapPosition &pos, bool usePictureCoordinates) {
-  for (std::list<MapPosition*>::const_iterator i=calibrationPoints.begin();i!=calibrationPoints.end();i++) {
-    MapPosition *t=*i;
-    if (usePictureCoordinates) {
-      Int dX=pos.getX()-t->getX();
-      Int dY=pos.getY()-t->getY();
-      UInt d=dX*dX+dY*dY;
-      t->setDistance(d);
-    } else {
-      t->setDistance(pos.computeDistance(t));
-    }
-    //DEBUG("d=%d",d);
+// Returns the position of the transform for the ordered triple i,j,k in the table of n points
+static inline Int getTransformIndex(Int n, Int i, Int j, Int k) {
+  Int jIndex=j-(j>i);
+  Int kIndex=k-(k>i)-(k>j);
+  return (i*(n-1)+jIndex)*(n-2)+kIndex;
+}
+
+// Computes the transform defined by the three given calibration points
+void MapCalibrator::computeTransform(const MapCalibratorPoint *a, const MapCalibratorPoint *b, const MapCalibratorPoint *c, bool fromPictureCoordinates, MapCalibratorTransform &transform) {
+  double pictureX[3] = { (double)a->x, (double)b->x, (double)c->x };
+  double pictureY[3] = { (double)a->y, (double)b->y, (double)c->y };
+  double cartesianX[3] = { a->cartesianX, b->cartesianX, c->cartesianX };
+  double cartesianY[3] = { a->cartesianY, b->cartesianY, c->cartesianY };
+  if (fromPictureCoordinates) {
+    transform.valid=FloatingPoint::solveZEqualsC0XPlusC1YPlusC2(pictureX,pictureY,cartesianX,transform.horizontal)&&
+                    FloatingPoint::solveZEqualsC0XPlusC1YPlusC2(pictureX,pictureY,cartesianY,transform.vertical);
+  } else {
+    transform.valid=FloatingPoint::solveZEqualsC0XPlusC1YPlusC2(cartesianX,cartesianY,pictureX,transform.horizontal)&&
+                    FloatingPoint::solveZEqualsC0XPlusC1YPlusC2(cartesianX,cartesianY,pictureY,transform.vertical);
   }
-  calibrationPoints.sort(MapPosition::distanceSortPredicate);
 }
 
-// Store the contents of the object in a binary file
-void MapCalibrator::store(std::ofstream *ofs) {
+// Precomputes the transforms from the current calibration points
+void MapCalibrator::updateTransforms() {
 
-  // Write the size of the object for detecting changes later
-  Storage::storeInt(ofs,type);
-  Int size;
-  switch(type) {
-    case MapCalibratorTypeLinear:
-      size=sizeof(MapCalibratorLinear);
-      break;
-    case MapCalibratorTypeSphericalNormalMercator:
-      size=sizeof(MapCalibratorSphericalNormalMercator);
-      break;
-    case MapCalibratorTypeProj:
-      size=sizeof(MapCalibratorProj);
-      break;
-    default:
-      FATAL("map calibrator type not supported",NULL);
-      break;
+  // Copy the calibration points into an array
+  Int n=calibrationPoints.size();
+  MapCalibratorPoint *points=NULL;
+  if (n>0) {
+    if (!(points=(MapCalibratorPoint*)malloc(n*sizeof(MapCalibratorPoint)))) {
+      FATAL("can not create calibration point array",NULL);
+      return;
+    }
   }
-  Storage::storeInt(ofs,size);
-
-  // Store all relevant fields
-  Storage::storeMem(ofs,(char*)this,size,true);
-  if (args==NULL)
-    Storage::storeString(ofs,(char*)"");
-  else
-    Storage::storeString(ofs,args);
-  Storage::storeInt(ofs,calibrationPoints.size());
-  for(std::list<MapPosition*>::iterator i=calibrationPoints.begin();i!=calibrationPoints.end();i++) {
-    (*i)->store(ofs);
+  Int l=0;
+  for (std::list<MapPosition*>::const_iterator i=calibrationPoints.begin();i!=calibrationPoints.end();i++) {
+    MapPosition *t=*i;
+    points[l].x=t->getX();
+    points[l].y=t->getY();
+    points[l].cartesianX=t->getCartesianX();
+    points[l].cartesianY=t->getCartesianY();
+    l++;
+  }
+
+  // The conversion to picture coordinates uses the first three calibration points
+  MapCalibratorTransform cartesianToPicture;
+  cartesianToPicture.valid=false;
+  if (n>=3) {
+    computeTransform(&points[0],&points[1],&points[2],false,cartesianToPicture);
+  }
+
+  // The conversion from picture coordinates uses the three nearest calibration points
+  // Precompute the transforms for all possible triples if this is affordable
+  MapCalibratorTransform *pictureToCartesian=NULL;
+  if ((n>=3)&&(n<=maxPrecomputedPoints)) {
+    if (!(pictureToCartesian=(MapCalibratorTransform*)malloc(n*(n-1)*(n-2)*sizeof(MapCalibratorTransform)))) {
+      FATAL("can not create transform array",NULL);
+      return;
+    }
+    for (Int i=0;i<n;i++) {
+      for (Int j=0;j<n;j++) {
+        if (j==i)
+          continue;
+        for (Int k=0;k<n;k++) {
+          if ((k==i)||(k==j))
+            continue;
+          computeTransform(&points[i],&points[j],&points[k],true,pictureToCartesian[getTransformIndex(n,i,j,k)]);
+        }
+      }
+    }
   }
 
+  // Replace the previous data
+  if (this->points) free(this->points);
+  if (this->pictureToCartesian) free(this->pictureToCartesian);
+  this->points=points;
+  this->pointCount=n;
+  this->cartesianToPicture=cartesianToPicture;
+  this->pictureToCartesian=pictureToCartesian;
 }
 
-// Reads the contents of the object from a binary file
-MapCalibrator *MapCalibrator::retrieve(char *&cacheData, Int &cacheSize) {
+// Returns the three calibration points nearest to the given picture coordinates, ordered by distance
+void MapCalibrator::findThreeNearestCalibrationPoints(Int x, Int y, Int *nearest) const {
+  UInt nearestDistance[3];
+  for (Int i=0;i<pointCount;i++) {
+    Int dX=x-points[i].x;
+    Int dY=y-points[i].y;
+    UInt d=dX*dX+dY*dY;
+
+    // Insert the point behind all points with the same distance (as a stable sort does)
+    Int j=(i<3) ? i : 3;
+    while ((j>0)&&(d<nearestDistance[j-1])) {
+      if (j<3) {
+        nearest[j]=nearest[j-1];
+        nearestDistance[j]=nearestDistance[j-1];
+      }
+      j--;
+    }
+    if (j<3) {
+      nearest[j]=i;
+      nearestDistance[j]=d;
+    }
+  }
+}
 
-  //PROFILE_START;
+// Adds the contents of the object to the map index
+void MapCalibrator::store(MapIndex *mapIndex, MapIndexContainer &record) {
+  record.calibratorType=type;
+  record.calibratorArgs=mapIndex->storeString(args==NULL ? "" : args);
+  record.calibrationPointCount=0;
+  for(std::list<MapPosition*>::iterator i=calibrationPoints.begin();i!=calibrationPoints.end();i++) {
+    MapIndexCalibrationPoint p;
+    p.lat=(*i)->getLat();
+    p.lng=(*i)->getLng();
+    p.cartesianX=(*i)->getCartesianX();
+    p.cartesianY=(*i)->getCartesianY();
+    p.x=(*i)->getX();
+    p.y=(*i)->getY();
+    Int index=mapIndex->storeCalibrationPoint(p);
+    if (record.calibrationPointCount==0)
+      record.calibrationPointFirst=index;
+    record.calibrationPointCount++;
+  }
+}
 
-  // Read the type
-  Int t;
-  Storage::retrieveInt(cacheData,cacheSize,t);
-  MapCalibratorType type=(MapCalibratorType)t;
+// Creates the object from the map index
+MapCalibrator *MapCalibrator::retrieve(MapIndex *mapIndex, const MapIndexContainer *record) {
 
-  // Check if the class has changed
-  Int expectedSize;
-  switch(type) {
+  // Create the calibrator
+  switch(record->calibratorType) {
     case MapCalibratorTypeLinear:
-      expectedSize=sizeof(MapCalibratorLinear);
-#ifdef TARGET_LINUX
-      if (expectedSize!=56) {
-        FATAL("unknown size of object (%d), please adapt class storage",expectedSize);
-        return NULL;
-      }
-#endif
-      break;
     case MapCalibratorTypeSphericalNormalMercator:
-      expectedSize=sizeof(MapCalibratorSphericalNormalMercator);
-#ifdef TARGET_LINUX
-      if (expectedSize!=64) {
-        FATAL("unknown size of object (%d), please adapt class storage",expectedSize);
-        return NULL;
-      }
-#endif
-      break;
     case MapCalibratorTypeProj:
-      expectedSize=sizeof(MapCalibratorProj);
-#ifdef TARGET_LINUX
-      if (expectedSize!=72) {
-        FATAL("unknown size of object (%d), please adapt class storage",expectedSize);
-        return NULL;
-      }
-#endif
       break;
     default:
       DEBUG("unsupported map calibration type, aborting retrieve",NULL);
       return NULL;
-      break;
   }
-
-  // Read the size of the object and check with current size
-  Int size=0;
-  Storage::retrieveInt(cacheData,cacheSize,size);
-  if (size!=expectedSize) {
-    DEBUG("stored size of object does not match implemented object size, aborting retrieve",NULL);
-    return NULL;
-  }
-  //PROFILE_ADD("sanity check");
-
-  // Create a new map container object
-  Storage::skipPadding(cacheData,cacheSize);
-  MapCalibrator *mapCalibrator=MapCalibrator::newMapCalibrator(type,cacheData,cacheSize);
-  //PROFILE_ADD("object creation");
-
-  // Read the fields
-  Storage::retrieveString(cacheData,cacheSize,&mapCalibrator->args);
+  MapCalibrator *mapCalibrator=MapCalibrator::newMapCalibrator((MapCalibratorType)record->calibratorType);
+  char *args=mapIndex->getString(record->calibratorArgs);
+  mapCalibrator->setArgs(args==NULL ? "" : args);
 
   // Init the calibrator
   mapCalibrator->init();
 
   // Read the calibration points
-  Storage::retrieveInt(cacheData,cacheSize,size);
-  for (Int i=0;i<size;i++) {
-    MapPosition *p=MapPosition::retrieve(cacheData,cacheSize);
-    if (p==NULL) {
-      MapCalibrator::destruct(mapCalibrator);
-      return NULL;
+  for (UInt i=0;i<record->calibrationPointCount;i++) {
+    const MapIndexCalibrationPoint *p=mapIndex->getCalibrationPoint(record->calibrationPointFirst+i);
+    MapPosition *t=new MapPosition();
+    if (!t) {
+      FATAL("can not create map position",NULL);
     }
-    mapCalibrator->calibrationPoints.push_back(p);
+    t->setLat(p->lat);
+    t->setLng(p->lng);
+    t->setCartesianX(p->cartesianX);
+    t->setCartesianY(p->cartesianY);
+    t->setX(p->x);
+    t->setY(p->y);
+    mapCalibrator->calibrationPoints.push_back(t);
   }
-  //PROFILE_ADD("map position retrieve");
-
+  mapCalibrator->updateTransforms();
 
   // Return result
   return mapCalibrator;
 }
 
-// Destructs the objects correctly (i.e., if memory has not been allocated by new)
+// Destructs the object
 void MapCalibrator::destruct(MapCalibrator *object) {
-  if (object->doNotDelete) {
-    object->~MapCalibrator();
-  } else {
-    delete object;
-  }
+  delete object;
 }
 
 // Creates a new map calibrator of the given type by reserving new memory
@@ -245,38 +275,19 @@ MapCalibrator *MapCalibrator::newMapCalibrator(MapCalibratorType type) {
   return NULL;
 }
 
-// Creates a new map calibrator of the given type by using given memory
-MapCalibrator *MapCalibrator::newMapCalibrator(MapCalibratorType type, char *&cacheData, Int &cacheSize) {
-  MapCalibrator *mapCalibrator=NULL;
-  MapCalibratorLinear *linear;
-  MapCalibratorSphericalNormalMercator *mercator;
-  Int size;
-  switch(type) {
-    case MapCalibratorTypeLinear:
-      size=sizeof(MapCalibratorLinear);
-      mapCalibrator=new(cacheData) MapCalibratorLinear(true);
-      break;
-    case MapCalibratorTypeSphericalNormalMercator:
-      size=sizeof(MapCalibratorSphericalNormalMercator);
-      mapCalibrator=new(cacheData) MapCalibratorSphericalNormalMercator(true);
-      break;
-    case MapCalibratorTypeProj:
-      size=sizeof(MapCalibratorProj);
-      mapCalibrator=new(cacheData) MapCalibratorProj(true);
-      break;
-    default:
-      FATAL("unsupported map calibration type",NULL);
-      return NULL;
-      break;
-  }
-  cacheSize-=size;
-  if (cacheSize<0) {
-    DEBUG("can not create map calibrator object",NULL);
-    return NULL;
-  }
-  //mapCalibrator=(MapCalibrator*)cacheData;
-  cacheData+=size;
-  return mapCalibrator;
+// Creates the resources a thread needs for creating calibrators in parallel
+MapCalibratorThreadContext *MapCalibrator::createThreadContext() {
+  return MapCalibratorProj::createThreadContext();
+}
+
+// Frees the resources a thread needs for creating calibrators in parallel
+void MapCalibrator::destroyThreadContext(MapCalibratorThreadContext *context) {
+  MapCalibratorProj::destroyThreadContext(context);
+}
+
+// Sets the resources used by the calibrators created in the calling thread
+void MapCalibrator::setThreadContext(MapCalibratorThreadContext *context) {
+  MapCalibratorProj::setThreadContext(context);
 }
 
 // Compute the distance in pixels for the given points
@@ -298,146 +309,103 @@ void MapCalibrator::deinit() {
 
 }
 
-// Returns the three nearest calibration points
-bool MapCalibrator::findThreeNearestCalibrationPoints(bool usePictureCoordinates, MapPosition pos, std::vector<double> &pictureX, std::vector<double> &pictureY, std::vector<double> &cartesianX, std::vector<double> &cartesianY) {
-
-  // Check that we have enough calibration points
-  if (calibrationPoints.size()<3) {
-    FATAL("at least 3 calibration points are required",NULL);
-    return false;
-  }
-
-  // Prepare variables
-  pictureX.resize(3);
-  pictureY.resize(3);
-  cartesianX.resize(3);
-  cartesianY.resize(3);
-
-  // Find the nearest calibration points
-  sortCalibrationPoints(pos,usePictureCoordinates);
-
-  // Solve the equation
-  Int j=0;
-  for (std::list<MapPosition*>::const_iterator i=calibrationPoints.begin();i!=calibrationPoints.end();i++) {
-    MapPosition *t=*i;
-    pictureX[j]=t->getX();
-    pictureY[j]=t->getY();
-    cartesianX[j]=t->getCartesianX();
-    cartesianY[j]=t->getCartesianY();
-    if (j==2)
-      break;
-    j++;
-  }
-  return true;
-}
-
 // Updates the geographic coordinates (longitude and latitude) from the given picture coordinates
 bool MapCalibrator::setGeographicCoordinates(MapPosition &pos) {
 
-  // Ensure that only one thread is executing this function at a time
-  core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
-
-  // Find the nearest calibration points
-  std::vector<double> picX;
-  std::vector<double> picY;
-  std::vector<double> cartX;
-  std::vector<double> cartY;
-  if (!findThreeNearestCalibrationPoints(true,pos,picX,picY,cartX,cartY)) {
-    core->getThread()->unlockMutex(accessMutex);
+  // Check that we have enough calibration points
+  if (pointCount<3) {
+    FATAL("at least 3 calibration points are required",NULL);
     return false;
   }
 
-  // Solve the equation to compute cartesian coordinates from picture coordinates
-  std::vector<double> cHoriz,cVert;
-  cHoriz=FloatingPoint::solveZEqualsC0XPlusC1YPlusC2(picX,picY,cartX);
-  cVert=FloatingPoint::solveZEqualsC0XPlusC1YPlusC2(picX,picY,cartY);
-  if ((cHoriz.size()==0)) {
-    FATAL("can not solve equation cartX=cHoriz[0]*picX+cHoriz[1]*picY+cHoriz[2]",NULL);
-    core->getThread()->unlockMutex(accessMutex);
-    return false;
+  // Get the transform defined by the nearest calibration points
+  Int nearest[3];
+  MapCalibratorTransform computedTransform;
+  const MapCalibratorTransform *transform;
+  findThreeNearestCalibrationPoints(pos.getX(),pos.getY(),nearest);
+  if (pictureToCartesian) {
+    transform=&pictureToCartesian[getTransformIndex(pointCount,nearest[0],nearest[1],nearest[2])];
+  } else {
+    computeTransform(&points[nearest[0]],&points[nearest[1]],&points[nearest[2]],true,computedTransform);
+    transform=&computedTransform;
   }
-  if ((cVert.size()==0)) {
-    FATAL("can not solve equation cartY=cVert[0]*picX+cVert[1]*picY+cVert[2]",NULL);
-    core->getThread()->unlockMutex(accessMutex);
+  if (!transform->valid) {
+    FATAL("can not solve equation cart=c[0]*picX+c[1]*picY+c[2]",NULL);
     return false;
   }
 
   // Compute the position
-  pos.setCartesianX(cHoriz[0]*pos.getX()+cHoriz[1]*pos.getY()+cHoriz[2]);
-  pos.setCartesianY(cVert[0]*pos.getX()+cVert[1]*pos.getY()+cVert[2]);
+  pos.setCartesianX(transform->horizontal[0]*pos.getX()+transform->horizontal[1]*pos.getY()+transform->horizontal[2]);
+  pos.setCartesianY(transform->vertical[0]*pos.getX()+transform->vertical[1]*pos.getY()+transform->vertical[2]);
   convertCartesianToGeographic(pos);
 
   // Check ranges
   if ((pos.getLng()>180.0)||(pos.getLng()<-180.0)) {
-    core->getThread()->unlockMutex(accessMutex);
     return false;
   }
   if ((pos.getLat()>90.0)||(pos.getLat()<-90.0)) {
-    core->getThread()->unlockMutex(accessMutex);
     return false;
   }
 
   // That's it
-  core->getThread()->unlockMutex(accessMutex);
   return true;
 }
 
+// Updates the geographic coordinates of all given positions (returns false if one of them failed)
+bool MapCalibrator::setGeographicCoordinates(MapPosition *positions, Int count) {
+  bool result=true;
+  for (Int i=0;i<count;i++) {
+    if (!setGeographicCoordinates(positions[i]))
+      result=false;
+  }
+  return result;
+}
+
 // Updates the picture coordinates from the given geographic coordinates
 bool MapCalibrator::setPictureCoordinates(MapPosition &pos, bool debug) {
 
-  // Ensure that only one thread is executing this function at a time
-  core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
-
-  // Find the nearest calibration points
-  std::vector<double> picX;
-  std::vector<double> picY;
-  std::vector<double> cartX;
-  std::vector<double> cartY;
-  if (!findThreeNearestCalibrationPoints(false,pos,picX,picY,cartX,cartY)) {
-    core->getThread()->unlockMutex(accessMutex);
+  // Check that we have enough calibration points
+  if (pointCount<3) {
+    FATAL("at least 3 calibration points are required",NULL);
     return false;
   }
   if (debug) {
     for (int i=0;i<3;i++) {
-      DEBUG("%d: picX=%03.0f picY=%03.0f cartX=%02.6f cartY=%02.6f",i,picX[i],picY[i],cartX[i],cartY[i]);
+      DEBUG("%d: picX=%03d picY=%03d cartX=%02.6f cartY=%02.6f",i,points[i].x,points[i].y,points[i].cartesianX,points[i].cartesianY);
     }
   }
-
-  // Solve the equation to compute picture coordinates from cartesian coordinates
-  std::vector<double> cHoriz,cVert;
-  cHoriz=FloatingPoint::solveZEqualsC0XPlusC1YPlusC2(cartX,cartY,picX);
-  cVert=FloatingPoint::solveZEqualsC0XPlusC1YPlusC2(cartX,cartY,picY);
-  if ((cHoriz.size()==0)) {
-    FATAL("can not solve equation picX=cHoriz[0]*cartX+cHoriz[1]*cartY+cHoriz[2]",NULL);
-    core->getThread()->unlockMutex(accessMutex);
-    return false;
-  }
-  if ((cVert.size()==0)) {
-    FATAL("can not solve equation picY=cVert[0]*cartX+cVert[1]*cartY+cVert[2]",NULL);
-    core->getThread()->unlockMutex(accessMutex);
+  if (!cartesianToPicture.valid) {
+    FATAL("can not solve equation pic=c[0]*cartX+c[1]*cartY+c[2]",NULL);
     return false;
   }
 
   // Compute the position
   convertGeographicToCartesian(pos);
-  double x=round(cHoriz[0]*pos.getCartesianX()+cHoriz[1]*pos.getCartesianY()+cHoriz[2]);
-  double y=round(cVert[0]*pos.getCartesianX()+cVert[1]*pos.getCartesianY()+cVert[2]);
+  double x=round(cartesianToPicture.horizontal[0]*pos.getCartesianX()+cartesianToPicture.horizontal[1]*pos.getCartesianY()+cartesianToPicture.horizontal[2]);
+  double y=round(cartesianToPicture.vertical[0]*pos.getCartesianX()+cartesianToPicture.vertical[1]*pos.getCartesianY()+cartesianToPicture.vertical[2]);
 
   // Check ranges
   if ((x>std::numeric_limits<Int>::max())||(x<std::numeric_limits<Int>::min())) {
-    core->getThread()->unlockMutex(accessMutex);
     return false;
   }
   if ((y>std::numeric_limits<Int>::max())||(y<std::numeric_limits<Int>::min())) {
-    core->getThread()->unlockMutex(accessMutex);
     return false;
   }
   pos.setX(x);
   pos.setY(y);
 
   // That's it
-  core->getThread()->unlockMutex(accessMutex);
   return true;
 }
 
+// Updates the picture coordinates of all given positions (returns false if one of them failed)
+bool MapCalibrator::setPictureCoordinates(MapPosition *positions, Int count) {
+  bool result=true;
+  for (Int i=0;i<count;i++) {
+    if (!setPictureCoordinates(positions[i]))
+      result=false;
+  }
+  return result;
+}
+
 }
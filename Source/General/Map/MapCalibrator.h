@@ -26,23 +26,49 @@
 
 namespace GEODISCOVERER {
 
+class MapIndex;
+struct MapIndexContainer;
+struct MapCalibratorThreadContext;
+
 typedef enum { MapCalibratorTypeLinear=0, MapCalibratorTypeSphericalNormalMercator=1, MapCalibratorTypeProj=2 } MapCalibratorType;
 
+// Calibration point in the form used for converting coordinates
+typedef struct MapCalibratorPoint {
+  Int x, y;                           // Picture coordinates
+  double cartesianX, cartesianY;      // Cartesian coordinates
+} MapCalibratorPoint;
+
+// Affine transform between picture and cartesian coordinates
+typedef struct MapCalibratorTransform {
+  double horizontal[3];               // Constants of the equation for the horizontal coordinate
+  double vertical[3];                 // Constants of the equation for the vertical coordinate
+  bool valid;                         // Indicates if the calibration points allowed to compute the constants
+} MapCalibratorTransform;
+
 class MapCalibrator {
 
 protected:
 
   MapCalibratorType type; // Type of calibrator
   char *args; // Arguments for the calibrator
-  bool doNotDelete; // Indicates if the object has been alloacted by an own memory handler
   std::list<MapPosition *> calibrationPoints; // List of calibration points
-  ThreadMutexInfo *accessMutex; // Mutex for using the set*Coordinates methods
+  ThreadMutexInfo *accessMutex; // Mutex for accessing the list of calibration points
+  MapCalibratorPoint *points; // Copy of the calibration points that is read without locking
+  Int pointCount; // Number of entries in points
+  MapCalibratorTransform cartesianToPicture; // Transform from cartesian to picture coordinates
+  MapCalibratorTransform *pictureToCartesian; // Transforms from picture to cartesian coordinates for each ordered triple of points (NULL if there are too many points)
+
+  // Up to this number of calibration points, the transforms for all triples are precomputed
+  static const Int maxPrecomputedPoints = 8;
 
-  // Finds the nearest n calibration points
-  void sortCalibrationPoints(MapPosition &pos, bool usePictureCoordinates);
+  // Computes the transform defined by the three given calibration points
+  static void computeTransform(const MapCalibratorPoint *a, const MapCalibratorPoint *b, const MapCalibratorPoint *c, bool fromPictureCoordinates, MapCalibratorTransform &transform);
 
-  // Returns the three nearest calibration points
-  bool findThreeNearestCalibrationPoints(bool usePictureCoordinates, MapPosition pos, std::vector<double> &pictureX, std::vector<double> &pictureY, std::vector<double> &cartesianX, std::vector<double> &cartesianY);
+  // Precomputes the transforms from the current calibration points
+  void updateTransforms();
+
+  // Returns the three calibration points nearest to the given picture coordinates, ordered by distance
+  void findThreeNearestCalibrationPoints(Int x, Int y, Int *nearest) const;
 
   // Convert the geographic longitude / latitude coordinates to cartesian X / Y coordinates
   virtual void convertGeographicToCartesian(MapPosition &pos) = 0;
@@ -55,48 +81,61 @@ public:
   // Creates a new map calibrator of the given type by reserving new memory
   static MapCalibrator *newMapCalibrator(MapCalibratorType type);
 
-  // Creates a new map calibrator of the given type by using given memory
-  static MapCalibrator *newMapCalibrator(MapCalibratorType type, char *&cacheData, Int &cacheSize);
-
   // Constructors and destructor
-  MapCalibrator(bool doNotDelete=false);
+  MapCalibrator();
   virtual ~MapCalibrator();
 
-  // Destructs the objects correctly (i.e., if memory has not been allocated by new)
+  // Destructs the object
   static void destruct(MapCalibrator *object);
 
+  // Creates and frees the resources a thread needs for creating calibrators in parallel
+  static MapCalibratorThreadContext *createThreadContext();
+  static void destroyThreadContext(MapCalibratorThreadContext *context);
+
+  // Sets the resources used by the calibrators created in the calling thread (NULL for the shared ones)
+  static void setThreadContext(MapCalibratorThreadContext *context);
+
   // Inits the calibrator
   virtual void init();
 
   // Frees the calibrator
   virtual void deinit();
 
+  // Moves the calibrator from the resources of the thread that created it to the shared ones
+  // Must be called before the thread context is destroyed
+  virtual void releaseThreadContext() {
+  }
+
   // Adds a calibration point
+  // All points must be added before the calibrator is used by multiple threads
   void addCalibrationPoint(MapPosition pos);
 
   // Updates the geographic coordinates (longitude and latitude) from the given picture coordinates
   bool setGeographicCoordinates(MapPosition &pos);
 
+  // Updates the geographic coordinates of all given positions (returns false if one of them failed)
+  bool setGeographicCoordinates(MapPosition *positions, Int count);
+
   // Updates the picture coordinates from the given geographic coordinates
   bool setPictureCoordinates(MapPosition &pos, bool debug=false);
 
+  // Updates the picture coordinates of all given positions (returns false if one of them failed)
+  bool setPictureCoordinates(MapPosition *positions, Int count);
+
   // Compute the distance in pixels for the given points
   double computePixelDistance(MapPosition a, MapPosition b);
 
   // Returns the number of calibration points
   Int numberOfCalibrationPoints() const
   {
-    core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
-    Int size=calibrationPoints.size();
-    core->getThread()->unlockMutex(accessMutex);
-    return size;
+    return pointCount;
   }
 
-  // Store the contents of the object in a binary file
-  void store(std::ofstream *ofs);
+  // Adds the contents of the object to the map index
+  void store(MapIndex *mapIndex, MapIndexContainer &record);
 
-  // Reads the contents of the object from a binary file
-  static MapCalibrator *retrieve(char *&cacheData, Int &cacheSize);
+  // Creates the object from the map index
+  static MapCalibrator *retrieve(MapIndex *mapIndex, const MapIndexContainer *record);
 
   // Getters and setters
   std::list<MapPosition*> *lockCalibrationPoints()
@@ -115,13 +154,9 @@ public:
   }
 
   void setArgs(std::string args) {
-    if (doNotDelete) {
-      FATAL("can not set new args because memory is statically allocated",NULL);
-    } else {
-      if (this->args) free(this->args);
-      if (!(this->args=strdup(args.c_str()))) {
-        FATAL("can not create string",NULL);
-      }
+    if (this->args) free(this->args);
+    if (!(this->args=strdup(args.c_str()))) {
+      FATAL("can not create string",NULL);
     }
   }
 };
@@ -26,7 +26,7 @@
 
 namespace GEODISCOVERER {
 
-MapCalibratorLinear::MapCalibratorLinear(bool doNotDelete) : MapCalibrator(doNotDelete) {
+MapCalibratorLinear::MapCalibratorLinear() : MapCalibrator() {
   type=MapCalibratorTypeLinear;
 }
 
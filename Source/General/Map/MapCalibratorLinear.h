@@ -40,7 +40,7 @@ protected:
 public:
 
   // Constructors and destructor
-  MapCalibratorLinear(bool doNotDelete=false);
+  MapCalibratorLinear();
   virtual ~MapCalibratorLinear();
 
 };
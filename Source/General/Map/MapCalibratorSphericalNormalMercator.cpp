@@ -26,7 +26,7 @@
 
 namespace GEODISCOVERER {
 
-MapCalibratorSphericalNormalMercator::MapCalibratorSphericalNormalMercator(bool doNotDelete) : MapCalibrator(doNotDelete) {
+MapCalibratorSphericalNormalMercator::MapCalibratorSphericalNormalMercator() : MapCalibrator() {
   type=MapCalibratorTypeSphericalNormalMercator;
 }
 
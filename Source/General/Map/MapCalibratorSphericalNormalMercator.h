@@ -40,7 +40,7 @@ protected:
 public:
 
   // Constructors and destructor
-  MapCalibratorSphericalNormalMercator(bool doNotDelete=false);
+  MapCalibratorSphericalNormalMercator();
   virtual ~MapCalibratorSphericalNormalMercator();
 
 };
@@ -25,54 +25,50 @@
 #include <MapPosition.h>
 #include <MapArea.h>
 #include <MapSource.h>
+#include <MapCache.h>
 #include <Storage.h>
 
 namespace GEODISCOVERER {
 
 // Constructor
-MapContainer::MapContainer(bool doNotDelete) {
+MapContainer::MapContainer() {
 
   // Set variables
-  this->doNotDelete=doNotDelete;
-  if (doNotDelete) {
-    new(&this->mapTiles) std::vector<MapTile*>();
-    new(&this->mapTilesIndexByMapTop) std::vector<Int>();
-    new(&this->mapTilesIndexByMapBottom) std::vector<Int>();
-    new(&this->mapTilesIndexByMapLeft) std::vector<Int>();
-    new(&this->mapTilesIndexByMapRight) std::vector<Int>();
-  } else {
-    this->mapCalibrator=NULL;
-    this->latNorth=-std::numeric_limits<double>::max();
-    this->latSouth=+std::numeric_limits<double>::max();
-    this->lngEast=-std::numeric_limits<double>::max();
-    this->lngWest=+std::numeric_limits<double>::max();
-    this->searchTree=NULL;
-    this->leftChild=NULL;
-    this->rightChild=NULL;
-    this->downloadComplete=true;
-    this->downloadErrorOccured=false;
-    this->x=0;
-    this->y=0;
-    this->overlayGraphicInvalid=false;
-    this->downloadRetries=0;
-    this->mapFileFolder=NULL;
-    this->archiveFileFolder=NULL;
-    this->imageFileName=NULL;
-    this->imageFilePath=NULL;
-    this->calibrationFileName=NULL;
-    this->calibrationFilePath=NULL;
-    this->archiveFileName=NULL;
-    this->archiveFilePath=NULL;
-    this->zoomLevelServer=0;
-    this->zoomLevelMap=0;
-    this->lngScale=0;
-    this->latScale=0;
-    this->imageType=ImageTypeUnknown;
-    this->width=0;
-    this->height=0;
-    this->overlayGraphicHash="";
-    this->serveToRemoteMap=false;
-  }
+  this->mapIndex=NULL;
+  this->mapIndexPosition=0;
+  this->isLoaded=true;
+  this->mapCalibrator=NULL;
+  this->latNorth=-std::numeric_limits<double>::max();
+  this->latSouth=+std::numeric_limits<double>::max();
+  this->lngEast=-std::numeric_limits<double>::max();
+  this->lngWest=+std::numeric_limits<double>::max();
+  this->searchTree=NULL;
+  this->leftChild=NULL;
+  this->rightChild=NULL;
+  this->downloadComplete=true;
+  this->downloadErrorOccured=false;
+  this->downloadStale=false;
+  this->x=0;
+  this->y=0;
+  this->overlayGraphicInvalid=false;
+  this->downloadRetries=0;
+  this->mapFileFolder=NULL;
+  this->archiveFileFolder=NULL;
+  this->imageFileName=NULL;
+  this->imageFilePath=NULL;
+  this->calibrationFileName=NULL;
+  this->calibrationFilePath=NULL;
+  this->archiveFileName=NULL;
+  this->archiveFilePath=NULL;
+  this->zoomLevelServer=0;
+  this->zoomLevelMap=0;
+  this->lngScale=0;
+  this->latScale=0;
+  this->imageType=ImageTypeUnknown;
+  this->width=0;
+  this->height=0;
+  this->overlayGraphicHash="";
+  this->serveToRemoteMap=false;
 }
 
 MapContainer::MapContainer(const MapContainer &pos) {
@@ -85,7 +81,7 @@ MapContainer::~MapContainer() {
   for(std::vector<MapTile *>::const_iterator i=mapTiles.begin(); i != mapTiles.end(); i++) {
     MapTile::destruct(*i);
   }
-  if (!doNotDelete) {
+  if (!mapIndex) {
     if (mapFileFolder) free(mapFileFolder);
     if (archiveFileFolder) free(archiveFileFolder);
     if (imageFileName) free(imageFileName);
@@ -138,6 +134,7 @@ void MapContainer::addTile(MapTile *tile)
 
 // Returns the map tile in which the position lies
 MapTile *MapContainer::findMapTileByPictureCoordinate(MapPosition pos) {
+  load();
   return findMapTileByPictureCoordinate(pos,searchTree,PictureBorderTop);
 }
 
@@ -210,6 +207,7 @@ MapTile *MapContainer::findMapTileByPictureCoordinate(MapPosition pos, MapTile *
 MapTile *MapContainer::findMapTileByPictureArea(MapArea area, MapTile *preferredNeigbor) {
   double bestDistance=+std::numeric_limits<double>::max();
   bool betterTileFound=false;
+  load();
   MapTile *foundTile=findMapTileByPictureArea(area,preferredNeigbor,searchTree,PictureBorderTop,bestDistance,betterTileFound);
   //DEBUG("found tile = %08x",foundTile);
   return foundTile;
@@ -336,6 +334,7 @@ std::list<MapTile*> MapContainer::findMapTilesByPictureArea(MapArea area) {
   double bestDistance=+std::numeric_limits<double>::max();
   bool betterTileFound=false;
   std::list<MapTile*> result;
+  load();
   findMapTileByPictureArea(area,NULL,searchTree,PictureBorderTop,bestDistance,betterTileFound,&result);
   return result;
 }
@@ -393,18 +392,20 @@ bool MapContainer::readCalibrationFile(std::string fileFolder, std::string fileB
   }
 
   // Extract the image
-  std::list<ZipArchive*> *mapArchives = core->getMapSource()->lockMapArchives(__FILE__, __LINE__);
-  UByte *imageData;
+  UByte *imageData=NULL;
   Int imageSize;
-  for (std::list<ZipArchive*>::iterator i=mapArchives->begin();i!=mapArchives->end();i++) {
-    if ((*i)->getEntrySize(imageFilePath)>0) {
-      imageData=(*i)->exportEntry(imageFilePath,imageSize);
-      break;
-    }
-  }
+  ZipArchiveReader *mapArchiveReader, *temporaryMapArchiveReader;
+  bool imageDataCopied=false;
+  core->getMapSource()->lockMapArchives(__FILE__, __LINE__);
+  mapArchiveReader=core->getMapSource()->findMapArchiveReader(getArchiveFilePath(),imageFilePath,temporaryMapArchiveReader);
   core->getMapSource()->unlockMapArchives();
-  if (imageData==NULL)
+  if (mapArchiveReader)
+    imageData=mapArchiveReader->readEntry(imageFilePath,imageSize,imageDataCopied);
+  if (imageData==NULL) {
+    if (temporaryMapArchiveReader)
+      delete temporaryMapArchiveReader;
     return false;
+  }
 
   // Check the type and dimension of the image
   if (core->getImage()->queryPNG(imageData,imageSize,imageWidth,imageHeight)) {
@@ -413,10 +414,16 @@ bool MapContainer::readCalibrationFile(std::string fileFolder, std::string fileB
     imageType=ImageTypeJPEG;
   } else {
     ERROR("file format of image <%s> not supported",imageFilePath);
-    free(imageData);
+    if (imageDataCopied)
+      free(imageData);
+    if (temporaryMapArchiveReader)
+      delete temporaryMapArchiveReader;
     return false;
   }
-  free(imageData);
+  if (imageDataCopied)
+    free(imageData);
+  if (temporaryMapArchiveReader)
+    delete temporaryMapArchiveReader;
 
   // Find out how many number of tiles are required to hold this image
   Int tileCountX=imageWidth/tileWidth;
@@ -624,191 +631,198 @@ double MapContainer::getBorder(GeographicBorder border)
   return 0;
 }
 
-// Stores the contents of the search tree in a binary file
-void MapContainer::storeSearchTree(std::ofstream *ofs, MapTile *node) {
+// Adds the tiles of the search tree to the map index and returns the index of the node
+Int MapContainer::storeSearchTree(MapIndex *mapIndex, MapTile *node, Int firstTile) {
 
   // Write the contents of the node
-  node->store(ofs);
-
-  // Store the left node
-  if (node->getLeftChild()==NULL) {
-    Storage::storeBool(ofs,false);
-  } else {
-    Storage::storeBool(ofs,true);
-    storeSearchTree(ofs,node->getLeftChild());
-  }
-
-  // Store the right node
-  if (node->getRightChild()==NULL) {
-    Storage::storeBool(ofs,false);
-  } else {
-    Storage::storeBool(ofs,true);
-    storeSearchTree(ofs,node->getRightChild());
-  }
-
+  MapIndexTile record;
+  memset(&record,0,sizeof(record));
+  node->store(record);
+  record.leftChild=-1;
+  record.rightChild=-1;
+  Int index=mapIndex->storeTile(record);
+
+  // Store the child nodes behind it
+  if (node->getLeftChild()!=NULL)
+    record.leftChild=storeSearchTree(mapIndex,node->getLeftChild(),firstTile);
+  if (node->getRightChild()!=NULL)
+    record.rightChild=storeSearchTree(mapIndex,node->getRightChild(),firstTile);
+  mapIndex->updateTile(index,record);
+  return index-firstTile;
 }
 
-// Store the contents of the object in a binary file
-void MapContainer::store(std::ofstream *ofs) {
-
-  // Write the size of the object for detecting changes later
-  Int size=sizeof(*this);
-  Storage::storeInt(ofs,size);
+// Adds the contents of the object to the map index
+void MapContainer::store(MapIndex *mapIndex) {
 
   // Store all relevant fields
-  MapContainer *leftChild=this->leftChild;
-  MapContainer *rightChild=this->rightChild;
-  MapTile *searchTree=this->searchTree;
-  this->leftChild=NULL;
-  this->rightChild=NULL;
-  this->searchTree=NULL;
-  Storage::storeMem(ofs,(char*)this,sizeof(MapContainer),true);
-  this->leftChild=leftChild;
-  this->rightChild=rightChild;
-  this->searchTree=searchTree;
-  Storage::storeString(ofs,archiveFileFolder);
-  Storage::storeString(ofs,mapFileFolder);
-  Storage::storeString(ofs,imageFileName);
-  Storage::storeString(ofs,imageFilePath);
-  Storage::storeString(ofs,calibrationFileName);
-  Storage::storeString(ofs,calibrationFilePath);
-  Storage::storeString(ofs,archiveFileName);
-  Storage::storeString(ofs,archiveFilePath);
-  mapCalibrator->store(ofs);
-
-  // Store the search tree
-  Storage::storeInt(ofs,mapTiles.size());
+  MapIndexContainer record;
+  memset(&record,0,sizeof(record));
+  record.latNorth=latNorth;
+  record.latSouth=latSouth;
+  record.lngEast=lngEast;
+  record.lngWest=lngWest;
+  record.latScale=latScale;
+  record.lngScale=lngScale;
+  record.archiveFileFolder=mapIndex->storeString(archiveFileFolder);
+  record.mapFileFolder=mapIndex->storeString(mapFileFolder);
+  record.imageFileName=mapIndex->storeString(imageFileName);
+  record.imageFilePath=mapIndex->storeString(imageFilePath);
+  record.calibrationFileName=mapIndex->storeString(calibrationFileName);
+  record.calibrationFilePath=mapIndex->storeString(calibrationFilePath);
+  record.archiveFileName=mapIndex->storeString(archiveFileName);
+  record.archiveFilePath=mapIndex->storeString(archiveFilePath);
+  record.imageType=imageType;
+  record.x=x;
+  record.y=y;
+  record.zoomLevelMap=zoomLevelMap;
+  record.zoomLevelServer=zoomLevelServer;
+  record.width=width;
+  record.height=height;
+  mapCalibrator->store(mapIndex,record);
+
+  // Store the tiles in the order of the search tree
+  record.searchTreeRoot=-1;
   if (searchTree) {
-    Storage::storeBool(ofs,true);
-    storeSearchTree(ofs,searchTree);
-  } else {
-    Storage::storeBool(ofs,false);
+    record.tileFirst=mapIndex->getStoredTileCount();
+    record.searchTreeRoot=storeSearchTree(mapIndex,searchTree,record.tileFirst);
+    record.tileCount=mapIndex->getStoredTileCount()-record.tileFirst;
   }
-
+  mapIndex->storeContainer(record);
 }
 
-// Reads the contents of the search tree from a binary file
-MapTile *MapContainer::retrieveSearchTree(MapContainer *mapContainer, Int &nodeNumber, char *&cacheData, Int &cacheSize, bool &abortRetrieve) {
+// Creates the object from the map index without reading its tiles and calibrator
+MapContainer *MapContainer::retrieve(MapIndex *mapIndex, Int position) {
 
-  // Read the current node
-  MapTile *node=MapTile::retrieve(cacheData,cacheSize,mapContainer);
-  if (node==NULL) {
-    abortRetrieve=true;
+  // Create a new map container object
+  MapContainer *mapContainer=new MapContainer();
+  if (!mapContainer) {
+    FATAL("can not create map container object",NULL);
     return NULL;
   }
-  mapContainer->mapTiles[nodeNumber]=node;
-  nodeNumber++;
-
-  // Update the progress
-  if (!core->getMapSource()->increaseProgress()) {
-    DEBUG("aborting search tree retrieve because core quit is requested",NULL);
-    return node;
-  }
-
-  // Read the left node
-  bool hasLeftNode;
-  Storage::retrieveBool(cacheData,cacheSize,hasLeftNode);
-  if (hasLeftNode) {
-    node->setLeftChild(retrieveSearchTree(mapContainer,nodeNumber,cacheData,cacheSize,abortRetrieve));
-    if (abortRetrieve)
-      return NULL;
-  }
+  const MapIndexContainer *record=mapIndex->getContainer(position);
+  mapContainer->mapIndex=mapIndex;
+  mapContainer->mapIndexPosition=position;
+  mapContainer->isLoaded=false;
 
-  // Read the right node
-  bool hasRightNode;
-  Storage::retrieveBool(cacheData,cacheSize,hasRightNode);
-  if (hasRightNode) {
-    node->setRightChild(retrieveSearchTree(mapContainer,nodeNumber,cacheData,cacheSize,abortRetrieve));
-    if (abortRetrieve)
-      return NULL;
-  }
+  // Read the fields
+  mapContainer->latNorth=record->latNorth;
+  mapContainer->latSouth=record->latSouth;
+  mapContainer->lngEast=record->lngEast;
+  mapContainer->lngWest=record->lngWest;
+  mapContainer->latScale=record->latScale;
+  mapContainer->lngScale=record->lngScale;
+  mapContainer->archiveFileFolder=mapIndex->getString(record->archiveFileFolder);
+  mapContainer->mapFileFolder=mapIndex->getString(record->mapFileFolder);
+  mapContainer->imageFileName=mapIndex->getString(record->imageFileName);
+  mapContainer->imageFilePath=mapIndex->getString(record->imageFilePath);
+  mapContainer->calibrationFileName=mapIndex->getString(record->calibrationFileName);
+  mapContainer->calibrationFilePath=mapIndex->getString(record->calibrationFilePath);
+  mapContainer->archiveFileName=mapIndex->getString(record->archiveFileName);
+  mapContainer->archiveFilePath=mapIndex->getString(record->archiveFilePath);
+  mapContainer->imageType=(ImageType)record->imageType;
+  mapContainer->x=record->x;
+  mapContainer->y=record->y;
+  mapContainer->zoomLevelMap=record->zoomLevelMap;
+  mapContainer->zoomLevelServer=record->zoomLevelServer;
+  mapContainer->width=record->width;
+  mapContainer->height=record->height;
 
-  // Return the node
-  return node;
+  // Return result
+  return mapContainer;
 }
 
-// Reads the contents of the object from a binary file
-MapContainer *MapContainer::retrieve(char *&cacheData, Int &cacheSize) {
-
-  //PROFILE_START;
+// Creates the tiles and the calibrator from the map index if not yet done
+void MapContainer::load() {
 
-  // Check if the class has changed
-  Int size=sizeof(MapContainer);
-#ifdef TARGET_LINUX
-  if (size!=360) {
-    FATAL("unknown size of object (%d), please adapt class storage",size);
-    return NULL;
+  // Only the first access reads the index
+  if (isLoaded)
+    return;
+  core->getMapSource()->lockAccess(__FILE__,__LINE__);
+  if (isLoaded) {
+    core->getMapSource()->unlockAccess();
+    return;
   }
-#endif
 
-  // Read the size of the object and check with current size
-  size=0;
-  Storage::retrieveInt(cacheData,cacheSize,size);
-  if (size!=sizeof(MapContainer)) {
-    DEBUG("stored size of object does not match implemented object size, aborting retrieve",NULL);
-    return NULL;
+  // Check that the records of this container are intact
+  // A damaged container is left without tiles and calibrator and the index is recreated at the next start
+  if (!mapIndex->verifyContainer(mapIndexPosition)) {
+    WARNING("map index is corrupted and will be recreated at the next start",NULL);
+    invalidate();
+    core->getMapSource()->unlockAccess();
+    return;
   }
-  //PROFILE_ADD("sanity check");
+  const MapIndexContainer *record=mapIndex->getContainer(mapIndexPosition);
 
-  // Create a new map container object
-  //PROFILE_ADD("map container init");
-  Storage::skipPadding(cacheData,cacheSize);
-  cacheSize-=sizeof(MapContainer);
-  if (cacheSize<0) {
-    DEBUG("can not create map container object",NULL);
-    return NULL;
+  // Create the calibrator
+  mapCalibrator=MapCalibrator::retrieve(mapIndex,record);
+  if (mapCalibrator==NULL) {
+    WARNING("map index contains an unsupported calibrator and will be recreated at the next start",NULL);
+    invalidate();
+    core->getMapSource()->unlockAccess();
+    return;
   }
-  MapContainer *mapContainer=(MapContainer*)cacheData;
-  mapContainer=new(cacheData) MapContainer(true);
-  cacheData+=sizeof(MapContainer);
-  //PROFILE_ADD("object creation");
 
-  // Read the fields
-  Storage::retrieveString(cacheData,cacheSize,&mapContainer->archiveFileFolder);
-  Storage::retrieveString(cacheData,cacheSize,&mapContainer->mapFileFolder);
-  Storage::retrieveString(cacheData,cacheSize,&mapContainer->imageFileName);
-  Storage::retrieveString(cacheData,cacheSize,&mapContainer->imageFilePath);
-  Storage::retrieveString(cacheData,cacheSize,&mapContainer->calibrationFileName);
-  Storage::retrieveString(cacheData,cacheSize,&mapContainer->calibrationFilePath);
-  Storage::retrieveString(cacheData,cacheSize,&mapContainer->archiveFileName);
-  Storage::retrieveString(cacheData,cacheSize,&mapContainer->archiveFilePath);
-
-  //PROFILE_ADD("field read"");
-  mapContainer->mapCalibrator=MapCalibrator::retrieve(cacheData,cacheSize);
-  if (mapContainer->mapCalibrator==NULL) {
-    MapContainer::destruct(mapContainer);
-    return NULL;
+  // Create the tiles and link them to the search tree
+  mapTiles.resize(record->tileCount);
+  for (UInt i=0;i<record->tileCount;i++) {
+    mapTiles[i]=MapTile::retrieve(mapIndex->getTile(record->tileFirst+i),this);
   }
-  //PROFILE_ADD("map calibrator retrieve");
-
-  // Read the search tree
-  Storage::retrieveInt(cacheData,cacheSize,size);
-  mapContainer->mapTiles.resize(size);
-  bool hasSearchTree;
-  Storage::retrieveBool(cacheData,cacheSize,hasSearchTree);
-  if (hasSearchTree) {
-    Int nodeNumber=0;
-    bool abortRetrieve=false;
-    mapContainer->searchTree=retrieveSearchTree(mapContainer,nodeNumber,cacheData,cacheSize,abortRetrieve);
-    if ((mapContainer->searchTree==NULL)||(abortRetrieve)||(core->getQuitCore())) {
-      mapContainer->mapTiles.resize(nodeNumber);
-      MapContainer::destruct(mapContainer);
-      return NULL;
+  for (UInt i=0;i<record->tileCount;i++) {
+    const MapIndexTile *t=mapIndex->getTile(record->tileFirst+i);
+    if (t->leftChild>=0)
+      mapTiles[i]->setLeftChild(mapTiles[t->leftChild]);
+    if (t->rightChild>=0)
+      mapTiles[i]->setRightChild(mapTiles[t->rightChild]);
+  }
+  if (record->searchTreeRoot>=0)
+    searchTree=mapTiles[record->searchTreeRoot];
+  isLoaded=true;
+
+  // Make the new tiles known to the cache
+  if (core->getMapCache()) {
+    for (std::vector<MapTile*>::iterator i=mapTiles.begin();i!=mapTiles.end();i++) {
+      core->getMapCache()->addTile(*i);
     }
   }
-  //PROFILE_ADD("map tile retrieve");
+  core->getMapSource()->unlockAccess();
+}
 
-  // Return result
-  return mapContainer;
+// Marks the container as unusable because its records in the map index are damaged
+void MapContainer::invalidate() {
+  mapIndex->invalidate();
+  isLoaded=true;
+  core->getMapSource()->markMapContainerObsolete(this);
 }
 
-// Destructs the objects correctly (i.e., if memory has not been allocated by new)
-void MapContainer::destruct(MapContainer *object) {
-  if (object->doNotDelete) {
-    object->~MapContainer();
-  } else {
-    delete object;
+// Reads the complete container from the map index such that the index can be released
+bool MapContainer::detach() {
+
+  // Nothing to do if the container is not backed by the index
+  if (!mapIndex)
+    return true;
+  if ((!isLoaded)&&(!mapIndex->verifyContainer(mapIndexPosition)))
+    return false;
+  load();
+  if (!mapCalibrator)
+    return false;
+
+  // Copy the strings that point into the index
+  char **strings[] = { &mapFileFolder, &archiveFileFolder, &imageFileName, &imageFilePath, &calibrationFileName, &calibrationFilePath, &archiveFileName, &archiveFilePath };
+  for (Int i=0;i<sizeof(strings)/sizeof(strings[0]);i++) {
+    if (*strings[i]) {
+      if (!(*strings[i]=strdup(*strings[i]))) {
+        FATAL("can not create string",NULL);
+        return false;
+      }
+    }
   }
+  mapIndex=NULL;
+  return true;
+}
+
+// Destructs the object
+void MapContainer::destruct(MapContainer *object) {
+  delete object;
 }
 
 // Checks if the container contains tiles that are currently used for screen drawing
@@ -835,6 +849,9 @@ TimestampInSeconds MapContainer::getLastAccess() {
 // Stores the overlayed graphics into a file (excluding the tile itself)
 void MapContainer::storeOverlayGraphics(std::string filefolder, std::string filename) {
 
+  // Ensure that the tiles exist
+  load();
+
   // Create the overlay file
   std::string filepath = filefolder + "/" + filename;
   remove(filepath.c_str());
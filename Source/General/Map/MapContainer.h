@@ -23,7 +23,9 @@
 #include <MapCalibrator.h>
 #include <MapTile.h>
 #include <ZipArchive.h>
+#include <ZipArchiveReader.h>
 #include <MapPosition.h>
+#include <MapIndex.h>
 
 #ifndef MAPCONTAINER_H_
 #define MAPCONTAINER_H_
@@ -37,7 +39,9 @@ class MapContainer {
 
 protected:
 
-  bool                doNotDelete;          // Indicates if the object has been alloacted by an own memory handler
+  MapIndex            *mapIndex;            // Index that holds the strings, tiles and calibrator (NULL if not created from an index)
+  Int                 mapIndexPosition;     // Position of the container in the index
+  std::atomic<bool>   isLoaded;             // Indicates that the tiles and the calibrator have been created
   char                *mapFileFolder;       // Folder in which the picture and calibration data of the map is stored
   char                *archiveFileFolder;   // Folder in which the map archive is stored
   char                *imageFileName;       // Filename of the picture of the map
@@ -66,6 +70,7 @@ protected:
   MapContainer *rightChild;                 // Right child in the kd tree
   bool downloadComplete;                    // Indicates that the image has been downloaded to disk
   bool downloadErrorOccured;                // Indicates that the image could not been downloaded to disk correctly
+  bool downloadStale;                       // Indicates that the stored image must be checked with the server even if it has not expired
   bool overlayGraphicInvalid;               // Indicates that this container is missing it's overlay graphics
   bool serveToRemoteMap;                    // Indicates that this container shall be served to a remote side after download is complete
   std::string overlayGraphicHash;           // Hash that represents the overlay content
@@ -105,16 +110,13 @@ protected:
   // Returns the map tile that lies in a given area and that is closest to the given neigbor
   MapTile *findMapTileByPictureArea(MapArea area, MapTile *preferredNeigbor, MapTile *currentTile, PictureBorder currentDimension, double &bestDistance, bool &betterTileFound, std::list<MapTile*> *foundMapTiles=NULL);
 
-  // Stores the contents of the search tree in a binary file
-  void storeSearchTree(std::ofstream *ofs, MapTile *node);
-
-  // Reads the contents of the search tree from a binary file
-  static MapTile *retrieveSearchTree(MapContainer *mapContainer, Int &nodeNumber, char *&cacheData, Int &cacheSize, bool &abortRetrieve);
+  // Adds the tiles of the search tree to the map index and returns the index of the node
+  Int storeSearchTree(MapIndex *mapIndex, MapTile *node, Int firstTile);
 
 public:
 
   // Constructor
-  MapContainer(bool doNotDelete=false);
+  MapContainer();
   MapContainer(const MapContainer &pos);
 
   // Destructor
@@ -123,7 +125,7 @@ public:
   // Operators
   MapContainer &operator=(const MapContainer &rhs);
 
-  // Destructs the objects correctly (i.e., if memory has not been allocated by new)
+  // Destructs the object
   static void destruct(MapContainer *object);
 
   // Returns the file extension of supported calibration files
@@ -147,11 +149,20 @@ public:
   // Writes a calibration file
   void writeCalibrationFile(ZipArchive *mapArchive);
 
-  // Store the contents of the object in a binary file
-  void store(std::ofstream *ofs);
+  // Adds the contents of the object to the map index
+  void store(MapIndex *mapIndex);
+
+  // Creates the object from the map index without reading its tiles and calibrator
+  static MapContainer *retrieve(MapIndex *mapIndex, Int position);
+
+  // Creates the tiles and the calibrator from the map index if not yet done
+  void load();
 
-  // Reads the contents of the object from a binary file
-  static MapContainer *retrieve(char *&cacheData, Int &cacheSize);
+  // Marks the container as unusable because its records in the map index are damaged
+  void invalidate();
+
+  // Reads the complete container from the map index such that the index can be released
+  bool detach();
 
   // Checks if the container contains tiles that are currently used for screen drawing
   bool isDrawn();
@@ -202,8 +213,9 @@ public:
       return std::string(imageFilePath);
   }
 
-  MapCalibrator *getMapCalibrator() const
+  MapCalibrator *getMapCalibrator()
   {
+      load();
       return mapCalibrator;
   }
 
@@ -241,6 +253,7 @@ public:
     return overlayFilename;
   }
 
+  // Only contains tiles if the container is loaded
   std::vector<MapTile*> *getMapTiles() {
     return (std::vector<MapTile*>*)(((((((((((((&mapTiles)))))))))))));
   }
@@ -318,6 +331,10 @@ public:
     return mapTiles.size();
   }
 
+  bool getIsLoaded() const {
+    return isLoaded;
+  }
+
   TimestampInSeconds getLastAccess();
 
   Int getDownloadRetries() const {
@@ -368,8 +385,8 @@ public:
   }
 
   void setCalibrationFileName(std::string calibrationFileName) {
-    if (doNotDelete) {
-      FATAL("can not set new calibration file name because memory is statically allocated",NULL);
+    if (mapIndex) {
+      FATAL("can not set new calibration file name because it is stored in the map index",NULL);
     } else {
       if (this->calibrationFileName) free(this->calibrationFileName);
       if (!(this->calibrationFileName=strdup(calibrationFileName.c_str()))) {
@@ -392,8 +409,8 @@ public:
   }
 
   void setImageFileName(std::string imageFileName) {
-    if (doNotDelete) {
-      FATAL("can not set new image file name because memory is statically allocated",NULL);
+    if (mapIndex) {
+      FATAL("can not set new image file name because it is stored in the map index",NULL);
     } else {
       if (this->imageFileName) free(this->imageFileName);
       if (!(this->imageFileName=strdup(imageFileName.c_str()))) {
@@ -412,8 +429,8 @@ public:
   }
 
   void setArchiveFileName(std::string archiveFileName) {
-    if (doNotDelete) {
-      FATAL("can not set new archive file name because memory is statically allocated",NULL);
+    if (mapIndex) {
+      FATAL("can not set new archive file name because it is stored in the map index",NULL);
     } else {
       if (this->archiveFileName) free(this->archiveFileName);
       if (!(this->archiveFileName=strdup(archiveFileName.c_str()))) {
@@ -432,8 +449,8 @@ public:
   }
 
   void setMapFileFolder(std::string mapFileFolder) {
-    if (doNotDelete) {
-      FATAL("can not set new map file folder because memory is statically allocated",NULL);
+    if (mapIndex) {
+      FATAL("can not set new map file folder because it is stored in the map index",NULL);
     } else {
       if (this->mapFileFolder) free(this->mapFileFolder);
       if (!(this->mapFileFolder=strdup(mapFileFolder.c_str()))) {
@@ -443,8 +460,8 @@ public:
   }
 
   void setArchiveFileFolder(std::string archiveFileFolder) {
-    if (doNotDelete) {
-      FATAL("can not set new archive file folder because memory is statically allocated",NULL);
+    if (mapIndex) {
+      FATAL("can not set new archive file folder because it is stored in the map index",NULL);
     } else {
       if (this->archiveFileFolder) free(this->archiveFileFolder);
       if (!(this->archiveFileFolder=strdup(archiveFileFolder.c_str()))) {
@@ -477,6 +494,14 @@ public:
     this->downloadErrorOccured = downloadErrorOccured;
   }
 
+  bool getDownloadStale() const {
+    return downloadStale;
+  }
+
+  void setDownloadStale(bool downloadStale) {
+    this->downloadStale = downloadStale;
+  }
+
   bool getServeToRemoteMap() const {
     return serveToRemoteMap;
   }
@@ -26,6 +26,7 @@
 #include <Commander.h>
 #include <UnitConverter.h>
 #include <MapEngine.h>
+#include <DownloadEngine.h>
 
 namespace GEODISCOVERER {
 
@@ -59,17 +60,44 @@ MapDownloader::MapDownloader(MapSourceMercatorTiles *mapSource) {
   maxDownloadRetries=core->getConfigStore()->getIntValue("Map","maxDownloadRetries",__FILE__, __LINE__);
   downloadQueueRecommendedSize=core->getConfigStore()->getIntValue("Map","downloadQueueRecommendedSize",__FILE__, __LINE__);
   imageQueueMaxSize=core->getConfigStore()->getIntValue("Map","imageQueueMaxSize",__FILE__, __LINE__);
+  storeDownloadedTilesUnchanged=core->getConfigStore()->getIntValue("Map","storeDownloadedTilesUnchanged",__FILE__, __LINE__);
+  downloadedTileCompressionLevel=core->getConfigStore()->getIntValue("Map","downloadedTileCompressionLevel",__FILE__, __LINE__);
+  downloadedTileRowFilter=core->getConfigStore()->getIntValue("Map","downloadedTileRowFilter",__FILE__, __LINE__);
+  archiveCommitMaxEntries=core->getConfigStore()->getIntValue("Map","archiveCommitMaxEntries",__FILE__, __LINE__);
+  archiveCommitMaxBytes=core->getConfigStore()->getIntValue("Map","archiveCommitMaxBytes",__FILE__, __LINE__);
+  archiveCommitMaxDelay=core->getConfigStore()->getIntValue("Map","archiveCommitMaxDelay",__FILE__, __LINE__);
+  archiveCommits=0;
+  archiveCommittedEntries=0;
+  archiveCommittedBytes=0;
   downloadQueueRecommendedSizeExceeded=false;
+  downloadQueueViewZoomLevel=0;
+  downloadQueueViewTileX=0;
+  downloadQueueViewTileY=0;
   accessMutex=core->getThread()->createMutex("map downloader access mutex");
   quitThreads=false;
   this->mapSource=mapSource;
+  if (!(downloadEngine=new DownloadEngine())) {
+    FATAL("can not create download engine",NULL);
+    return;
+  }
   downloadStartSignals.resize(numberOfDownloadThreads);
   mapImageDownloadThreadInfos.resize(numberOfDownloadThreads);
   downloadOngoing.resize(numberOfDownloadThreads);
+  composedImages.resize(numberOfDownloadThreads);
+  imageQueueSpaceSignals.resize(numberOfDownloadThreads);
   downloadStartTime=0;
   downloadedImages=0;
   for (Int i=0;i<numberOfDownloadThreads;i++) {
+    composedImages[i]=(Memory*)malloc(sizeof(Memory));
+    if (composedImages[i]==NULL) {
+      FATAL("can not create memory struct",NULL);
+      break;
+    }
+    composedImages[i]->data=NULL;
+    composedImages[i]->size=0;
+    composedImages[i]->pos=0;
     downloadStartSignals[i]=core->getThread()->createSignal();
+    imageQueueSpaceSignals[i]=core->getThread()->createSignal();
     UByte *args = (UByte *)malloc(sizeof(this)+sizeof(Int));
     if (!args) {
       FATAL("can not create args for map download thread",NULL);
@@ -92,6 +120,12 @@ MapDownloader::~MapDownloader() {
   // deinit(); // Is now called by map source directly
   for (Int i=0;i<numberOfDownloadThreads;i++) {
     core->getThread()->destroySignal(downloadStartSignals[i]);
+    core->getThread()->destroySignal(imageQueueSpaceSignals[i]);
+    if (composedImages[i]) {
+      if (composedImages[i]->data)
+        free(composedImages[i]->data);
+      free(composedImages[i]);
+    }
   }
   core->getThread()->destroySignal(updateStatsStartSignal);
   core->getThread()->destroyMutex(accessMutex);
@@ -117,6 +151,10 @@ void MapDownloader::deinit() {
   // Ensure that we have all mutexes
   core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
 
+  // Let all ongoing downloads fail such that the engine does not access the download threads anymore
+  DEBUG("aborting ongoing downloads",NULL);
+  downloadEngine->abortAllRequests();
+
   // Wait until the download thread has finished
   DEBUG("cancelling map image download thread",NULL);
   for (Int i=0;i<numberOfDownloadThreads;i++) {
@@ -136,6 +174,11 @@ void MapDownloader::deinit() {
   // Unlock all mutexes
   core->getThread()->unlockMutex(accessMutex);
 
+  // Stop the download engine
+  DEBUG("stopping download engine (%llu transfers over %llu connections)",downloadEngine->getCompletedTransfers(),downloadEngine->getOpenedConnections());
+  delete downloadEngine;
+  downloadEngine=NULL;
+
   // Delete all tile servers
   DEBUG("deleting tile servers",NULL);
   for(std::list<MapTileServer*>::iterator i=tileServers.begin();i!=tileServers.end();i++) {
@@ -211,20 +254,78 @@ void MapDownloader::queueMapContainerDownload(MapContainer *mapContainer)
   }
 
   // Request the download thread to fetch this image
-  downloadQueue.push_back(mapContainer);
-  if (downloadQueue.size()>downloadQueueRecommendedSize)
-    downloadQueueRecommendedSizeExceeded=true;
+  insertDownloadQueue(mapContainer);
   core->getThread()->unlockMutex(accessMutex);
   for (Int i=0;i<numberOfDownloadThreads;i++)
     core->getThread()->issueSignal(downloadStartSignals[i]);
 }
 
+// Returns the key that identifies the tile of the map container in the download queue
+std::string MapDownloader::getDownloadQueueKey(MapContainer *mapContainer) {
+  std::stringstream key;
+  key << mapContainer->getZoomLevelMap() << "/" << mapContainer->getX() << "/" << mapContainer->getY();
+  return key.str();
+}
+
+// Computes the priority of the map container with respect to the current view
+MapDownloadPriority MapDownloader::computeDownloadPriority(MapContainer *mapContainer) {
+
+  // Tiles of the displayed zoom level come first
+  Int zoomLevelDistance=0;
+  if (downloadQueueViewZoomLevel!=0)
+    zoomLevelDistance=abs(mapContainer->getZoomLevelMap()-downloadQueueViewZoomLevel);
+
+  // Within a zoom level, the distance in tiles to the view center is proportional to the distance on the screen
+  Int x,y;
+  downloadQueueViewPos.computeMercatorTileXY(mapContainer->getZoomLevelServer(),x,y);
+  double dx=mapContainer->getX()-x;
+  double dy=mapContainer->getY()-y;
+  return MapDownloadPriority(zoomLevelDistance,dx*dx+dy*dy);
+}
+
+// Adds the map container to the download queue
+// If its tile is already queued, the map container waits for the download of the queued one
+void MapDownloader::insertDownloadQueue(MapContainer *mapContainer) {
+  std::string key=getDownloadQueueKey(mapContainer);
+  std::map<std::string, MapDownloadQueueEntry>::iterator i=downloadQueueEntries.find(key);
+  if (i!=downloadQueueEntries.end()) {
+    MapDownloadQueueEntry &entry=i->second;
+    if ((entry.pos->second!=mapContainer)&&(std::find(entry.waitingMapContainers.begin(),entry.waitingMapContainers.end(),mapContainer)==entry.waitingMapContainers.end()))
+      entry.waitingMapContainers.push_back(mapContainer);
+    return;
+  }
+  downloadQueueEntries[key].pos=downloadQueue.insert(std::make_pair(computeDownloadPriority(mapContainer),mapContainer));
+  if (downloadQueue.size()>downloadQueueRecommendedSize)
+    downloadQueueRecommendedSizeExceeded=true;
+}
+
+// Recomputes the priorities of the download queue if the zoom level or the tile at the view center has changed
+void MapDownloader::updateDownloadPriorities(MapPosition viewPos, Int viewZoomLevel, Int viewTileX, Int viewTileY) {
+  core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+  if ((viewZoomLevel!=downloadQueueViewZoomLevel)||(viewTileX!=downloadQueueViewTileX)||(viewTileY!=downloadQueueViewTileY)) {
+    downloadQueueViewPos=viewPos;
+    downloadQueueViewZoomLevel=viewZoomLevel;
+    downloadQueueViewTileX=viewTileX;
+    downloadQueueViewTileY=viewTileY;
+
+    // The positions stay valid after the swap, so each entry can be moved to the new queue
+    MapDownloadQueue previousQueue;
+    previousQueue.swap(downloadQueue);
+    for (std::map<std::string, MapDownloadQueueEntry>::iterator i=downloadQueueEntries.begin();i!=downloadQueueEntries.end();i++) {
+      MapContainer *mapContainer=i->second.pos->second;
+      i->second.pos=downloadQueue.insert(std::make_pair(computeDownloadPriority(mapContainer),mapContainer));
+    }
+  }
+  core->getThread()->unlockMutex(accessMutex);
+}
+
 // Clears the download queue
 void MapDownloader::clearDownloadQueue()
 {
   core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
   if (!downloadQueue.empty()) {
     downloadQueue.clear();
+    downloadQueueEntries.clear();
   }
   core->getThread()->unlockMutex(accessMutex);
   core->getThread()->issueSignal(updateStatsStartSignal);
@@ -364,34 +465,17 @@ void MapDownloader::downloadMapImages(Int threadNr) {
     // Loop until the queue is empty
     while (1) {
 
-      // Get the next container from the queue
+      // Get the container that is the nearest to the view from the queue
+      // Other containers of the same tile are completed together with it
       MapContainer *mapContainer=NULL;
+      std::list<MapContainer*> waitingMapContainers;
       core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
       if (!downloadQueue.empty()) {
-
-        // Prefer visible map containers that are the nearest to the map center
-        MapPosition mapPos=*(core->getMapEngine()->lockMapPos(__FILE__,__LINE__));
-        core->getMapEngine()->unlockMapPos();
-        double minDistance=std::numeric_limits<double>::max();
-        std::list<MapContainer*>::iterator erasePos;
-        for (std::list<MapContainer*>::iterator i=downloadQueue.begin();i!=downloadQueue.end();i++) {
-          MapContainer *c=*i;
-          if (c->isDrawn()) {
-            double d=mapPos.computeDistance(c->getMapPosCenter());
-            if (d<minDistance) {
-              minDistance=d;
-              mapContainer=c;
-              erasePos=i;
-            }
-          }
-        }
-        if (!mapContainer) {
-          mapContainer=downloadQueue.front();
-          downloadQueue.pop_front();
-        } else {
-          //DEBUG("selected nearest map container: %s (%f m)",mapContainer->getArchiveFileName().c_str(),minDistance);
-          downloadQueue.erase(erasePos);
-        }
+        mapContainer=downloadQueue.begin()->second;
+        std::map<std::string, MapDownloadQueueEntry>::iterator entry=downloadQueueEntries.find(getDownloadQueueKey(mapContainer));
+        waitingMapContainers.swap(entry->second.waitingMapContainers);
+        downloadQueueEntries.erase(entry);
+        downloadQueue.erase(downloadQueue.begin());
       }
       if (!mapContainer) {
         core->getThread()->unlockMutex(accessMutex);
@@ -402,62 +486,135 @@ void MapDownloader::downloadMapImages(Int threadNr) {
       downloadOngoing[threadNr]=true;
       core->getThread()->unlockMutex(accessMutex);
 
-      // Download all images
-      bool downloadSuccess=true;
-      bool oneTileFound=false;
-      int fileNotFoundCount=0;
+      // Get the URLs of all layers
+      std::vector<MapTileServer*> layerServers;
       std::vector<std::string> urls;
       for (std::list<MapTileServer*>::iterator i=tileServers.begin();i!=tileServers.end();i++) {
         MapTileServer *tileServer=*i;
         if ((mapContainer->getZoomLevelMap()>=tileServer->getMinZoomLevelMap())&&(mapContainer->getZoomLevelMap()<=tileServer->getMaxZoomLevelMap())) {
-          std::string url;
-          DownloadResult result = tileServer->downloadTileImage(mapContainer,threadNr,url);
-          urls.push_back(url);
-          if (result==DownloadResultFileNotFound) 
-            fileNotFoundCount++;
-          if (result==DownloadResultOtherFail) {
-            DEBUG("other fail occured while downloading %s",url.c_str());
-            downloadSuccess=false;
-            break;
-          }
-          if (result==DownloadResultSuccess)
-            oneTileFound=true;
+          layerServers.push_back(tileServer);
+          urls.push_back(tileServer->createTileURL(mapContainer));
         }
       }
+
+      // Use the validators of a previous download if the tile is already on disk
+      // A forced redownload always asks the server, even if the stored tile has not expired yet
+      std::map<std::string, DownloadValidators> previousValidators;
+      bool revalidate=(urls.size()>0)&&(readTileValidators(mapContainer,previousValidators));
+      bool stillFresh=(revalidate)&&(!mapContainer->getDownloadStale());
+      for (std::list<MapContainer*>::iterator i=waitingMapContainers.begin();i!=waitingMapContainers.end();i++) {
+        if ((*i)->getDownloadStale())
+          stillFresh=false;
+      }
+      TimestampInSeconds now=core->getClock()->getSecondsSinceEpoch();
+      for (Int j=0;j<urls.size();j++) {
+        std::map<std::string, DownloadValidators>::iterator k=previousValidators.find(urls[j]);
+        if (k==previousValidators.end()) {
+          revalidate=false;
+          stillFresh=false;
+        } else if (k->second.expires<=now) {
+          stillFresh=false;
+        }
+      }
+
+      // Request all images at once such that the layers are downloaded in parallel
+      std::vector<bool> selectedLayers(urls.size(),true);
+      std::vector<DownloadResult> results(urls.size(),DownloadResultOtherFail);
+      std::vector<DownloadValidators> validators(urls.size());
+      Int notModifiedCount=0;
+      if (stillFresh) {
+        notModifiedCount=urls.size();
+      } else {
+        downloadTileImages(threadNr,layerServers,urls,selectedLayers,revalidate ? &previousValidators : NULL,results,validators);
+        for (Int j=0;j<urls.size();j++) {
+          if (results[j]==DownloadResultNotModified)
+            notModifiedCount++;
+        }
+
+        // Only the composed tile is stored, so unchanged layers must be downloaded again if another layer has changed
+        if ((notModifiedCount>0)&&(notModifiedCount<urls.size())) {
+          for (Int j=0;j<urls.size();j++)
+            selectedLayers[j]=(results[j]==DownloadResultNotModified);
+          downloadTileImages(threadNr,layerServers,urls,selectedLayers,NULL,results,validators);
+          notModifiedCount=0;
+        }
+      }
+
+      // Check the results
+      bool downloadSuccess=true;
+      bool oneTileFound=false;
+      int fileNotFoundCount=0;
+      for (Int j=0;j<urls.size();j++) {
+        if (results[j]==DownloadResultFileNotFound)
+          fileNotFoundCount++;
+        if (results[j]==DownloadResultOtherFail) {
+          DEBUG("other fail occured while downloading %s",urls[j].c_str());
+          downloadSuccess=false;
+        }
+        if (results[j]==DownloadResultSuccess)
+          oneTileFound=true;
+      }
       if (!oneTileFound)
         downloadSuccess=false;
-      
+      if (!downloadSuccess) {
+        for (std::list<MapTileServer*>::iterator i=tileServers.begin();i!=tileServers.end();i++)
+          (*i)->discardTileImage(threadNr);
+      }
+
       // Process the image
       bool maxRetriesReached=(mapContainer->getDownloadRetries()>=maxDownloadRetries);
       if (fileNotFoundCount==tileServers.size()) {
         DEBUG("no tile server has a tile at this position, skipping retry",NULL);
         maxRetriesReached=true;
       }
-      if (downloadSuccess) {
-
-        // Create one tile image out of the downloaded ones
-        ImagePixel *composedImagePixel=NULL;
-        Int composedImageWidth, composedImageHeight;
-        Int j=0;
-        for (std::list<MapTileServer*>::iterator i=tileServers.begin();i!=tileServers.end();i++) {
-          MapTileServer *tileServer=*i;
-          if ((mapContainer->getZoomLevelMap()>=tileServer->getMinZoomLevelMap())&&(mapContainer->getZoomLevelMap()<=tileServer->getMaxZoomLevelMap())) {
-
-            // Load the image and compose it with the existing image
-            if (!tileServer->composeTileImage(urls[j],composedImagePixel,composedImageWidth,composedImageHeight,threadNr)) {
-              if (composedImagePixel)
-                free(composedImagePixel);
-              composedImagePixel=NULL;
+      if ((urls.size()>0)&&(notModifiedCount==urls.size())) {
+
+        // The stored image is still valid, so use it without writing it again
+        markMapContainerComplete(mapContainer);
+        for (std::list<MapContainer*>::iterator i=waitingMapContainers.begin();i!=waitingMapContainers.end();i++)
+          markMapContainerComplete(*i);
+        core->getMapEngine()->setForceCacheUpdate(__FILE__, __LINE__);
+        core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+        downloadedImages++;
+        core->getThread()->unlockMutex(accessMutex);
+
+      } else if (downloadSuccess) {
+
+        // Store the downloaded image as it is if only one tile server contributes to it
+        UByte *imageData=NULL;
+        UInt imageSize;
+        ImageType imageType=ImageTypePNG;
+        if ((storeDownloadedTilesUnchanged)&&(urls.size()==1)) {
+          for (std::list<MapTileServer*>::iterator i=tileServers.begin();i!=tileServers.end();i++) {
+            MapTileServer *tileServer=*i;
+            if ((mapContainer->getZoomLevelMap()>=tileServer->getMinZoomLevelMap())&&(mapContainer->getZoomLevelMap()<=tileServer->getMaxZoomLevelMap())) {
+              imageData=tileServer->takeStorableTileImage(threadNr,imageSize,imageType);
               break;
             }
-            j++;
           }
         }
-        UByte *imageData=NULL;
-        UInt imageSize;
-        if (composedImagePixel) {
-          imageData = core->getImage()->writePNG(composedImagePixel,composedImageWidth,composedImageHeight,core->getImage()->getRGBPixelSize(),imageSize);
-          free(composedImagePixel);
+
+        // Otherwise create one tile image out of the downloaded ones
+        if (!imageData) {
+          bool composedImageValid=false;
+          Int composedImageWidth, composedImageHeight;
+          Int j=0;
+          imageType=ImageTypePNG;
+          for (std::list<MapTileServer*>::iterator i=tileServers.begin();i!=tileServers.end();i++) {
+            MapTileServer *tileServer=*i;
+            if ((mapContainer->getZoomLevelMap()>=tileServer->getMinZoomLevelMap())&&(mapContainer->getZoomLevelMap()<=tileServer->getMaxZoomLevelMap())) {
+
+              // Load the image and compose it with the existing image
+              if (!tileServer->composeTileImage(urls[j],composedImages[threadNr],composedImageValid,composedImageWidth,composedImageHeight,threadNr)) {
+                composedImageValid=false;
+                break;
+              }
+              j++;
+            }
+          }
+          if (composedImageValid) {
+            imageData = core->getImage()->writePNG(composedImages[threadNr]->data,composedImageWidth,composedImageHeight,core->getImage()->getRGBPixelSize(),imageSize,false,downloadedTileCompressionLevel,downloadedTileRowFilter);
+          }
         }
 
         // Queue the image
@@ -465,21 +622,26 @@ void MapDownloader::downloadMapImages(Int threadNr) {
           MapImage image;
           image.imageData=imageData;
           image.imageSize=imageSize;
+          image.imageType=imageType;
           image.mapContainer=mapContainer;
-          Int size;
-          do {
+          image.waitingMapContainers=waitingMapContainers;
+          image.validators=serializeTileValidators(urls,results,validators);
+          // Wait until the write thread has taken an image if the queue is full
+          while (1) {
             core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
-            size=imageQueue.size();
-            if (size<imageQueueMaxSize) {
+            if (imageQueue.size()<imageQueueMaxSize) {
               imageQueue.push_back(image);
               core->getThread()->unlockMutex(accessMutex);
-            } else {
-              core->getThread()->unlockMutex(accessMutex);
-              //DEBUG("image queue is full",NULL);
-              sleep(1);
+              break;
+            }
+            core->getThread()->unlockMutex(accessMutex);
+            //DEBUG("image queue is full",NULL);
+            core->getThread()->issueSignal(writeImagesStartSignal);
+            core->getThread()->waitForSignal(imageQueueSpaceSignals[threadNr]);
+            if (quitThreads) {
+              core->getThread()->exitThread();
             }
           }
-          while (size>=imageQueueMaxSize);
           core->getThread()->issueSignal(writeImagesStartSignal);
         }
 
@@ -489,9 +651,9 @@ void MapDownloader::downloadMapImages(Int threadNr) {
         if (!maxRetriesReached) {
           mapContainer->setDownloadRetries(mapContainer->getDownloadRetries()+1);
           core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
-          downloadQueue.push_back(mapContainer);
-          if (downloadQueue.size()>downloadQueueRecommendedSize)
-            downloadQueueRecommendedSizeExceeded=true;
+          insertDownloadQueue(mapContainer);
+          for (std::list<MapContainer*>::iterator i=waitingMapContainers.begin();i!=waitingMapContainers.end();i++)
+            insertDownloadQueue(*i);
           core->getThread()->unlockMutex(accessMutex);
 
           // Wait some time before downloading again
@@ -501,10 +663,9 @@ void MapDownloader::downloadMapImages(Int threadNr) {
 
           // Mark the container as complete such that it can be removed
           //DEBUG("set download complete",NULL);
-          mapSource->lockAccess(__FILE__, __LINE__);
-          mapContainer->setDownloadComplete(true);
-          mapContainer->setDownloadErrorOccured(true);
-          mapSource->unlockAccess();
+          markMapContainerFailed(mapContainer);
+          for (std::list<MapContainer*>::iterator i=waitingMapContainers.begin();i!=waitingMapContainers.end();i++)
+            markMapContainerFailed(*i);
           core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
           downloadedImages++;
           core->getThread()->unlockMutex(accessMutex);
@@ -606,7 +767,193 @@ void MapDownloader::updateDownloadStatus() {
   }
 }
 
-// Updates the download status
+// Marks the map container as downloaded
+void MapDownloader::markMapContainerComplete(MapContainer *mapContainer) {
+  bool serveToRemoteMap;
+  mapSource->lockAccess(__FILE__, __LINE__);
+  mapContainer->setDownloadComplete(true);
+  serveToRemoteMap=mapContainer->getServeToRemoteMap();
+  std::string calibrationFilePath = mapContainer->getCalibrationFilePath();
+  mapSource->unlockAccess();
+  if (serveToRemoteMap) {
+    std::stringstream cmd;
+    cmd << "serveRemoteMapContainer(" << calibrationFilePath << ")";
+    mapSource->queueRemoteServerCommand(cmd.str());
+  }
+}
+
+// Marks the map container as failed such that it can be removed
+void MapDownloader::markMapContainerFailed(MapContainer *mapContainer) {
+  mapSource->lockAccess(__FILE__, __LINE__);
+  mapContainer->setDownloadComplete(true);
+  mapContainer->setDownloadErrorOccured(true);
+  mapSource->unlockAccess();
+}
+
+// Returns the name of the archive entry that holds the validators of the tile
+std::string MapDownloader::getTileValidatorsFileName(MapContainer *mapContainer) {
+  std::string filename=mapContainer->getCalibrationFileName();
+  return filename.substr(0,filename.size()-4)+".gdv";
+}
+
+// Reads the validators of a previous download of the tile
+bool MapDownloader::readTileValidators(MapContainer *mapContainer, std::map<std::string, DownloadValidators> &validators) {
+
+  // Open the archive of the tile if it exists
+  if (access(mapContainer->getArchiveFilePath().c_str(),F_OK)==-1)
+    return false;
+  ZipArchiveReader mapArchive(mapContainer->getArchiveFileFolder(),mapContainer->getArchiveFileName());
+  if (!mapArchive.init())
+    return false;
+  std::string filename=getTileValidatorsFileName(mapContainer);
+  if (!mapArchive.hasEntry(filename))
+    return false;
+  Int size;
+  bool copied;
+  UByte *data=mapArchive.readEntry(filename,size,copied);
+  if (!data)
+    return false;
+  std::istringstream in(std::string((char*)data,size));
+  if (copied)
+    free(data);
+
+  // Each line holds the url, the entity tag, the modification date and the expiry time of one layer
+  std::string line;
+  while (std::getline(in,line)) {
+    std::istringstream fields(line);
+    std::string url,expires;
+    DownloadValidators v;
+    std::getline(fields,url,'\t');
+    std::getline(fields,v.eTag,'\t');
+    std::getline(fields,v.lastModified,'\t');
+    std::getline(fields,expires,'\t');
+    v.expires=atol(expires.c_str());
+    if (url!="")
+      validators[url]=v;
+  }
+  return validators.size()>0;
+}
+
+// Converts the validators of the downloaded layers into the format stored in the archive
+std::string MapDownloader::serializeTileValidators(std::vector<std::string> &urls, std::vector<DownloadResult> &results, std::vector<DownloadValidators> &validators) {
+  std::stringstream out;
+  for (Int j=0;j<urls.size();j++) {
+    if ((results[j]==DownloadResultSuccess)&&((validators[j].eTag!="")||(validators[j].lastModified!="")||(validators[j].expires!=0))) {
+      out << urls[j] << "\t" << validators[j].eTag << "\t" << validators[j].lastModified << "\t" << validators[j].expires << "\n";
+    }
+  }
+  return out.str();
+}
+
+// Downloads the images of the selected layers in parallel
+// The calling thread waits until all layers of the tile are there, so the number of
+// transfers in flight is still bounded by the number of download threads times the layers
+void MapDownloader::downloadTileImages(Int threadNr, std::vector<MapTileServer*> &layerServers, std::vector<std::string> &urls, std::vector<bool> &selectedLayers, std::map<std::string, DownloadValidators> *previousValidators, std::vector<DownloadResult> &results, std::vector<DownloadValidators> &validators) {
+
+  // Request all images
+  std::vector<DownloadRequest*> requests(urls.size(),NULL);
+  for (Int j=0;j<urls.size();j++) {
+    if (selectedLayers[j]) {
+      const DownloadValidators *v=NULL;
+      if (previousValidators) {
+        std::map<std::string, DownloadValidators>::iterator k=previousValidators->find(urls[j]);
+        if (k!=previousValidators->end())
+          v=&k->second;
+      }
+      requests[j]=layerServers[j]->requestTileImage(downloadEngine,urls[j],v);
+    }
+  }
+
+  // Wait until all images are downloaded
+  for (Int j=0;j<urls.size();j++) {
+    if (selectedLayers[j]) {
+      validators[j]=DownloadValidators();
+      validators[j].expires=0;
+      results[j]=layerServers[j]->receiveTileImage(downloadEngine,requests[j],threadNr,urls[j],&validators[j]);
+    }
+  }
+}
+
+// Writes the collected images to disk and marks their map containers as complete
+void MapDownloader::commitImages(std::map<std::string, ZipArchive*> &archives, std::list<MapImage> &images) {
+
+  // Write all archives
+  Int entries=0;
+  Int bytes=0;
+  std::unordered_set<std::string> failedArchives;
+  for (std::map<std::string, ZipArchive*>::iterator i=archives.begin();i!=archives.end();i++) {
+    ZipArchive *mapArchive=i->second;
+
+    // The counters are reset when the changes are written
+    Int uncommittedEntries=mapArchive->getUncommittedEntries();
+    Int uncommittedBytes=mapArchive->getUncommittedBytes();
+    if (mapArchive->writeChanges(false)) {
+      entries+=uncommittedEntries;
+      bytes+=uncommittedBytes;
+      mapSource->updateMapArchiveFiles(i->first);
+    } else {
+      WARNING("can not write <%s>",i->first.c_str());
+      mapArchive->discardChanges();
+      failedArchives.insert(i->first);
+    }
+    delete mapArchive;
+  }
+  archives.clear();
+  core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+  archiveCommits++;
+  archiveCommittedEntries+=entries;
+  archiveCommittedBytes+=bytes;
+  DEBUG("commit %d: %d entries with %d bytes (%d entries with %d bytes in total)",archiveCommits,entries,bytes,archiveCommittedEntries,archiveCommittedBytes);
+  core->getThread()->unlockMutex(accessMutex);
+
+  // Update the map cache
+  // Images of archives that could not be written are downloaded again
+  Int completedImages=0;
+  bool retryDownloads=false;
+  for (std::list<MapImage>::iterator i=images.begin();i!=images.end();i++) {
+    MapImage image=*i;
+    std::string archiveFilePath=image.mapContainer->getArchiveFileFolder()+"/"+image.mapContainer->getArchiveFileName();
+    if (failedArchives.find(archiveFilePath)!=failedArchives.end()) {
+      if (image.mapContainer->getDownloadRetries()<maxDownloadRetries) {
+        image.mapContainer->setDownloadRetries(image.mapContainer->getDownloadRetries()+1);
+        core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+        insertDownloadQueue(image.mapContainer);
+        for (std::list<MapContainer*>::iterator j=image.waitingMapContainers.begin();j!=image.waitingMapContainers.end();j++)
+          insertDownloadQueue(*j);
+        core->getThread()->unlockMutex(accessMutex);
+        retryDownloads=true;
+      } else {
+        markMapContainerFailed(image.mapContainer);
+        for (std::list<MapContainer*>::iterator j=image.waitingMapContainers.begin();j!=image.waitingMapContainers.end();j++)
+          markMapContainerFailed(*j);
+        completedImages++;
+      }
+    } else {
+      mapSource->lockAccess(__FILE__, __LINE__);
+      image.mapContainer->setImageType(image.imageType);
+      for (std::list<MapContainer*>::iterator j=image.waitingMapContainers.begin();j!=image.waitingMapContainers.end();j++)
+        (*j)->setImageType(image.imageType);
+      mapSource->unlockAccess();
+      markMapContainerComplete(image.mapContainer);
+      for (std::list<MapContainer*>::iterator j=image.waitingMapContainers.begin();j!=image.waitingMapContainers.end();j++)
+        markMapContainerComplete(*j);
+      completedImages++;
+    }
+  }
+  if (retryDownloads) {
+    for (Int i=0;i<numberOfDownloadThreads;i++)
+      core->getThread()->issueSignal(downloadStartSignals[i]);
+  }
+  if (completedImages>0) {
+    core->getMapEngine()->setForceCacheUpdate(__FILE__, __LINE__);
+    core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+    downloadedImages+=completedImages;
+    core->getThread()->unlockMutex(accessMutex);
+  }
+  images.clear();
+}
+
+// Writes downloaded images to storage
 void MapDownloader::writeImages() {
 
   // Set the priority
@@ -623,6 +970,11 @@ void MapDownloader::writeImages() {
       core->getThread()->exitThread();
     }
 
+    // Collect the images in batches and write them with one commit per archive
+    std::map<std::string, ZipArchive*> archives;
+    std::list<MapImage> images;
+    Int batchBytes=0;
+    TimestampInMicroseconds batchStartTime=0;
     while (1) {
 
       // Queue empty?
@@ -630,54 +982,66 @@ void MapDownloader::writeImages() {
       MapImage image;
       core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
       bool imageQueueEmpty = (imageQueue.size()==0) ? true : false;
+      bool imageQueueFull = (imageQueue.size()>=imageQueueMaxSize) ? true : false;
       if (!imageQueueEmpty) {
         image=imageQueue.front();
         imageQueue.pop_front();
       }
       core->getThread()->unlockMutex(accessMutex);
-      if ((imageQueueEmpty)||(quitThreads))
+
+      // Wake up the download threads that wait for space in the queue
+      if (imageQueueFull) {
+        for (Int i=0;i<numberOfDownloadThreads;i++)
+          core->getThread()->issueSignal(imageQueueSpaceSignals[i]);
+      }
+      if ((imageQueueEmpty)||(quitThreads)) {
+        commitImages(archives,images);
         break;
+      }
 
       // Add the image to the archive
+      std::string archiveFilePath=image.mapContainer->getArchiveFileFolder()+"/"+image.mapContainer->getArchiveFileName();
       ZipArchive *mapArchive=NULL;
-      //DEBUG("writing image data",NULL);
-      mapArchive=new ZipArchive(image.mapContainer->getArchiveFileFolder(), image.mapContainer->getArchiveFileName());
-      if ((mapArchive==NULL)||(!mapArchive->init()))
-        FATAL("can not create zip archive object",NULL);
+      std::map<std::string, ZipArchive*>::iterator i=archives.find(archiveFilePath);
+      if (i==archives.end()) {
+        //DEBUG("writing image data",NULL);
+        mapArchive=new ZipArchive(image.mapContainer->getArchiveFileFolder(), image.mapContainer->getArchiveFileName());
+        if ((mapArchive==NULL)||(!mapArchive->init()))
+          FATAL("can not create zip archive object",NULL);
+        archives[archiveFilePath]=mapArchive;
+      } else {
+        mapArchive=i->second;
+      }
+      if (images.size()==0)
+        batchStartTime=core->getClock()->getMicrosecondsSinceStart();
+      mapArchive->removeEntry(image.mapContainer->getImageFilePath());
       mapArchive->addEntry(image.mapContainer->getImageFilePath(),(void*)image.imageData,(Int)image.imageSize);
 
       // Write the gdm file
-      if (mapArchive) {
-        //DEBUG("writing calibration data",NULL);
-        image.mapContainer->writeCalibrationFile(mapArchive);
-        mapArchive->writeChanges();
-        mapSource->updateMapArchiveFiles(mapArchive->getArchiveFolder()+"/"+mapArchive->getArchiveName());
-        delete mapArchive;
-        mapArchive=NULL;
-      } else {
-        WARNING("can not store <%s>",image.mapContainer->getImageFileName().c_str());
+      //DEBUG("writing calibration data",NULL);
+      mapArchive->removeEntry(image.mapContainer->getCalibrationFileName());
+      image.mapContainer->writeCalibrationFile(mapArchive);
+
+      // Write the validators that allow to check later if the tile has changed
+      std::string validatorsFileName=getTileValidatorsFileName(image.mapContainer);
+      mapArchive->removeEntry(validatorsFileName);
+      if (image.validators.size()>0) {
+        void *validatorsData;
+        if (!(validatorsData=malloc(image.validators.size()))) {
+          FATAL("can not reserve memory for tile validators",NULL);
+        }
+        memcpy(validatorsData,image.validators.c_str(),image.validators.size());
+        mapArchive->addEntry(validatorsFileName,validatorsData,image.validators.size());
       }
-
-      // Update the map cache
-      //DEBUG("set download complete",NULL);
-      bool serveToRemoteMap;
-      mapSource->lockAccess(__FILE__, __LINE__);
-      image.mapContainer->setDownloadComplete(true);
-      serveToRemoteMap=image.mapContainer->getServeToRemoteMap();
-      std::string calibrationFilePath = image.mapContainer->getCalibrationFilePath();
-      mapSource->unlockAccess();
-      if (serveToRemoteMap) {
-        std::stringstream cmd;
-        cmd << "serveRemoteMapContainer(" << calibrationFilePath << ")";
-        mapSource->queueRemoteServerCommand(cmd.str());
+      images.push_back(image);
+      batchBytes+=image.imageSize;
+
+      // Commit the batch if it is large or old enough
+      if ((images.size()>=archiveCommitMaxEntries)||(batchBytes>=archiveCommitMaxBytes)||
+          (core->getClock()->getMicrosecondsSinceStart()-batchStartTime>=(TimestampInMicroseconds)archiveCommitMaxDelay*1000)) {
+        commitImages(archives,images);
+        batchBytes=0;
       }
-      //DEBUG("set force cache update",NULL);
-      core->getMapEngine()->setForceCacheUpdate(__FILE__, __LINE__);
-      //DEBUG("inceasing download counter",NULL);
-      core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
-      downloadedImages++;
-      core->getThread()->unlockMutex(accessMutex);
-
     }
 
   }
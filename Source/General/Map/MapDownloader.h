@@ -30,10 +30,23 @@ namespace GEODISCOVERER {
 typedef std::map<std::string, Int> MapLayerNameMap;
 typedef std::pair<std::string, Int> MapLayerNamePair;
 
+// Orders the download queue by the distance in zoom levels and then by the squared distance in tiles to the view
+typedef std::pair<Int, double> MapDownloadPriority;
+typedef std::multimap<MapDownloadPriority, MapContainer*> MapDownloadQueue;
+
+// Tile in the download queue
+struct MapDownloadQueueEntry {
+  MapDownloadQueue::iterator pos;                 // Position of the map container that is downloaded
+  std::list<MapContainer*> waitingMapContainers;  // Other map containers of the same tile that wait for the download
+};
+
 struct MapImage {
   UByte *imageData;
   UInt imageSize;
+  ImageType imageType;
   MapContainer *mapContainer;
+  std::list<MapContainer*> waitingMapContainers;
+  std::string validators;
 };
 
 class MapDownloader {
@@ -43,7 +56,12 @@ protected:
   MapSourceMercatorTiles *mapSource;                      // Map source this object downloads for
   Int downloadErrorWaitTime;                              // Time in seconds to wait after a download error before starting a new download
   Int maxDownloadRetries;                                 // Maximum number of retries before a download is aborted
-  std::list<MapContainer*> downloadQueue;                 // Queue of map containers that must be downloaded from the server
+  MapDownloadQueue downloadQueue;                         // Queue of map containers that must be downloaded from the server
+  std::map<std::string, MapDownloadQueueEntry> downloadQueueEntries; // Queued tiles by their z/x/y key
+  MapPosition downloadQueueViewPos;                       // View center the priorities of the download queue refer to
+  Int downloadQueueViewZoomLevel;                         // Zoom level of the view the priorities of the download queue refer to
+  Int downloadQueueViewTileX;                             // Tile at the view center the priorities of the download queue refer to
+  Int downloadQueueViewTileY;                             // Tile at the view center the priorities of the download queue refer to
   ThreadMutexInfo *accessMutex;                           // Mutex for accessing the map downloader object
   std::vector<ThreadSignalInfo *> downloadStartSignals;   // Signals that triggers the download thread
   bool quitThreads;                                       // Indicates that the map download image and the status thread shall exit
@@ -51,8 +69,13 @@ protected:
   ThreadSignalInfo *updateStatsStartSignal;               // Signal for starting the status update computation
   ThreadInfo *updateStatsThreadInfo;                      // Thread that computes statistics about the download
   std::list<MapTileServer*> tileServers;                  // List of tile servers to download images from
+  DownloadEngine *downloadEngine;                         // Engine that downloads the images over reused connections
   Int numberOfDownloadThreads;                            // Number of threads to spawn that download images
   std::vector<bool> downloadOngoing;                      // Indicates if the download thread is working
+  std::vector<Memory*> composedImages;                    // Reusable buffer per download thread for composing the layers
+  bool storeDownloadedTilesUnchanged;                     // Indicates that tiles from a single opaque layer are stored without re-encoding
+  Int downloadedTileCompressionLevel;                     // Compression level of the PNG encoder for composed tiles
+  Int downloadedTileRowFilter;                            // Row filter of the PNG encoder for composed tiles
   std::list<std::string> layerGroupNames;                 // List of used layer group names
   TimestampInSeconds downloadStartTime;                   // Last time the first download was started
   Int downloadedImages;                                   // Number of downloaded images so far
@@ -61,7 +84,45 @@ protected:
   std::list<MapImage> imageQueue;                         // Queue of images that must be written to storage
   UInt imageQueueMaxSize;                                 // Maximum size of the image queue
   ThreadSignalInfo *writeImagesStartSignal;               // Signal for starting the writing of images to storage
+  std::vector<ThreadSignalInfo *> imageQueueSpaceSignals; // Signals that wake up download threads waiting for space in the image queue
   ThreadInfo *writeImagesThreadInfo;                      // Thread that writes images to storage
+  Int archiveCommitMaxEntries;                            // Maximum number of images to collect before writing them to storage
+  Int archiveCommitMaxBytes;                              // Maximum number of bytes to collect before writing them to storage
+  Int archiveCommitMaxDelay;                              // Maximum time in milliseconds to collect images before writing them to storage
+  Int archiveCommits;                                     // Number of times collected images have been written to storage
+  Int archiveCommittedEntries;                            // Number of images written to storage
+  Int archiveCommittedBytes;                              // Number of image bytes written to storage
+
+  // Returns the key that identifies the tile of the map container in the download queue
+  std::string getDownloadQueueKey(MapContainer *mapContainer);
+
+  // Computes the priority of the map container with respect to the current view
+  MapDownloadPriority computeDownloadPriority(MapContainer *mapContainer);
+
+  // Adds the map container to the download queue
+  // If its tile is already queued, the map container waits for the download of the queued one
+  void insertDownloadQueue(MapContainer *mapContainer);
+
+  // Marks the map container as downloaded
+  void markMapContainerComplete(MapContainer *mapContainer);
+
+  // Marks the map container as failed such that it can be removed
+  void markMapContainerFailed(MapContainer *mapContainer);
+
+  // Returns the name of the archive entry that holds the validators of the tile
+  std::string getTileValidatorsFileName(MapContainer *mapContainer);
+
+  // Reads the validators of a previous download of the tile
+  bool readTileValidators(MapContainer *mapContainer, std::map<std::string, DownloadValidators> &validators);
+
+  // Converts the validators of the downloaded layers into the format stored in the archive
+  std::string serializeTileValidators(std::vector<std::string> &urls, std::vector<DownloadResult> &results, std::vector<DownloadValidators> &validators);
+
+  // Downloads the images of the selected layers in parallel
+  void downloadTileImages(Int threadNr, std::vector<MapTileServer*> &layerServers, std::vector<std::string> &urls, std::vector<bool> &selectedLayers, std::map<std::string, DownloadValidators> *previousValidators, std::vector<DownloadResult> &results, std::vector<DownloadValidators> &validators);
+
+  // Writes the collected images to disk and marks their map containers as complete
+  void commitImages(std::map<std::string, ZipArchive*> &archives, std::list<MapImage> &images);
 
 public:
 
@@ -89,6 +150,9 @@ public:
   // Adds a map container to the download queue
   void queueMapContainerDownload(MapContainer *mapContainer);
 
+  // Recomputes the priorities of the download queue if the zoom level or the tile at the view center has changed
+  void updateDownloadPriorities(MapPosition viewPos, Int viewZoomLevel, Int viewTileX, Int viewTileY);
+
   // Merges all so far downloaded zip archives into the first one
   void maintenance();
 
@@ -114,6 +178,18 @@ public:
   std::list<MapTileServer*> *getTileServers() {
     return &tileServers;
   }
+
+  Int getArchiveCommits() const {
+    return archiveCommits;
+  }
+
+  Int getArchiveCommittedEntries() const {
+    return archiveCommittedEntries;
+  }
+
+  Int getArchiveCommittedBytes() const {
+    return archiveCommittedBytes;
+  }
 };
 
 } /* namespace GEODISCOVERER */
@@ -261,15 +261,6 @@ void MapEngine::fillGeographicAreaWithTiles(MapArea area, MapTile *preferredNeig
     //Int searchedYNorth,searchedYSouth;
     //Int searchedXWest,searchedXEast;
     //double searchedLatNorth,searchedLatSouth,searchedLngEast,searchedLngWest;
-    Int visXByCalibrator,visYByCalibrator;
-
-    // Use the calibrator to compute the position
-    MapPosition pos=area.getRefPos();
-    tile->getParentMapContainer()->getMapCalibrator()->setPictureCoordinates(pos);
-    Int diffVisX=tile->getMapX()-pos.getX();
-    Int diffVisY=tile->getMapY()-pos.getY();
-    visXByCalibrator=area.getRefPos().getX()+diffVisX;
-    visYByCalibrator=area.getRefPos().getY()-diffVisY-tile->getHeight();
 
     // Has the tile already been processed?
     if (!tile->getIsProcessed()) {
@@ -334,9 +325,14 @@ void MapEngine::fillGeographicAreaWithTiles(MapArea area, MapTile *preferredNeig
         /*if ((tile->getVisX()!=visXByCalibrator)||(tile->getVisY()!=visYByCalibrator)) {
           DEBUG("tile %s has changed position to (%d, %d)",tile->getVisName().front().c_str(),visXByCalibrator,visYByCalibrator);
         }*/
+        // Tiles that are already drawn keep their position, so only added tiles need the calibrator
         if (!tile->isDrawn()) {
-          tile->setVisX(visXByCalibrator);
-          tile->setVisY(visYByCalibrator);
+          MapPosition pos=area.getRefPos();
+          tile->getParentMapContainer()->getMapCalibrator()->setPictureCoordinates(pos);
+          Int diffVisX=tile->getMapX()-pos.getX();
+          Int diffVisY=tile->getMapY()-pos.getY();
+          tile->setVisX(area.getRefPos().getX()+diffVisX);
+          tile->setVisY(area.getRefPos().getY()-diffVisY-tile->getHeight());
         }
       }
 
@@ -812,25 +808,27 @@ void MapEngine::updateMap() {
           newDisplayArea.setXEast(refPos.getX()+zoomedScreenWidth/2);
 
           // Compute the geographic boundaries
-          MapPosition t=newMapPos;
+          MapPosition corners[4];
           double latNorth,latSouth,lngWest,lngEast;
-          t.setX(newMapPos.getX()-zoomedScreenWidth/2);
-          t.setY(newMapPos.getY()-zoomedScreenHeight/2);
-          calibrator->setGeographicCoordinates(t);
-          latNorth=t.getLat();
-          lngWest=t.getLng();
-          t.setY(newMapPos.getY()+zoomedScreenHeight/2);
-          calibrator->setGeographicCoordinates(t);
-          latSouth=t.getLat();
-          if (t.getLng()<lngWest) lngWest=t.getLng();
-          t.setX(newMapPos.getX()+zoomedScreenWidth/2);
-          calibrator->setGeographicCoordinates(t);
-          if (t.getLat()<latSouth) latSouth=t.getLat();
-          lngEast=t.getLng();
-          t.setY(newMapPos.getY()-zoomedScreenHeight/2);
-          calibrator->setGeographicCoordinates(t);
-          if (t.getLat()>latNorth) latNorth=t.getLat();
-          if (t.getLng()>lngEast) lngEast=t.getLng();
+          for (Int i=0;i<4;i++)
+            corners[i]=newMapPos;
+          corners[0].setX(newMapPos.getX()-zoomedScreenWidth/2);
+          corners[0].setY(newMapPos.getY()-zoomedScreenHeight/2);
+          corners[1].setX(newMapPos.getX()-zoomedScreenWidth/2);
+          corners[1].setY(newMapPos.getY()+zoomedScreenHeight/2);
+          corners[2].setX(newMapPos.getX()+zoomedScreenWidth/2);
+          corners[2].setY(newMapPos.getY()+zoomedScreenHeight/2);
+          corners[3].setX(newMapPos.getX()+zoomedScreenWidth/2);
+          corners[3].setY(newMapPos.getY()-zoomedScreenHeight/2);
+          calibrator->setGeographicCoordinates(corners,4);
+          latNorth=corners[0].getLat();
+          lngWest=corners[0].getLng();
+          latSouth=corners[1].getLat();
+          if (corners[1].getLng()<lngWest) lngWest=corners[1].getLng();
+          if (corners[2].getLat()<latSouth) latSouth=corners[2].getLat();
+          lngEast=corners[2].getLng();
+          if (corners[3].getLat()>latNorth) latNorth=corners[3].getLat();
+          if (corners[3].getLng()>lngEast) lngEast=corners[3].getLng();
           newDisplayArea.setLatNorth(latNorth);
           newDisplayArea.setLatSouth(latSouth);
           newDisplayArea.setLngEast(lngEast);
@@ -885,6 +883,7 @@ void MapEngine::updateMap() {
 
           // Update the access time of the tile and copy the visual position
           TimestampInSeconds currentTime=core->getClock()->getSecondsSinceEpoch();
+          core->getMapCache()->touchTiles(tiles);
           for (std::list<MapTile*>::const_iterator i=tiles.begin();i!=tiles.end();i++) {
             MapTile *t=*i;
 
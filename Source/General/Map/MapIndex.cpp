@@ -0,0 +1,375 @@
+//============================================================================
+// Name        : MapIndex.cpp
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <Core.h>
+#include <MapIndex.h>
+#include <MapSource.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <zlib.h>
+
+namespace GEODISCOVERER {
+
+const char MapIndex::magic[8] = { 'G', 'D', 'M', 'A', 'P', 'I', 'D', 'X' };
+const UInt MapIndex::version = 2;
+const UInt MapIndex::alignment = 8;
+const UInt MapIndex::noString = std::numeric_limits<UInt>::max();
+
+// Constructor
+MapIndex::MapIndex() {
+  mapping=NULL;
+  mappingSize=0;
+  header=NULL;
+  memset(&storedHeader,0,sizeof(storedHeader));
+}
+
+// Destructor
+MapIndex::~MapIndex() {
+  close();
+}
+
+// Computes the checksum of the given memory
+UInt MapIndex::computeChecksum(UInt checksum, const void *data, size_t size) {
+  return adler32(checksum,(const Bytef*)data,size);
+}
+
+// Computes the checksum of the header and the directory sections
+UInt MapIndex::computeHeaderChecksum(const MapIndexHeader *header, const UByte *data) {
+  MapIndexHeader t=*header;
+  t.checksum=0;
+  UInt checksum=computeChecksum(adler32(0,Z_NULL,0),&t,sizeof(t));
+  return computeChecksum(checksum,data+header->containerOffset,header->calibrationPointOffset-header->containerOffset);
+}
+
+// Checks if the section lies within the file
+bool MapIndex::isSectionValid(UInt offset, UInt count, size_t recordSize) const {
+  if ((offset<sizeof(MapIndexHeader))||(offset%alignment!=0))
+    return false;
+  if ((size_t)offset>mappingSize)
+    return false;
+  return (size_t)count<=(mappingSize-offset)/recordSize;
+}
+
+// Checks if the string offset is valid
+bool MapIndex::isStringValid(UInt offset) const {
+  return (offset==noString)||(offset<header->stringSize);
+}
+
+// Maps the index file into memory and verifies its directory
+bool MapIndex::open(std::string filePath) {
+
+  // Map the file into memory
+  close();
+  this->filePath=filePath;
+  int fd=::open(filePath.c_str(),O_RDONLY);
+  if (fd<0) {
+    DEBUG("can not open <%s>",filePath.c_str());
+    return false;
+  }
+  struct stat stat_buffer;
+  if ((fstat(fd,&stat_buffer)!=0)||(stat_buffer.st_size<(off_t)sizeof(MapIndexHeader))) {
+    DEBUG("<%s> is not a map index",filePath.c_str());
+    ::close(fd);
+    return false;
+  }
+  mappingSize=stat_buffer.st_size;
+  void *m=mmap(NULL,mappingSize,PROT_READ,MAP_PRIVATE,fd,0);
+  ::close(fd);
+  if (m==MAP_FAILED) {
+    DEBUG("can not map <%s> into memory",filePath.c_str());
+    mappingSize=0;
+    return false;
+  }
+  mapping=(UByte*)m;
+  header=(const MapIndexHeader*)mapping;
+
+  // Check the header
+  bool valid=true;
+  if ((memcmp(header->magic,magic,sizeof(magic))!=0)||(header->byteOrder!=1)) {
+    DEBUG("<%s> is not a map index",filePath.c_str());
+    valid=false;
+  } else if (header->version!=version) {
+    DEBUG("<%s> has schema version %d but version %d is required",filePath.c_str(),header->version,version);
+    valid=false;
+  } else if (header->fileSize!=mappingSize) {
+    DEBUG("<%s> is truncated",filePath.c_str());
+    valid=false;
+  }
+
+  // Check that all sections lie within the file
+  if ((valid)&&(
+      (!isSectionValid(header->containerOffset,header->containerCount,sizeof(MapIndexContainer)))||
+      (!isSectionValid(header->treeNodeOffset,header->treeNodeCount,sizeof(MapIndexTreeNode)))||
+      (!isSectionValid(header->searchTreeOffset,header->searchTreeCount,sizeof(Int)))||
+      (!isSectionValid(header->layerNameOffset,header->layerNameCount,sizeof(MapIndexLayerName)))||
+      (!isSectionValid(header->archiveOffset,header->archiveCount,sizeof(MapIndexArchive)))||
+      (!isSectionValid(header->stringOffset,header->stringSize,1))||
+      (!isSectionValid(header->calibrationPointOffset,header->calibrationPointCount,sizeof(MapIndexCalibrationPoint)))||
+      (!isSectionValid(header->tileOffset,header->tileCount,sizeof(MapIndexTile)))||
+      (header->containerOffset>header->calibrationPointOffset)||
+      (header->stringSize==0))) {
+    DEBUG("<%s> has invalid sections",filePath.c_str());
+    valid=false;
+  }
+
+  // Verify the directory
+  if ((valid)&&(computeHeaderChecksum(header,mapping)!=header->checksum)) {
+    DEBUG("checksum of <%s> does not match",filePath.c_str());
+    valid=false;
+  }
+
+  // Check the references between the records
+  if ((valid)&&(mapping[header->stringOffset+header->stringSize-1]!=0))
+    valid=false;
+  for (UInt i=0;(valid)&&(i<header->containerCount);i++) {
+    const MapIndexContainer *c=getContainer(i);
+    if ((!isStringValid(c->archiveFileFolder))||(!isStringValid(c->mapFileFolder))||
+        (!isStringValid(c->imageFileName))||(!isStringValid(c->imageFilePath))||
+        (!isStringValid(c->calibrationFileName))||(!isStringValid(c->calibrationFilePath))||
+        (!isStringValid(c->archiveFileName))||(!isStringValid(c->archiveFilePath))||
+        (!isStringValid(c->calibratorArgs))||
+        (c->calibrationPointFirst>header->calibrationPointCount)||
+        (c->calibrationPointCount>header->calibrationPointCount-c->calibrationPointFirst)||
+        (c->tileFirst>header->tileCount)||
+        (c->tileCount>header->tileCount-c->tileFirst)||
+        (c->searchTreeRoot<-1)||(c->searchTreeRoot>=(Int)c->tileCount))
+      valid=false;
+  }
+  for (UInt i=0;(valid)&&(i<header->treeNodeCount);i++) {
+    const MapIndexTreeNode *n=getTreeNode(i);
+    if ((n->container<0)||(n->container>=(Int)header->containerCount)||
+        (n->leftChild<-1)||(n->leftChild>=(Int)header->treeNodeCount)||
+        (n->rightChild<-1)||(n->rightChild>=(Int)header->treeNodeCount))
+      valid=false;
+  }
+  for (UInt i=0;(valid)&&(i<header->searchTreeCount);i++) {
+    Int root=getSearchTree(i);
+    if ((root<-1)||(root>=(Int)header->treeNodeCount))
+      valid=false;
+  }
+  for (UInt i=0;(valid)&&(i<header->layerNameCount);i++) {
+    if ((getLayerName(i)->name==noString)||(!isStringValid(getLayerName(i)->name)))
+      valid=false;
+  }
+  for (UInt i=0;(valid)&&(i<header->archiveCount);i++) {
+    if ((getArchive(i)->path==noString)||(!isStringValid(getArchive(i)->path)))
+      valid=false;
+  }
+  if (!valid) {
+    DEBUG("<%s> can not be used",filePath.c_str());
+    close();
+    return false;
+  }
+  return true;
+}
+
+// Releases the mapped file
+void MapIndex::close() {
+  if (mapping)
+    munmap(mapping,mappingSize);
+  mapping=NULL;
+  mappingSize=0;
+  header=NULL;
+}
+
+// Verifies the tiles and calibration points of the container
+bool MapIndex::verifyContainer(Int index) const {
+  const MapIndexContainer *c=getContainer(index);
+  UInt checksum=adler32(0,Z_NULL,0);
+  checksum=computeChecksum(checksum,getCalibrationPoint(c->calibrationPointFirst),c->calibrationPointCount*sizeof(MapIndexCalibrationPoint));
+  checksum=computeChecksum(checksum,getTile(c->tileFirst),c->tileCount*sizeof(MapIndexTile));
+  if (checksum!=c->checksum)
+    return false;
+  for (UInt i=0;i<c->tileCount;i++) {
+    const MapIndexTile *t=getTile(c->tileFirst+i);
+    if ((t->leftChild<-1)||(t->leftChild>=(Int)c->tileCount)||(t->rightChild<-1)||(t->rightChild>=(Int)c->tileCount))
+      return false;
+  }
+  return true;
+}
+
+// Removes the index file such that it is recreated at the next start
+void MapIndex::invalidate() {
+  if (filePath!="")
+    remove(filePath.c_str());
+}
+
+// Adds a string to the index and returns its offset
+UInt MapIndex::storeString(const char *value) {
+  if (value==NULL)
+    return noString;
+  std::unordered_map<std::string, UInt>::iterator i=storedStringOffsets.find(value);
+  if (i!=storedStringOffsets.end())
+    return i->second;
+  UInt offset=storedStrings.size();
+  storedStrings.insert(storedStrings.end(),value,value+strlen(value)+1);
+  storedStringOffsets[value]=offset;
+  return offset;
+}
+
+// Adds a map container to the index and returns its position
+Int MapIndex::storeContainer(const MapIndexContainer &container) {
+  storedContainers.push_back(container);
+  return storedContainers.size()-1;
+}
+
+// Adds a calibration point to the index and returns its position
+Int MapIndex::storeCalibrationPoint(const MapIndexCalibrationPoint &calibrationPoint) {
+  storedCalibrationPoints.push_back(calibrationPoint);
+  return storedCalibrationPoints.size()-1;
+}
+
+// Adds a tile to the index and returns its position
+Int MapIndex::storeTile(const MapIndexTile &tile) {
+  storedTiles.push_back(tile);
+  return storedTiles.size()-1;
+}
+
+// Updates a tile in the index
+void MapIndex::updateTile(Int index, const MapIndexTile &tile) {
+  storedTiles[index]=tile;
+}
+
+// Adds a node of a map container search tree and returns its position
+Int MapIndex::storeTreeNode(const MapIndexTreeNode &treeNode) {
+  storedTreeNodes.push_back(treeNode);
+  return storedTreeNodes.size()-1;
+}
+
+// Updates a node of a map container search tree
+void MapIndex::updateTreeNode(Int index, const MapIndexTreeNode &treeNode) {
+  storedTreeNodes[index]=treeNode;
+}
+
+// Adds the root node of the search tree of the next zoom level (-1 if none)
+void MapIndex::storeSearchTree(Int root) {
+  storedSearchTrees.push_back(root);
+}
+
+// Adds a map layer name
+void MapIndex::storeLayerName(std::string name, Int zoomLevel) {
+  MapIndexLayerName layerName;
+  layerName.name=storeString(name.c_str());
+  layerName.zoomLevel=zoomLevel;
+  storedLayerNames.push_back(layerName);
+}
+
+// Adds the stamp of a map archive
+void MapIndex::storeArchive(std::string path, Long modificationTime, Long size) {
+  MapIndexArchive archive;
+  memset(&archive,0,sizeof(archive));
+  archive.path=storeString(path.c_str());
+  archive.modificationTime=modificationTime;
+  archive.size=size;
+  storedArchives.push_back(archive);
+}
+
+// Sets the information about the complete map
+void MapIndex::storeMapInfo(Int minZoomLevel, Int maxZoomLevel, double centerLat, double centerLng, double centerLatScale, double centerLngScale) {
+  storedHeader.minZoomLevel=minZoomLevel;
+  storedHeader.maxZoomLevel=maxZoomLevel;
+  storedHeader.centerLat=centerLat;
+  storedHeader.centerLng=centerLng;
+  storedHeader.centerLatScale=centerLatScale;
+  storedHeader.centerLngScale=centerLngScale;
+}
+
+// Writes the collected records into the index file
+bool MapIndex::write(std::string filePath) {
+
+  // Compute the checksums of the containers
+  for (std::vector<MapIndexContainer>::iterator i=storedContainers.begin();i!=storedContainers.end();i++) {
+    UInt checksum=adler32(0,Z_NULL,0);
+    if (i->calibrationPointCount>0)
+      checksum=computeChecksum(checksum,&storedCalibrationPoints[i->calibrationPointFirst],i->calibrationPointCount*sizeof(MapIndexCalibrationPoint));
+    if (i->tileCount>0)
+      checksum=computeChecksum(checksum,&storedTiles[i->tileFirst],i->tileCount*sizeof(MapIndexTile));
+    i->checksum=checksum;
+  }
+
+  // Lay out the directory sections behind the header
+  std::vector<UByte> data(sizeof(MapIndexHeader),0);
+  MapIndexHeader &h=storedHeader;
+  memcpy(h.magic,magic,sizeof(magic));
+  h.version=version;
+  h.byteOrder=1;
+  h.mapTileWidth=core->getMapSource()->getMapTileWidth();
+  h.mapTileHeight=core->getMapSource()->getMapTileHeight();
+  if (storedStrings.size()==0)
+    storedStrings.push_back(0);
+  struct {
+    UInt *offset;
+    UInt *count;
+    const void *records;
+    UInt recordCount;
+    size_t recordSize;
+  } sections[] = {
+    { &h.containerOffset, &h.containerCount, storedContainers.empty() ? NULL : &storedContainers[0], (UInt)storedContainers.size(), sizeof(MapIndexContainer) },
+    { &h.treeNodeOffset, &h.treeNodeCount, storedTreeNodes.empty() ? NULL : &storedTreeNodes[0], (UInt)storedTreeNodes.size(), sizeof(MapIndexTreeNode) },
+    { &h.searchTreeOffset, &h.searchTreeCount, storedSearchTrees.empty() ? NULL : &storedSearchTrees[0], (UInt)storedSearchTrees.size(), sizeof(Int) },
+    { &h.layerNameOffset, &h.layerNameCount, storedLayerNames.empty() ? NULL : &storedLayerNames[0], (UInt)storedLayerNames.size(), sizeof(MapIndexLayerName) },
+    { &h.archiveOffset, &h.archiveCount, storedArchives.empty() ? NULL : &storedArchives[0], (UInt)storedArchives.size(), sizeof(MapIndexArchive) },
+    { &h.stringOffset, &h.stringSize, &storedStrings[0], (UInt)storedStrings.size(), 1 }
+  };
+  for (Int i=0;i<sizeof(sections)/sizeof(sections[0]);i++) {
+    data.resize((data.size()+alignment-1)/alignment*alignment,0);
+    *sections[i].offset=data.size();
+    *sections[i].count=sections[i].recordCount;
+    const UByte *records=(const UByte*)sections[i].records;
+    data.insert(data.end(),records,records+sections[i].recordCount*sections[i].recordSize);
+  }
+  data.resize((data.size()+alignment-1)/alignment*alignment,0);
+
+  // The calibration points and tiles follow the directory
+  h.calibrationPointOffset=data.size();
+  h.calibrationPointCount=storedCalibrationPoints.size();
+  h.tileOffset=h.calibrationPointOffset+h.calibrationPointCount*sizeof(MapIndexCalibrationPoint);
+  h.tileCount=storedTiles.size();
+  h.fileSize=h.tileOffset+h.tileCount*sizeof(MapIndexTile);
+  memcpy(&data[0],&h,sizeof(h));
+  h.checksum=computeHeaderChecksum(&h,&data[0]);
+  memcpy(&data[0],&h,sizeof(h));
+
+  // Write the file under a temporary name such that mappings of the old file stay intact
+  std::string tempFilePath=filePath+".tmp";
+  std::ofstream ofs;
+  ofs.open(tempFilePath.c_str(),std::ios::binary);
+  if (ofs.fail()) {
+    WARNING("can not open <%s> for writing",tempFilePath.c_str());
+    return false;
+  }
+  ofs.write((const char*)&data[0],data.size());
+  if (h.calibrationPointCount>0)
+    ofs.write((const char*)&storedCalibrationPoints[0],h.calibrationPointCount*sizeof(MapIndexCalibrationPoint));
+  if (h.tileCount>0)
+    ofs.write((const char*)&storedTiles[0],h.tileCount*sizeof(MapIndexTile));
+  bool failed=ofs.bad();
+  ofs.close();
+  if ((failed)||(rename(tempFilePath.c_str(),filePath.c_str())!=0)) {
+    WARNING("can not store map index into <%s>",filePath.c_str());
+    remove(tempFilePath.c_str());
+    return false;
+  }
+  return true;
+}
+
+}
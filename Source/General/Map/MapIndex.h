@@ -0,0 +1,302 @@
+//============================================================================
+// Name        : MapIndex.h
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#ifndef MAPINDEX_H_
+#define MAPINDEX_H_
+
+namespace GEODISCOVERER {
+
+// Header at the start of the index file
+typedef struct MapIndexHeader {
+  char magic[8];                          // Identifies the file as a map index
+  UInt version;                           // Version of the schema
+  UInt byteOrder;                         // Stored as 1 to detect files written with a different byte order
+  UInt fileSize;                          // Size of the complete file in bytes
+  UInt checksum;                          // Adler-32 of the header (with this field set to zero) and the directory sections
+  Int mapTileWidth;                       // Width of the tiles the index was created for
+  Int mapTileHeight;                      // Height of the tiles the index was created for
+  Int minZoomLevel;                       // Minimum zoom level of the map
+  Int maxZoomLevel;                       // Maximum zoom level of the map
+  double centerLat;                       // Latitude of the map center
+  double centerLng;                       // Longitude of the map center
+  double centerLatScale;                  // Latitude scale of the map center
+  double centerLngScale;                  // Longitude scale of the map center
+  UInt containerOffset;                   // Start of the map containers
+  UInt containerCount;                    // Number of map containers
+  UInt treeNodeOffset;                    // Start of the nodes of the map container search trees
+  UInt treeNodeCount;                     // Number of map container search tree nodes
+  UInt searchTreeOffset;                  // Start of the root nodes of the search trees of all zoom levels
+  UInt searchTreeCount;                   // Number of zoom levels
+  UInt layerNameOffset;                   // Start of the map layer names
+  UInt layerNameCount;                    // Number of map layer names
+  UInt archiveOffset;                     // Start of the map archives the index was created from
+  UInt archiveCount;                      // Number of map archives
+  UInt stringOffset;                      // Start of the zero terminated strings
+  UInt stringSize;                        // Size of all strings in bytes
+  UInt calibrationPointOffset;            // Start of the calibration points
+  UInt calibrationPointCount;             // Number of calibration points
+  UInt tileOffset;                        // Start of the map tiles
+  UInt tileCount;                         // Number of map tiles
+} MapIndexHeader;
+
+// Map container in the index
+// Strings are offsets into the string section (MapIndex::noString if not set)
+typedef struct MapIndexContainer {
+  double latNorth;                        // Maximum north border
+  double latSouth;                        // Minimum south border
+  double lngEast;                         // Maximum east border
+  double lngWest;                         // Minimum west border
+  double latScale;                        // Scale factor for latitude
+  double lngScale;                        // Scale factor for longitude
+  UInt archiveFileFolder;                 // Folder in which the map archive is stored
+  UInt mapFileFolder;                     // Folder in which the picture and calibration data of the map is stored
+  UInt imageFileName;                     // Filename of the picture of the map
+  UInt imageFilePath;                     // Complete path to the picture of the map
+  UInt calibrationFileName;               // Filename of the calibration data of the map
+  UInt calibrationFilePath;               // Complete path to the calibration data of the map
+  UInt archiveFileName;                   // Filename of the archive file
+  UInt archiveFilePath;                   // Complete path to the archive file
+  Int imageType;                          // File format of the image
+  Int x;                                  // X coordinate
+  Int y;                                  // Y coordinate
+  Int zoomLevelMap;                       // Zoom level in the map
+  Int zoomLevelServer;                    // Zoom level on the server
+  Int width;                              // Width of the map
+  Int height;                             // Height of the map
+  Int calibratorType;                     // Type of the calibrator
+  UInt calibratorArgs;                    // Arguments of the calibrator
+  UInt calibrationPointFirst;             // Index of the first calibration point
+  UInt calibrationPointCount;             // Number of calibration points
+  UInt tileFirst;                         // Index of the first tile
+  UInt tileCount;                         // Number of tiles
+  Int searchTreeRoot;                     // Root of the kd tree of the tiles (relative to the first tile, -1 if none)
+  UInt checksum;                          // Adler-32 of the tiles and calibration points of this container
+  UInt padding;                           // Keeps the size a multiple of 8 bytes
+} MapIndexContainer;
+
+// Node of a map container search tree in the index
+typedef struct MapIndexTreeNode {
+  Int container;                          // Index of the map container
+  Int leftChild;                          // Index of the left child node (-1 if none)
+  Int rightChild;                         // Index of the right child node (-1 if none)
+} MapIndexTreeNode;
+
+// Map layer name in the index
+typedef struct MapIndexLayerName {
+  UInt name;                              // Name of the layer
+  Int zoomLevel;                          // Zoom level of the layer
+} MapIndexLayerName;
+
+// Map archive in the index
+// Containers of an archive whose stamp does not match anymore are read again
+typedef struct MapIndexArchive {
+  UInt path;                              // Path to the archive
+  UInt padding;                           // Keeps the size a multiple of 8 bytes
+  Long modificationTime;                  // Modification time of the archive when it was read
+  Long size;                              // Size of the archive in bytes when it was read
+} MapIndexArchive;
+
+// Calibration point in the index
+typedef struct MapIndexCalibrationPoint {
+  double lat;                             // Latitude
+  double lng;                             // Longitude
+  double cartesianX;                      // X position in the cartesian coordinate system of the map projection
+  double cartesianY;                      // Y position in the cartesian coordinate system of the map projection
+  Int x;                                  // X position in the picture
+  Int y;                                  // Y position in the picture
+} MapIndexCalibrationPoint;
+
+// Map tile in the index
+typedef struct MapIndexTile {
+  double latNorthMax;                     // Maximum north border
+  double latNorthMin;                     // Minimum north border
+  double latSouthMax;                     // Maximum south border
+  double latSouthMin;                     // Minimum south border
+  double lngEastMin;                      // Minimum east border
+  double lngEastMax;                      // Maximum east border
+  double lngWestMax;                      // Maximum west border
+  double lngWestMin;                      // Minimum west border
+  double latScale;                        // Scale factor for latitude
+  double lngScale;                        // Scale factor for longitude
+  double lngX[2];                         // x Position in world (both sides)
+  double latY[2];                         // y Position in world (both sides)
+  double northAngle;                      // Angle to true north in degrees
+  Int mapX;                               // x Position in map
+  Int mapY;                               // y Position in map
+  Int leftChild;                          // Left child in the kd tree (relative to the first tile of the container, -1 if none)
+  Int rightChild;                         // Right child in the kd tree (relative to the first tile of the container, -1 if none)
+} MapIndexTile;
+
+// Index of all map containers of a map source
+//
+// The file consists of fixed size records that are used in place after
+// mapping the file into memory. The header and the directory sections
+// (containers, search trees, layer names, archives and strings) are verified when the
+// file is opened. The tiles and calibration points of a container are only
+// verified and touched when the container is loaded.
+class MapIndex {
+
+protected:
+
+  // Identification and version of the schema
+  static const char magic[8];
+  static const UInt version;
+
+  // Alignment of the sections in the file
+  static const UInt alignment;
+
+  // Memory mapped file
+  std::string filePath;
+  UByte *mapping;
+  size_t mappingSize;
+  const MapIndexHeader *header;
+
+  // Records collected for writing
+  MapIndexHeader storedHeader;
+  std::vector<MapIndexContainer> storedContainers;
+  std::vector<MapIndexTreeNode> storedTreeNodes;
+  std::vector<Int> storedSearchTrees;
+  std::vector<MapIndexLayerName> storedLayerNames;
+  std::vector<MapIndexArchive> storedArchives;
+  std::vector<char> storedStrings;
+  std::unordered_map<std::string, UInt> storedStringOffsets;
+  std::vector<MapIndexCalibrationPoint> storedCalibrationPoints;
+  std::vector<MapIndexTile> storedTiles;
+
+  // Computes the checksum of the given memory
+  static UInt computeChecksum(UInt checksum, const void *data, size_t size);
+
+  // Computes the checksum of the header and the directory sections
+  static UInt computeHeaderChecksum(const MapIndexHeader *header, const UByte *data);
+
+  // Checks if the section lies within the file
+  bool isSectionValid(UInt offset, UInt count, size_t recordSize) const;
+
+  // Checks if the string offset is valid
+  bool isStringValid(UInt offset) const;
+
+public:
+
+  // Marks a string that is not set
+  static const UInt noString;
+
+  // Constructor
+  MapIndex();
+
+  // Destructor
+  virtual ~MapIndex();
+
+  // Maps the index file into memory and verifies its directory
+  bool open(std::string filePath);
+
+  // Releases the mapped file
+  void close();
+
+  // Adds a string to the index and returns its offset
+  UInt storeString(const char *value);
+
+  // Adds a map container to the index and returns its position
+  Int storeContainer(const MapIndexContainer &container);
+
+  // Adds a calibration point to the index and returns its position
+  Int storeCalibrationPoint(const MapIndexCalibrationPoint &calibrationPoint);
+
+  // Adds a tile to the index and returns its position
+  Int storeTile(const MapIndexTile &tile);
+
+  // Updates a tile in the index
+  void updateTile(Int index, const MapIndexTile &tile);
+
+  // Adds a node of a map container search tree and returns its position
+  Int storeTreeNode(const MapIndexTreeNode &treeNode);
+
+  // Updates a node of a map container search tree
+  void updateTreeNode(Int index, const MapIndexTreeNode &treeNode);
+
+  // Adds the root node of the search tree of the next zoom level (-1 if none)
+  void storeSearchTree(Int root);
+
+  // Adds a map layer name
+  void storeLayerName(std::string name, Int zoomLevel);
+
+  // Adds the stamp of a map archive
+  void storeArchive(std::string path, Long modificationTime, Long size);
+
+  // Sets the information about the complete map
+  void storeMapInfo(Int minZoomLevel, Int maxZoomLevel, double centerLat, double centerLng, double centerLatScale, double centerLngScale);
+
+  // Writes the collected records into the index file
+  bool write(std::string filePath);
+
+  // Verifies the tiles and calibration points of the container
+  bool verifyContainer(Int index) const;
+
+  // Removes the index file such that it is recreated at the next start
+  void invalidate();
+
+  // Getters and setters
+  Int getStoredTileCount() const {
+    return storedTiles.size();
+  }
+
+  const MapIndexHeader *getHeader() const {
+    return header;
+  }
+
+  const MapIndexContainer *getContainer(Int index) const {
+    return ((const MapIndexContainer*)(mapping+header->containerOffset))+index;
+  }
+
+  const MapIndexTreeNode *getTreeNode(Int index) const {
+    return ((const MapIndexTreeNode*)(mapping+header->treeNodeOffset))+index;
+  }
+
+  Int getSearchTree(Int zoomLevel) const {
+    return ((const Int*)(mapping+header->searchTreeOffset))[zoomLevel];
+  }
+
+  const MapIndexLayerName *getLayerName(Int index) const {
+    return ((const MapIndexLayerName*)(mapping+header->layerNameOffset))+index;
+  }
+
+  const MapIndexArchive *getArchive(Int index) const {
+    return ((const MapIndexArchive*)(mapping+header->archiveOffset))+index;
+  }
+
+  const MapIndexCalibrationPoint *getCalibrationPoint(Int index) const {
+    return ((const MapIndexCalibrationPoint*)(mapping+header->calibrationPointOffset))+index;
+  }
+
+  const MapIndexTile *getTile(Int index) const {
+    return ((const MapIndexTile*)(mapping+header->tileOffset))+index;
+  }
+
+  char *getString(UInt offset) const {
+    if (offset==noString)
+      return NULL;
+    return (char*)(mapping+header->stringOffset+offset);
+  }
+};
+
+}
+
+#endif /* MAPINDEX_H_ */
@@ -105,15 +105,15 @@ MapPosition MapPosition::computeTarget(double bearing, double distance) {
   return target;
 }
 
-// Computes the bearing in degrees clockwise from north (0°) to the given destination point
-double MapPosition::computeBearing(MapPosition target) {
-  double latDist = target.getLatRad()-getLatRad();
-  double lngDist = target.getLngRad()-getLngRad();
+// Computes the bearing from the coordinates in rad (origin values are passed with their sine and cosine)
+static inline double computeBearingRad(double originLatRad, double originLngRad, double sinOriginLat, double cosOriginLat, double targetLatRad, double targetLngRad) {
+  double latDist = targetLatRad-originLatRad;
+  double lngDist = targetLngRad-originLngRad;
   if ((latDist==0)&&(lngDist==0))
     return 0;
-  double y = sin(lngDist)*cos(target.getLatRad());
-  double x = cos(getLatRad())*sin(target.getLatRad()) -
-             sin(getLatRad())*cos(target.getLatRad())*cos(lngDist);
+  double y = sin(lngDist)*cos(targetLatRad);
+  double x = cosOriginLat*sin(targetLatRad) -
+             sinOriginLat*cos(targetLatRad)*cos(lngDist);
   double bearing = FloatingPoint::rad2degree(atan2(y,x));
   bearing += 360;
   if (bearing >= 360)
@@ -121,16 +121,107 @@ double MapPosition::computeBearing(MapPosition target) {
   return bearing;
 }
 
-// Computes the distance in meters to the given destination point
-double MapPosition::computeDistance(MapPosition target)
-{
-  double latDist = FloatingPoint::degree2rad(target.getLat() - getLat());
-  double lngDist = FloatingPoint::degree2rad(target.getLng() - getLng());
-  double t1 = sin(latDist / 2) * sin(latDist / 2) + cos(FloatingPoint::degree2rad(getLat())) * cos(FloatingPoint::degree2rad(target.getLat())) * sin(lngDist / 2) * sin(lngDist / 2);
+// Computes the haversine distance from the differences in rad and the cosine of both latitudes
+static inline double computeHaversineDistance(double latDist, double lngDist, double cosOriginLat, double cosTargetLat, double earthRadius) {
+  double sinLatDist = sin(latDist / 2);
+  double sinLngDist = sin(lngDist / 2);
+  double t1 = sinLatDist * sinLatDist + cosOriginLat * cosTargetLat * sinLngDist * sinLngDist;
   double t2 = 2 * atan2(sqrt(t1), sqrt(1 - t1));
   return earthRadius * t2;
 }
 
+// Computes the bearing in degrees clockwise from north (0°) to the given destination point
+double MapPosition::computeBearing(const MapPosition &target) {
+  return computeBearing(getGeoPoint(),target.getGeoPoint());
+}
+
+// Computes the distance in meters to the given destination point
+double MapPosition::computeDistance(const MapPosition &target)
+{
+  return computeDistance(getGeoPoint(),target.getGeoPoint());
+}
+
+// Computes the bearing in degrees clockwise from north (0°) from the origin to the destination point
+double MapPosition::computeBearing(const GeoPoint &origin, const GeoPoint &target) {
+  double originLatRad = FloatingPoint::degree2rad(origin.lat);
+  return computeBearingRad(originLatRad, FloatingPoint::degree2rad(origin.lng), sin(originLatRad), cos(originLatRad),
+                           FloatingPoint::degree2rad(target.lat), FloatingPoint::degree2rad(target.lng));
+}
+
+// Computes the distance in meters between the given points
+double MapPosition::computeDistance(const GeoPoint &origin, const GeoPoint &target)
+{
+  double latDist = FloatingPoint::degree2rad(target.lat - origin.lat);
+  double lngDist = FloatingPoint::degree2rad(target.lng - origin.lng);
+  return computeHaversineDistance(latDist, lngDist, cos(FloatingPoint::degree2rad(origin.lat)), cos(FloatingPoint::degree2rad(target.lat)), earthRadius);
+}
+
+// Computes the distances in meters between consecutive points (distances[i] is the one from points[i] to points[i+1])
+void MapPosition::computeDistances(const GeoPoint *points, Int count, double *distances) {
+  if (count<2)
+    return;
+  double cosOriginLat = cos(FloatingPoint::degree2rad(points[0].lat));
+  for (Int i=0;i<count-1;i++) {
+    double cosTargetLat = cos(FloatingPoint::degree2rad(points[i+1].lat));
+    double latDist = FloatingPoint::degree2rad(points[i+1].lat - points[i].lat);
+    double lngDist = FloatingPoint::degree2rad(points[i+1].lng - points[i].lng);
+    distances[i] = computeHaversineDistance(latDist, lngDist, cosOriginLat, cosTargetLat, earthRadius);
+    cosOriginLat = cosTargetLat;
+  }
+}
+
+// Computes the distances in meters from all points to the given target
+void MapPosition::computeDistances(const GeoPoint *points, Int count, const GeoPoint &target, double *distances) {
+  double cosTargetLat = cos(FloatingPoint::degree2rad(target.lat));
+  for (Int i=0;i<count;i++) {
+    double latDist = FloatingPoint::degree2rad(target.lat - points[i].lat);
+    double lngDist = FloatingPoint::degree2rad(target.lng - points[i].lng);
+    distances[i] = computeHaversineDistance(latDist, lngDist, cos(FloatingPoint::degree2rad(points[i].lat)), cosTargetLat, earthRadius);
+  }
+}
+
+// Computes the bearings in degrees from the given origin to all points
+void MapPosition::computeBearings(const GeoPoint &origin, const GeoPoint *points, Int count, double *bearings) {
+  double originLatRad = FloatingPoint::degree2rad(origin.lat);
+  double originLngRad = FloatingPoint::degree2rad(origin.lng);
+  double sinOriginLat = sin(originLatRad);
+  double cosOriginLat = cos(originLatRad);
+  for (Int i=0;i<count;i++) {
+    bearings[i] = computeBearingRad(originLatRad, originLngRad, sinOriginLat, cosOriginLat,
+                                    FloatingPoint::degree2rad(points[i].lat), FloatingPoint::degree2rad(points[i].lng));
+  }
+}
+
+// Computes the normal distances of a location to path segments that lie around the location
+void MapPosition::computeNormalDistances(const double *segmentLengths, const double *startDistances, const double *endDistances, Int count, double *distances) {
+  for (Int i=0;i<count;i++) {
+    double a = segmentLengths[i];
+    double b = startDistances[i];
+    double c = endDistances[i];
+    double distance = std::numeric_limits<double>::max();
+    if ((a!=0.0)&&(b!=0.0)&&(c!=0.0)) {
+      double t = 2*a*c;
+      t = (a*a+c*c-b*b)/t;
+      double alpha;
+      if (t>=1)
+        alpha=0;
+      else
+        alpha=acos(t);
+      distance = sin(alpha)*c;
+      t = 2*a*b;
+      t = (a*a+b*b-c*c)/t;
+      double beta;
+      if (t>=1)
+        beta=0;
+      else
+        beta=acos(t);
+      if ((fabs(alpha)>M_PI_2)||(fabs(beta)>M_PI_2))
+        distance=std::numeric_limits<double>::max();
+    }
+    distances[i]=distance;
+  }
+}
+
 // Store the contents of the object in a binary file
 void MapPosition::store(std::ofstream *ofs)
 {
@@ -32,6 +32,12 @@ extern const char *GPX10Namespace;
 extern const char *GPX11Namespace;
 extern const char *GDNamespace;
 
+// Geographic coordinate without any further attributes
+typedef struct GeoPoint {
+  double lat;                                       // WGS84 Latitude in degrees
+  double lng;                                       // WGS84 Longitude in degrees
+} GeoPoint;
+
 class MapPosition {
 
 protected:
@@ -87,10 +93,30 @@ public:
   MapPosition computeTarget(double bearing, double distance);
 
   // Computes the bearing in degrees clockwise from north (0°) to the given destination point
-  double computeBearing(MapPosition target);
+  double computeBearing(const MapPosition &target);
 
   // Computes the distance in meters to the given destination point
-  double computeDistance(MapPosition target);
+  double computeDistance(const MapPosition &target);
+
+  // Computes the bearing in degrees clockwise from north (0°) from the origin to the destination point
+  static double computeBearing(const GeoPoint &origin, const GeoPoint &target);
+
+  // Computes the distance in meters between the given points
+  static double computeDistance(const GeoPoint &origin, const GeoPoint &target);
+
+  // Computes the distances in meters between consecutive points (distances[i] is the one from points[i] to points[i+1])
+  static void computeDistances(const GeoPoint *points, Int count, double *distances);
+
+  // Computes the distances in meters from all points to the given target
+  static void computeDistances(const GeoPoint *points, Int count, const GeoPoint &target, double *distances);
+
+  // Computes the bearings in degrees from the given origin to all points
+  static void computeBearings(const GeoPoint &origin, const GeoPoint *points, Int count, double *bearings);
+
+  // Computes the normal distances of a location to path segments that lie around the location
+  // The triangle of each segment is given by its length and the distances from the location to its start and end
+  // Segments whose normal does not hit them get the maximum double value
+  static void computeNormalDistances(const double *segmentLengths, const double *startDistances, const double *endDistances, Int count, double *distances);
 
   // Compute the normal distance from the locationPos to the vector spanned from the prevPos and this pos
   double computeNormalDistance(MapPosition prevPos, MapPosition locationPos, double overlapInMeters, bool insideOnly, bool debugMsgs=false, MapPosition *normalPos=NULL);
@@ -132,6 +158,17 @@ public:
   void setFromMercatorTileXY(Int zoomLevel, Int x, Int y);
 
   // Getters and setters
+  static double getEarthRadius() {
+    return earthRadius;
+  }
+
+  GeoPoint getGeoPoint() const {
+    GeoPoint p;
+    p.lat=lat;
+    p.lng=lng;
+    return p;
+  }
+
   bool getIsUpdated() const {
     return isUpdated;
   }
@@ -325,6 +362,11 @@ public:
       this->hasSpeed = hasSpeed;
   }
 
+  void setHasTimestamp(bool hasTimestamp)
+  {
+      this->hasTimestamp = hasTimestamp;
+  }
+
   bool getIsWGS84Altitude() const
   {
       return isWGS84Altitude;
@@ -72,6 +72,7 @@ MapSource::MapSource() {
   remoteServerThreadInfo=NULL;
   resetRemoteServerThread=false;
   recreateMapArchiveFiles=true;
+  mapArchiveIndexRetrieved=false;
 }
 
 MapSource::~MapSource() {
@@ -109,6 +110,14 @@ void MapSource::deinit()
     delete *i;
   }
   mapArchives.clear();
+  for(std::unordered_map<std::string, ZipArchiveReader*>::iterator i=mapArchiveReaders.begin();i!=mapArchiveReaders.end();i++) {
+    if (i->second)
+      delete i->second;
+  }
+  mapArchiveReaders.clear();
+  storeMapArchiveIndex();
+  mapArchiveIndex.clear();
+  mapArchiveIndexRetrieved=false;
   GraphicObject *pathAnimators=core->getDefaultGraphicEngine()->lockPathAnimators(__FILE__, __LINE__);
   for (std::list<GraphicPrimitiveKey>::iterator i=retrievedPathAnimators.begin();i!=retrievedPathAnimators.end();i++) {
     pathAnimators->removePrimitive(*i,true);
@@ -549,8 +558,10 @@ MapContainer *MapSource::findMapContainerByGeographicCoordinate(MapPosition pos,
       &&(currentMapContainer->getLngEast() >=pos.getLng())&&(currentMapContainer->getLngWest() <=pos.getLng())) {
 
     // Compute the position in this map
+    // Containers with damaged index records have no calibrator and are skipped
     bool overflowOccured=false;
-    overflowOccured=!(currentMapContainer->getMapCalibrator()->setPictureCoordinates(pos));
+    MapCalibrator *mapCalibrator=currentMapContainer->getMapCalibrator();
+    overflowOccured=(!mapCalibrator)||(!mapCalibrator->setPictureCoordinates(pos));
     if (!overflowOccured) {
 
       // Check if the position lies in this map
@@ -717,7 +728,8 @@ MapContainer *MapSource::findMapContainerByGeographicArea(MapArea area, MapTile
         // Compute the boundaries of the map within the area
         bool overflowOccured=false;
         MapPosition pos=area.getRefPos();
-        overflowOccured=!(currentMapContainer->getMapCalibrator()->setPictureCoordinates(pos));
+        MapCalibrator *mapCalibrator=currentMapContainer->getMapCalibrator();
+        overflowOccured=(!mapCalibrator)||(!mapCalibrator->setPictureCoordinates(pos));
         MapArea translatedArea=area;
         if (!overflowOccured) {
           translatedArea.setRefPos(pos);
@@ -900,6 +912,11 @@ std::list<MapContainer*> MapSource::findMapContainersByGeographicCoordinate(MapP
 
 // Performs maintenance tasks
 void MapSource::maintenance() {
+
+  // Write the archive index such that a crash does not loose it
+  lockMapArchives(__FILE__,__LINE__);
+  storeMapArchiveIndex();
+  unlockMapArchives();
 }
 
 // Recreates the search data structures
@@ -1402,6 +1419,7 @@ void MapSource::remoteServer() {
               if (preferredNeighbor) {
                 FATAL("two map containers use same calibration path",NULL);
               }
+              (*i)->load();
               std::vector<MapTile*> *tiles=(*i)->getMapTiles();
               for (std::vector<MapTile*>::iterator j=tiles->begin();j!=tiles->end();j++) {
                 if (((*j)->getMapX()==mapX)&&((*j)->getMapY()==mapY)) {
@@ -1864,6 +1882,103 @@ UByte *MapSource::fetchMapTile(Int z, Int x, Int y, double saturationOffset, dou
 
 // Inserts the new map archive file into the file list
 void MapSource::updateMapArchiveFiles(std::string filePath) {  
+  lockMapArchives(__FILE__, __LINE__);
+  updateMapArchiveIndex(filePath);
+  unlockMapArchives();
+}
+
+// Adds an opened archive to the map archives (map archives must be locked)
+void MapSource::insertMapArchive(ZipArchive *mapArchive) {
+  mapArchives.push_back(mapArchive);
+  updateMapArchiveIndex(mapArchive->getArchiveFolder()+"/"+mapArchive->getArchiveName());
+}
+
+// Updates the index with the entries of the archive (map archives must be locked)
+void MapSource::updateMapArchiveIndex(std::string archiveFilePath) {
+  if (!mapArchiveIndexRetrieved) {
+    mapArchiveIndex.retrieve(getFolderPath()+"/archiveIndex.bin");
+    mapArchiveIndexRetrieved=true;
+  }
+  mapArchiveIndex.updateArchive(archiveFilePath);
+}
+
+// Writes the index if it has changed (map archives must be locked)
+void MapSource::storeMapArchiveIndex() {
+  if ((mapArchiveIndexRetrieved)&&(mapArchiveIndex.getChanged()))
+    mapArchiveIndex.store(getFolderPath()+"/archiveIndex.bin");
+}
+
+// Removes the entries of the archive from the index (map archives must be locked)
+void MapSource::removeFromMapArchiveIndex(std::string archiveFilePath) {
+  mapArchiveIndex.removeArchive(archiveFilePath);
+}
+
+// Returns the path of the archive that contains the entry (map archives must be locked)
+std::string MapSource::findMapArchive(std::string entryPath) {
+  return mapArchiveIndex.findArchive(entryPath);
+}
+
+// Returns a reader for the archive that contains the entry (map archives must be locked)
+ZipArchiveReader *MapSource::findMapArchiveReader(std::string archiveFilePath, std::string entryPath, ZipArchiveReader *&temporaryReader) {
+  temporaryReader=NULL;
+
+  // Try the expected archive first and then the one from the index
+  ZipArchiveReader *reader=getMapArchiveReader(archiveFilePath);
+  if ((reader)&&(reader->hasEntry(entryPath)))
+    return reader;
+  std::string indexedArchiveFilePath=findMapArchive(entryPath);
+  if (indexedArchiveFilePath!="") {
+    if (indexedArchiveFilePath!=archiveFilePath) {
+      reader=getMapArchiveReader(indexedArchiveFilePath);
+      if ((reader)&&(reader->hasEntry(entryPath)))
+        return reader;
+    }
+    archiveFilePath=indexedArchiveFilePath;
+  }
+
+  // Open the archive only for this access if the map source does not keep it open
+  if (access(archiveFilePath.c_str(),F_OK)==-1)
+    return NULL;
+  size_t pos=archiveFilePath.find_last_of("/");
+  if (pos==std::string::npos)
+    reader=new ZipArchiveReader(".",archiveFilePath);
+  else
+    reader=new ZipArchiveReader(archiveFilePath.substr(0,pos),archiveFilePath.substr(pos+1));
+  if (!reader)
+    FATAL("can not create zip archive reader object",NULL);
+  if ((!reader->init())||(!reader->hasEntry(entryPath))) {
+    delete reader;
+    return NULL;
+  }
+  temporaryReader=reader;
+  return reader;
+}
+
+// Returns the reader for one of the map archives (map archives must be locked)
+ZipArchiveReader *MapSource::getMapArchiveReader(std::string archiveFilePath) {
+
+  // Already opened?
+  std::unordered_map<std::string, ZipArchiveReader*>::iterator i=mapArchiveReaders.find(archiveFilePath);
+  if (i!=mapArchiveReaders.end())
+    return i->second;
+
+  // Only the archives that are kept open by the map source get a reader
+  // The reader stays valid until the map source is deinitialized
+  ZipArchiveReader *mapArchiveReader=NULL;
+  for (std::list<ZipArchive*>::iterator j=mapArchives.begin();j!=mapArchives.end();j++) {
+    if ((*j)->getArchiveFolder()+"/"+(*j)->getArchiveName()==archiveFilePath) {
+      mapArchiveReader=new ZipArchiveReader((*j)->getArchiveFolder(),(*j)->getArchiveName());
+      if (!mapArchiveReader)
+        FATAL("can not create zip archive reader object",NULL);
+      if (!mapArchiveReader->init()) {
+        delete mapArchiveReader;
+        mapArchiveReader=NULL;
+      }
+      mapArchiveReaders[archiveFilePath]=mapArchiveReader;
+      break;
+    }
+  }
+  return mapArchiveReader;
 }
 
 
@@ -24,6 +24,7 @@
 #include <MapDownloader.h>
 #include <MapContainer.h>
 #include <MapArchiveFile.h>
+#include <MapArchiveIndex.h>
 
 #ifndef MAPSOURCE_H_
 #define MAPSOURCE_H_
@@ -42,6 +43,9 @@ protected:
   std::string folder;                             // Folder that contains the map data
   std::list<ZipArchive*> mapArchives;             // Zip archives that contain the calibrated maps
   ThreadMutexInfo *mapArchivesMutex;              // Mutex to access the map archives
+  std::unordered_map<std::string, ZipArchiveReader*> mapArchiveReaders; // Memory mapped views of the map archives indexed by their path
+  MapArchiveIndex mapArchiveIndex;                // Remembers which map archive contains which entry
+  bool mapArchiveIndexRetrieved;                  // Indicates if the stored map archive index has been read
   double neighborPixelTolerance ;                 // Maximum allowed difference in pixels to classify a tile as a neighbor
   std::vector<MapContainer*> mapContainers;       // Vector of all maps
   MapPosition *centerPosition;                    // Center position of the map
@@ -258,6 +262,28 @@ public:
   // Inserts the new map archive file into the file list
   virtual void updateMapArchiveFiles(std::string filePath);
 
+  // Returns the reader for one of the map archives (map archives must be locked)
+  ZipArchiveReader *getMapArchiveReader(std::string archiveFilePath);
+
+  // Adds an opened archive to the map archives (map archives must be locked)
+  void insertMapArchive(ZipArchive *mapArchive);
+
+  // Updates the index with the entries of the archive (map archives must be locked)
+  void updateMapArchiveIndex(std::string archiveFilePath);
+
+  // Writes the index if it has changed (map archives must be locked)
+  void storeMapArchiveIndex();
+
+  // Removes the entries of the archive from the index (map archives must be locked)
+  void removeFromMapArchiveIndex(std::string archiveFilePath);
+
+  // Returns the path of the archive that contains the entry (map archives must be locked)
+  std::string findMapArchive(std::string entryPath);
+
+  // Returns a reader for the archive that contains the entry (map archives must be locked)
+  // If the archive is not kept open, the reader is also returned in temporaryReader and must be deleted after use
+  ZipArchiveReader *findMapArchiveReader(std::string archiveFilePath, std::string entryPath, ZipArchiveReader *&temporaryReader);
+
   // Getters and setters
   Int getMapTileLength() const {
     return mapTileLength;
@@ -23,20 +23,33 @@
 #include <Core.h>
 #include <MapSourceCalibratedPictures.h>
 #include <MapPosition.h>
-#include <Storage.h>
+#include <MapIndex.h>
 
 namespace GEODISCOVERER {
 
+// Calibration file read thread
+void *mapSourceCalibratedPicturesReadThread(void *args) {
+  MapSourceCalibratedPictures *mapSource = (MapSourceCalibratedPictures*)args;
+  mapSource->readCalibrationFiles();
+  return NULL;
+}
+
 MapSourceCalibratedPictures::MapSourceCalibratedPictures(std::list<std::string> mapArchivePaths)  : MapSource() {
   type=MapSourceTypeCalibratedPictures;
-  cacheData=NULL;
+  mapIndex=NULL;
+  readMutex=NULL;
+  readSignal=NULL;
+  readStartedThreads=0;
+  readNext=0;
+  readFinished=0;
+  readFailed=false;
   this->mapArchivePaths=mapArchivePaths;
 }
 
 MapSourceCalibratedPictures::~MapSourceCalibratedPictures() {
   deinit();
-  if (cacheData) {
-    free(cacheData);
+  if (mapIndex) {
+    delete mapIndex;
   }
 }
 
@@ -54,7 +67,7 @@ void MapSourceCalibratedPictures::deinit()
 }
 
 // Loads all calibrated pictures in the given directory
-bool MapSourceCalibratedPictures::collectMapTiles(std::string directory, std::list<std::vector<std::string> > &mapFilebases)
+bool MapSourceCalibratedPictures::collectMapTiles(std::string directory, std::unordered_set<std::string> &unchangedArchivePaths, std::list<std::vector<std::string> > &mapFilebases)
 {
   std::string filename;
 
@@ -94,6 +107,10 @@ bool MapSourceCalibratedPictures::collectMapTiles(std::string directory, std::li
         unlink(gdsFilename.c_str());
       }
 
+      // The calibration files of unchanged archives are already known
+      if (unchangedArchivePaths.find(getArchivePath(*i))!=unchangedArchivePaths.end())
+        continue;
+
       // If this file is not a calibration file, skip it
       Int pos=filename.find_last_of(".");
       std::string extension=filename.substr(pos+1);
@@ -117,6 +134,191 @@ bool MapSourceCalibratedPictures::collectMapTiles(std::string directory, std::li
   return true;
 }
 
+// Returns the path of the archive in the same way the map containers store it
+std::string MapSourceCalibratedPictures::getArchivePath(ZipArchive *mapArchive) {
+  if (mapArchive->getArchiveFolder()==".")
+    return mapArchive->getArchiveName();
+  else
+    return mapArchive->getArchiveFolder() + "/" + mapArchive->getArchiveName();
+}
+
+// Clears everything that is computed from all containers
+void MapSourceCalibratedPictures::clearSearchDataStructures() {
+  for(std::vector<MapContainerTreeNode*>::iterator i=zoomLevelSearchTrees.begin();i!=zoomLevelSearchTrees.end();i++) {
+    if (*i)
+      delete *i;
+  }
+  zoomLevelSearchTrees.clear();
+  if (centerPosition) {
+    MapPosition::destruct(centerPosition);
+    centerPosition=NULL;
+  }
+  mapLayerNameMap.clear();
+}
+
+// Keeps the containers of unchanged archives from the map index and drops the rest
+bool MapSourceCalibratedPictures::retrieveUnchangedArchives(std::unordered_map<std::string, struct stat> &mapArchiveStats, std::unordered_set<std::string> &unchangedArchivePaths) {
+
+  // Find the archives whose stamp still matches
+  for (UInt i=0;i<mapIndex->getHeader()->archiveCount;i++) {
+    const MapIndexArchive *archive=mapIndex->getArchive(i);
+    std::string path=mapIndex->getString(archive->path);
+    std::unordered_map<std::string, struct stat>::iterator j=mapArchiveStats.find(path);
+    if ((j!=mapArchiveStats.end())&&(j->second.st_mtime==archive->modificationTime)&&(j->second.st_size==archive->size))
+      unchangedArchivePaths.insert(path);
+  }
+  // Archives that were added or removed also require the index to be rebuilt
+  if ((unchangedArchivePaths.size()==mapArchiveStats.size())&&(unchangedArchivePaths.size()==mapIndex->getHeader()->archiveCount))
+    return true;
+  DEBUG("%d of %d archives in the map index are unchanged and %d archives exist",(Int)unchangedArchivePaths.size(),(Int)mapIndex->getHeader()->archiveCount,(Int)mapArchiveStats.size());
+
+  // Read the containers of the unchanged archives completely such that the index can be replaced
+  // The zoom levels are converted back to the ones of the map for the new normalization
+  std::vector<MapContainer*> unchangedMapContainers;
+  for (std::vector<MapContainer*>::iterator i=mapContainers.begin();i!=mapContainers.end();i++) {
+    MapContainer *c=*i;
+    if (unchangedArchivePaths.find(c->getArchiveFilePath())!=unchangedArchivePaths.end()) {
+      if (!c->detach())
+        return false;
+      unchangedMapContainers.push_back(c);
+    }
+  }
+  for (std::vector<MapContainer*>::iterator i=mapContainers.begin();i!=mapContainers.end();i++) {
+    MapContainer *c=*i;
+    if (unchangedArchivePaths.find(c->getArchiveFilePath())!=unchangedArchivePaths.end())
+      c->setZoomLevelMap(c->getZoomLevelMap()+minZoomLevel-1);
+    else
+      MapContainer::destruct(c);
+  }
+  mapContainers=unchangedMapContainers;
+
+  // Clear everything that is computed from all containers
+  clearSearchDataStructures();
+  return true;
+}
+
+// Reads calibration files until all are processed (called by the read threads)
+void MapSourceCalibratedPictures::readCalibrationFiles() {
+
+  // Create and use the calibrators with the resources of this thread
+  core->getThread()->lockMutex(readMutex,__FILE__,__LINE__);
+  MapCalibrator::setThreadContext(readThreadContexts[readStartedThreads]);
+  readStartedThreads++;
+  core->getThread()->unlockMutex(readMutex);
+  while (true) {
+
+    // Get the next file to read
+    core->getThread()->lockMutex(readMutex,__FILE__,__LINE__);
+    if ((readFailed)||(readNext>=readMapFilebases.size())||(core->getQuitCore())) {
+      core->getThread()->unlockMutex(readMutex);
+      break;
+    }
+    Int index=readNext;
+    readNext++;
+    std::vector<std::string> mapFilebase=readMapFilebases[index];
+    core->getThread()->unlockMutex(readMutex);
+
+    // Create a new map container and read the calibration in
+    std::string filebase=mapFilebase[2];
+    std::string extension=mapFilebase[3];
+    MapContainer *mapContainer=new MapContainer();
+    if (!mapContainer) {
+      FATAL("can not create map container",NULL);
+      return;
+    }
+    mapContainer->setArchiveFileFolder(mapFilebase[0]);
+    mapContainer->setArchiveFileName(mapFilebase[1]);
+    bool success=mapContainer->readCalibrationFile(std::string(dirname((char*)filebase.c_str())),std::string(basename((char*)filebase.c_str())),extension);
+    //DEBUG("archiveFileFolder=%s archiveFileName=%s archiveFilePath=%s",mapContainer->getArchiveFileFolder().c_str(),mapContainer->getArchiveFileName().c_str(),mapContainer->getArchiveFilePath().c_str());
+
+    // Remember the container at the position of its file
+    core->getThread()->lockMutex(readMutex,__FILE__,__LINE__);
+    if (success) {
+      readMapContainers[index]=mapContainer;
+    } else {
+      delete mapContainer;
+      readFailed=true;
+    }
+    readFinished++;
+    core->getThread()->unlockMutex(readMutex);
+    core->getThread()->issueSignal(readSignal);
+  }
+  MapCalibrator::setThreadContext(NULL);
+  core->getThread()->issueSignal(readSignal);
+}
+
+// Reads the calibration files with multiple threads and adds the containers in the order of the files
+bool MapSourceCalibratedPictures::readCalibrationFiles(std::list<std::vector<std::string> > &mapFilebases, std::string title, DialogKey dialog) {
+
+  // Prepare the work
+  readMapFilebases.assign(mapFilebases.begin(),mapFilebases.end());
+  readMapContainers.assign(readMapFilebases.size(),NULL);
+  readNext=0;
+  readFinished=0;
+  readFailed=false;
+  readMutex=core->getThread()->createMutex("map source calibrated pictures read mutex");
+  readSignal=core->getThread()->createSignal();
+
+  // Start the threads
+  TimestampInMicroseconds readStartTime=core->getClock()->getMicrosecondsSinceStart();
+  Int numberOfReadThreads=core->getConfigStore()->getIntValue("Map","numberOfCalibrationReadThreads",__FILE__, __LINE__);
+  if (numberOfReadThreads<1)
+    numberOfReadThreads=1;
+  for (Int i=0;i<numberOfReadThreads;i++)
+    readThreadContexts.push_back(MapCalibrator::createThreadContext());
+  std::vector<ThreadInfo*> readThreadInfos;
+  for (Int i=0;i<numberOfReadThreads;i++) {
+    std::stringstream threadName;
+    threadName << "map source calibrated pictures read thread " << i;
+    ThreadInfo *threadInfo=core->getThread()->createThread(threadName.str(),mapSourceCalibratedPicturesReadThread,this);
+    if (threadInfo)
+      readThreadInfos.push_back(threadInfo);
+  }
+
+  // Update the progress until no thread is working anymore
+  while (true) {
+    core->getThread()->waitForSignal(readSignal);
+    core->getThread()->lockMutex(readMutex,__FILE__,__LINE__);
+    Int finished=readFinished;
+    bool done=(readFinished==readNext)&&((readFailed)||(readNext>=readMapFilebases.size())||(core->getQuitCore()));
+    core->getThread()->unlockMutex(readMutex);
+    core->getDialog()->updateProgress(dialog,title,finished);
+    if (done)
+      break;
+  }
+  for (std::vector<ThreadInfo*>::iterator i=readThreadInfos.begin();i!=readThreadInfos.end();i++) {
+    core->getThread()->waitForThread(*i);
+    core->getThread()->destroyThread(*i);
+  }
+  core->getThread()->destroySignal(readSignal);
+  core->getThread()->destroyMutex(readMutex);
+  readSignal=NULL;
+  readMutex=NULL;
+  double readDuration=(double)(core->getClock()->getMicrosecondsSinceStart()-readStartTime)/1000000.0;
+  DEBUG("read %d calibration files with %d threads in %.1f s (%.0f files/s)",readFinished,(Int)readThreadInfos.size(),readDuration,(readDuration>0)?readFinished/readDuration:0.0);
+
+  // Add the containers in the order of the files such that the result does not depend on the threads
+  // Their calibrators stop using the resources of the read threads before these are freed
+  bool result=(!readFailed)&&(readFinished==readMapFilebases.size());
+  Int i=0;
+  for (;(i<readMapContainers.size())&&(readMapContainers[i]!=NULL);i++) {
+    readMapContainers[i]->getMapCalibrator()->releaseThreadContext();
+    mapContainers.push_back(readMapContainers[i]);
+  }
+  for (;i<readMapContainers.size();i++) {
+    if (readMapContainers[i])
+      delete readMapContainers[i];
+  }
+  for (std::vector<MapCalibratorThreadContext*>::iterator j=readThreadContexts.begin();j!=readThreadContexts.end();j++)
+    MapCalibrator::destroyThreadContext(*j);
+  readThreadContexts.clear();
+  readMapFilebases.clear();
+  readMapContainers.clear();
+  if ((!result)&&(core->getQuitCore()))
+    DEBUG("cache retrieve aborted because core quit requested",NULL);
+  return result;
+}
+
 // Initializes the source
 bool MapSourceCalibratedPictures::init()
 {
@@ -125,77 +327,19 @@ bool MapSourceCalibratedPictures::init()
   MapContainer *mapContainer;
   bool result;
   std::list<std::vector<std::string> > mapFilebases;
-  std::ofstream ofs;
-  std::ifstream ifs;
-  //FILE *in;
-  struct stat mapFolderStat,mapCacheStat,mapArchiveStat;
+  struct stat mapCacheStat,mapArchiveStat;
   bool cacheRetrieved;
   std::string title;
   std::string mapPath=getFolderPath();
-  std::string cacheFilepath=mapPath+"/cache.bin";
+  std::string cacheFilepath=mapPath+"/index.bin";
   ZipArchive *mapArchive;
   std::string mapArchiveDir;
   std::string mapArchiveFile;
   char *mapArchivePathCStr = NULL;
   Int progress;
   DialogKey dialog;
-
-  // Check if we can use the cache
-  cacheRetrieved=false;
-  if (((core->statFile(mapPath,&mapFolderStat))==0)&&(core->statFile(cacheFilepath,&mapCacheStat)==0)) {
-
-    // Is the cache newer than the folder?
-    bool isOlder=false;
-    if (mapCacheStat.st_mtime<mapFolderStat.st_mtime) {
-      isOlder=true;
-    }
-    for(std::list<std::string>::iterator i=mapArchivePaths.begin();i!=mapArchivePaths.end();i++) {
-      if (core->statFile((*i),&mapArchiveStat)==0) {
-        if (mapCacheStat.st_mtime<mapArchiveStat.st_mtime) {
-          isOlder=true;
-        }
-      }
-    }
-    if (!isOlder) {
-
-      // Load the cache
-      ifs.open(cacheFilepath.c_str(),std::ios::binary);
-      if (ifs.fail()) {
-      //if (!(in=fopen(cacheFilepath.c_str(),"r"))) {
-        remove(cacheFilepath.c_str());
-        WARNING("can not open <%s> for reading",cacheFilepath.c_str());
-      } else {
-
-        // Load the complete file into memory
-        if (!(cacheData=(char*)malloc(mapCacheStat.st_size+1))) {
-          FATAL("can not allocate memory for cache",NULL);
-          return false;
-        }
-        ifs.read(cacheData,mapCacheStat.st_size);
-        ifs.close();
-        //fread(cache,mapCacheStat.st_size,1,in);
-        //fclose(in);
-        cacheData[mapCacheStat.st_size]=0; // to prevent that strings never end
-        Int cacheSize=mapCacheStat.st_size;
-
-        // Retrieve the objects
-        char *cacheData2=cacheData;
-        bool success = MapSourceCalibratedPictures::retrieve(this,cacheData2,cacheSize,folder);
-        if ((cacheSize!=0)||(!success)) {
-          remove(cacheFilepath.c_str());
-          deinit();
-          if (core->getQuitCore()) {
-            DEBUG("cache retrieve aborted because core quit requested",NULL);
-            result=false;
-            goto cleanup;
-          }
-          WARNING("falling back to full map read because cache is corrupted",NULL);
-        } else {
-          cacheRetrieved=true;
-        }
-      }
-    }
-  }
+  std::unordered_map<std::string, struct stat> mapArchiveStats;
+  std::unordered_set<std::string> unchangedArchivePaths;
 
   // Open the zip archive that contains the maps
   title="Reading tiles of map " + folder;
@@ -219,13 +363,56 @@ bool MapSourceCalibratedPictures::init()
       result=false;
       goto cleanup;
     }
-    mapArchives.push_back(mapArchive);
+    insertMapArchive(mapArchive);
+
+    // Remember the stamp of the archive to detect changes at the next start
+    if (core->statFile(mapArchivePath,&mapArchiveStat)==0)
+      mapArchiveStats[getArchivePath(mapArchive)]=mapArchiveStat;
     progress++;
     core->getDialog()->updateProgress(dialog,title,progress);
   }
   unlockMapArchives();
   core->getDialog()->closeProgress(dialog);
 
+  // The cache of previous versions is replaced by the index
+  remove((mapPath+"/cache.bin").c_str());
+
+  // Check if we can use the index
+  // Only the containers of archives that have changed since the index was written are read again
+  cacheRetrieved=false;
+  if (core->statFile(cacheFilepath,&mapCacheStat)==0) {
+
+    // Map the index into memory and create the containers from it
+    if (!(mapIndex=new MapIndex())) {
+      FATAL("can not create map index object",NULL);
+      return false;
+    }
+    if ((!mapIndex->open(cacheFilepath))||(!MapSourceCalibratedPictures::retrieve(this,mapIndex,folder))||(!retrieveUnchangedArchives(mapArchiveStats,unchangedArchivePaths))) {
+      remove(cacheFilepath.c_str());
+      for (std::vector<MapContainer*>::const_iterator i=mapContainers.begin();i!=mapContainers.end();i++) {
+        MapContainer::destruct(*i);
+      }
+      mapContainers.clear();
+      clearSearchDataStructures();
+      unchangedArchivePaths.clear();
+      delete mapIndex;
+      mapIndex=NULL;
+      if (core->getQuitCore()) {
+        DEBUG("cache retrieve aborted because core quit requested",NULL);
+        result=false;
+        goto cleanup;
+      }
+      WARNING("falling back to full map read because map index can not be used",NULL);
+    } else if ((unchangedArchivePaths.size()==mapArchiveStats.size())&&(unchangedArchivePaths.size()==mapIndex->getHeader()->archiveCount)) {
+      cacheRetrieved=true;
+    } else {
+
+      // The containers of the unchanged archives do not need the index anymore
+      delete mapIndex;
+      mapIndex=NULL;
+    }
+  }
+
   // Could the cache not be loaded?
   if (!cacheRetrieved) {
 
@@ -236,8 +423,8 @@ bool MapSourceCalibratedPictures::init()
     std::string title="Collecting files of map " + std::string(folder);
     DialogKey dialog=core->getDialog()->createProgress(title,0);
 
-    // Go through all calibration files in the map directory
-    if (!collectMapTiles(mapPath,mapFilebases)) {
+    // Go through all calibration files in the changed archives
+    if (!collectMapTiles(mapPath,unchangedArchivePaths,mapFilebases)) {
       result=false;
       goto cleanup;
     }
@@ -255,9 +442,14 @@ bool MapSourceCalibratedPictures::init()
       goto cleanup;
     }
 
-    // Create the progress dialog
+    // Read the calibration files
     title="Reading files of map " + std::string(folder);
     dialog=core->getDialog()->createProgress(title,mapFilebases.size());
+    if (!readCalibrationFiles(mapFilebases,title,dialog)) {
+      core->getDialog()->closeProgress(dialog);
+      result=false;
+      goto cleanup;
+    }
 
     // Init variables
     centerPosition=new MapPosition();
@@ -267,46 +459,11 @@ bool MapSourceCalibratedPictures::init()
     centerPosition->setLatScale(std::numeric_limits<double>::max());
     centerPosition->setLngScale(std::numeric_limits<double>::max());
 
-    // Go through all found maps
-    Int progress=1;
+    // Go through the containers of all archives
     Int maxZoomLevel=std::numeric_limits<Int>::min();
     Int minZoomLevel=std::numeric_limits<Int>::max();
-    //DEBUG("mapContainers.size()=%d",mapContainers.size());
-    for (std::list<std::vector<std::string> >::const_iterator i=mapFilebases.begin();i!=mapFilebases.end();i++) {
-
-      std::string filebase=(*i)[2];
-      std::string extension=(*i)[3];
-      std::string filepath=filebase + "." + extension;
-
-      // Shall we stop?
-      if (core->getQuitCore()) {
-        DEBUG("cache retrieve aborted because core quit requested",NULL);
-        result=false;
-        goto cleanup;
-      }
-
-      // Output some info
-      Int percentage=round(((double)progress*100)/(double)mapFilebases.size());
-      //INFO("reading map <%s> (%d%%)", filepath.c_str(), percentage);
-      core->getDialog()->updateProgress(dialog,title,progress);
-      progress++;
-
-      // Create a new map container and read the calibration in
-      mapContainer=new MapContainer();
-      if (!mapContainer) {
-        FATAL("can not create map container",NULL);
-        result=false;
-        goto cleanup;
-      }
-      mapContainer->setArchiveFileFolder((*i)[0]);
-      mapContainer->setArchiveFileName((*i)[1]);
-      if (!(mapContainer->readCalibrationFile(std::string(dirname((char*)filebase.c_str())),std::string(basename((char*)filebase.c_str())),extension))) {
-        result=false;
-        delete mapContainer;
-        goto cleanup;
-      }
-      //DEBUG("archiveFileFolder=%s archiveFileName=%s archiveFilePath=%s",mapContainer->getArchiveFileFolder().c_str(),mapContainer->getArchiveFileName().c_str(),mapContainer->getArchiveFilePath().c_str());
-      mapContainers.push_back(mapContainer);
+    for(std::vector<MapContainer*>::iterator i=mapContainers.begin();i!=mapContainers.end();i++) {
+      mapContainer=*i;
 
       // Remember the map with the lowest scale
       if ((mapContainer->getLatScale()<centerPosition->getLatScale())&&(mapContainer->getLngScale()<centerPosition->getLngScale())) {
@@ -378,18 +535,7 @@ bool MapSourceCalibratedPictures::init()
     // Store the map source contents for fast retrieval later
     title="Writing cache for map " + std::string(folder);
     dialog=core->getDialog()->createProgress(title,0);
-    ofs.open(cacheFilepath.c_str(),std::ios::binary);
-    if (ofs.fail()) {
-      WARNING("can not open <%s> for writing",cacheFilepath.c_str());
-      remove(cacheFilepath.c_str());
-    } else {
-      store(&ofs);
-      if (ofs.bad()) {
-        WARNING("can not store object into <%s>",cacheFilepath.c_str());
-        remove(cacheFilepath.c_str());
-      }
-      ofs.close();
-    }
+    store(cacheFilepath,mapArchiveStats);
 
     // Close progress
     core->getDialog()->closeProgress(dialog);
@@ -414,235 +560,164 @@ cleanup:
   return result;
 }
 
-// Stores the contents of the search tree in a binary file
-void MapSourceCalibratedPictures::storeSearchTree(std::ofstream *ofs, MapContainerTreeNode *node) {
+// Adds the search tree to the map index and returns the index of the node
+Int MapSourceCalibratedPictures::storeSearchTree(MapIndex *mapIndex, MapContainerTreeNode *node, std::unordered_map<MapContainer*,Int> &containerIndex) {
 
   // Write the node index
-  bool found=false;
-  for (int i=0;i<mapContainers.size();i++) {
-    if (node->getContents()==mapContainers[i]) {
-      Storage::storeInt(ofs,i);
-      found=true;
-      break;
-    }
-  }
-  if (!found) {
+  std::unordered_map<MapContainer*,Int>::iterator i=containerIndex.find(node->getContents());
+  if (i==containerIndex.end()) {
     FATAL("could not find tree node for given map container",NULL);
-    return;
-  }
-
-  // Store the left node
-  if (node->getLeftChild()==NULL) {
-    Storage::storeBool(ofs,false);
-  } else {
-    Storage::storeBool(ofs,true);
-    storeSearchTree(ofs,node->getLeftChild());
-  }
-
-  // Store the right node
-  if (node->getRightChild()==NULL) {
-    Storage::storeBool(ofs,false);
-  } else {
-    Storage::storeBool(ofs,true);
-    storeSearchTree(ofs,node->getRightChild());
+    return -1;
   }
-
+  MapIndexTreeNode record;
+  record.container=i->second;
+  record.leftChild=-1;
+  record.rightChild=-1;
+  Int index=mapIndex->storeTreeNode(record);
+
+  // Store the child nodes
+  if (node->getLeftChild()!=NULL)
+    record.leftChild=storeSearchTree(mapIndex,node->getLeftChild(),containerIndex);
+  if (node->getRightChild()!=NULL)
+    record.rightChild=storeSearchTree(mapIndex,node->getRightChild(),containerIndex);
+  mapIndex->updateTreeNode(index,record);
+  return index;
 }
 
-// Store the contents of the object in a binary file
-void MapSourceCalibratedPictures::store(std::ofstream *ofs) {
-
-  Int totalTileCount=0;
+// Writes the contents of the object into the map index file
+void MapSourceCalibratedPictures::store(std::string filePath, std::unordered_map<std::string, struct stat> &mapArchiveStats) {
 
-  // Write the size of the object for detecting changes later
-  Int size=sizeof(*this);
-  Storage::storeInt(ofs,size);
+  MapIndex mapIndex;
 
   // Store all relevant fields
-  centerPosition->store(ofs);
   DEBUG("minZoomLevel=%d maxZoomLevel=%d",minZoomLevel,maxZoomLevel);
-  Storage::storeInt(ofs,minZoomLevel);
-  Storage::storeInt(ofs,maxZoomLevel);
+  mapIndex.storeMapInfo(minZoomLevel,maxZoomLevel,centerPosition->getLat(),centerPosition->getLng(),centerPosition->getLatScale(),centerPosition->getLngScale());
 
   // Store all container objects
-  Storage::storeInt(ofs,mapContainers.size());
+  std::unordered_map<MapContainer*,Int> containerIndex;
   for (int i=0;i<mapContainers.size();i++) {
-    mapContainers[i]->store(ofs);
-    totalTileCount+=mapContainers[i]->getTileCount();
+    mapContainers[i]->store(&mapIndex);
+    containerIndex[mapContainers[i]]=i;
   }
 
   // Store the search trees
-  Storage::storeInt(ofs,zoomLevelSearchTrees.size());
   for (int i=0;i<zoomLevelSearchTrees.size();i++) {
     MapContainerTreeNode *startNode=zoomLevelSearchTrees[i];
     if (startNode) {
-      Storage::storeBool(ofs,true);
-      storeSearchTree(ofs,startNode);
+      mapIndex.storeSearchTree(storeSearchTree(&mapIndex,startNode,containerIndex));
     } else {
-      Storage::storeBool(ofs,false);
+      mapIndex.storeSearchTree(-1);
     }
   }
 
   // Store the map layer names
-  Storage::storeInt(ofs,mapLayerNameMap.size());
   for (MapLayerNameMap::iterator i=mapLayerNameMap.begin();i!=mapLayerNameMap.end();i++) {
-    Storage::storeString(ofs,i->first);
-    Storage::storeInt(ofs,i->second);
+    mapIndex.storeLayerName(i->first,i->second);
   }
 
-  // Store the size for the progress dialog
-  Int progressValueMax=totalTileCount+zoomLevelSearchTrees.size();
-  Storage::storeInt(ofs,progressValueMax);
-  //DEBUG("progressValueMax=%d",progressValueMax);
+  // Store the stamps of the archives
+  for (std::unordered_map<std::string, struct stat>::iterator i=mapArchiveStats.begin();i!=mapArchiveStats.end();i++) {
+    mapIndex.storeArchive(i->first,i->second.st_mtime,i->second.st_size);
+  }
+
+  // Write the file
+  if (!mapIndex.write(filePath))
+    remove(filePath.c_str());
 }
 
-// Reads the contents of the search tree from a binary file
-MapContainerTreeNode *MapSourceCalibratedPictures::retrieveSearchTree(MapSourceCalibratedPictures *mapSource, char *&cacheData, Int &cacheSize) {
+// Creates the search tree from the map index
+MapContainerTreeNode *MapSourceCalibratedPictures::retrieveSearchTree(MapSourceCalibratedPictures *mapSource, MapIndex *mapIndex, Int index, Int depth) {
 
-  // Create a new map container tree node object
-  MapContainerTreeNode *mapContainerTreeNode=new MapContainerTreeNode();
-  if (!mapContainerTreeNode) {
-    DEBUG("can not create map container tree node object",NULL);
+  // A valid tree can not be deeper than the number of its nodes
+  if (depth>mapIndex->getHeader()->treeNodeCount) {
+    DEBUG("search tree contains a cycle, aborting retrieve",NULL);
     return NULL;
   }
 
-  // Read the current node index and update the contents of the tree node
-  Int index;
-  Storage::retrieveInt(cacheData,cacheSize,index);
-  if (index>=mapSource->mapContainers.size()) {
-    DEBUG("node index is out of range, aborting retrieve",NULL);
+  // Create a new map container tree node object
+  MapContainerTreeNode *mapContainerTreeNode=new MapContainerTreeNode();
+  if (!mapContainerTreeNode) {
+    FATAL("can not create map container tree node object",NULL);
     return NULL;
   }
-  mapContainerTreeNode->setContents(mapSource->mapContainers[index]);
-
-  // Read the left node
-  bool hasLeftNode;
-  Storage::retrieveBool(cacheData,cacheSize,hasLeftNode);
-  if (hasLeftNode) {
-    mapContainerTreeNode->setLeftChild(retrieveSearchTree(mapSource,cacheData,cacheSize));
+  const MapIndexTreeNode *record=mapIndex->getTreeNode(index);
+  mapContainerTreeNode->setContents(mapSource->mapContainers[record->container]);
+
+  // Read the child nodes
+  if (record->leftChild>=0) {
+    MapContainerTreeNode *child=retrieveSearchTree(mapSource,mapIndex,record->leftChild,depth+1);
+    if (child==NULL) {
+      delete mapContainerTreeNode;
+      return NULL;
+    }
+    mapContainerTreeNode->setLeftChild(child);
   }
-
-  // Read the right node
-  bool hasRightNode;
-  Storage::retrieveBool(cacheData,cacheSize,hasRightNode);
-  if (hasRightNode) {
-    mapContainerTreeNode->setRightChild(retrieveSearchTree(mapSource,cacheData,cacheSize));
+  if (record->rightChild>=0) {
+    MapContainerTreeNode *child=retrieveSearchTree(mapSource,mapIndex,record->rightChild,depth+1);
+    if (child==NULL) {
+      delete mapContainerTreeNode;
+      return NULL;
+    }
+    mapContainerTreeNode->setRightChild(child);
   }
 
   // Return the node
   return mapContainerTreeNode;
 }
 
-// Reads the contents of the object from a binary file
-bool MapSourceCalibratedPictures::retrieve(MapSourceCalibratedPictures *mapSource, char *&cacheData, Int &cacheSize, std::string folder) {
-
-  //PROFILE_START;
-  bool success=true;
-
-  // Check if the class has changed
-  Int size=sizeof(MapSourceCalibratedPictures);
-#ifdef TARGET_LINUX
-  if (size!=552) {
-    FATAL("unknown size of object (%d), please adapt class storage",size);
-    return false;
-  }
-#endif
+// Creates the containers from the map index
+// Their tiles and calibrators are read when they are used for the first time
+bool MapSourceCalibratedPictures::retrieve(MapSourceCalibratedPictures *mapSource, MapIndex *mapIndex, std::string folder) {
 
-  // Read the size of the object and check with current size
-  size=0;
-  Storage::retrieveInt(cacheData,cacheSize,size);
-  if (size!=sizeof(MapSourceCalibratedPictures)) {
-    DEBUG("stored size of object does not match implemented object size, aborting retrieve",NULL);
+  // Check that the index matches the current configuration
+  const MapIndexHeader *header=mapIndex->getHeader();
+  if ((header->mapTileWidth!=mapSource->getMapTileWidth())||(header->mapTileHeight!=mapSource->getMapTileHeight())) {
+    DEBUG("map index was created for a different tile size, aborting retrieve",NULL);
     return false;
   }
-  //PROFILE_ADD("sanity check");
-
-  // Create a busy dialog
-  core->getMapSource()->openProgress("Reading cache of map " + folder, *((Int*)&cacheData[cacheSize-sizeof(Int)]));
 
   // Read the fields
-  if ((mapSource->centerPosition=MapPosition::retrieve(cacheData,cacheSize))==NULL) {
-    success=false;
-    goto cleanup;
+  if (!(mapSource->centerPosition=new MapPosition())) {
+    FATAL("can not create map position object",NULL);
+    return false;
   }
-  Storage::retrieveInt(cacheData,cacheSize,mapSource->minZoomLevel);
-  Storage::retrieveInt(cacheData,cacheSize,mapSource->maxZoomLevel);
+  mapSource->centerPosition->setLat(header->centerLat);
+  mapSource->centerPosition->setLng(header->centerLng);
+  mapSource->centerPosition->setLatScale(header->centerLatScale);
+  mapSource->centerPosition->setLngScale(header->centerLngScale);
+  mapSource->minZoomLevel=header->minZoomLevel;
+  mapSource->maxZoomLevel=header->maxZoomLevel;
   DEBUG("minZoomLevel=%d maxZoomLevel=%d",mapSource->minZoomLevel,mapSource->maxZoomLevel);
-  //PROFILE_ADD("position retrieve");
-
-  // Read the map containers
-  Storage::retrieveInt(cacheData,cacheSize,size);
-  mapSource->mapContainers.resize(size);
-  for (int i=0;i<size;i++) {
-
-    // Retrieve the map container
-    MapContainer *c=MapContainer::retrieve(cacheData,cacheSize);
-    if (c==NULL) {
-      mapSource->mapContainers.resize(i);
-      success=false;
-      goto cleanup;
-    }
-    mapSource->mapContainers[i]=c;
 
+  // Create the map containers
+  mapSource->mapContainers.resize(header->containerCount);
+  for (UInt i=0;i<header->containerCount;i++) {
+    mapSource->mapContainers[i]=MapContainer::retrieve(mapIndex,i);
   }
-  //PROFILE_ADD("map tile retrieve");
 
   // Read the search trees
-  Storage::retrieveInt(cacheData,cacheSize,size);
-  mapSource->zoomLevelSearchTrees.resize(size);
-  for (int i=0;i<size;i++) {
-
-    // Retrieve the search tree
-    bool hasSearchTree;
-    Storage::retrieveBool(cacheData,cacheSize,hasSearchTree);
-    if (hasSearchTree) {
-      MapContainerTreeNode *n=retrieveSearchTree(mapSource,cacheData,cacheSize);
+  mapSource->zoomLevelSearchTrees.resize(header->searchTreeCount);
+  for (UInt i=0;i<header->searchTreeCount;i++) {
+    Int root=mapIndex->getSearchTree(i);
+    if (root>=0) {
+      MapContainerTreeNode *n=retrieveSearchTree(mapSource,mapIndex,root,0);
       if (n==NULL) {
         mapSource->zoomLevelSearchTrees.resize(i);
-        success=false;
-        goto cleanup;
+        return false;
       }
       mapSource->zoomLevelSearchTrees[i]=n;
     }
-
-    // Update the progress
-    if (!core->getMapSource()->increaseProgress()) {
-      mapSource->zoomLevelSearchTrees.resize(i+1);
-      success=false;
-      goto cleanup;
-    }
-
   }
-  //PROFILE_ADD("search tree retrieve");
 
   // Read the map layer names
-  Storage::retrieveInt(cacheData,cacheSize,size);
-  for (Int i=0;i<size;i++) {
-    char *name;
-    Int zoomLevel;
-    Storage::retrieveString(cacheData,cacheSize,&name);
-    Storage::retrieveInt(cacheData,cacheSize,zoomLevel);
-    mapSource->mapLayerNameMap[name]=zoomLevel;
+  for (UInt i=0;i<header->layerNameCount;i++) {
+    const MapIndexLayerName *layerName=mapIndex->getLayerName(i);
+    mapSource->mapLayerNameMap[mapIndex->getString(layerName->name)]=layerName->zoomLevel;
   }
 
-  // The progress value was already consumed
-  DEBUG("cacheSize=%d",cacheSize);
-  cacheSize-=sizeof(Int);
-  cacheData+=sizeof(Int);
-
-
   // Object is initialized
   mapSource->setIsInitialized(true);
-
-  // Close the dialog
-cleanup:
-  core->getMapSource()->closeProgress();
-  //PROFILE_ADD("cleanup");
-
-  //PROFILE_END;
-
-  // Return result
-  return success;
+  return true;
 }
 
 }
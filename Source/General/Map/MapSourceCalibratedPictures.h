@@ -34,17 +34,40 @@ protected:
   // Path to the map archive
   std::list<std::string> mapArchivePaths;
 
-  // Memory that holds all the sub objects if retrieve was used
-  char *cacheData;
+  // Index that holds the contents of the containers if retrieve was used
+  MapIndex *mapIndex;
 
-  // Stores the contents of the search tree in a binary file
-  void storeSearchTree(std::ofstream *ofs, MapContainerTreeNode *node);
+  // Adds the search tree to the map index and returns the index of the node
+  Int storeSearchTree(MapIndex *mapIndex, MapContainerTreeNode *node, std::unordered_map<MapContainer*,Int> &containerIndex);
 
-  // Reads the contents of the search tree from a binary file
-  static MapContainerTreeNode *retrieveSearchTree(MapSourceCalibratedPictures *mapSource, char *&cacheData, Int &cacheSize);
+  // Creates the search tree from the map index
+  static MapContainerTreeNode *retrieveSearchTree(MapSourceCalibratedPictures *mapSource, MapIndex *mapIndex, Int index, Int depth);
+
+  // Variables for reading the calibration files with multiple threads
+  ThreadMutexInfo *readMutex;                             // Mutex for accessing the read variables
+  ThreadSignalInfo *readSignal;                           // Issued when a read thread has processed a file
+  std::vector<std::vector<std::string> > readMapFilebases; // Calibration files to read
+  std::vector<MapContainer*> readMapContainers;           // Read containers in the order of the files
+  std::vector<MapCalibratorThreadContext*> readThreadContexts; // Calibrator resources of each read thread
+  Int readStartedThreads;                                 // Number of read threads that have taken their calibrator resources
+  Int readNext;                                           // Index of the next file to read
+  Int readFinished;                                       // Number of processed files
+  bool readFailed;                                        // Indicates that a file could not be read
+
+  // Reads the calibration files with multiple threads and adds the containers in the order of the files
+  bool readCalibrationFiles(std::list<std::vector<std::string> > &mapFilebases, std::string title, DialogKey dialog);
 
   // Loads all calibrated pictures in the given directory
-  bool collectMapTiles(std::string directory, std::list<std::vector<std::string> > &mapFilebases);
+  bool collectMapTiles(std::string directory, std::unordered_set<std::string> &unchangedArchivePaths, std::list<std::vector<std::string> > &mapFilebases);
+
+  // Returns the path of the archive in the same way the map containers store it
+  static std::string getArchivePath(ZipArchive *mapArchive);
+
+  // Clears everything that is computed from all containers
+  void clearSearchDataStructures();
+
+  // Keeps the containers of unchanged archives from the map index and drops the rest
+  bool retrieveUnchangedArchives(std::unordered_map<std::string, struct stat> &mapArchiveStats, std::unordered_set<std::string> &unchangedArchivePaths);
 
 public:
 
@@ -61,11 +84,15 @@ public:
   // Clears the source
   virtual void deinit();
 
-  // Store the contents of the object in a binary file
-  void store(std::ofstream *ofs);
+  // Reads calibration files until all are processed (called by the read threads)
+  void readCalibrationFiles();
+
+  // Writes the contents of the object into the map index file
+  void store(std::string filePath, std::unordered_map<std::string, struct stat> &mapArchiveStats);
 
-  // Reads the contents of the object from a binary file
-  static bool retrieve(MapSourceCalibratedPictures *mapSource, char *&cacheData, Int &cacheSize, std::string folder);
+  // Creates the containers from the map index
+  // Their tiles and calibrators are read when they are used for the first time
+  static bool retrieve(MapSourceCalibratedPictures *mapSource, MapIndex *mapIndex, std::string folder);
 
   // Getters and setters
 
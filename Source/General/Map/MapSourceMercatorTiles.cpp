@@ -54,6 +54,7 @@ MapSourceMercatorTiles::MapSourceMercatorTiles(TimestampInSeconds lastGDSModific
   downloadAreaMinDistance=core->getConfigStore()->getIntValue("Map","downloadAreaMinDistance",__FILE__, __LINE__) * 1000;
   mapFolderDiskUsage=0;
   mapFolderMaxSize=((Long)core->getConfigStore()->getIntValue("Map","mapFolderMaxSize",__FILE__, __LINE__))*1024LL*1024LL;
+  revalidateDownloadedTiles=core->getConfigStore()->getIntValue("Map","revalidateDownloadedTiles",__FILE__, __LINE__);
   mapTileLength=256;
   errorOccured=false;
   downloadWarningOccured=false;
@@ -109,7 +110,7 @@ bool MapSourceMercatorTiles::init() {
     ERROR("can not open tiles.gda in map directory <%s>",folder.c_str());
     return false;
   }
-  mapArchives.push_back(mapArchive);
+  insertMapArchive(mapArchive);
 
   // Read all the additional tilesX.gda files
   std::string title="Reading tiles of map " + getFolder();
@@ -388,8 +389,12 @@ MapTile *MapSourceMercatorTiles::fetchMapTile(MapPosition pos, Int zoomLevel) {
   mapContainer->createSearchTree();
 
   // Check if the tile has already been saved to disk
+  // Stale tiles are downloaded again but the server is asked to only send them if they have changed
   if (access((mapContainer->getArchiveFilePath()).c_str(),F_OK)==-1) {
     mapDownloader->queueMapContainerDownload(mapContainer);
+  } else if (staleMapArchives.erase(mapContainer->getArchiveFilePath())>0) {
+    mapContainer->setDownloadStale(true);
+    mapDownloader->queueMapContainerDownload(mapContainer);
   }
 
   // Store the new map container and indicate that a search data structure is required
@@ -463,6 +468,89 @@ MapTile *MapSourceMercatorTiles::findMapTileByGeographicArea(MapArea area, MapTi
   }
 }
 
+// Fills the given area with tiles
+// The tiles of a zoom level form a regular grid, so the covered tiles are computed directly
+// instead of searching them one by one
+void MapSourceMercatorTiles::fillGeographicAreaWithTiles(MapArea area, MapTile *preferredNeighbor, Int maxTiles, std::list<MapTile*> *tiles) {
+
+  // Use the generic search if the area does not belong to a zoom level of the grid
+  Int zMap=area.getZoomLevel();
+  Int minZoomLevelMap,minZoomLevelServer,maxZoomLevelServer;
+  mapDownloader->getLayerGroupZoomLevelBounds(zMap,minZoomLevelMap,minZoomLevelServer,maxZoomLevelServer);
+  if ((zMap<minZoomLevel)||(zMap>maxZoomLevel)||(minZoomLevelMap==-1)) {
+    MapSource::fillGeographicAreaWithTiles(area,preferredNeighbor,maxTiles,tiles);
+    return;
+  }
+
+  // Check if the area is plausible
+  if ((area.getLatNorth()<area.getLatSouth())||(area.getLngEast()<area.getLngWest()))
+    return;
+
+  // Respect the bounds
+  if (area.getLatNorth()>latBound)
+    area.setLatNorth(latBound);
+  if (area.getLatSouth()<-latBound)
+    area.setLatSouth(-latBound);
+  if (area.getLngEast()>lngBound)
+    area.setLngEast(lngBound);
+  if (area.getLngWest()<-lngBound)
+    area.setLngWest(-lngBound);
+
+  // Compute the covered range of tiles
+  Int zServer,startX,endX,startY,endY;
+  computeMercatorBounds(&area,zMap,zServer,startX,endX,startY,endY);
+  MapPosition centerPos=area.getCenterPos();
+  Int centerX,centerY;
+  centerPos.computeMercatorTileXY(zServer,centerX,centerY);
+
+  // Downloads near the new view shall come first
+  mapDownloader->updateDownloadPriorities(centerPos,zMap,centerX,centerY);
+
+  // Order the tiles by their distance to the center
+  // Central tiles are then kept if the maximum number of tiles is reached
+  std::vector<std::pair<Int, std::pair<Int, Int> > > coveredTiles;
+  for (Int x=startX;x<=endX;x++) {
+    for (Int y=startY;y<=endY;y++) {
+      Int distance=(x-centerX)*(x-centerX)+(y-centerY)*(y-centerY);
+      coveredTiles.push_back(std::pair<Int, std::pair<Int, Int> >(distance,std::pair<Int, Int>(x,y)));
+    }
+  }
+  std::sort(coveredTiles.begin(),coveredTiles.end());
+
+  // Fetch the tiles
+  Int previousTileCount=tiles->size();
+  for (std::vector<std::pair<Int, std::pair<Int, Int> > >::iterator i=coveredTiles.begin();i!=coveredTiles.end();i++) {
+    if (tiles->size()>=maxTiles)
+      break;
+    MapPosition pos;
+    pos.setFromMercatorTileXY(zServer,i->second.first,i->second.second);
+    MapTile *tile=fetchMapTile(pos,zMap);
+    if (tile)
+      tiles->push_back(tile);
+  }
+
+#ifdef DEBUG_CHECKS_ENABLED
+  // Check that the recursive search finds the same tiles
+  // Only complete ranges can be compared because both searches stop differently at the maximum number of tiles
+  if (tiles->size()<maxTiles) {
+    std::list<MapTile*> searchedTiles;
+    MapSource::fillGeographicAreaWithTiles(area,preferredNeighbor,maxTiles,&searchedTiles);
+    std::list<MapTile*>::iterator firstTile=tiles->begin();
+    std::advance(firstTile,previousTileCount);
+    std::unordered_set<MapTile*> computedTiles(firstTile,tiles->end());
+    std::unordered_set<MapTile*> foundTiles(searchedTiles.begin(),searchedTiles.end());
+    for (std::unordered_set<MapTile*>::iterator i=foundTiles.begin();i!=foundTiles.end();i++) {
+      if (computedTiles.find(*i)==computedTiles.end())
+        ERROR("tile <%s> found by the recursive search is missing in the computed range (z=%d x=%d..%d y=%d..%d)",(*i)->getParentMapContainer()->getImageFilePath().c_str(),zServer,startX,endX,startY,endY);
+    }
+    for (std::unordered_set<MapTile*>::iterator i=computedTiles.begin();i!=computedTiles.end();i++) {
+      if (foundTiles.find(*i)==foundTiles.end())
+        ERROR("tile <%s> of the computed range is not found by the recursive search (z=%d x=%d..%d y=%d..%d)",(*i)->getParentMapContainer()->getImageFilePath().c_str(),zServer,startX,endX,startY,endY);
+    }
+  }
+#endif
+}
+
 // Marks a map container as obsolete
 // Please note that other objects might still use this map container
 // Call unlinkMapContainer to solve this afterwards
@@ -571,8 +659,15 @@ void MapSourceMercatorTiles::cleanMapFolder(std::string dirPath,MapArea *display
               Int zServer,startX,endX,startY,endY;
               computeMercatorBounds(displayArea,zMap,zServer,startX,endX,startY,endY);
               if ((x>=startX)&&(x<=endX)&&(y>=startY)&&(y<=endY)) {
-                //DEBUG("deleting %s",entryPath.c_str());
-                remove(entryPath.c_str());
+                if (revalidateDownloadedTiles) {
+                  //DEBUG("marking %s as stale",entryPath.c_str());
+                  lockAccess(__FILE__,__LINE__);
+                  staleMapArchives.insert(entryPath);
+                  unlockAccess();
+                } else {
+                  //DEBUG("deleting %s",entryPath.c_str());
+                  remove(entryPath.c_str());
+                }
               }
             }
           }
@@ -672,6 +767,9 @@ void MapSourceMercatorTiles::maintenance() {
         }
         unlockAccess();
         if (!mapArchiveFileInUse) {
+          lockMapArchives(__FILE__,__LINE__);
+          removeFromMapArchiveIndex(mapArchiveFile.getFilePath());
+          unlockMapArchives();
           mapArchiveFiles.erase(i);
           break;
         }
@@ -714,6 +812,9 @@ void MapSourceMercatorTiles::maintenance() {
 
   // Reset the download warning message
   downloadWarningOccured=false;
+
+  // Do the general maintenance
+  MapSource::maintenance();
 }
 
 // Finds the calibrator for the given position
@@ -1288,7 +1389,21 @@ UByte *MapSourceMercatorTiles::fetchMapTile(Int z, Int x, Int y, double saturati
         delete mapArchive;
         if (size>0) {
           imageSize=(UInt)size;
-          if ((saturationOffset!=0)||(brightnessOffset!=0)) {
+
+          // Tiles stored as downloaded may be jpeg images, so convert them into png
+          Int width,height;
+          if ((!core->getImage()->queryPNG(imageData,imageSize,width,height))&&(core->getImage()->queryJPEG(imageData,imageSize,width,height))) {
+            UInt pixelSize;
+            ImagePixel *pixels=core->getImage()->loadJPEG(imageData,imageSize,width,height,pixelSize,NULL);
+            free(imageData);
+            imageData=NULL;
+            imageSize=0;
+            if (pixels) {
+              imageData=core->getImage()->writePNG(pixels,width,height,pixelSize,imageSize);
+              free(pixels);
+            }
+          }
+          if ((imageData)&&((saturationOffset!=0)||(brightnessOffset!=0))) {
             UByte *imageData2=core->getImage()->hsvFilter(imageData,imageSize,0,saturationOffset,brightnessOffset);
             free(imageData);
             imageData=imageData2;
@@ -1320,6 +1435,7 @@ void MapSourceMercatorTiles::updateMapArchiveFiles(std::string filePath) {
   mapFolderDiskUsage+=stats.st_size;
   //DEBUG("adding map archive <%s> to file list (disk usage is %ld Bytes)",filePath.c_str(),mapFolderDiskUsage);
   unlockAccess();
+  MapSource::updateMapArchiveFiles(filePath);
 }
 
 
@@ -50,6 +50,8 @@ protected:
   TimestampInSeconds lastGDMModification;           // Time when the newest GDM for this map was last modified
   Long mapFolderDiskUsage;                          // Current size of the map folder in bytes
   Long mapFolderMaxSize;                            // Maximum size of the map folder in Bytes to maintain
+  bool revalidateDownloadedTiles;                   // Indicates that tiles are checked with the server instead of being deleted on a redownload
+  std::unordered_set<std::string> staleMapArchives; // Archives whose tiles must be checked with the server before they are used
 
   // Fetches the map tile in which the given position lies from disk or server
   MapTile *fetchMapTile(MapPosition pos, Int zoomLevel);
@@ -93,6 +95,9 @@ public:
   // Returns the map tile that lies in a given area
   virtual MapTile *findMapTileByGeographicArea(MapArea area, MapTile *preferredNeigbor, MapContainer* &usedMapContainer);
 
+  // Fills the given area with tiles
+  virtual void fillGeographicAreaWithTiles(MapArea area, MapTile *preferredNeighbor, Int maxTiles, std::list<MapTile*> *tiles);
+
   // Performs maintenance (e.g., recreate degraded search tree)
   virtual void maintenance();
 
@@ -210,7 +210,7 @@ bool MapSourceRemote::init()
       useMapArchive=false;
     }
     if (useMapArchive) {
-      mapArchives.push_back(mapArchive);
+      insertMapArchive(mapArchive);
     } else {
       delete mapArchive;
     }
@@ -380,6 +380,9 @@ void MapSourceRemote::maintenance() {
   if (contentsChanged) {
     contentsChanged=false;
   }
+
+  // Do the general maintenance
+  MapSource::maintenance();
 }
 
 // Adds a new map archive
@@ -442,7 +445,7 @@ bool MapSourceRemote::addMapArchive(std::string path, std::string hash) {
       }
     }
   }
-  mapArchives.push_back(mapArchive);
+  insertMapArchive(mapArchive);
 
   // Go through all entries in the archive and create map containers
   std::list<MapContainer*> newMapContainers;
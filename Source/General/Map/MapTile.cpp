@@ -34,7 +34,7 @@
 
 namespace GEODISCOVERER {
 
-MapTile::MapTile(Int mapX, Int mapY, MapContainer *parent, bool doNotInit, bool doNotDelete) : rectangle(core->getDefaultScreen()), visualization(core->getDefaultScreen()) {
+MapTile::MapTile(Int mapX, Int mapY, MapContainer *parent, bool doNotInit) : rectangle(core->getDefaultScreen()), visualization(core->getDefaultScreen()) {
 
   //PROFILE_START
 
@@ -44,7 +44,6 @@ MapTile::MapTile(Int mapX, Int mapY, MapContainer *parent, bool doNotInit, bool
   //PROFILE_ADD("config read")
 
   // Copy variables
-  this->doNotDelete=doNotDelete;
   this->mapX[0]=mapX;
   this->mapY[0]=mapY;
   this->parent=parent;
@@ -120,25 +119,22 @@ void MapTile::resetVisualization() {
 void MapTile::init() {
 
   // Compute borders
-  MapPosition pos,upperLeftCorner,upperRightCorner,lowerLeftCorner,lowerRightCorner;
+  MapPosition corners[4];
   MapCalibrator *calibrator=parent->getMapCalibrator();
-  pos.setX(this->mapX[0]);
-  pos.setY(this->mapY[0]);
-  calibrator->setGeographicCoordinates(pos);
-  latY[0]=pos.getLat();
-  lngX[0]=pos.getLng();
-  upperLeftCorner=pos;
-  pos.setX(this->mapX[1]+1);
-  calibrator->setGeographicCoordinates(pos);
-  lngX[1]=pos.getLng();
-  upperRightCorner=pos;
-  pos.setY(this->mapY[1]+1);
-  calibrator->setGeographicCoordinates(pos);
-  latY[1]=pos.getLat();
-  lowerRightCorner=pos;
-  pos.setX(this->mapX[0]);
-  calibrator->setGeographicCoordinates(pos);
-  lowerLeftCorner=pos;
+  corners[0].setX(this->mapX[0]);
+  corners[0].setY(this->mapY[0]);
+  corners[1].setX(this->mapX[1]+1);
+  corners[1].setY(this->mapY[0]);
+  corners[2].setX(this->mapX[1]+1);
+  corners[2].setY(this->mapY[1]+1);
+  corners[3].setX(this->mapX[0]);
+  corners[3].setY(this->mapY[1]+1);
+  calibrator->setGeographicCoordinates(corners,4);
+  MapPosition &upperLeftCorner=corners[0],&upperRightCorner=corners[1],&lowerRightCorner=corners[2],&lowerLeftCorner=corners[3];
+  latY[0]=upperLeftCorner.getLat();
+  lngX[0]=upperLeftCorner.getLng();
+  lngX[1]=upperRightCorner.getLng();
+  latY[1]=lowerRightCorner.getLat();
   if (upperLeftCorner.getLat()>upperRightCorner.getLat()) {
     this->latNorthMax=upperLeftCorner.getLat();
     this->latNorthMin=upperRightCorner.getLat();
@@ -222,57 +218,53 @@ Int MapTile::getMapBorder(PictureBorder border)
   return 0;
 }
 
-// Store the contents of the object in a binary file
-void MapTile::store(std::ofstream *ofs) {
-
-  // Write the size of the object for detecting changes later
-  Int size=sizeof(*this);
-  Storage::storeInt(ofs,size);
-
-  // Store all relevant fields
-  MapTile *leftChild=this->leftChild;
-  MapTile *rightChild=this->rightChild;
-  this->leftChild=NULL;
-  this->rightChild=NULL;
-  Storage::storeMem(ofs,(char*)this,sizeof(MapTile),true);
-  this->leftChild=leftChild;
-  this->rightChild=rightChild;
+// Copies the contents of the object into the map index record
+void MapTile::store(MapIndexTile &record) const {
+  record.latNorthMax=latNorthMax;
+  record.latNorthMin=latNorthMin;
+  record.latSouthMax=latSouthMax;
+  record.latSouthMin=latSouthMin;
+  record.lngEastMin=lngEastMin;
+  record.lngEastMax=lngEastMax;
+  record.lngWestMax=lngWestMax;
+  record.lngWestMin=lngWestMin;
+  record.latScale=latScale;
+  record.lngScale=lngScale;
+  record.lngX[0]=lngX[0];
+  record.lngX[1]=lngX[1];
+  record.latY[0]=latY[0];
+  record.latY[1]=latY[1];
+  record.northAngle=northAngle;
+  record.mapX=mapX[0];
+  record.mapY=mapY[0];
 }
 
-// Reads the contents of the object from a binary file
-MapTile *MapTile::retrieve(char *&cacheData, Int &cacheSize, MapContainer *parent) {
-
-  //PROFILE_START;
-
-  // Check if the class has changed
-  Int size=sizeof(MapTile);
-#ifdef TARGET_LINUX
-  if (size!=1448) {
-    FATAL("unknown size of object (%d), please adapt class storage",size);
-    return NULL;
-  }
-#endif
+// Creates the object from the map index record
+MapTile *MapTile::retrieve(const MapIndexTile *record, MapContainer *parent) {
 
-  // Read the size of the object and check with current size
-  size=0;
-  Storage::retrieveInt(cacheData,cacheSize,size);
-  if (size!=sizeof(MapTile)) {
-    DEBUG("stored size of object does not match implemented object size, aborting retrieve",NULL);
+  // Create the tile without computing the borders
+  MapTile *mapTile=new MapTile(record->mapX,record->mapY,parent,true);
+  if (!mapTile) {
+    FATAL("can not create map tile object",NULL);
     return NULL;
   }
-  //PROFILE_ADD("sanity check");
 
-  // Create a new object
-  Storage::skipPadding(cacheData,cacheSize);
-  cacheSize-=sizeof(MapTile);
-  if (cacheSize<0) {
-    DEBUG("can not create map tile object",NULL);
-    return NULL;
-  }
-  MapTile *mapTile=(MapTile*)cacheData;
-  mapTile=new(cacheData) MapTile(mapTile->mapX[0],mapTile->mapY[0],parent,true,true);
-  cacheData+=sizeof(MapTile);
-  //PROFILE_ADD("object creation");
+  // Copy the precomputed fields
+  mapTile->latNorthMax=record->latNorthMax;
+  mapTile->latNorthMin=record->latNorthMin;
+  mapTile->latSouthMax=record->latSouthMax;
+  mapTile->latSouthMin=record->latSouthMin;
+  mapTile->lngEastMin=record->lngEastMin;
+  mapTile->lngEastMax=record->lngEastMax;
+  mapTile->lngWestMax=record->lngWestMax;
+  mapTile->lngWestMin=record->lngWestMin;
+  mapTile->latScale=record->latScale;
+  mapTile->lngScale=record->lngScale;
+  mapTile->lngX[0]=record->lngX[0];
+  mapTile->lngX[1]=record->lngX[1];
+  mapTile->latY[0]=record->latY[0];
+  mapTile->latY[1]=record->latY[1];
+  mapTile->northAngle=record->northAngle;
 
   // Return result
   return mapTile;
@@ -299,13 +291,9 @@ void MapTile::activateVisPos()
   visualization.setZ(visZ);
 }
 
-// Destructs the objects correctly (i.e., if memory has not been allocated by new)
+// Destructs the object
 void MapTile::destruct(MapTile *object) {
-  if (object->doNotDelete) {
-    object->~MapTile();
-  } else {
-    delete object;
-  }
+  delete object;
 }
 
 // Called when the tile is removed from the screen
@@ -41,12 +41,13 @@ typedef enum { PictureBorderTop, PictureBorderBottom, PictureBorderRight, Pictur
 typedef std::map<NavigationPath*, std::list<NavigationPathSegment*>* > MapTileNavigationPathMap;
 typedef std::pair<NavigationPath*, std::list<NavigationPathSegment*>* > MapTileNavigationPathPair;
 
+struct MapIndexTile;
+
 class MapTile {
 
 protected:
 
   // Properties
-  bool                doNotDelete;              // Indicates if the object has been alloacted by an own memory handler
   Int                 mapX[2];                  // x Position in map (both sides)
   Int                 mapY[2];                  // y Position in map (both sides)
   Int                 visX;                     // x Position on the screen
@@ -107,12 +108,12 @@ protected:
 public:
 
   // Constructor
-  MapTile(Int mapX, Int mapY, MapContainer *parent, bool doNotInit=false, bool doNotDelete=false);
+  MapTile(Int mapX, Int mapY, MapContainer *parent, bool doNotInit=false);
 
   // Destructor
   virtual ~MapTile();
 
-  // Destructs the objects correctly (i.e., if memory has not been allocated by new)
+  // Destructs the object
   static void destruct(MapTile *object);
 
   // Compares two tiles according to their distance
@@ -145,11 +146,11 @@ public:
   // Called when the tile is removed from the screen
   void removeGraphic();
 
-  // Store the contents of the object in a binary file
-  void store(std::ofstream *ofs);
+  // Copies the contents of the object into the map index record
+  void store(MapIndexTile &record) const;
 
-  // Reads the contents of the object from a binary file
-  static MapTile *retrieve(char *&cacheData, Int &cacheSize, MapContainer *parent);
+  // Creates the object from the map index record
+  static MapTile *retrieve(const MapIndexTile *record, MapContainer *parent);
 
   // Checks if the area is a neighbor of the tile and computes the center position of the neighbor
   bool getNeighborPos(MapArea area, MapPosition &neighborPos);
@@ -23,6 +23,7 @@
 #include <Core.h>
 #include <MapTileServer.h>
 #include <MapSourceMercatorTiles.h>
+#include <DownloadEngine.h>
 
 namespace GEODISCOVERER {
 
@@ -73,29 +74,37 @@ bool MapTileServer::replaceVariableInServerURL(std::string &url, std::string var
   return true;
 }
 
-// Downloads a map image from the server
-DownloadResult MapTileServer::downloadTileImage(MapContainer *mapContainer, Int threadNr, std::string &url) {
+// Returns the URL of the map image on the server
+std::string MapTileServer::createTileURL(MapContainer *mapContainer) {
 
-  Int imageWidth, imageHeight;
-
-  // Prepare the directory
-  std::stringstream t;
+  // Prepare the tile coordinates
   std::stringstream z; z << mapContainer->getZoomLevelServer();
   std::stringstream x; x << mapContainer->getX();
   std::stringstream y; y << mapContainer->getY();
 
   // Prepare the url
-  url=serverURL;
+  std::string url=serverURL;
   replaceVariableInServerURL(url,"${z}",z.str());
   replaceVariableInServerURL(url,"${x}",x.str());
   replaceVariableInServerURL(url,"${y}",y.str());
+  return url;
+}
+
+// Requests the download of a map image from the server
+DownloadRequest *MapTileServer::requestTileImage(DownloadEngine *downloadEngine, std::string url, const DownloadValidators *validators) {
+  return downloadEngine->submitRequest(url,&httpHeader,validators);
+}
+
+// Waits until the requested map image has been downloaded
+DownloadResult MapTileServer::receiveTileImage(DownloadEngine *downloadEngine, DownloadRequest *request, Int threadNr, std::string url, DownloadValidators *validators) {
+
+  Int imageWidth, imageHeight;
 
-  // Download the file
+  // Get the downloaded file
   DownloadResult result;
   if (images[threadNr]->data!=NULL)
     FATAL("previous image has not been freed",NULL);
-  UInt size;
-  images[threadNr]->data = core->downloadURL(url,result,images[threadNr]->size,!mapSource->getDownloadWarningOccured(),true,&httpHeader);
+  images[threadNr]->data = downloadEngine->waitForRequest(request,result,images[threadNr]->size,!mapSource->getDownloadWarningOccured(),true,validators);
   switch (result) {
     case DownloadResultSuccess:
 
@@ -110,11 +119,14 @@ DownloadResult MapTileServer::downloadTileImage(MapContainer *mapContainer, Int
         return DownloadResultSuccess;
       }
 
+    // The previously downloaded image is still valid
+    case DownloadResultNotModified:
+      discardTileImage(threadNr);
+      return DownloadResultNotModified;
+
     // Some tile servers do not have tiles for every location, so ignore file not found
     case DownloadResultFileNotFound:
-      if (images[threadNr]->data)
-        free(images[threadNr]->data);
-      images[threadNr]->data=NULL;
+      discardTileImage(threadNr);
       return DownloadResultFileNotFound;
 
     case DownloadResultOtherFail:
@@ -123,14 +135,44 @@ DownloadResult MapTileServer::downloadTileImage(MapContainer *mapContainer, Int
       mapSource->unlockAccess();
       break;
   }
+  discardTileImage(threadNr);
+  return DownloadResultOtherFail;
+}
+
+// Frees the downloaded image
+void MapTileServer::discardTileImage(Int threadNr) {
   if (images[threadNr]->data)
     free(images[threadNr]->data);
   images[threadNr]->data=NULL;
-  return DownloadResultOtherFail;
 }
 
-// Loads a map image in RGBA format
-bool MapTileServer::composeTileImage(std::string url, ImagePixel* &composedTileImage, Int &composedImageWidth, Int &composedImageHeight, Int threadNr) {
+// Hands over the downloaded image if it can be stored without decoding it
+UByte *MapTileServer::takeStorableTileImage(Int threadNr, UInt &imageSize, ImageType &imageType) {
+
+  // Only opaque images can be stored as they are
+  if ((images[threadNr]->data==NULL)||(overlayAlpha<1.0))
+    return NULL;
+  Int width,height;
+  bool hasAlpha;
+  if (core->getImage()->queryPNG(images[threadNr]->data,images[threadNr]->size,width,height,&hasAlpha)) {
+    if (hasAlpha)
+      return NULL;
+    imageType=ImageTypePNG;
+  } else if (core->getImage()->queryJPEG(images[threadNr]->data,images[threadNr]->size,width,height)) {
+    imageType=ImageTypeJPEG;
+  } else {
+    return NULL;
+  }
+
+  // Hand over the memory
+  UByte *imageData=images[threadNr]->data;
+  imageSize=images[threadNr]->size;
+  images[threadNr]->data=NULL;
+  return imageData;
+}
+
+// Loads a map image and overlays it atop of the composed image
+bool MapTileServer::composeTileImage(std::string url, Memory *composedTileImage, bool &composedTileImageValid, Int &composedImageWidth, Int &composedImageHeight, Int threadNr) {
 
   ImagePixel *tileImage;
   UInt pixelSize;
@@ -143,10 +185,10 @@ bool MapTileServer::composeTileImage(std::string url, ImagePixel* &composedTileI
   // Read in the image
   switch(imageType) {
     case ImageTypeJPEG:
-      tileImage=core->getImage()->loadJPEG(images[threadNr]->data,images[threadNr]->size,width,height,pixelSize,false);
+      tileImage=core->getImage()->loadJPEG(images[threadNr]->data,images[threadNr]->size,width,height,pixelSize,NULL);
       break;
     case ImageTypePNG:
-      tileImage=core->getImage()->loadPNG(images[threadNr]->data,images[threadNr]->size,width,height,pixelSize,false);
+      tileImage=core->getImage()->loadPNG(images[threadNr]->data,images[threadNr]->size,width,height,pixelSize,NULL);
       break;
     case ImageTypeUnknown:
       FATAL("image type not known",NULL);
@@ -161,31 +203,42 @@ bool MapTileServer::composeTileImage(std::string url, ImagePixel* &composedTileI
     return false;
   }
 
-  // Create a new composed image if it is not already set
-  if (composedTileImage==NULL) {
-    if (!(composedTileImage=(ImagePixel*)malloc(width*height*Image::getRGBPixelSize()))) {
-      FATAL("can not reserve memory for composed tile image",NULL);
-      free(tileImage);
-      return false;
+  // Alpha of this layer in fixed point representation
+  UInt alpha=(UInt)(overlayAlpha*256.0+0.5);
+  if (alpha>256)
+    alpha=256;
+
+  // Prepare the composed image if this is the first layer
+  if (!composedTileImageValid) {
+    UInt composedSize=width*height*Image::getRGBPixelSize();
+    if (composedTileImage->size<composedSize) {
+      if (!(composedTileImage->data=(UByte*)realloc(composedTileImage->data,composedSize))) {
+        FATAL("can not reserve memory for composed tile image",NULL);
+        composedTileImage->size=0;
+        free(tileImage);
+        return false;
+      }
+      composedTileImage->size=composedSize;
     }
-    memset(composedTileImage,0xFF,width*height*Image::getRGBPixelSize());
     composedImageWidth=width;
     composedImageHeight=height;
-  }
+    composedTileImageValid=true;
 
-  // Convert the image in RGBA format if necessary
-  double alpha;
-  for (Int i=0;i<width*height;i++) {
-    if (pixelSize==Image::getRGBAPixelSize()) {
-      alpha = ((double)tileImage[pixelSize*i+3])/255.0*overlayAlpha;
-    } else {
-      alpha = overlayAlpha;
+    // An opaque layer can be copied directly
+    if ((alpha==256)&&(pixelSize==Image::getRGBPixelSize())) {
+      memcpy(composedTileImage->data,tileImage,composedSize);
+      free(tileImage);
+      return true;
     }
-    for (Int j=0;j<core->getImage()->getRGBPixelSize();j++)
-      composedTileImage[Image::getRGBPixelSize()*i+j] = (ImagePixel)
-        (double)composedTileImage[Image::getRGBPixelSize()*i+j] * (1.0-alpha) +
-        (double)tileImage[pixelSize*i+j] * alpha;
+    memset(composedTileImage->data,0xFF,composedSize);
+  } else if ((width!=composedImageWidth)||(height!=composedImageHeight)) {
+    WARNING("size of downloaded map from <%s> does not match the other layers",url.c_str());
+    free(tileImage);
+    return false;
   }
+
+  // Blend the image atop of the composed image
+  core->getImage()->blendToRGB888(composedTileImage->data,tileImage,pixelSize,width*height,alpha);
   free(tileImage);
   return true;
 }
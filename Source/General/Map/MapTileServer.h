@@ -29,6 +29,10 @@
 
 namespace GEODISCOVERER {
 
+class DownloadEngine;
+struct DownloadRequest;
+struct DownloadValidators;
+
 class MapTileServer {
 
 protected:
@@ -57,11 +61,23 @@ public:
   // Destructor
   virtual ~MapTileServer();
 
-  // Downloads a map image from the server
-  DownloadResult downloadTileImage(MapContainer *mapContainer, Int threadNr, std::string &url);
+  // Returns the URL of the map image on the server
+  std::string createTileURL(MapContainer *mapContainer);
+
+  // Requests the download of a map image from the server
+  DownloadRequest *requestTileImage(DownloadEngine *downloadEngine, std::string url, const DownloadValidators *validators=NULL);
+
+  // Waits until the requested map image has been downloaded
+  DownloadResult receiveTileImage(DownloadEngine *downloadEngine, DownloadRequest *request, Int threadNr, std::string url, DownloadValidators *validators=NULL);
+
+  // Frees the downloaded image
+  void discardTileImage(Int threadNr);
+
+  // Hands over the downloaded image if it can be stored without decoding it
+  UByte *takeStorableTileImage(Int threadNr, UInt &imageSize, ImageType &imageType);
 
-  // Loads a map image and overlays it atop of imagePixel
-  bool composeTileImage(std::string url, ImagePixel* &composedTileImage, Int &composedImageWidth, Int &composedImageHeight, Int threadNr);
+  // Loads a map image and overlays it atop of the composed image
+  bool composeTileImage(std::string url, Memory *composedTileImage, bool &composedTileImageValid, Int &composedImageWidth, Int &composedImageHeight, Int threadNr);
 
   // Getters and setters
   Int getMaxZoomLevelMap() const {
@@ -73,7 +73,6 @@ std::vector<double> FloatingPoint::solveZEqualsC0XPlusC1(std::vector<double> &x,
 std::vector<double> FloatingPoint::solveZEqualsC0XPlusC1YPlusC2(std::vector<double> &x, std::vector<double> &y, std::vector<double> &z) {
   std::vector<double> c;
   c.resize(3);
-  double t;
   if (x.size()!=3) {
     FATAL("three samples for x are required to solve z=c0*x+c1*y+c2",NULL);
     return c;
@@ -86,6 +85,16 @@ std::vector<double> FloatingPoint::solveZEqualsC0XPlusC1YPlusC2(std::vector<doub
     FATAL("three samples for z are required to solve z=c0*x+c1*y+c2",NULL);
     return c;
   }
+  if (!solveZEqualsC0XPlusC1YPlusC2(&x[0],&y[0],&z[0],&c[0])) {
+    ERROR("can not solve equation z=c0*x+c1*y+c2 (divisor is zero)",NULL);
+    return std::vector<double>();
+  }
+  return c;
+}
+
+// Computes the constants c0-c2 of the equation c0*x+c1*y+c2 for three samples
+bool FloatingPoint::solveZEqualsC0XPlusC1YPlusC2(const double *x, const double *y, const double *z, double *c) {
+  double t;
   /*for (int i=0;i<3;i++) {
     DEBUG("x[%d]=%.2f y[%d]=%.2f z[%d]=%.2f",i,x[i],i,y[i],i,z[i]);
   }*/
@@ -101,16 +110,14 @@ std::vector<double> FloatingPoint::solveZEqualsC0XPlusC1YPlusC2(std::vector<doub
   // Compute c1
   t=x2x0*y1y0-x1x0*y2y0;
   if (t==0.0) {
-    ERROR("can not compute c[1] (divisor is zero)",NULL);
-    return std::vector<double>();
+    return false;
   }
   c[1]=(x2x0*z1z0-x1x0*z2z0)/t;
   //DEBUG("c[1]=%e",c[1]);
 
   // Compute c0
   if ((x2x0==0.0)&&(x1x0==0.0)) {
-    ERROR("can not compute c[0] (divisor is zero)",NULL);
-    return std::vector<double>();
+    return false;
   }
   if (x2x0==0.0) {
     c[0]=(z1z0-c[1]*y1y0)/x1x0;
@@ -122,7 +129,7 @@ std::vector<double> FloatingPoint::solveZEqualsC0XPlusC1YPlusC2(std::vector<doub
   // Compute c2
   c[2]=z[0]-c[0]*x[0]-c[1]*y[0];
   //DEBUG("c[2]=%e",c[2]);
-  return c;
+  return true;
 }
 
 /*
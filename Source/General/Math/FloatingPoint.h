@@ -37,6 +37,9 @@ public:
   // Solve z=c0*x+c1*y+c2
   static std::vector<double> solveZEqualsC0XPlusC1YPlusC2(std::vector<double> &x,std::vector<double> &y,std::vector<double> &z);
 
+  // Solve z=c0*x+c1*y+c2 for three samples without allocating memory (returns false if there is no solution)
+  static bool solveZEqualsC0XPlusC1YPlusC2(const double *x, const double *y, const double *z, double *c);
+
   // Compute the angle of a orthogonal triangle
   static double computeAngle(double adjacent, double opposite);
 
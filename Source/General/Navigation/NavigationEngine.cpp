@@ -71,6 +71,7 @@ NavigationEngine::NavigationEngine() :
   locationPosMutex=core->getThread()->createMutex("navigation engine location pos mutex");
   compassBearingMutex=core->getThread()->createMutex("navigation engine compass bearing mutex");
   recordTrack=core->getConfigStore()->getIntValue("Navigation","recordTrack", __FILE__, __LINE__);
+  compactRecordedTrack=false;
   colorOffsetDelta=core->getConfigStore()->getDoubleValue("Navigation","colorOffsetDelta", __FILE__, __LINE__);
   compassBearing=0;
   isInitialized=false;
@@ -144,6 +145,9 @@ NavigationEngine::NavigationEngine() :
   // Cleanup the path caches
   cleanupNavigationPathCache(getRoutePath());
   cleanupNavigationPathCache(getTrackPath());  
+#ifdef DEBUG_CHECKS_ENABLED
+  NavigationPathPoints::checkCodec(core->getHomePath()+"/codecCheck.gdroute");
+#endif
 }
 
 // Remove cache files that do not have their original gpx files anymore
@@ -243,6 +247,7 @@ void NavigationEngine::init() {
     return;
   }
   recordedTrack->setNormalColor(c->getGraphicColorValue("Navigation/TrackColor", __FILE__, __LINE__), __FILE__, __LINE__);
+  recordedTrack->createJournal();
 
   // In case the last recorded track is not from today we create a new one
   std::string lastRecordedTrackFilename=c->getStringValue("Navigation","lastRecordedTrackFilename", __FILE__, __LINE__);
@@ -263,11 +268,21 @@ void NavigationEngine::init() {
   }
 
   // Prepare the last recorded track if it does exist
+  // A track with a journal was interrupted and is continued independent of the day
   std::string filepath=recordedTrack->getGpxFilefolder()+"/"+lastRecordedTrackFilename;
-  if ((isToday)&&(lastRecordedTrackFilename!="")&&(access(filepath.c_str(),F_OK)==0)) {
+  bool gpxExists=(lastRecordedTrackFilename!="")&&(access(filepath.c_str(),F_OK)==0);
+  bool journalExists=(lastRecordedTrackFilename!="")&&(access((filepath+NavigationPathJournal::filenameExtension).c_str(),F_OK)==0);
+  if (((isToday)&&(gpxExists))||(journalExists)) {
     //DEBUG("track gpx file exists, using it",NULL);
     recordedTrack->setGpxFilename(lastRecordedTrackFilename);
 
+    // Without a gpx file, the journal contains the complete track
+    if (!gpxExists) {
+      recordedTrack->replayJournal();
+      recordedTrack->setIsInit(true);
+      recordedTrack->setHasBeenLoaded(true);
+    }
+
   } else {
     //DEBUG("track gpx file does not exist, starting new track",NULL);
     c->setStringValue("Navigation","lastRecordedTrackFilename",recordedTrack->getGpxFilename(), __FILE__, __LINE__);
@@ -660,8 +675,13 @@ void NavigationEngine::updateTrack() {
 // Saves the recorded track if required
 void NavigationEngine::backup() {
 
-  // Store the recorded track
-  recordedTrack->writeGPXFile(); // locking is handled within method
+  // Secure the recorded track
+  // The gpx file is rewritten after the recording has been stopped
+  lockRecordedTrack(__FILE__, __LINE__);
+  bool compact=compactRecordedTrack;
+  compactRecordedTrack=false;
+  unlockRecordedTrack();
+  recordedTrack->backup(compact); // locking is handled within method
 
 }
 
@@ -688,6 +708,8 @@ bool NavigationEngine::setRecordTrack(bool recordTrack, bool ignoreIsInit, bool
       recordedTrack->addEndPosition(NavigationPath::getPathInterruptedPos());
   }
   lockRecordedTrack(__FILE__, __LINE__);
+  if ((!recordTrack)&&(this->recordTrack))
+    compactRecordedTrack=true;
   this->recordTrack=recordTrack;
   core->getConfigStore()->setIntValue("Navigation","recordTrack",recordTrack,__FILE__,__LINE__);
   unlockRecordedTrack();
@@ -1238,8 +1260,10 @@ void NavigationEngine::backgroundLoader() {
     if (core->getQuitCore()) {
       goto exitThread;
     }
-    if (recordedTrack->readGPXFile())
+    if (recordedTrack->readGPXFile()) {
+      recordedTrack->replayJournal();
       recordedTrack->setIsInit(true);
+    }
   }
 
   // Load all routes
@@ -1900,6 +1924,7 @@ void NavigationEngine::initAddressPoints() {
     navigationPointsVisualization.push_back(pointVis);
   }
   addressPoints=storedAddressPoints;
+  updateAddressPointIndex();
   resetOverlayGraphicHash();
   core->getDefaultGraphicEngine()->unlockDrawing();
 
@@ -1916,6 +1941,7 @@ void NavigationEngine::addAddressPointCandidate(std::string name, double lng, do
   core->getDefaultGraphicEngine()->lockDrawing(__FILE__,__LINE__);
   NavigationPointVisualization pointVis(&navigationPointsGraphicObject, lat, lng, NavigationPointVisualizationTypePointCandidate, name, NULL);
   navigationPointsVisualization.push_back(pointVis);
+  spatialIndex.addAddressPoint(name,pointVis.getPos().getGeoPoint());
   resetOverlayGraphicHash();
   core->getDefaultGraphicEngine()->unlockDrawing();
 
@@ -1946,6 +1972,7 @@ void NavigationEngine::removeAddressPointCandidates() {
   }
 
   // Trigger updates
+  updateAddressPointIndex();
   resetOverlayGraphicHash();
   core->getDefaultGraphicEngine()->unlockDrawing();
   triggerNavigationInfoUpdate();
@@ -1964,43 +1991,27 @@ NavigationPath *NavigationEngine::findRoute(std::string name) {
 }
 
 // Returns the address point at the given position
-bool NavigationEngine::getAddressPoint(GraphicPosition visPos, NavigationPoint &result, boolean informApp) {
+bool NavigationEngine::getAddressPoint(MapPosition pos, NavigationPoint &result, boolean informApp) {
   bool success=false;  
   std::string name="";
-  core->getDefaultGraphicEngine()->lockDrawing(__FILE__,__LINE__);
-  std::list<GraphicPrimitive*> *visibleAddressPoints = navigationPointsGraphicObject.getDrawList();
-  //DEBUG("visPos.getX()=%d visPos.getY()=%d visPos.getZoom()=%f",visPos.getX(),visPos.getY(),visPos.getZoom());
-  for (std::list<GraphicPrimitive*>::iterator i=visibleAddressPoints->begin();i!=visibleAddressPoints->end();i++) {
-    GraphicRectangle *r=(GraphicRectangle*)*i;
-    double diffX = r->getX()-visPos.getX();
-    double diffY = r->getY()-visPos.getY();
-    double distance = sqrt( diffX*diffX + diffY*diffY ) * visPos.getZoom();
-    if (r->getReference()==NULL) {
-      FATAL("navigation point has no reference",NULL);
-      continue;
-    }
-    NavigationPointVisualization *v=(NavigationPointVisualization*)r->getReference();
-    switch (v->getVisualizationType()) {
-      case NavigationPointVisualizationTypeStartFlag:
-      case NavigationPointVisualizationTypeEndFlag:
-        continue;
-        break;
-      default:
-        break;
-    }
-    //DEBUG("distance=%f",distance);
-    //DEBUG("r.getX()=%d r.getY()=%d",r->getX(),r->getY());
-    if (distance < r->getIconHeight()/8) {
-      name=r->getName().front();
+
+  // Look up the nearest address point within the area covered by its icon
+  double maxDistance;
+  Int iconRadius=core->getDefaultGraphicEngine()->getNavigationPointIcon()->getIconHeight()/8;
+  if (core->getMapEngine()->calculateMaxDistanceInMeters(iconRadius,maxDistance)) {
+    std::list<NavigationSpatialIndexEntry> entries;
+    spatialIndex.findNearest(pos.getGeoPoint(),1,maxDistance,NavigationSpatialIndexEntryTypeAddressPoint,entries);
+    if (entries.size()>0) {
+      name=entries.front().name;
       //DEBUG("name=%s",name.c_str());
-      if ((informApp)&&(name!=lastAddressPointName)) {
-        core->getCommander()->dispatch("nearbyAddressPoint(\""+name+"\")");
-        lastAddressPointName=name;
-      }
-      break;
     }
   }
+  core->getDefaultGraphicEngine()->lockDrawing(__FILE__,__LINE__);
   if (name!="") {
+    if ((informApp)&&(name!=lastAddressPointName)) {
+      core->getCommander()->dispatch("nearbyAddressPoint(\""+name+"\")");
+      lastAddressPointName=name;
+    }
     if (core->getDefaultDevice()->getIsWatch()) {
       // Watch has no address points, but at least we can return the name
       result.setName(name);
@@ -2026,6 +2037,21 @@ bool NavigationEngine::getAddressPoint(GraphicPosition visPos, NavigationPoint &
   return success;
 }
 
+// Updates the address points in the spatial index from the visualized ones
+void NavigationEngine::updateAddressPointIndex() {
+  spatialIndex.clearAddressPoints();
+  for (std::list<NavigationPointVisualization>::iterator i=navigationPointsVisualization.begin();i!=navigationPointsVisualization.end();i++) {
+    switch (i->getVisualizationType()) {
+      case NavigationPointVisualizationTypePoint:
+      case NavigationPointVisualizationTypePointCandidate:
+        spatialIndex.addAddressPoint(i->getName(),i->getPos().getGeoPoint());
+        break;
+      default:
+        break;
+    }
+  }
+}
+
 // Exports the active route inclusive selection as an GPX file
 void NavigationEngine::exportActiveRoute() {
   if (activeRoute!=NULL) {
@@ -2116,6 +2142,7 @@ void NavigationEngine::retrieveOverlayGraphics(std::string filefolder, std::stri
     navigationPointVisualization.retrieve(data,size);
     navigationPointsVisualization.push_back(navigationPointVisualization);
   }
+  updateAddressPointIndex();
   core->getDefaultGraphicEngine()->unlockDrawing();
 
   // That's it!
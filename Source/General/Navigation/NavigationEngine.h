@@ -27,6 +27,7 @@
 #include <NavigationInfo.h>
 #include <MapPosition.h>
 #include <GraphicEngine.h>
+#include <NavigationSpatialIndex.h>
 
 #ifndef NAVIGATIONENGINE_H_
 #define NAVIGATIONENGINE_H_
@@ -64,6 +65,9 @@ protected:
   // Indicates if the track recording is enabled or disabled
   bool recordTrack;
 
+  // Indicates that the gpx file of the recorded track shall be rewritten at the next backup
+  bool compactRecordedTrack;
+
   // Current track
   NavigationPath *recordedTrack;
 
@@ -204,6 +208,9 @@ protected:
   // List of navigation points that are visualized
   std::list<NavigationPointVisualization> navigationPointsVisualization;
 
+  // Spatial index of all path segments and address points
+  NavigationSpatialIndex spatialIndex;
+
   // Hash that represents the overlay content
   std::string overlayGraphicHash;
 
@@ -213,6 +220,9 @@ protected:
   // Reads the address points from disk
   void initAddressPoints();
 
+  // Updates the address points in the spatial index from the visualized ones
+  void updateAddressPointIndex();
+
   // Deinitializes a path
   void deletePath(NavigationPath *path);
 
@@ -362,7 +372,7 @@ public:
   NavigationPath *findRoute(std::string name);
 
   // Returns the address point at the given position
-  bool getAddressPoint(GraphicPosition visPos, NavigationPoint &result, boolean informApp=false);
+  bool getAddressPoint(MapPosition pos, NavigationPoint &result, boolean informApp=false);
 
   // Returns information about the address point that is the nearest to the current position
   bool getNearestAddressPoint(NavigationPoint &navigationPoint, double &distance, TimestampInMicroseconds &updateTimestamp, bool &alarm);
@@ -489,6 +499,10 @@ public:
     return activeRoute;
   }
 
+  NavigationSpatialIndex *getSpatialIndex() {
+    return &spatialIndex;
+  }
+
   const double getColorOffsetDelta() const {
     return colorOffsetDelta;
   }
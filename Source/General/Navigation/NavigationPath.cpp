@@ -28,16 +28,25 @@
 #include <NavigationEngine.h>
 #include <Commander.h>
 #include <NavigationPathSegment.h>
-#include <Storage.h>
 #include <ElevationEngine.h>
 
 namespace GEODISCOVERER {
 
+const UByte NavigationPath::noRank = 255;
+
+// Orders the visualizations from the coarsest to the finest zoom level
+static bool compareVisualizationScale(NavigationPathVisualization *a, NavigationPathVisualization *b) {
+  if (a->getLngScale()!=b->getLngScale())
+    return a->getLngScale()<b->getLngScale();
+  return a->getZoomLevel()<b->getZoomLevel();
+}
+
 // Constructor
 NavigationPath::NavigationPath() : animator(core->getDefaultScreen()) {
 
   // Init variables
-  cacheData=NULL;
+  changeCount=0;
+  matcherMutex=core->getThread()->createMutex("navigation path matcher mutex");
   setGpxFilefolder(core->getNavigationEngine()->getTrackPath());
   pathMinSegmentLength=core->getConfigStore()->getIntValue("Graphic","pathMinSegmentLength", __FILE__, __LINE__);
   pathMinDirectionDistance=core->getConfigStore()->getIntValue("Graphic","pathMinDirectionDistance", __FILE__, __LINE__);
@@ -56,8 +65,9 @@ NavigationPath::NavigationPath() : animator(core->getDefaultScreen()) {
   isInit=false;
   reverse=false;
   lastValidAltiudeMeters=NAN;
-  lastValidAltiudePos.invalidate();
+  lastValidAltiudePos=NavigationPath::getPathInterruptedPos().getGeoPoint();
   importWaypoints=NavigationPathImportWaypointsUndecided;
+  journal=NULL;
 
   // Do the dynamic initialization
   init();
@@ -78,6 +88,13 @@ NavigationPath::~NavigationPath() {
   GraphicObject *pathAnimators=core->getDefaultGraphicEngine()->lockPathAnimators(__FILE__, __LINE__);
   pathAnimators->removePrimitive(animatorKey,false);
   core->getDefaultGraphicEngine()->unlockPathAnimators();
+
+  // Free the mutex
+  core->getThread()->destroyMutex(matcherMutex);
+
+  // Close the journal
+  if (journal)
+    delete journal;
 }
 
 // Updates the visualization of the tile (path line and arrows)
@@ -128,15 +145,18 @@ void NavigationPath::updateTileVisualization(std::list<MapContainer*> *mapContai
 
     // Compute the coordinates of the segment within the container
     MapContainer *mapContainer=*j;
+    MapCalibrator *mapCalibrator=mapContainer->getMapCalibrator();
+    if (!mapCalibrator)
+      continue;
     MapPosition prevArrowPos=prevPos;
     bool overflowOccured=false;
-    if (!mapContainer->getMapCalibrator()->setPictureCoordinates(prevPos)) {
+    if (!mapCalibrator->setPictureCoordinates(prevPos)) {
       overflowOccured=true;
     }
-    if (!mapContainer->getMapCalibrator()->setPictureCoordinates(prevArrowPos)) {
+    if (!mapCalibrator->setPictureCoordinates(prevArrowPos)) {
       overflowOccured=true;
     }
-    if (!mapContainer->getMapCalibrator()->setPictureCoordinates(currentPos)) {
+    if (!mapCalibrator->setPictureCoordinates(currentPos)) {
       overflowOccured=true;
     }
     if (!overflowOccured) {
@@ -277,21 +297,22 @@ void NavigationPath::updateTileVisualization(std::list<MapContainer*> *mapContai
 }
 
 // Updates the crossing path segments in the map tiles of the given map containers for the new point
-void NavigationPath::updateCrossingTileSegments(std::list<MapContainer*> *mapContainers, NavigationPathVisualization *visualization, Int pos) {
+void NavigationPath::updateCrossingTileSegments(std::list<MapContainer*> *mapContainers, NavigationPathVisualization *visualization, MapPosition pos, Int index, Int prevIndex) {
 
   std::list<MapContainer*> foundContainers;
 
   // Find the map containers if necessary
   if (mapContainers==NULL) {
-    foundContainers = core->getMapSource()->findMapContainersByGeographicCoordinate(visualization->getPoint(pos),visualization->getZoomLevel());
+    foundContainers = core->getMapSource()->findMapContainersByGeographicCoordinate(pos,visualization->getZoomLevel());
     mapContainers = &foundContainers;
   }
 
   // Add this point to the path segments of all tiles it lies within
   for(std::list<MapContainer*>::iterator i=mapContainers->begin();i!=mapContainers->end();i++) {
     MapContainer* mapContainer=*i;
-    MapPosition t=visualization->getPoint(pos);
-    if (mapContainer->getMapCalibrator()->setPictureCoordinates(t)) {
+    MapPosition t=pos;
+    MapCalibrator *mapCalibrator=mapContainer->getMapCalibrator();
+    if ((mapCalibrator)&&(mapCalibrator->setPictureCoordinates(t))) {
       MapTile* mapTile=mapContainer->findMapTileByPictureCoordinate(t);
       if (mapTile) {
 
@@ -303,12 +324,12 @@ void NavigationPath::updateCrossingTileSegments(std::list<MapContainer*> *mapCon
         }  else {
           addNewSegment=true;
           for (std::list<NavigationPathSegment*>::iterator j=pathSegments->begin();j!=pathSegments->end();j++) {
-            if ((pos>=(*j)->getStartIndex())&&(pos<=(*j)->getEndIndex())) {
+            if ((index>=(*j)->getStartIndex())&&(index<=(*j)->getEndIndex())) {
               addNewSegment=false;
               break; // already present
             }
-            if (pos==(*j)->getEndIndex()+1) {
-              (*j)->setEndIndex(pos);
+            if ((prevIndex!=-1)&&(prevIndex==(*j)->getEndIndex())) {
+              (*j)->setEndIndex(index);
               addNewSegment=false;
               break; // existing segment extended
             }
@@ -324,7 +345,7 @@ void NavigationPath::updateCrossingTileSegments(std::list<MapContainer*> *mapCon
           }
           pathSegment->setPath(this);
           pathSegment->setVisualization(visualization);
-          pathSegment->setStartIndex(pos);
+          pathSegment->setStartIndex(index);
           pathSegment->setEndIndex(pathSegment->getStartIndex());
           mapTile->addCrossingNavigationPathSegment(this, pathSegment);
         }
@@ -348,12 +369,19 @@ void NavigationPath::addEndPosition(MapPosition pos) {
   lastPoint=pos;
 
   // Add the new pair
-  mapPositions.push_back(pos);
-  pos.setIndex(mapPositions.size()-1);
+  pathPoints.add(pos,pos==NavigationPath::getPathInterruptedPos());
+  changeCount++;
+  pos.setIndex(pathPoints.size()-1);
+  Int index=pos.getIndex();
 
   // Update the length and altitude meters
   if (endIndex==-1) {
-    updateMetrics(secondLastPoint,lastPoint);
+    Int curIndex=pathPoints.size()-1;
+    Int prevIndex=((hasSecondLastPoint)&&(curIndex>0)) ? curIndex-1 : -1;
+    double distance=0;
+    if ((prevIndex!=-1)&&(!pathPoints.isInterrupted(prevIndex))&&(!pathPoints.isInterrupted(curIndex)))
+      distance=MapPosition::computeDistance(pathPoints.getGeoPoint(prevIndex),pathPoints.getGeoPoint(curIndex));
+    updateMetrics(prevIndex,curIndex,distance);
   }
 
   // Path was modified
@@ -361,70 +389,91 @@ void NavigationPath::addEndPosition(MapPosition pos) {
   isStored=false;
   core->getMapSource()->unlockAccess();
 
-  // Update the visualization for each zoom level
-  for(std::vector<NavigationPathVisualization*>::iterator i=zoomLevelVisualizations.begin();i!=zoomLevelVisualizations.end();i++) {
+  // Secure the point in the journal (points read from disk are already stored)
+  if ((journal)&&(getIsInit()))
+    journal->append(pos,index);
+
+  // Update the spatial index
+  core->getNavigationEngine()->getSpatialIndex()->addPoint(this);
+
+  // Update the visualization of each pyramid level, starting with the coarsest one
+  // A point of the line or an arrow of a coarser level is also used in all finer levels
+  bool isInterrupted=(pos==NavigationPath::getPathInterruptedPos());
+  core->getMapSource()->lockAccess(__FILE__,__LINE__);
+  lineRanks.push_back(isInterrupted ? 0 : noRank);
+  arrowRanks.push_back(noRank);
+  core->getMapSource()->unlockAccess();
+  for(std::vector<NavigationPathVisualization*>::iterator i=pyramidLevels.begin();i!=pyramidLevels.end();i++) {
     NavigationPathVisualization *visualization=*i;
+    UByte rank=visualization->getRank();
 
-    // Get the calibrator for this point
+    // Interruptions are part of all levels
     core->getMapSource()->lockAccess(__FILE__,__LINE__);
+    if (isInterrupted) {
+      visualization->addPoint(pos,-1);
+      core->getMapSource()->unlockAccess();
+      continue;
+    }
+
+    // Get the calibrator for this point
     bool deleteCalibrator=false;
-    MapCalibrator *calibrator=NULL;
-    if (pos!=NavigationPath::getPathInterruptedPos())
-      calibrator=visualization->findCalibrator(pos,deleteCalibrator);
-
-    // Just add this point if the prev point or the current point interrupted the line
-    if ((visualization->getPrevLinePoint()==NavigationPath::getPathInterruptedPos())||(pos==NavigationPath::getPathInterruptedPos())) {
-      if ((pos==NavigationPath::getPathInterruptedPos())||(calibrator!=NULL)) {
-        visualization->addPoint(pos);
-      }
-      if (calibrator!=NULL) {
-        updateCrossingTileSegments(NULL, visualization, visualization->getPointsSize()-1);
-      }
+    MapCalibrator *calibrator=visualization->findCalibrator(pos,deleteCalibrator);
+    if (!calibrator) {
+
+      // Position can not be found in map, interrupt it
+      visualization->addUncoveredPoint(index);
+      core->getMapSource()->unlockAccess();
+      continue;
+    }
+
+    // Just add this point if the prev point interrupted the line
+    if (visualization->getPrevLinePoint()==NavigationPath::getPathInterruptedPos()) {
+      pos.setHasBearing(false);
+      visualization->addPoint(pos,index);
+      if (lineRanks[index]>rank)
+        lineRanks[index]=rank;
+      updateCrossingTileSegments(NULL, visualization, pos, index, -1);
       core->getMapSource()->unlockAccess();
 
     } else {
 
       // Check if the point is far enough away from the previous point for this zoom level
-      if (!calibrator) {
-
-        // Position can not be found in map, interrupt it
-        visualization->addPoint(NavigationPath::getPathInterruptedPos());
+      if ((lineRanks[index]<rank)||(calibrator->computePixelDistance(visualization->getPrevLinePoint(),pos)>=pathMinSegmentLength)) {
+        if (lineRanks[index]>rank)
+          lineRanks[index]=rank;
+
+        // Check if an arrow needs to be added
+        if ((arrowRanks[index]<rank)||(calibrator->computePixelDistance(visualization->getPrevArrowPoint(),pos)>=pathMinDirectionDistance)) {
+          if (arrowRanks[index]>rank)
+            arrowRanks[index]=rank;
+          pos.setHasBearing(true);  // bearing flag is used to indicate that an arrow must be added
+          pos.setBearing(visualization->getColorOffset());
+          //DEBUG("addEndPosition: %d (%f,%f) => %f",visualization->getZoomLevel(),pos.getLat(),pos.getLng(),pos.getBearing());
+          visualization->updateColorOffset(reverse);
+        } else {
+          pos.setHasBearing(false);
+        }
+        MapPosition prevLinePoint=visualization->getPrevLinePoint();
+        MapPosition prevArrowPoint=visualization->getPrevArrowPoint();
         core->getMapSource()->unlockAccess();
 
-      } else {
-        double length=calibrator->computePixelDistance(visualization->getPrevLinePoint(),pos);
-        if (length>=pathMinSegmentLength) {
-
-          // Check if an arrow needs to be added
-          bool addArrow=false;
-          double arrowDistance=calibrator->computePixelDistance(visualization->getPrevArrowPoint(),pos);
-          if (arrowDistance>=pathMinDirectionDistance) {
-            pos.setHasBearing(true);  // bearing flag is used to indicate that an arrow must be added
-            pos.setBearing(visualization->getColorOffset());
-            //DEBUG("addEndPosition: %d (%f,%f) => %f",visualization->getZoomLevel(),pos.getLat(),pos.getLng(),pos.getBearing());
-            visualization->updateColorOffset(reverse);
-          } else {
-            pos.setHasBearing(false);
-          }
-          core->getMapSource()->unlockAccess();
-
-          // Add a line stroke to all matching tiles
-          updateTileVisualization(NULL,visualization,visualization->getPrevLinePoint(),visualization->getPrevArrowPoint(),pos);
+        // Add a line stroke to all matching tiles
+        updateTileVisualization(NULL,visualization,prevLinePoint,prevArrowPoint,pos);
 
-          // Update the previous point
-          core->getMapSource()->lockAccess(__FILE__,__LINE__);
-          visualization->addPoint(pos);
-          updateCrossingTileSegments(NULL, visualization, visualization->getPointsSize()-1);
-          core->getMapSource()->unlockAccess();
+        // Update the previous point
+        core->getMapSource()->lockAccess(__FILE__,__LINE__);
+        Int prevIndex=visualization->getPrevLineIndex();
+        visualization->addPoint(pos,index);
+        updateCrossingTileSegments(NULL, visualization, pos, index, prevIndex);
+        core->getMapSource()->unlockAccess();
 
-        } else {
-          core->getMapSource()->unlockAccess();
-        }
+      } else {
+        core->getMapSource()->unlockAccess();
       }
     }
 
     // Delete the calibrator if required
-    if ((deleteCalibrator)&&(calibrator))
+    if (deleteCalibrator)
       delete calibrator;
 
   }
@@ -441,6 +490,7 @@ void NavigationPath::deinit() {
     delete *i;
   }
   zoomLevelVisualizations.clear();
+  pyramidLevels.clear();
 
   // Remove from all tiles the path segments
   core->getMapSource()->lockAccess(__FILE__,__LINE__);
@@ -459,13 +509,15 @@ void NavigationPath::deinit() {
   core->getDefaultGraphicEngine()->unlockPathAnimators();
 
   // Delete all points
-  mapPositions.clear();
-
-  // Delete the cahce (if used)
-  if (cacheData) {
-    free(cacheData);
-    cacheData=NULL;
-  }
+  // The spatial index reads the points, so the path is removed from it first
+  core->getNavigationEngine()->getSpatialIndex()->removePath(this);
+  pathPoints.clear();
+  lineRanks.clear();
+  arrowRanks.clear();
+  changeCount++;
+  core->getThread()->lockMutex(matcherMutex, __FILE__, __LINE__);
+  matcher.clear();
+  core->getThread()->unlockMutex(matcherMutex);
 
   // Is not initialized
   setIsInit(false);
@@ -486,7 +538,11 @@ void NavigationPath::init() {
   isStored=true;
   hasBeenLoaded=false;
   isNew=true;
-  mapPositions.clear();
+  core->getNavigationEngine()->getSpatialIndex()->removePath(this);
+  pathPoints.clear();
+  lineRanks.clear();
+  arrowRanks.clear();
+  changeCount++;
   blinkMode=false;
   startIndex=-1;
   endIndex=-1;
@@ -513,6 +569,13 @@ void NavigationPath::init() {
     //DEBUG("z=%d latScale=%e lngScale=%e",zoomLevel,latScale,lngScale);
   }
   core->getMapSource()->unlockAccess();
+
+  // Order the zoom levels into a pyramid
+  pyramidLevels=zoomLevelVisualizations;
+  std::sort(pyramidLevels.begin(),pyramidLevels.end(),compareVisualizationScale);
+  for(Int rank=0;rank<pyramidLevels.size();rank++) {
+    pyramidLevels[rank]->setRank(rank);
+  }
 }
 
 // Indicates that textures and buffers have been cleared
@@ -561,13 +624,42 @@ void NavigationPath::addVisualization(std::list<MapContainer*> *mapContainers) {
     if ((j==mapContainers->end())||(zoomLevel!=(*j)->getZoomLevelMap())) {
       if (zoomLevel!=-1) {
 
-        // Process the so far collected containers
+        // Collect the points of this zoom level
+        // Points outside of the maps of this zoom level interrupt the line
         MapPosition prevPoint=NavigationPath::getPathInterruptedPos();
         MapPosition prevArrowPoint;
         NavigationPathVisualization *visualization = zoomLevelVisualizations[zoomLevel-1];
+        std::vector<MapPosition> points;
+        std::vector<Int> indices;
         core->getMapSource()->lockAccess(__FILE__,__LINE__);
-        std::vector<MapPosition> points(*visualization->getPoints());
+        UByte rank=visualization->getRank();
+        const std::vector<NavigationPathUncoveredRange> *uncoveredRanges=visualization->getUncoveredRanges();
+        std::vector<NavigationPathUncoveredRange>::const_iterator uncoveredRange=uncoveredRanges->begin();
+        double colorOffset=0;
+        for(Int i=0;i<lineRanks.size();i++) {
+          while ((uncoveredRange!=uncoveredRanges->end())&&(uncoveredRange->second<i))
+            uncoveredRange++;
+          bool isCovered=(uncoveredRange==uncoveredRanges->end())||(uncoveredRange->first>i);
+          if ((pathPoints.isInterrupted(i))||(!isCovered)) {
+            if ((indices.size()>0)&&(indices.back()!=-1)) {
+              points.push_back(NavigationPath::getPathInterruptedPos());
+              indices.push_back(-1);
+            }
+          } else if (lineRanks[i]<=rank) {
+            MapPosition p=pathPoints.get(i);
+            p.setHasBearing(false);
+            if ((arrowRanks[i]<=rank)&&(indices.size()>0)&&(indices.back()!=-1)) {
+              p.setHasBearing(true);
+              p.setBearing(colorOffset);
+              colorOffset=NavigationPathVisualization::computeNextColorOffset(colorOffset,reverse);
+            }
+            points.push_back(p);
+            indices.push_back(i);
+          }
+        }
         core->getMapSource()->unlockAccess();
+
+        // Process the so far collected containers
         for(Int i=0;i<points.size();i++) {
 
           // Handle path interrupted positions
@@ -575,6 +667,11 @@ void NavigationPath::addVisualization(std::list<MapContainer*> *mapContainers) {
           if ((p==NavigationPath::getPathInterruptedPos())||(prevPoint==NavigationPath::getPathInterruptedPos())) {
             prevArrowPoint=p;
             prevPoint=p;
+            if (p!=NavigationPath::getPathInterruptedPos()) {
+              core->getMapSource()->lockAccess(__FILE__,__LINE__);
+              updateCrossingTileSegments(&mapContainersOfSameZoomLevel, visualization, p, indices[i], -1);
+              core->getMapSource()->unlockAccess();
+            }
           } else {
 
             /*if (p.getHasBearing()) {
@@ -586,7 +683,7 @@ void NavigationPath::addVisualization(std::list<MapContainer*> *mapContainers) {
 
             /// Update crossing tile segments
             core->getMapSource()->lockAccess(__FILE__,__LINE__);
-            updateCrossingTileSegments(&mapContainersOfSameZoomLevel, visualization, i);
+            updateCrossingTileSegments(&mapContainersOfSameZoomLevel, visualization, p, indices[i], indices[i-1]);
             core->getMapSource()->unlockAccess();
 
             // Remember the last point
@@ -641,190 +738,168 @@ void NavigationPath::computeNavigationInfo(MapPosition locationPos, MapPosition
     return;
   }
 
-  // Init variables
-  std::vector<MapPosition> mapPositions=getSelectedPoints();
-  std::vector<MapPosition>::iterator nearestIterator,fallbackNearestIterator;
-  Int startIndex, endIndex;
-  startIndex=reverse ? mapPositions.size()-1 : 0;
-  endIndex=reverse ? 0 : mapPositions.size()-1;
+  // Only one thread may use the matcher
+  core->getThread()->lockMutex(matcherMutex, __FILE__, __LINE__);
+
+  // Copy the selected points in the order they are travelled if they have changed
+  Int first, last;
+  getSelectedRange(first,last);
+  if (!matcher.isUpToDate(changeCount,first,last,reverse))
+    matcher.update(pathPoints,first,last,reverse,changeCount);
 
-  // All code after this point is using local variables or read-only class members
+  // All code after this point is using the matcher or read-only class members
   // We can safely unlock the general access to the path object
   core->getMapSource()->unlockAccess();
+  const NavigationPathPoints &points=matcher.getPoints();
+  const GeoPoint *geoPoints=points.getGeoPoints();
+  Int startIndex=0;
+  Int endIndex=points.size()-1;
+  if (points.size()==0) {
+    core->getThread()->unlockMutex(matcherMutex);
+    return;
+  }
 
   // Search for the nearest point on the route
   // In case we have location bearing, use the one that lies most close to the bearing
   // Otherwise, use the one most close to the route
+  // Only the segments near enough to the location are checked
   bool offRoute=true;
-  bool firstPos=true;
   double routeBearing=0;
   double minBearingDiff=std::numeric_limits<double>::max();
   double distanceToRoute=std::numeric_limits<double>::max();
-  double fallbackDistanceToRoute=std::numeric_limits<double>::max();
-  std::vector<MapPosition>::iterator iterator,prevIterator;
-  iterator=mapPositions.begin()+startIndex;
-  while (true) {
-
-    // Compute the fallback distance in case the normal distance calculation doesn't find a point
-    double distance = (*iterator).computeDistance(locationPos);
-    if (distance<fallbackDistanceToRoute)  {
-      fallbackDistanceToRoute=distance;
-      fallbackNearestIterator=iterator;
-    }
-
-    // Compute the current bearing of the route
-    if (!firstPos) {
-      routeBearing=(*prevIterator).computeBearing(*iterator);
-
-      // If the route point is around the nearest found point,
-      // remember the one that is closest to the location bearing
-      double distance=(*iterator).computeNormalDistance(*prevIterator,locationPos,0,true,false);
-      if (distance<minDistanceToBeOffRoute) {
-        offRoute=false; // in case the nearest point is too far away due to route with minimized points
-        double bearingDiff;
-        if (locationPos.getHasBearing()) {
-          bearingDiff=fabs(routeBearing-locationPos.getBearing());
-          if (bearingDiff<minBearingDiff) {
-            nearestIterator=iterator;
-            minBearingDiff=bearingDiff;
-            distanceToRoute=distance;
-          }
-        } else {
-          if (distance<distanceToRoute)  {
-            nearestIterator=iterator;
-            distanceToRoute=distance;
-          }
-        }
+  Int nearestIndex=0;
+  GeoPoint location=locationPos.getGeoPoint();
+  std::vector<std::pair<Int,double> > segments;
+  matcher.setLocation(location);
+  matcher.findSegments(minDistanceToBeOffRoute,segments);
+  for (std::vector<std::pair<Int,double> >::iterator i=segments.begin();i!=segments.end();i++) {
+    Int index=i->first;
+    double distance=i->second;
+    offRoute=false; // in case the nearest point is too far away due to route with minimized points
+    double bearingDiff;
+    if (locationPos.getHasBearing()) {
+      routeBearing=MapPosition::computeBearing(geoPoints[index-1],geoPoints[index]);
+      bearingDiff=fabs(routeBearing-locationPos.getBearing());
+      if (bearingDiff<minBearingDiff) {
+        nearestIndex=index;
+        minBearingDiff=bearingDiff;
+        distanceToRoute=distance;
       }
     } else {
-      firstPos=false;
-    }
-
-    // Select the next route point
-    prevIterator=iterator;
-    if (iterator==mapPositions.begin()+endIndex)
-      break;
-    if (reverse) {
-      iterator--;
-    } else {
-      iterator++;
+      if (distance<distanceToRoute)  {
+        nearestIndex=index;
+        distanceToRoute=distance;
+      }
     }
   }
+
+  // Use the nearest point in case the normal distance calculation doesn't find a segment
   if (distanceToRoute==std::numeric_limits<double>::max()) {
-    distanceToRoute=fallbackDistanceToRoute;
-    nearestIterator=fallbackNearestIterator;
+    double fallbackDistanceToRoute;
+    Int fallbackNearestIndex=matcher.findNearestPoint(fallbackDistanceToRoute);
+    if (fallbackNearestIndex!=-1) {
+      distanceToRoute=fallbackDistanceToRoute;
+      nearestIndex=fallbackNearestIndex;
+    }
   }
+  matcher.setMatchedIndex(nearestIndex);
   //DEBUG("distanceToRoute=%f",distanceToRoute);
   /*if (offRoute) {
-    DEBUG("off route: minDistance=%.2f index=%d",minDistance,nearestIterator-mapPositions.begin());
+    DEBUG("off route: minDistance=%.2f index=%d",minDistance,nearestIndex);
   } else {
-    DEBUG("on route:  minDistance=%.2f index=%d",minDistance,nearestIterator-mapPositions.begin());
+    DEBUG("on route:  minDistance=%.2f index=%d",minDistance,nearestIndex);
   }
-  core->getNavigationEngine()->setTargetAtGeographicCoordinate(nearestIterator->getLng(),nearestIterator->getLat(),false);
+  core->getNavigationEngine()->setTargetAtGeographicCoordinate(geoPoints[nearestIndex].lng,geoPoints[nearestIndex].lat,false);
   GraphicPosition *visPos=core->getGraphicEngine()->lockPos(__FILE__, __LINE__);
   visPos->updateLastUserModification();
   core->getGraphicEngine()->unlockPos();*/
 
   // From the nearest point, find the point at the predefined distance
+  // Stop as soon as the remaining points can not change the way point and turn point anymore
   bool wayPointSet = false;
   double distanceToRouteEnd=distanceToRoute;
   double turnAngle=NavigationInfo::getUnknownAngle();
-  MapPosition pos;
-  MapPosition lastValidPos=NavigationPath::getPathInterruptedPos();
-  MapPosition prevPos=NavigationPath::getPathInterruptedPos();
-  MapPosition bestTurnLookForwardPos;
-  MapPosition turnPoint;
-  iterator=std::vector<MapPosition>::iterator(nearestIterator);
+  Int lastValidIndex=-1;
+  Int bestTurnLookForwardIndex=-1;
+  Int turnPointIndex=-1;
+  Int index=nearestIndex;
+  Int prevIndex=-1;
   bool firstFrontPosFound = false;
   bool turnPointSet = false;
   bool prevPointWasTurnPoint = true;
   if (distanceToRoute!=std::numeric_limits<double>::max()) {
     while (true) {
-      pos = *iterator;
-      if (pos!=NavigationPath::getPathInterruptedPos()) {
-        lastValidPos=pos;
+      if (!points.isInterrupted(index)) {
+        lastValidIndex=index;
 
         // Compute the distance
-        if (prevPos!=NavigationPath::getPathInterruptedPos()) {
-          distanceToRouteEnd+=prevPos.computeDistance(pos);
+        if ((prevIndex!=-1)&&(!points.isInterrupted(prevIndex))) {
+          distanceToRouteEnd+=matcher.getSegmentLength(prevIndex);
         }
-        //core->getNavigationEngine()->setTargetAtGeographicCoordinate(pos.getLng(),pos.getLat(),false);
+        //core->getNavigationEngine()->setTargetAtGeographicCoordinate(geoPoints[index].lng,geoPoints[index].lat,false);
 
         // Ignore points that lie behind the current bearing for way point and turn point computation
-        double bearing = locationPos.computeBearing(pos);
+        double bearing = MapPosition::computeBearing(location,geoPoints[index]);
         if ((fabs(bearing-locationPos.getBearing())<90.0)||(firstFrontPosFound)) {
 
           // Determine the way point for target computation
-          double distanceFromLocation = pos.computeDistance(locationPos);
+          double distanceFromLocation = MapPosition::computeDistance(geoPoints[index],location);
           if ((!wayPointSet)&&(distanceFromLocation>minDistanceToRouteWayPoint)) {
-            wayPoint=pos;
+            wayPoint=points.get(index);
             wayPointSet=true;
           }
 
           // Update the look back and look forward points for turn detection
-          std::vector<MapPosition>::iterator turnIterator=iterator;
-          MapPosition turnLookBackPos=pos;
-          MapPosition prevPos2=pos;
+          Int turnIndex=index;
+          Int turnLookBackIndex=index;
           double distance=0;
           while (true) {
-            MapPosition pos2 = *turnIterator;
-            if (pos2==NavigationPath::getPathInterruptedPos()) {
+            if (points.isInterrupted(turnIndex)) {
               break;
             } else {
-              distance+=pos2.computeDistance(prevPos2);
-              prevPos2=pos2;
-              turnLookBackPos=pos2;
+              if (turnIndex!=index)
+                distance+=matcher.getSegmentLength(turnIndex);
+              turnLookBackIndex=turnIndex;
               if (distance>turnDetectionDistance) {
                 break;
               }
             }
-            if (turnIterator==mapPositions.begin()+startIndex)
+            if (turnIndex==startIndex)
               break;
-            if (reverse) {
-              turnIterator++;
-            } else {
-              turnIterator--;
-            }
+            turnIndex--;
           }
-          turnIterator=iterator;
-          MapPosition turnLookForwardPos=pos;
-          prevPos2=pos;
+          turnIndex=index;
+          Int turnLookForwardIndex=index;
           distance=0;
           while (true) {
-            MapPosition pos2 = *turnIterator;
-            if (pos2==NavigationPath::getPathInterruptedPos()) {
+            if (points.isInterrupted(turnIndex)) {
               break;
             } else {
-              distance+=pos2.computeDistance(prevPos2);
-              prevPos2=pos2;
-              turnLookForwardPos=pos2;
+              if (turnIndex!=index)
+                distance+=matcher.getSegmentLength(turnIndex-1);
+              turnLookForwardIndex=turnIndex;
               if (distance>turnDetectionDistance) {
                 break;
               }
             }
-            if (turnIterator==mapPositions.begin()+endIndex)
+            if (turnIndex==endIndex)
               break;
-            if (reverse) {
-              turnIterator--;
-            } else {
-              turnIterator++;
-            }
+            turnIndex++;
           }
-
           // If we are off route and this is the first route point:
           // Mark it as a turn
           if ((offRoute)&&(!firstFrontPosFound)) {
             //DEBUG("marking first route point as turn",NULL);
             turnPointSet=true;
-            turnPoint=pos;
-            bestTurnLookForwardPos=turnLookForwardPos;
+            turnPointIndex=index;
+            bestTurnLookForwardIndex=turnLookForwardIndex;
             prevPointWasTurnPoint=false;
           }
           firstFrontPosFound=true;
 
           // Turn detection
-          double turnLookBackAngle=pos.computeBearing(turnLookBackPos);
-          double turnLookForwardAngle=pos.computeBearing(turnLookForwardPos);
+          double turnLookBackAngle=MapPosition::computeBearing(geoPoints[index],geoPoints[turnLookBackIndex]);
+          double turnLookForwardAngle=MapPosition::computeBearing(geoPoints[index],geoPoints[turnLookForwardIndex]);
           double angle=turnLookForwardAngle-turnLookBackAngle;
           if (angle<0)
             angle+=360;
@@ -833,22 +908,22 @@ void NavigationPath::computeNavigationInfo(MapPosition locationPos, MapPosition
           angle=180-angle;
           /*if ((!turnPointSet)||(prevPointWasTurnPoint)) {
             DEBUG("lookBackAngle=%f loockForwardAngle=%f angle=%f",turnLookBackAngle,turnLookForwardAngle,angle);
-            core->getNavigationEngine()->setTargetAtGeographicCoordinate(pos.getLng(),pos.getLat(),false);
+            core->getNavigationEngine()->setTargetAtGeographicCoordinate(geoPoints[index].lng,geoPoints[index].lat,false);
             sleep(1);
           }*/
           if (fabs(angle)>minTurnAngle) {
             if (prevPointWasTurnPoint) {
-              //DEBUG("turn point candidate found: lat=%f, lng=%f, angle=%f",pos.getLat(),pos.getLng(),angle);
+              //DEBUG("turn point candidate found: lat=%f, lng=%f, angle=%f",geoPoints[index].lat,geoPoints[index].lng,angle);
               if (!turnPointSet) {
-                turnPoint=pos;
-                bestTurnLookForwardPos=turnLookForwardPos;
+                turnPointIndex=index;
+                bestTurnLookForwardIndex=turnLookForwardIndex;
                 turnAngle=angle;
                 //DEBUG("candidate set",NULL);
               } else {
                 if (turnAngle<0) {
                   if ((angle<0)&&(angle<turnAngle)) {
-                    turnPoint=pos;
-                    bestTurnLookForwardPos=turnLookForwardPos;
+                    turnPointIndex=index;
+                    bestTurnLookForwardIndex=turnLookForwardIndex;
                     turnAngle=angle;
                     //DEBUG("candidate set",NULL);
                   } else {
@@ -856,8 +931,8 @@ void NavigationPath::computeNavigationInfo(MapPosition locationPos, MapPosition
                   }
                 } else {
                   if ((angle>0)&&(angle>turnAngle)) {
-                    turnPoint=pos;
-                    bestTurnLookForwardPos=turnLookForwardPos;
+                    turnPointIndex=index;
+                    bestTurnLookForwardIndex=turnLookForwardIndex;
                     turnAngle=angle;
                     //DEBUG("candidate set",NULL);
                   } else {
@@ -874,22 +949,32 @@ void NavigationPath::computeNavigationInfo(MapPosition locationPos, MapPosition
           }
         }
       }
-      prevPos=pos;
-      if (iterator==mapPositions.begin()+endIndex)
+      prevIndex=index;
+      if (index==endIndex)
+        break;
+
+      // Skip the remaining points if they can not change the result anymore
+      // This is the case if the turn point is complete or if any later turn point would be too far away
+      if ((wayPointSet)&&(((turnPointSet)&&(!prevPointWasTurnPoint))||((!turnPointSet)&&(matcher.isFartherAway(index+1,maxDistanceToTurnWayPoint))))) {
+        distanceToRouteEnd+=matcher.getRemainingLength(index);
         break;
-      if (reverse) {
-        iterator--;
-      } else {
-        iterator++;
       }
+      index++;
     }
   }
   if (!wayPointSet) {
-    if (lastValidPos!=NavigationPath::getPathInterruptedPos())
-      wayPoint=pos;
+    if (lastValidIndex!=-1)
+      wayPoint=points.get(prevIndex);
     else
       wayPoint.invalidate();
   }
+  MapPosition turnPoint;
+  MapPosition bestTurnLookForwardPos;
+  if (turnPointIndex!=-1) {
+    turnPoint=points.get(turnPointIndex);
+    bestTurnLookForwardPos=points.get(bestTurnLookForwardIndex);
+  }
+  core->getThread()->unlockMutex(matcherMutex);
   double turnDistance=locationPos.computeDistance(turnPoint);
   if ((!turnPointSet)||(turnDistance>maxDistanceToTurnWayPoint)||(turnDistance<minDistanceToTurnWayPoint)) {
     turnPoint.invalidate();
@@ -920,33 +1005,37 @@ void NavigationPath::computeNavigationInfo(MapPosition locationPos, MapPosition
   navigationInfo.setTurnDistance(turnDistance);
 }
 
-// Computes the metrics for the given map positions
-void NavigationPath::updateMetrics(MapPosition prevPoint, MapPosition curPoint) {
+// Computes the metrics for the given points
+void NavigationPath::updateMetrics(Int prevIndex, Int curIndex, double distance) {
+  bool prevPointInterrupted=(prevIndex==-1)||(pathPoints.isInterrupted(prevIndex));
+  bool curPointInterrupted=pathPoints.isInterrupted(curIndex);
+  const GeoPoint &curPoint=pathPoints.getGeoPoint(curIndex);
 
   // Reset the altitude filter if path is interrupted
-  if (curPoint==NavigationPath::getPathInterruptedPos()) {
+  if (curPointInterrupted) {
     lastValidAltiudeMeters=NAN;
   } else {
-    if (prevPoint==NavigationPath::getPathInterruptedPos()) {
+    if (prevPointInterrupted) {
       lastValidAltiudePos=curPoint;
     }    
   }
-  if ((prevPoint!=NavigationPath::getPathInterruptedPos())&&(curPoint!=NavigationPath::getPathInterruptedPos())) {
-    //DEBUG("prevPoint.altitude=%f curPoint.altitude=%f lastValidAltiudeMeters=%f",prevPoint.getAltitude(),curPoint.getAltitude(),lastValidAltiudeMeters);
-    length+=prevPoint.computeDistance(curPoint);
-    MapPosition demPos=curPoint;
-    demPos.setHasAltitude(false);
+  if ((!prevPointInterrupted)&&(!curPointInterrupted)) {
+    //DEBUG("prevPoint.altitude=%f curPoint.altitude=%f lastValidAltiudeMeters=%f",pathPoints.getAltitude(prevIndex),pathPoints.getAltitude(curIndex),lastValidAltiudeMeters);
+    length+=distance;
+    MapPosition demPos;
     if (calculateAltitudeGainsFromDEM) {
+      demPos=pathPoints.get(curIndex);
+      demPos.setHasAltitude(false);
       core->getElevationEngine()->getElevation(&demPos);
     }
-    if ((demPos.getHasAltitude())||(curPoint.getHasAltitude())) {
+    if ((demPos.getHasAltitude())||(pathPoints.getHasAltitude(curIndex))) {
         
       // Decide which source to use
       double altitude=NAN;
       if (demPos.getHasAltitude()) {
         altitude=demPos.getAltitude();
       } else {
-        altitude=curPoint.getAltitude();
+        altitude=pathPoints.getAltitude(curIndex);
       }
 
       // Do we have an altitude?
@@ -960,7 +1049,7 @@ void NavigationPath::updateMetrics(MapPosition prevPoint, MapPosition curPoint)
         // Check if the altitude difference is sane
         // Check if we are far enough away from last point
         double altitudeDiff = altitude - lastValidAltiudeMeters;
-        double distanceDiff = lastValidAltiudePos.computeDistance(curPoint);
+        double distanceDiff = MapPosition::computeDistance(lastValidAltiudePos,curPoint);
         if (distanceDiff>=minDistanceToCalculateAltitude) {
 
           // Update the altitude meters
@@ -992,12 +1081,13 @@ void NavigationPath::updateMetrics(MapPosition prevPoint, MapPosition curPoint)
       }
     }
   }
-  if (curPoint.getHasAltitude()) {
-    if (curPoint.getAltitude()<minAltitude) {
-      minAltitude=curPoint.getAltitude();
+  if (pathPoints.getHasAltitude(curIndex)) {
+    double prevAltitude=(prevIndex==-1) ? NavigationPath::getPathInterruptedPos().getAltitude() : pathPoints.getAltitude(prevIndex);
+    if (pathPoints.getAltitude(curIndex)<minAltitude) {
+      minAltitude=pathPoints.getAltitude(curIndex);
     }
-    if (prevPoint.getAltitude()>maxAltitude) {
-      maxAltitude=curPoint.getAltitude();
+    if (prevAltitude>maxAltitude) {
+      maxAltitude=pathPoints.getAltitude(curIndex);
     }
   }
 }
@@ -1005,19 +1095,20 @@ void NavigationPath::updateMetrics(MapPosition prevPoint, MapPosition curPoint)
 // Updates the metrics (altitude, length, duration, ...) of the path
 void NavigationPath::updateMetrics() {
   Int startIndex, endIndex;
-  MapPosition prevPos = NavigationPath::getPathInterruptedPos();
-  startIndex=reverse ? mapPositions.size()-1 : 0;
+  Int prevIndex = -1;
+  Int size = pathPoints.size();
+  startIndex=reverse ? size-1 : 0;
   if (this->startIndex!=-1)
     startIndex=this->startIndex;
-  endIndex=reverse ? 0 : mapPositions.size()-1;
+  endIndex=reverse ? 0 : size-1;
   if (this->endIndex!=-1)
     endIndex=this->endIndex;
   if (reverse) {
-    if (startIndex<mapPositions.size()-1)
-      prevPos=mapPositions[startIndex+1];
+    if (startIndex<size-1)
+      prevIndex=startIndex+1;
   } else {
     if (startIndex>0)
-      prevPos=mapPositions[startIndex-1];
+      prevIndex=startIndex-1;
   }
   length=0;
   altitudeUp=0;
@@ -1027,11 +1118,31 @@ void NavigationPath::updateMetrics() {
   altitudeUpBuffer=0;
   altitudeDownBuffer=0;
   lastValidAltiudeMeters=NAN;
-  lastValidAltiudePos=NavigationPath::getPathInterruptedPos();
+  lastValidAltiudePos=NavigationPath::getPathInterruptedPos().getGeoPoint();
+
+  // Compute the lengths of all segments that are visited in one pass
+  // segmentLengths[i] is the length of the segment between point first+i and first+i+1
+  Int first, last;
+  if (reverse) {
+    first=endIndex+1;
+    last=(prevIndex!=-1) ? prevIndex : startIndex;
+  } else {
+    first=(prevIndex!=-1) ? prevIndex : startIndex;
+    last=endIndex-1;
+  }
+  std::vector<double> segmentLengths;
+  if (last>first) {
+    segmentLengths.resize(last-first);
+    MapPosition::computeDistances(pathPoints.getGeoPoints()+first,last-first+1,&segmentLengths[0]);
+  }
+
   //DEBUG("starting metric calculation for path %s",getGpxFilename().c_str());
   for(Int i=startIndex;reverse?i>endIndex:i<endIndex;reverse?i--:i++) {
-    updateMetrics(prevPos,mapPositions[i]);
-    prevPos=mapPositions[i];
+    double distance=0;
+    if (prevIndex!=-1)
+      distance=segmentLengths[(reverse ? i : prevIndex)-first];
+    updateMetrics(prevIndex,i,distance);
+    prevIndex=i;
   }
 }
 
@@ -1051,15 +1162,15 @@ void NavigationPath::setStartFlag(Int index, const char *file, int line) {
 
     // Shall the start flag be resetted?
     if (index==-2) {
-      index = reverse ? mapPositions.size()-1 : 0;
+      index = reverse ? pathPoints.size()-1 : 0;
     }
 
     // First check if start flag is within range of path
     //DEBUG("index=%d",index);
     if (index<0)
       index=0;
-    if (index>mapPositions.size()-1)
-      index=mapPositions.size()-1;
+    if (index>pathPoints.size()-1)
+      index=pathPoints.size()-1;
     //DEBUG("index=%d",index);
 
     // If the new start flag is behind the end flag, set the end flag to the start flag
@@ -1117,15 +1228,15 @@ void NavigationPath::setEndFlag(Int index, const char *file, int line) {
 
     // Shall the end flag be resetted?
     if (index==-2) {
-      index = reverse ? 0 : mapPositions.size()-1;
+      index = reverse ? 0 : pathPoints.size()-1;
     }
 
     // First check if end flag is within range of path
     //DEBUG("index=%d",index);
     if (index<0)
       index=0;
-    if (index>mapPositions.size()-1)
-      index=mapPositions.size()-1;
+    if (index>pathPoints.size()-1)
+      index=pathPoints.size()-1;
     //DEBUG("index=%d",index);
 
     // If the new end flag is behind the start flag, set the start flag to the end flag
@@ -1167,110 +1278,71 @@ void NavigationPath::setEndFlag(Int index, const char *file, int line) {
   core->onPathChange(this, NavigationPathChangeTypeFlagSet);
 }
 
-// Returns the points selected by the flags
-std::vector<MapPosition> NavigationPath::getSelectedPoints() {
-  //DEBUG("startIndex=%d endIndex=%d size=%d reverse=%d",startIndex,endIndex,mapPositions.size(),reverse);
-  if ((startIndex==-1)&&(endIndex==-1))
-    return mapPositions;
-  else {
-    Int startIndex;
-    Int endIndex;
-    if (reverse) {
-      endIndex=0;
-      startIndex=mapPositions.size()-1;
-    } else {
-      startIndex=0;
-      endIndex=mapPositions.size()-1;
-    }
-    if (this->startIndex!=-1)
-      startIndex=this->startIndex;
-    if (this->endIndex!=-1)
-      endIndex=this->endIndex;
-    std::vector<MapPosition>::iterator startIterator;
-    std::vector<MapPosition>::iterator endIterator;
-    if (reverse) {
-      startIterator = mapPositions.begin()+endIndex;
-      endIterator = mapPositions.begin()+startIndex+1;
-    } else {
-      startIterator = mapPositions.begin()+startIndex;
-      endIterator = mapPositions.begin()+endIndex+1;
-    }
-    return std::vector<MapPosition>(startIterator,endIterator);
+// Returns the range of points selected by the flags in the order they are stored
+void NavigationPath::getSelectedRange(Int &first, Int &last) const {
+  Int startIndex;
+  Int endIndex;
+  if (reverse) {
+    endIndex=0;
+    startIndex=pathPoints.size()-1;
+  } else {
+    startIndex=0;
+    endIndex=pathPoints.size()-1;
+  }
+  if (this->startIndex!=-1)
+    startIndex=this->startIndex;
+  if (this->endIndex!=-1)
+    endIndex=this->endIndex;
+  if (reverse) {
+    first=endIndex;
+    last=startIndex;
+  } else {
+    first=startIndex;
+    last=endIndex;
   }
 }
 
-// Store the contents of the object in a binary file
-void NavigationPath::store(std::ofstream *ofs) {
-
-  // Write the size of the object for detecting changes later
-  Int size=sizeof(*this);
-  Storage::storeInt(ofs,size);
-
-  // Store all relevant fields
-  Storage::storeString(ofs,name.c_str());
-  Storage::storeString(ofs,description.c_str());
-
-  // Store all positions
-  Storage::storeInt(ofs,mapPositions.size());
-  for (int i=0;i<mapPositions.size();i++) {
-    mapPositions[i].store(ofs);
-  }
+// Returns the points selected by the flags
+std::vector<MapPosition> NavigationPath::getSelectedPoints() {
+  //DEBUG("startIndex=%d endIndex=%d size=%d reverse=%d",startIndex,endIndex,pathPoints.size(),reverse);
+  Int first, last;
+  getSelectedRange(first,last);
+  return pathPoints.getMapPositions(first,last+1);
 }
 
-// Reads the contents of the object from a binary file
-bool NavigationPath::retrieve(NavigationPath *navigationPath, char *&cacheData, Int &cacheSize) {
+// Reads the contents of the object from a binary route file
+bool NavigationPath::retrieve(NavigationPath *navigationPath, std::string filePath) {
 
   //PROFILE_START;
   bool success=true;
   std::list<std::string> status;
   Int processedPercentage, prevProcessedPercentage=-1;
   std::stringstream progress;
+  NavigationPathPoints points;
 
   status.push_back("Loading cached path (init):");
   status.push_back(navigationPath->getGpxFilename());
 
-  // Check if the class has changed
-  Int size=sizeof(NavigationPath);
-#ifdef TARGET_LINUX
-  if (size!=1512) {
-    FATAL("unknown size of object (%d), please adapt class storage",size);
-    core->getMapSource()->unlockAccess();
-    return false;
-  }
-#endif
-
-  // Read the size of the object and check with current size
-  size=0;
-  Storage::retrieveInt(cacheData,cacheSize,size);
-  if (size!=sizeof(NavigationPath)) {
-    DEBUG("stored size of object does not match implemented object size, aborting retrieve",NULL);
-    return false;
-  }
-  //PROFILE_ADD("sanity check");
+  Int size;
 
   // Backup important data
   std::string oldName = navigationPath->name;
   std::string oldDescription = navigationPath->description;
 
-  // Read the fields
-  char *str;
-  Storage::retrieveString(cacheData,cacheSize,&str);
-  navigationPath->name=std::string(str);
-  Storage::retrieveString(cacheData,cacheSize,&str);
-  navigationPath->description=std::string(str);
-
-  // Read all positions
-  Storage::retrieveInt(cacheData,cacheSize,size);
+  // Read the fields and all positions
+  if (!points.read(filePath,navigationPath->name,navigationPath->description)) {
+    success=false;
+    goto cleanup;
+  }
+  size=points.size();
   for (int i=0;i<size;i++) {
 
-    // Retrieve the map container
-    MapPosition *p=MapPosition::retrieve(cacheData,cacheSize);
-    if ((p==NULL)||(core->getQuitCore())) {
-      navigationPath->mapPositions.resize(i);
+    // Add the position to the path
+    if (core->getQuitCore()) {
       success=false;
       goto cleanup;
     }
-    navigationPath->addEndPosition(*p);
+    navigationPath->addEndPosition(points.get(i));
 
     // Update status
     processedPercentage=i*100/size;
@@ -1287,7 +1359,11 @@ cleanup:
   if (!success) {
     navigationPath->name=oldName;
     navigationPath->description=oldDescription;
-    navigationPath->mapPositions.clear();
+    core->getNavigationEngine()->getSpatialIndex()->removePath(navigationPath);
+    navigationPath->pathPoints.clear();
+    navigationPath->lineRanks.clear();
+    navigationPath->arrowRanks.clear();
+    navigationPath->changeCount++;
   }
 
   return success;
@@ -1317,6 +1393,8 @@ void NavigationPath::setBlinkMode(bool blinkMode, const char *file, int line)
 void NavigationPath::setGpxFilename(std::string gpxFilename)
 {
   this->gpxFilename = gpxFilename;
+  if (journal)
+    journal->open(gpxFilefolder + "/" + gpxFilename);
   core->getDefaultGraphicEngine()->lockPathAnimators(__FILE__, __LINE__);
   std::list<std::string> name;
   name.push_back(gpxFilename);
@@ -1324,6 +1402,42 @@ void NavigationPath::setGpxFilename(std::string gpxFilename)
   core->getDefaultGraphicEngine()->unlockPathAnimators();
 }
 
+// Records all added points in a journal next to the gpx file
+void NavigationPath::createJournal() {
+  if (!(journal=new NavigationPathJournal())) {
+    FATAL("can not create navigation path journal object",NULL);
+    return;
+  }
+  journal->open(gpxFilefolder + "/" + gpxFilename);
+}
+
+// Adds the points of the journal that are not yet stored in the gpx file
+void NavigationPath::replayJournal() {
+  if (!journal)
+    return;
+  core->getMapSource()->lockAccess(__FILE__, __LINE__);
+  Int storedCount=pathPoints.size();
+  core->getMapSource()->unlockAccess();
+  std::list<MapPosition> missingPoints;
+  journal->replay(storedCount,missingPoints);
+  for (std::list<MapPosition>::iterator i=missingPoints.begin();i!=missingPoints.end();i++) {
+    addEndPosition(*i);
+  }
+  if (missingPoints.size()>0)
+    DEBUG("recovered %d points of <%s> from its journal",(Int)missingPoints.size(),gpxFilename.c_str());
+}
+
+// Secures the added points on disk
+void NavigationPath::backup(bool compact) {
+  if (journal) {
+    journal->sync();
+    Int count=journal->getRecordCount();
+    if ((!compact)&&(count>0)&&(count<journal->getMaxCount()))
+      return;
+  }
+  writeGPXFile(); // locking is handled within method
+}
+
 // Sets the folder for the gpx file
 void NavigationPath::setGpxFilefolder(std::string gpxFilefolder) {
   this->gpxFilefolder = gpxFilefolder;
@@ -1340,38 +1454,47 @@ void NavigationPath::setGpxFilefolder(std::string gpxFilefolder) {
 // Computes the distance from the start flag to the given point
 double NavigationPath::computeDistance(MapPosition targetPos, double overlapInMeters, MapPosition &selectedPos) {
 
+  // Compute the distances of all points in one pass
+  // segmentLengths[i] is the length of the segment between point i and i+1
+  Int first, last;
+  getSelectedRange(first,last);
+  NavigationPathPoints points=pathPoints.getRange(first,last+1);
+  Int size=points.size();
+  if (size==0)
+    return 0;
+  std::vector<double> targetDistances(size);
+  std::vector<double> segmentLengths(size);
+  MapPosition::computeDistances(points.getGeoPoints(),size,targetPos.getGeoPoint(),&targetDistances[0]);
+  MapPosition::computeDistances(points.getGeoPoints(),size,&segmentLengths[0]);
+
   // Find the nearest pos on the route to the given one
-  std::vector<MapPosition> points=getSelectedPoints();
   double nearestDistance=std::numeric_limits<double>::max();
   double selectedDistance=0;
   double distance=0;
-  double bearing;
-  MapPosition prevPathPos=NavigationPath::getPathInterruptedPos();
-  for (int i=0; i<points.size(); i++) {
-    MapPosition pos;
+  Int prevIndex=-1;
+  for (int i=0; i<size; i++) {
+    Int index;
     if (getReverse())
-      pos=points[points.size()-1-i];
+      index=size-1-i;
     else
-      pos=points[i];
-    if ((prevPathPos!=NavigationPath::getPathInterruptedPos())&&(pos!=NavigationPath::getPathInterruptedPos())) {
-      distance+=prevPathPos.computeDistance(pos);
-      double d=pos.computeDistance(targetPos);
-      MapPosition t;
-      if ((pos.computeNormalDistance(prevPathPos,targetPos,overlapInMeters,true,false,&t)!=std::numeric_limits<double>::max())) {
-        if (d<nearestDistance) {
-          //bearing=fabs(prevPathPos.computeBearing(points[i])-points[i].computeBearing(pos));
-          nearestDistance=d;          
-          /*if (bearing>90) 
-            selectedDistance=distance-points[i].computeDistance(pos);
-          else
-            selectedDistance=distance-points[i].computeDistance(pos);*/
-          selectedDistance=distance-pos.computeDistance(targetPos);
+      index=i;
+    if ((prevIndex!=-1)&&(!points.isInterrupted(prevIndex))&&(!points.isInterrupted(index))) {
+      distance+=segmentLengths[getReverse() ? index : prevIndex];
+      double d=targetDistances[index];
+
+      // Only check the normal of segments that are nearer than the current best one
+      if (d<nearestDistance) {
+        MapPosition t;
+        MapPosition pos=points.get(index);
+        if ((pos.computeNormalDistance(points.get(prevIndex),targetPos,overlapInMeters,true,false,&t)!=std::numeric_limits<double>::max())) {
+          nearestDistance=d;
+          selectedDistance=distance-d;
           selectedPos=t;
-          //DEBUG("i=%d d=%f bearing=%f selectedDistance=%f",i,d,bearing,selectedDistance);
+          //DEBUG("i=%d d=%f selectedDistance=%f",i,d,selectedDistance);
         }
-      } 
+      }
     }
-    prevPathPos=pos;
+    prevIndex=index;
   }
   return selectedDistance;
 }
@@ -21,6 +21,9 @@
 //============================================================================
 
 #include <MapPosition.h>
+#include <NavigationPathPoints.h>
+#include <NavigationPathJournal.h>
+#include <NavigationPathMatcher.h>
 #include <GraphicPrimitive.h>
 #include <GraphicObject.h>
 #include <NavigationPathVisualization.h>
@@ -41,8 +44,10 @@ class NavigationPath {
 
 protected:
 
-  char *cacheData;                                // Pointer to the cache (if used)
-  std::vector<MapPosition> mapPositions;          // List of map positions the path consists of
+  NavigationPathPoints pathPoints;                // List of points the path consists of
+  ULong changeCount;                              // Incremented whenever points are added or removed
+  NavigationPathMatcher matcher;                  // Matches locations to the selected points for navigation
+  ThreadMutexInfo *matcherMutex;                  // Mutex for accessing the matcher
   Int startIndex;                                 // Current start in mapPosition list
   Int endIndex;                                   // Current end in mapPosition list
   std::string name;                               // The name of the path
@@ -55,7 +60,7 @@ protected:
   MapPosition secondLastPoint;                    // The point added before the last point
   bool hasSecondLastPoint;                        // Indicates if the path already has its second last point
   double lastValidAltiudeMeters;                  // The last (filtered) altitude that was used for altitude meter computation
-  MapPosition lastValidAltiudePos;                // The last position that was used for altitude meter computation
+  GeoPoint lastValidAltiudePos;                   // The last position that was used for altitude meter computation
   bool blinkMode;                                 // Indicates if the path shall blink
   GraphicColor normalColor;                       // Normal color of the path
   GraphicColor highlightColor;                    // Highlight color of the path
@@ -82,6 +87,7 @@ protected:
   double trackRecordingMinDistance;               // Required minimum navigationDistance in meter to the last track point such that the point is added to the track
   NavigationPatImportWaypointsType importWaypoints; // Decides if the waypoints contained in the route shall be imported
   bool calculateAltitudeGainsFromDEM;             // Decides if track/route altitude is ignored and DEM data is used instead to calculate altitude gains
+  NavigationPathJournal *journal;                 // Journal of the added points (NULL if the path has none)
 
   // Information about the path
   double length;                                  // Current length of the track in meters
@@ -92,39 +98,46 @@ protected:
 
   // Visualization of the path for each zoom level
   std::vector<NavigationPathVisualization*> zoomLevelVisualizations;
+
+  // Visualizations sorted from the coarsest to the finest zoom level
+  std::vector<NavigationPathVisualization*> pyramidLevels;
+
+  // Coarsest pyramid level in which a point is part of the line or has an arrow (one entry per point)
+  std::vector<UByte> lineRanks;
+  std::vector<UByte> arrowRanks;
   
   // Filter to smooth altitude values
   double altitudeUpBuffer, altitudeDownBuffer;
 
-  // Finds nodes in a xml tree
-  std::list<XMLNode> findNodes(XMLDocument document, XMLXPathContext xpathCtx, std::string path);
-
-  // Extracts information about the path from the given node set
-  void extractInformation(std::list<XMLNode> nodes);
+  // Extracts information about the path from the given node
+  void extractInformation(XMLNode node);
 
   // Updates the visualization of the tile (path line and arrows)
   void updateTileVisualization(std::list<MapContainer*> *mapContainers, NavigationPathVisualization *visualization, MapPosition prevPos, MapPosition prevArrowPos, MapPosition currentPos);
 
   // Updates the crossing path segments in the map tiles of the given map containers for the new point
-  void updateCrossingTileSegments(std::list<MapContainer*> *mapContainers, NavigationPathVisualization *visualization, Int pos);
+  void updateCrossingTileSegments(std::list<MapContainer*> *mapContainers, NavigationPathVisualization *visualization, MapPosition pos, Int index, Int prevIndex);
 
   // Updates the metrics (altitude, length, duration, ...) of the path
   void updateMetrics();
 
-  // Computes the metrics for the given map positions
-  void updateMetrics(MapPosition prevPoint, MapPosition curPoint);
+  // Computes the metrics for the given points (prevIndex is -1 if there is no previous point)
+  void updateMetrics(Int prevIndex, Int curIndex, double distance);
 
-  // Store the contents of the object in a binary file
-  void store(std::ofstream *ofs);
+  // Returns the range of points selected by the flags in the order they are stored
+  void getSelectedRange(Int &first, Int &last) const;
 
-  // Reads the contents of the object from a binary file
-  static bool retrieve(NavigationPath *navigationPath, char *&cacheData, Int &cacheSize);
+  // Reads the contents of the object from a binary route file
+  static bool retrieve(NavigationPath *navigationPath, std::string filePath);
 
   // Writes the cache to a file
   void writeCache();
 
 public:
 
+  // Rank of a point that is not used in any pyramid level
+  static const UByte noRank;
+
   // Constructor
   NavigationPath();
 
@@ -140,6 +153,16 @@ public:
   // Reads the path contents from a gpx file
   bool readGPXFile();
 
+  // Records all added points in a journal next to the gpx file
+  void createJournal();
+
+  // Adds the points of the journal that are not yet stored in the gpx file
+  void replayJournal();
+
+  // Secures the added points on disk
+  // The gpx file is only rewritten if requested, if the journal has grown too large or if the path was changed otherwise
+  void backup(bool compact);
+
   // Clears the graphical representation
   void deinit();
 
@@ -322,7 +345,11 @@ public:
   }
 
   MapPosition getPoint(Int index) {
-    return mapPositions[index];
+    return pathPoints.get(index);
+  }
+
+  const NavigationPathPoints &getPathPoints() const {
+    return pathPoints;
   }
 
   std::vector<MapPosition> getSelectedPoints();
@@ -344,10 +371,10 @@ public:
   }
 
   Int getSelectedSize() const {
-    if (mapPositions.size()==0)
+    if (pathPoints.size()==0)
       return 0;
     Int startIndex=0;
-    Int endIndex=mapPositions.size()-1;
+    Int endIndex=pathPoints.size()-1;
     if (this->reverse) {
       startIndex=endIndex;
       endIndex=0;
@@ -363,17 +390,17 @@ public:
   }
 
   MapPosition getStartFlagPos() const {
-    Int startIndex=reverse ? mapPositions.size()-1 : 0;
+    Int startIndex=reverse ? pathPoints.size()-1 : 0;
     if (this->startIndex!=-1)
       startIndex=this->startIndex;
-    return mapPositions[startIndex];
+    return pathPoints.get(startIndex);
   }
 
   MapPosition getEndFlagPos() const {
-    Int endIndex=reverse ? 0 : mapPositions.size()-1;
+    Int endIndex=reverse ? 0 : pathPoints.size()-1;
     if (this->endIndex!=-1)
       endIndex=this->endIndex;
-    return mapPositions[endIndex];
+    return pathPoints.get(endIndex);
   }
 };
 
@@ -0,0 +1,295 @@
+//============================================================================
+// Name        : NavigationPathJournal.cpp
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <Core.h>
+#include <NavigationPathJournal.h>
+#include <NavigationPath.h>
+#include <fcntl.h>
+#include <zlib.h>
+
+namespace GEODISCOVERER {
+
+const char NavigationPathJournal::magic[8] = { 'G','D','J','R','N','A','L','\0' };
+const UInt NavigationPathJournal::version = 1;
+const std::string NavigationPathJournal::filenameExtension = ".journal";
+
+// Converts a journal record into a map position
+static MapPosition getPosition(const NavigationPathJournalRecord &record) {
+  if (record.flags&NavigationPathPointInterrupted)
+    return NavigationPath::getPathInterruptedPos();
+  MapPosition pos;
+  pos.setLat(record.lat);
+  pos.setLng(record.lng);
+  pos.setAltitude(record.altitude);
+  pos.setHasAltitude(record.flags&NavigationPathPointHasAltitude);
+  pos.setIsWGS84Altitude(record.flags&NavigationPathPointIsWGS84Altitude);
+  pos.setTimestamp(record.timestamp);
+  pos.setHasTimestamp(record.flags&NavigationPathPointHasTimestamp);
+  if (record.flags&NavigationPathPointHasBearing) {
+    pos.setHasBearing(true);
+    pos.setBearing(record.bearing);
+  }
+  if (record.flags&NavigationPathPointHasSpeed) {
+    pos.setHasSpeed(true);
+    pos.setSpeed(record.speed);
+  }
+  if (record.flags&NavigationPathPointHasAccuracy) {
+    pos.setHasAccuracy(true);
+    pos.setAccuracy(record.accuracy);
+  }
+  return pos;
+}
+
+// Constructor
+NavigationPathJournal::NavigationPathJournal() {
+  fileDescriptor=-1;
+  syncedCount=0;
+  accessMutex=core->getThread()->createMutex("navigation path journal access mutex");
+  syncCount=core->getConfigStore()->getIntValue("Navigation","trackJournalSyncCount", __FILE__, __LINE__);
+  maxCount=core->getConfigStore()->getIntValue("Navigation","trackJournalMaxCount", __FILE__, __LINE__);
+}
+
+// Destructor
+NavigationPathJournal::~NavigationPathJournal() {
+  core->getThread()->lockMutex(accessMutex, __FILE__, __LINE__);
+  writeRecords();
+  closeFile();
+  core->getThread()->unlockMutex(accessMutex);
+  core->getThread()->destroyMutex(accessMutex);
+}
+
+// Computes the checksum of the record
+UInt NavigationPathJournal::computeChecksum(const NavigationPathJournalRecord &record) {
+  NavigationPathJournalRecord t=record;
+  t.checksum=0;
+  return adler32(adler32(0,Z_NULL,0),(const Bytef*)&t,sizeof(t));
+}
+
+// Closes the journal file
+void NavigationPathJournal::closeFile() {
+  if (fileDescriptor!=-1) {
+    close(fileDescriptor);
+    fileDescriptor=-1;
+  }
+}
+
+// Writes all records into a new journal file
+bool NavigationPathJournal::rewrite() {
+
+  // Without records, the journal is not needed anymore
+  closeFile();
+  syncedCount=0;
+  if (records.size()==0) {
+    remove(filePath.c_str());
+    return true;
+  }
+
+  // Write the header and all records into a temporary file
+  NavigationPathJournalHeader header;
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,magic,sizeof(magic));
+  header.version=version;
+  header.byteOrder=1;
+  std::string tempFilePath=filePath+"+";
+  int fd=::open(tempFilePath.c_str(),O_WRONLY|O_CREAT|O_TRUNC,S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+  if (fd==-1) {
+    ERROR("can not open journal <%s> for writing",tempFilePath.c_str());
+    return false;
+  }
+  size_t recordsSize=records.size()*sizeof(NavigationPathJournalRecord);
+  bool errorOccured=false;
+  if (write(fd,&header,sizeof(header))!=(ssize_t)sizeof(header))
+    errorOccured=true;
+  if ((!errorOccured)&&(write(fd,&records[0],recordsSize)!=(ssize_t)recordsSize))
+    errorOccured=true;
+  if ((!errorOccured)&&(fsync(fd)!=0))
+    errorOccured=true;
+  close(fd);
+  if (errorOccured) {
+    ERROR("can not write journal <%s>",tempFilePath.c_str());
+    remove(tempFilePath.c_str());
+    return false;
+  }
+
+  // Replace the journal
+  if (rename(tempFilePath.c_str(),filePath.c_str())!=0) {
+    ERROR("can not rename <%s> to <%s>",tempFilePath.c_str(),filePath.c_str());
+    remove(tempFilePath.c_str());
+    return false;
+  }
+  syncedCount=records.size();
+  return true;
+}
+
+// Appends the records that are not yet on disk and syncs the file
+bool NavigationPathJournal::writeRecords() {
+
+  // Skip if there is nothing to do
+  if (syncedCount==records.size())
+    return true;
+
+  // Open the journal if not already done
+  if (fileDescriptor==-1) {
+    if (access(filePath.c_str(),F_OK)!=0)
+      return rewrite();
+    fileDescriptor=::open(filePath.c_str(),O_WRONLY|O_APPEND);
+    if (fileDescriptor==-1) {
+      ERROR("can not open journal <%s> for appending",filePath.c_str());
+      return false;
+    }
+  }
+
+  // Append the new records
+  // If this fails, the journal might end with a damaged record and is therefore written again
+  size_t size=(records.size()-syncedCount)*sizeof(NavigationPathJournalRecord);
+  if ((write(fileDescriptor,&records[syncedCount],size)!=(ssize_t)size)||(fsync(fileDescriptor)!=0)) {
+    WARNING("can not append to journal <%s>",filePath.c_str());
+    return rewrite();
+  }
+  syncedCount=records.size();
+  return true;
+}
+
+// Uses the journal of the given gpx file
+void NavigationPathJournal::open(std::string gpxFilePath) {
+  core->getThread()->lockMutex(accessMutex, __FILE__, __LINE__);
+  writeRecords();
+  closeFile();
+  filePath=gpxFilePath+filenameExtension;
+  records.clear();
+  syncedCount=0;
+  core->getThread()->unlockMutex(accessMutex);
+}
+
+// Adds a point to the journal
+void NavigationPathJournal::append(MapPosition pos, Int index) {
+
+  // Create the record
+  NavigationPathJournalRecord record;
+  memset(&record,0,sizeof(record));
+  record.index=index;
+  if (pos==NavigationPath::getPathInterruptedPos()) {
+    record.flags=NavigationPathPointInterrupted;
+  } else {
+    record.lat=pos.getLat();
+    record.lng=pos.getLng();
+    record.altitude=pos.getAltitude();
+    record.timestamp=pos.getTimestamp();
+    record.bearing=pos.getBearing();
+    record.speed=pos.getSpeed();
+    record.accuracy=pos.getAccuracy();
+    if (pos.getHasAltitude())
+      record.flags|=NavigationPathPointHasAltitude;
+    if (pos.getIsWGS84Altitude())
+      record.flags|=NavigationPathPointIsWGS84Altitude;
+    if (pos.getHasTimestamp())
+      record.flags|=NavigationPathPointHasTimestamp;
+    if (pos.getHasBearing())
+      record.flags|=NavigationPathPointHasBearing;
+    if (pos.getHasSpeed())
+      record.flags|=NavigationPathPointHasSpeed;
+    if (pos.getHasAccuracy())
+      record.flags|=NavigationPathPointHasAccuracy;
+  }
+  record.checksum=computeChecksum(record);
+
+  // Add it and write the batch if it is complete
+  core->getThread()->lockMutex(accessMutex, __FILE__, __LINE__);
+  records.push_back(record);
+  if (records.size()-syncedCount>=syncCount)
+    writeRecords();
+  core->getThread()->unlockMutex(accessMutex);
+}
+
+// Writes all pending points to disk
+void NavigationPathJournal::sync() {
+  core->getThread()->lockMutex(accessMutex, __FILE__, __LINE__);
+  writeRecords();
+  core->getThread()->unlockMutex(accessMutex);
+}
+
+// Drops all points that are stored in the gpx file
+void NavigationPathJournal::compact(Int storedCount) {
+  core->getThread()->lockMutex(accessMutex, __FILE__, __LINE__);
+  std::vector<NavigationPathJournalRecord>::iterator i=records.begin();
+  while ((i!=records.end())&&(i->index<storedCount))
+    i++;
+  records.erase(records.begin(),i);
+  rewrite();
+  core->getThread()->unlockMutex(accessMutex);
+}
+
+// Reads the journal file and returns the points that follow the given number of stored points
+void NavigationPathJournal::replay(Int storedCount, std::list<MapPosition> &missingPoints) {
+
+  core->getThread()->lockMutex(accessMutex, __FILE__, __LINE__);
+  closeFile();
+  records.clear();
+  syncedCount=0;
+
+  // Skip if there is no journal
+  int fd=::open(filePath.c_str(),O_RDONLY);
+  if (fd==-1) {
+    core->getThread()->unlockMutex(accessMutex);
+    return;
+  }
+
+  // Check the header
+  NavigationPathJournalHeader header;
+  if ((read(fd,&header,sizeof(header))!=(ssize_t)sizeof(header))||(memcmp(header.magic,magic,sizeof(magic))!=0)||
+      (header.version!=version)||(header.byteOrder!=1)) {
+    WARNING("ignoring journal <%s> because it has an unknown format",filePath.c_str());
+  } else {
+
+    // Use all intact records that continue the stored points
+    NavigationPathJournalRecord record;
+    while (read(fd,&record,sizeof(record))==(ssize_t)sizeof(record)) {
+      if (computeChecksum(record)!=record.checksum) {
+        WARNING("journal <%s> ends with a damaged record",filePath.c_str());
+        break;
+      }
+      if (record.index<storedCount)
+        continue;
+      if (record.index!=storedCount+records.size()) {
+        WARNING("journal <%s> does not continue the stored points",filePath.c_str());
+        break;
+      }
+      records.push_back(record);
+      missingPoints.push_back(getPosition(record));
+    }
+  }
+  close(fd);
+
+  // Write the journal again such that new records follow the last intact one
+  rewrite();
+  core->getThread()->unlockMutex(accessMutex);
+}
+
+// Returns the number of points that are not yet part of the gpx file
+Int NavigationPathJournal::getRecordCount() {
+  core->getThread()->lockMutex(accessMutex, __FILE__, __LINE__);
+  Int count=records.size();
+  core->getThread()->unlockMutex(accessMutex);
+  return count;
+}
+
+}
@@ -0,0 +1,124 @@
+//============================================================================
+// Name        : NavigationPathJournal.h
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <MapPosition.h>
+
+#ifndef NAVIGATIONPATHJOURNAL_H_
+#define NAVIGATIONPATHJOURNAL_H_
+
+namespace GEODISCOVERER {
+
+// Header at the start of the journal file
+typedef struct NavigationPathJournalHeader {
+  char magic[8];                          // Identifies the file as a path journal
+  UInt version;                           // Version of the schema
+  UInt byteOrder;                         // Stored as 1 to detect files written with a different byte order
+} NavigationPathJournalHeader;
+
+// Point in the journal
+typedef struct NavigationPathJournalRecord {
+  UInt index;                             // Position of the point in the path
+  UInt checksum;                          // Adler-32 of the record with this field set to zero
+  double lat;                             // Latitude
+  double lng;                             // Longitude
+  double altitude;                        // Altitude
+  TimestampInMilliseconds timestamp;      // Time of the point
+  float bearing;                          // Bearing
+  float speed;                            // Speed
+  float accuracy;                         // Accuracy
+  UByte flags;                            // Flags of the point (see NavigationPathPointFlag)
+  UByte padding[3];                       // Keeps the size a multiple of 8 bytes
+} NavigationPathJournalRecord;
+
+// Append-only journal of the points added to a path
+//
+// Points are collected in memory and appended to the file in small batches
+// that are synced to disk. The gpx file is only rewritten occasionally; the
+// journal then drops all points that are contained in it. A record carries
+// the position of its point in the path, so records that are already part of
+// the gpx file are skipped on replay and a torn record at the end of the file
+// stops the replay.
+class NavigationPathJournal {
+
+protected:
+
+  // Identification and version of the schema
+  static const char magic[8];
+  static const UInt version;
+
+  std::string filePath;                               // Path to the journal file
+  int fileDescriptor;                                 // Descriptor of the opened journal file (-1 if closed)
+  ThreadMutexInfo *accessMutex;                       // Mutex for accessing the journal
+  std::vector<NavigationPathJournalRecord> records;   // Points that are not yet part of the gpx file
+  Int syncedCount;                                    // Number of records that are already synced to disk
+  Int syncCount;                                      // Number of new records after which the journal is synced
+  Int maxCount;                                       // Number of records after which the gpx file shall be rewritten
+
+  // Computes the checksum of the record
+  static UInt computeChecksum(const NavigationPathJournalRecord &record);
+
+  // Writes all records into a new journal file
+  bool rewrite();
+
+  // Appends the records that are not yet on disk and syncs the file
+  bool writeRecords();
+
+  // Closes the journal file
+  void closeFile();
+
+public:
+
+  // Extension of the journal file relative to the gpx file
+  static const std::string filenameExtension;
+
+  // Constructor
+  NavigationPathJournal();
+
+  // Destructor
+  virtual ~NavigationPathJournal();
+
+  // Uses the journal of the given gpx file
+  void open(std::string gpxFilePath);
+
+  // Adds a point to the journal
+  void append(MapPosition pos, Int index);
+
+  // Writes all pending points to disk
+  void sync();
+
+  // Drops all points that are stored in the gpx file
+  void compact(Int storedCount);
+
+  // Reads the journal file and returns the points that follow the given number of stored points
+  void replay(Int storedCount, std::list<MapPosition> &missingPoints);
+
+  // Getters and setters
+  Int getRecordCount();
+
+  Int getMaxCount() const {
+    return maxCount;
+  }
+};
+
+}
+
+#endif /* NAVIGATIONPATHJOURNAL_H_ */
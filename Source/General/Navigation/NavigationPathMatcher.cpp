@@ -0,0 +1,229 @@
+//============================================================================
+// Name        : NavigationPathMatcher.cpp
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <Core.h>
+#include <NavigationPathMatcher.h>
+
+namespace GEODISCOVERER {
+
+const Int NavigationPathMatcher::blockSize = 32;
+const double NavigationPathMatcher::distanceTolerance = 1.0;
+
+// Constructor
+NavigationPathMatcher::NavigationPathMatcher() {
+  matchedIndex=-1;
+  changeCount=0;
+  first=-1;
+  last=-1;
+  reverse=false;
+  location.lat=0;
+  location.lng=0;
+}
+
+// Destructor
+NavigationPathMatcher::~NavigationPathMatcher() {
+}
+
+// Indicates if the points match the given selection of the path
+bool NavigationPathMatcher::isUpToDate(ULong changeCount, Int first, Int last, bool reverse) const {
+  return (this->changeCount==changeCount)&&(this->first==first)&&(this->last==last)&&(this->reverse==reverse);
+}
+
+// Copies the selected points from the path
+void NavigationPathMatcher::update(const NavigationPathPoints &pathPoints, Int first, Int last, bool reverse, ULong changeCount) {
+
+  // Copy the points in the order they are travelled
+  points=pathPoints.getRange(first,last+1);
+  if (reverse)
+    points.reverse();
+  this->changeCount=changeCount;
+  this->first=first;
+  this->last=last;
+  this->reverse=reverse;
+  matchedIndex=-1;
+  Int size=points.size();
+  segmentLengths.assign(size,0);
+  remainingLengths.assign(size,0);
+  locationDistances.assign(size,0);
+  normalDistances.assign(size,0);
+  blocks.clear();
+  if (size==0)
+    return;
+
+  // Compute the segment lengths and the remaining length of the path at each point
+  const GeoPoint *geoPoints=points.getGeoPoints();
+  MapPosition::computeDistances(geoPoints,size,&segmentLengths[0]);
+  for (Int i=size-2;i>=0;i--) {
+    remainingLengths[i]=remainingLengths[i+1];
+    if ((!points.isInterrupted(i))&&(!points.isInterrupted(i+1)))
+      remainingLengths[i]+=segmentLengths[i];
+  }
+
+  // Group the points into blocks
+  // Neighboring blocks share one point such that each segment belongs to exactly one block
+  Int start=0;
+  do {
+    NavigationPathMatcherBlock block;
+    block.start=start;
+    block.end=start+blockSize;
+    if (block.end>size-1)
+      block.end=size-1;
+    for (Int k=0;k<3;k++) {
+      block.min[k]=std::numeric_limits<double>::max();
+      block.max[k]=-std::numeric_limits<double>::max();
+    }
+    block.maxSegmentLength=0;
+    for (Int i=block.start;i<=block.end;i++) {
+      if (points.isInterrupted(i))
+        continue;
+      double latRad=FloatingPoint::degree2rad(geoPoints[i].lat);
+      double lngRad=FloatingPoint::degree2rad(geoPoints[i].lng);
+      double v[3] = { cos(latRad)*cos(lngRad), cos(latRad)*sin(lngRad), sin(latRad) };
+      for (Int k=0;k<3;k++) {
+        if (v[k]<block.min[k])
+          block.min[k]=v[k];
+        if (v[k]>block.max[k])
+          block.max[k]=v[k];
+      }
+      if ((i<block.end)&&(!points.isInterrupted(i+1))&&(segmentLengths[i]>block.maxSegmentLength))
+        block.maxSegmentLength=segmentLengths[i];
+    }
+    blocks.push_back(block);
+    start+=blockSize;
+  } while (start<size-1);
+  blockDistances.resize(blocks.size());
+  remainingBlockDistances.resize(blocks.size());
+}
+
+// Removes all points
+void NavigationPathMatcher::clear() {
+  points.clear();
+  segmentLengths.clear();
+  remainingLengths.clear();
+  locationDistances.clear();
+  normalDistances.clear();
+  blocks.clear();
+  blockDistances.clear();
+  remainingBlockDistances.clear();
+  matchedIndex=-1;
+  changeCount=0;
+  first=-1;
+  last=-1;
+}
+
+// Sets the location and computes the minimum distance to each block
+void NavigationPathMatcher::setLocation(const GeoPoint &location) {
+  this->location=location;
+
+  // The chord between two points on the sphere is never longer than the great circle distance
+  // The distance to the bounding box of a block is therefore a lower bound for all of its points
+  double latRad=FloatingPoint::degree2rad(location.lat);
+  double lngRad=FloatingPoint::degree2rad(location.lng);
+  double v[3] = { cos(latRad)*cos(lngRad), cos(latRad)*sin(lngRad), sin(latRad) };
+  for (Int i=0;i<blocks.size();i++) {
+    NavigationPathMatcherBlock &block=blocks[i];
+    if (block.min[0]>block.max[0]) {
+      blockDistances[i]=std::numeric_limits<double>::max();
+      continue;
+    }
+    double d=0;
+    for (Int k=0;k<3;k++) {
+      double t=0;
+      if (v[k]<block.min[k])
+        t=block.min[k]-v[k];
+      if (v[k]>block.max[k])
+        t=v[k]-block.max[k];
+      d+=t*t;
+    }
+    blockDistances[i]=sqrt(d)*MapPosition::getEarthRadius();
+  }
+  for (Int i=blocks.size()-1;i>=0;i--) {
+    remainingBlockDistances[i]=blockDistances[i];
+    if ((i+1<blocks.size())&&(remainingBlockDistances[i+1]<remainingBlockDistances[i]))
+      remainingBlockDistances[i]=remainingBlockDistances[i+1];
+  }
+}
+
+// Finds all segments whose normal distance to the location is below the given one
+void NavigationPathMatcher::findSegments(double maxDistance, std::vector<std::pair<Int,double> > &segments) {
+  segments.clear();
+  const GeoPoint *geoPoints=points.getGeoPoints();
+  for (Int i=0;i<blocks.size();i++) {
+    NavigationPathMatcherBlock &block=blocks[i];
+    Int count=block.end-block.start;
+    if (count==0)
+      continue;
+
+    // Skip the block if none of its segments can be near enough
+    // If the normal hits the segment, its length is at least half of the distances to both ends minus the segment length
+    if (blockDistances[i]-block.maxSegmentLength/2-distanceTolerance>=maxDistance)
+      continue;
+
+    // Compute the normal distances of all segments in the block
+    MapPosition::computeDistances(&geoPoints[block.start],count+1,location,&locationDistances[block.start]);
+    MapPosition::computeNormalDistances(&segmentLengths[block.start],&locationDistances[block.start],&locationDistances[block.start]+1,count,&normalDistances[block.start]);
+    for (Int j=block.start;j<block.end;j++) {
+      if ((points.isInterrupted(j))||(points.isInterrupted(j+1)))
+        continue;
+      if (normalDistances[j]<maxDistance)
+        segments.push_back(std::pair<Int,double>(j+1,normalDistances[j]));
+    }
+  }
+}
+
+// Finds the point nearest to the location (-1 if none is found)
+Int NavigationPathMatcher::findNearestPoint(double &distance) {
+  Int nearestIndex=-1;
+  distance=std::numeric_limits<double>::max();
+  if (blocks.size()==0)
+    return nearestIndex;
+
+  // Start at the block of the last match to find a near point early
+  // Blocks that are farther away than the nearest point found so far are skipped
+  // On equal distances, the point that comes first on the path is used
+  const GeoPoint *geoPoints=points.getGeoPoints();
+  Int startBlock=(matchedIndex!=-1) ? getBlockIndex(matchedIndex) : 0;
+  for (Int j=0;j<blocks.size();j++) {
+    Int i=(startBlock+j)%blocks.size();
+    NavigationPathMatcherBlock &block=blocks[i];
+    if (blockDistances[i]-distanceTolerance>distance)
+      continue;
+    MapPosition::computeDistances(&geoPoints[block.start],block.end-block.start+1,location,&locationDistances[block.start]);
+    for (Int k=block.start;k<=block.end;k++) {
+      double d=locationDistances[k];
+      if ((d<distance)||((d==distance)&&(k<nearestIndex))) {
+        distance=d;
+        nearestIndex=k;
+      }
+    }
+  }
+  return nearestIndex;
+}
+
+// Indicates if all points from the given one on are farther away from the location than the given distance
+bool NavigationPathMatcher::isFartherAway(Int index, double distance) const {
+  if (index>=points.size())
+    return true;
+  return remainingBlockDistances[getBlockIndex(index)]-distanceTolerance>distance;
+}
+
+}
@@ -0,0 +1,125 @@
+//============================================================================
+// Name        : NavigationPathMatcher.h
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <NavigationPathPoints.h>
+
+#ifndef NAVIGATIONPATHMATCHER_H_
+#define NAVIGATIONPATHMATCHER_H_
+
+namespace GEODISCOVERER {
+
+// Consecutive points of the path that are checked together
+typedef struct NavigationPathMatcherBlock {
+  Int start;                          // Index of the first point
+  Int end;                            // Index of the last point
+  double min[3];                      // Minimum of the points on the unit sphere
+  double max[3];                      // Maximum of the points on the unit sphere
+  double maxSegmentLength;            // Length of the longest segment in meters
+} NavigationPathMatcherBlock;
+
+// Matches locations to the segments of a path
+// The points are kept in the order they are travelled and are grouped into blocks
+// A block is only looked at if its bounding box can contain a match
+class NavigationPathMatcher {
+
+protected:
+
+  NavigationPathPoints points;                      // Points of the path in the order they are travelled
+  std::vector<double> segmentLengths;               // Length of the segment from point i to point i+1
+  std::vector<double> remainingLengths;             // Length of the path from point i to the last point
+  std::vector<NavigationPathMatcherBlock> blocks;   // Blocks the points are grouped into
+  std::vector<double> locationDistances;            // Distances from the location to the points of the checked blocks
+  std::vector<double> normalDistances;              // Normal distances from the location to the segments of the checked blocks
+  std::vector<double> blockDistances;               // Minimum distance from the location to each block
+  std::vector<double> remainingBlockDistances;      // Minimum distance from the location to block i and all following blocks
+  GeoPoint location;                                // Location the distances are computed for
+  Int matchedIndex;                                 // Index of the point the last location was matched to
+  ULong changeCount;                                // Change count of the path the points were copied from
+  Int first;                                        // First point of the path that was copied
+  Int last;                                         // Last point of the path that was copied
+  bool reverse;                                     // Indicates if the points were copied in reverse order
+  static const Int blockSize;                       // Number of segments in a block
+  static const double distanceTolerance;            // Tolerance in meters that covers rounding errors of the distance computations
+
+  // Returns the block that contains the given point
+  Int getBlockIndex(Int index) const {
+    Int block=index/blockSize;
+    if (block>=blocks.size())
+      block=blocks.size()-1;
+    return block;
+  }
+
+public:
+
+  // Constructor
+  NavigationPathMatcher();
+
+  // Destructor
+  virtual ~NavigationPathMatcher();
+
+  // Indicates if the points match the given selection of the path
+  bool isUpToDate(ULong changeCount, Int first, Int last, bool reverse) const;
+
+  // Copies the selected points from the path
+  void update(const NavigationPathPoints &pathPoints, Int first, Int last, bool reverse, ULong changeCount);
+
+  // Removes all points
+  void clear();
+
+  // Sets the location and computes the minimum distance to each block
+  void setLocation(const GeoPoint &location);
+
+  // Finds all segments whose normal distance to the location is below the given one
+  // The index of the segment's end point and its normal distance are returned in the order of the path
+  void findSegments(double maxDistance, std::vector<std::pair<Int,double> > &segments);
+
+  // Finds the point nearest to the location (-1 if none is found)
+  Int findNearestPoint(double &distance);
+
+  // Indicates if all points from the given one on are farther away from the location than the given distance
+  bool isFartherAway(Int index, double distance) const;
+
+  // Getters and setters
+  Int size() const {
+    return points.size();
+  }
+
+  const NavigationPathPoints &getPoints() const {
+    return points;
+  }
+
+  double getSegmentLength(Int index) const {
+    return segmentLengths[index];
+  }
+
+  double getRemainingLength(Int index) const {
+    return remainingLengths[index];
+  }
+
+  void setMatchedIndex(Int matchedIndex) {
+    this->matchedIndex = matchedIndex;
+  }
+};
+
+}
+
+#endif /* NAVIGATIONPATHMATCHER_H_ */
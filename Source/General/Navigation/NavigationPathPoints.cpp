@@ -0,0 +1,438 @@
+//============================================================================
+// Name        : NavigationPathPoints.cpp
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <Core.h>
+#include <NavigationPathPoints.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <zlib.h>
+
+namespace GEODISCOVERER {
+
+const char NavigationPathPoints::magic[8] = { 'G', 'D', 'R', 'O', 'U', 'T', 'E', 0 };
+const UInt NavigationPathPoints::version = 1;
+
+// Constructor
+NavigationPathPoints::NavigationPathPoints() {
+}
+
+// Destructor
+NavigationPathPoints::~NavigationPathPoints() {
+}
+
+// Adds a point to the end
+void NavigationPathPoints::add(MapPosition &pos, bool interrupted) {
+  geoPoints.push_back(pos.getGeoPoint());
+  UByte flag=0;
+  if (interrupted) {
+    flag|=NavigationPathPointInterrupted;
+  } else {
+    if (pos.getHasAltitude())
+      flag|=NavigationPathPointHasAltitude;
+    if (pos.getIsWGS84Altitude())
+      flag|=NavigationPathPointIsWGS84Altitude;
+    if (pos.getHasTimestamp())
+      flag|=NavigationPathPointHasTimestamp;
+    if (pos.getHasBearing())
+      flag|=NavigationPathPointHasBearing;
+    if (pos.getHasSpeed())
+      flag|=NavigationPathPointHasSpeed;
+    if (pos.getHasAccuracy())
+      flag|=NavigationPathPointHasAccuracy;
+  }
+  flags.push_back(flag);
+
+  // Only fill the columns that are used
+  if ((altitudes.size()>0)||(pos.getAltitude()!=-std::numeric_limits<double>::max()))
+    setLastValue(altitudes,pos.getAltitude(),-std::numeric_limits<double>::max());
+  if ((timestamps.size()>0)||(pos.getTimestamp()!=0))
+    setLastValue(timestamps,pos.getTimestamp(),(TimestampInMilliseconds)0);
+  if ((bearings.size()>0)||(flag&NavigationPathPointHasBearing))
+    setLastValue(bearings,(float)pos.getBearing(),(float)0);
+  if ((speeds.size()>0)||(flag&NavigationPathPointHasSpeed))
+    setLastValue(speeds,(float)pos.getSpeed(),(float)0);
+  if ((accuracies.size()>0)||(flag&NavigationPathPointHasAccuracy))
+    setLastValue(accuracies,(float)pos.getAccuracy(),(float)0);
+}
+
+// Returns the point at the given index
+MapPosition NavigationPathPoints::get(Int index) const {
+  MapPosition pos;
+  UByte flag=flags[index];
+  if (flag&NavigationPathPointInterrupted)
+    return pos;
+  pos.setLat(geoPoints[index].lat);
+  pos.setLng(geoPoints[index].lng);
+  pos.setHasAltitude(flag&NavigationPathPointHasAltitude);
+  pos.setIsWGS84Altitude(flag&NavigationPathPointIsWGS84Altitude);
+  pos.setAltitude(getAltitude(index));
+  pos.setHasTimestamp(flag&NavigationPathPointHasTimestamp);
+  if (timestamps.size()>0)
+    pos.setTimestamp(timestamps[index]);
+  if (flag&NavigationPathPointHasBearing) {
+    pos.setHasBearing(true);
+    pos.setBearing(bearings[index]);
+  }
+  if (flag&NavigationPathPointHasSpeed) {
+    pos.setHasSpeed(true);
+    pos.setSpeed(speeds[index]);
+  }
+  if (flag&NavigationPathPointHasAccuracy) {
+    pos.setHasAccuracy(true);
+    pos.setAccuracy(accuracies[index]);
+  }
+  return pos;
+}
+
+// Returns the points in the given range as map positions
+std::vector<MapPosition> NavigationPathPoints::getMapPositions(Int start, Int end) const {
+  std::vector<MapPosition> result;
+  if (end>start)
+    result.reserve(end-start);
+  for (Int i=start;i<end;i++)
+    result.push_back(get(i));
+  return result;
+}
+
+// Returns a copy of the points in the given range
+NavigationPathPoints NavigationPathPoints::getRange(Int start, Int end) const {
+  NavigationPathPoints result;
+  if (end<=start)
+    return result;
+  copyColumn(geoPoints,start,end,result.geoPoints);
+  copyColumn(flags,start,end,result.flags);
+  copyColumn(altitudes,start,end,result.altitudes);
+  copyColumn(timestamps,start,end,result.timestamps);
+  copyColumn(bearings,start,end,result.bearings);
+  copyColumn(speeds,start,end,result.speeds);
+  copyColumn(accuracies,start,end,result.accuracies);
+  return result;
+}
+
+// Removes all points
+void NavigationPathPoints::clear() {
+  truncate(0);
+}
+
+// Removes all points from the given index on
+void NavigationPathPoints::truncate(Int size) {
+  if (size>=geoPoints.size())
+    return;
+  geoPoints.resize(size);
+  flags.resize(size);
+  if (altitudes.size()>0) altitudes.resize(size);
+  if (timestamps.size()>0) timestamps.resize(size);
+  if (bearings.size()>0) bearings.resize(size);
+  if (speeds.size()>0) speeds.resize(size);
+  if (accuracies.size()>0) accuracies.resize(size);
+}
+
+// Reverses the order of the points
+void NavigationPathPoints::reverse() {
+  std::reverse(geoPoints.begin(),geoPoints.end());
+  std::reverse(flags.begin(),flags.end());
+  std::reverse(altitudes.begin(),altitudes.end());
+  std::reverse(timestamps.begin(),timestamps.end());
+  std::reverse(bearings.begin(),bearings.end());
+  std::reverse(speeds.begin(),speeds.end());
+  std::reverse(accuracies.begin(),accuracies.end());
+}
+
+// Appends a variable length integer
+void NavigationPathPoints::writeVarint(std::vector<UByte> &data, ULong value) {
+  while (value>=0x80) {
+    data.push_back((value&0x7F)|0x80);
+    value>>=7;
+  }
+  data.push_back(value);
+}
+
+// Reads a variable length integer
+bool NavigationPathPoints::readVarint(const UByte *&data, const UByte *end, ULong &value) {
+  value=0;
+  for (Int shift=0;shift<64;shift+=7) {
+    if (data>=end)
+      return false;
+    UByte b=*data;
+    data++;
+    value|=((ULong)(b&0x7F))<<shift;
+    if ((b&0x80)==0)
+      return true;
+  }
+  return false;
+}
+
+// Appends 64 bit values as variable length differences to their predecessor
+void NavigationPathPoints::writeDeltaColumn(std::vector<UByte> &data, const UByte *values, Int count, Int stride) {
+  ULong prev=0;
+  for (Int i=0;i<count;i++) {
+    ULong value;
+    memcpy(&value,values+i*stride,sizeof(value));
+    Long delta=(Long)(value-prev);
+    writeVarint(data,((ULong)delta<<1)^(ULong)(delta>>63));
+    prev=value;
+  }
+}
+
+// Reads 64 bit values stored as variable length differences to their predecessor
+bool NavigationPathPoints::readDeltaColumn(const UByte *data, UInt size, UByte *values, Int count, Int stride) {
+  const UByte *end=data+size;
+  ULong prev=0;
+  for (Int i=0;i<count;i++) {
+    ULong encoded;
+    if (!readVarint(data,end,encoded))
+      return false;
+    ULong delta=(encoded>>1)^(~(encoded&1)+1);
+    prev+=delta;
+    memcpy(values+i*stride,&prev,sizeof(prev));
+  }
+  return data==end;
+}
+
+// Writes the points and the name and description of their path into a binary route file
+bool NavigationPathPoints::write(std::string filePath, std::string name, std::string description) const {
+
+  // Encode the columns
+  Int count=size();
+  NavigationPathPointsHeader header;
+  memset(&header,0,sizeof(header));
+  std::vector<UByte> columns[NavigationPathPointsColumnCount];
+  if (count>0) {
+    writeDeltaColumn(columns[NavigationPathPointsColumnLat],(const UByte*)&geoPoints[0].lat,count,sizeof(GeoPoint));
+    writeDeltaColumn(columns[NavigationPathPointsColumnLng],(const UByte*)&geoPoints[0].lng,count,sizeof(GeoPoint));
+    writeRawColumn(columns[NavigationPathPointsColumnFlags],flags);
+    if (altitudes.size()>0)
+      writeDeltaColumn(columns[NavigationPathPointsColumnAltitudes],(const UByte*)&altitudes[0],count,sizeof(double));
+    if (timestamps.size()>0)
+      writeDeltaColumn(columns[NavigationPathPointsColumnTimestamps],(const UByte*)&timestamps[0],count,sizeof(TimestampInMilliseconds));
+    writeRawColumn(columns[NavigationPathPointsColumnBearings],bearings);
+    writeRawColumn(columns[NavigationPathPointsColumnSpeeds],speeds);
+    writeRawColumn(columns[NavigationPathPointsColumnAccuracies],accuracies);
+  }
+
+  // Assemble the contents behind the header
+  std::vector<UByte> data;
+  data.insert(data.end(),name.begin(),name.end());
+  data.insert(data.end(),description.begin(),description.end());
+  for (Int i=0;i<NavigationPathPointsColumnCount;i++) {
+    header.columnSize[i]=columns[i].size();
+    data.insert(data.end(),columns[i].begin(),columns[i].end());
+  }
+
+  // Fill the header
+  memcpy(header.magic,magic,sizeof(magic));
+  header.version=version;
+  header.byteOrder=1;
+  header.fileSize=sizeof(header)+data.size();
+  header.pointCount=count;
+  header.nameSize=name.size();
+  header.descriptionSize=description.size();
+  header.checksum=adler32(adler32(0,Z_NULL,0),data.size()>0 ? &data[0] : NULL,data.size());
+
+  // Write the file
+  std::ofstream ofs;
+  ofs.open(filePath.c_str(),std::ios::binary);
+  if (ofs.fail()) {
+    WARNING("can not open <%s> for writing",filePath.c_str());
+    return false;
+  }
+  ofs.write((const char*)&header,sizeof(header));
+  if (data.size()>0)
+    ofs.write((const char*)&data[0],data.size());
+  bool failed=ofs.bad();
+  ofs.close();
+  if (failed) {
+    WARNING("can not store path into <%s>",filePath.c_str());
+    remove(filePath.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Reads the points and the name and description of their path from a binary route file
+bool NavigationPathPoints::read(std::string filePath, std::string &name, std::string &description) {
+
+  // Map the file into memory
+  clear();
+  int fd=open(filePath.c_str(),O_RDONLY);
+  if (fd<0) {
+    DEBUG("can not open <%s>",filePath.c_str());
+    return false;
+  }
+  struct stat stat_buffer;
+  if ((fstat(fd,&stat_buffer)!=0)||(stat_buffer.st_size<(off_t)sizeof(NavigationPathPointsHeader))) {
+    DEBUG("<%s> is not a binary route",filePath.c_str());
+    ::close(fd);
+    return false;
+  }
+  size_t mappingSize=stat_buffer.st_size;
+  void *mapping=mmap(NULL,mappingSize,PROT_READ,MAP_PRIVATE,fd,0);
+  ::close(fd);
+  if (mapping==MAP_FAILED) {
+    DEBUG("can not map <%s> into memory",filePath.c_str());
+    return false;
+  }
+  const NavigationPathPointsHeader *header=(const NavigationPathPointsHeader*)mapping;
+  const UByte *data=(const UByte*)mapping+sizeof(NavigationPathPointsHeader);
+  size_t dataSize=mappingSize-sizeof(NavigationPathPointsHeader);
+
+  // Check the header
+  bool valid=true;
+  if ((memcmp(header->magic,magic,sizeof(magic))!=0)||(header->byteOrder!=1)) {
+    DEBUG("<%s> is not a binary route",filePath.c_str());
+    valid=false;
+  } else if (header->version!=version) {
+    DEBUG("<%s> has format version %d but version %d is required",filePath.c_str(),header->version,version);
+    valid=false;
+  } else if (header->fileSize!=mappingSize) {
+    DEBUG("<%s> is truncated",filePath.c_str());
+    valid=false;
+  } else if (adler32(adler32(0,Z_NULL,0),data,dataSize)!=header->checksum) {
+    DEBUG("checksum of <%s> does not match",filePath.c_str());
+    valid=false;
+  }
+  size_t totalSize=(size_t)header->nameSize+header->descriptionSize;
+  for (Int i=0;i<NavigationPathPointsColumnCount;i++)
+    totalSize+=header->columnSize[i];
+  if ((valid)&&(totalSize!=dataSize)) {
+    DEBUG("<%s> has invalid columns",filePath.c_str());
+    valid=false;
+  }
+
+  // Decode the columns
+  if (valid) {
+    name.assign((const char*)data,header->nameSize);
+    data+=header->nameSize;
+    description.assign((const char*)data,header->descriptionSize);
+    data+=header->descriptionSize;
+    const UByte *columns[NavigationPathPointsColumnCount];
+    for (Int i=0;i<NavigationPathPointsColumnCount;i++) {
+      columns[i]=data;
+      data+=header->columnSize[i];
+    }
+    Int count=header->pointCount;
+    const UInt *columnSize=header->columnSize;
+    if (count>0) {
+      geoPoints.resize(count);
+      if (columnSize[NavigationPathPointsColumnAltitudes]>0)
+        altitudes.resize(count);
+      if (columnSize[NavigationPathPointsColumnTimestamps]>0)
+        timestamps.resize(count);
+      valid=(readDeltaColumn(columns[NavigationPathPointsColumnLat],columnSize[NavigationPathPointsColumnLat],(UByte*)&geoPoints[0].lat,count,sizeof(GeoPoint)))&&
+            (readDeltaColumn(columns[NavigationPathPointsColumnLng],columnSize[NavigationPathPointsColumnLng],(UByte*)&geoPoints[0].lng,count,sizeof(GeoPoint)))&&
+            (columnSize[NavigationPathPointsColumnFlags]==count)&&
+            (readRawColumn(columns[NavigationPathPointsColumnFlags],columnSize[NavigationPathPointsColumnFlags],count,flags))&&
+            ((altitudes.size()==0)||(readDeltaColumn(columns[NavigationPathPointsColumnAltitudes],columnSize[NavigationPathPointsColumnAltitudes],(UByte*)&altitudes[0],count,sizeof(double))))&&
+            ((timestamps.size()==0)||(readDeltaColumn(columns[NavigationPathPointsColumnTimestamps],columnSize[NavigationPathPointsColumnTimestamps],(UByte*)&timestamps[0],count,sizeof(TimestampInMilliseconds))))&&
+            (readRawColumn(columns[NavigationPathPointsColumnBearings],columnSize[NavigationPathPointsColumnBearings],count,bearings))&&
+            (readRawColumn(columns[NavigationPathPointsColumnSpeeds],columnSize[NavigationPathPointsColumnSpeeds],count,speeds))&&
+            (readRawColumn(columns[NavigationPathPointsColumnAccuracies],columnSize[NavigationPathPointsColumnAccuracies],count,accuracies));
+    } else {
+      for (Int i=0;i<NavigationPathPointsColumnCount;i++) {
+        if (columnSize[i]!=0)
+          valid=false;
+      }
+    }
+    if (!valid)
+      DEBUG("<%s> has invalid columns",filePath.c_str());
+  }
+  munmap(mapping,mappingSize);
+  if (!valid)
+    clear();
+  return valid;
+}
+
+#ifdef DEBUG_CHECKS_ENABLED
+// Checks that the binary route file reproduces the points exactly
+void NavigationPathPoints::checkCodec(std::string filePath) {
+
+  // Variable length integers at the limits of their byte count
+  const ULong varints[] = { 0, 1, 0x7F, 0x80, 0x3FFF, 0x4000, 0xFFFFFFFFULL, 0x7FFFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFFFFULL };
+  std::vector<UByte> data;
+  for (Int i=0;i<sizeof(varints)/sizeof(ULong);i++)
+    writeVarint(data,varints[i]);
+  const UByte *p=&data[0];
+  for (Int i=0;i<sizeof(varints)/sizeof(ULong);i++) {
+    ULong value;
+    if ((!readVarint(p,&data[0]+data.size(),value))||(value!=varints[i])) {
+      FATAL("varint %d does not survive the round trip",i);
+      return;
+    }
+  }
+  if (p!=&data[0]+data.size()) {
+    FATAL("varints do not use all bytes",NULL);
+    return;
+  }
+
+  // Points that go back and forth with gaps, NaN and missing altitudes
+  NavigationPathPoints points;
+  double lats[] = { 48.1, 48.2, 47.9, -12.5, 89.9, -89.9, 0.0, -0.0, 48.1000000001 };
+  double lngs[] = { 11.5, 11.4, -179.9, 179.9, 0.0, -0.0, 11.5, -11.5, 11.5000000001 };
+  double alts[] = { 520.5, NAN, 510.0, -std::numeric_limits<double>::max(), 8848.0, -420.0, NAN, -std::numeric_limits<double>::max(), 0.0 };
+  TimestampInMilliseconds timestamps[] = { 1000000, 999000, 0, 2000000000000LL, 1000001, 0, 5, 4, 3 };
+  Int count=sizeof(lats)/sizeof(double);
+  for (Int i=0;i<count;i++) {
+    MapPosition pos;
+    pos.setLat(lats[i]);
+    pos.setLng(lngs[i]);
+    pos.setAltitude(alts[i]);
+    pos.setHasAltitude(alts[i]!=-std::numeric_limits<double>::max());
+    pos.setIsWGS84Altitude(i%2==0);
+    pos.setTimestamp(timestamps[i]);
+    pos.setHasTimestamp(timestamps[i]!=0);
+    if (i%3==0) {
+      pos.setHasBearing(true);
+      pos.setBearing(i*30.5);
+    }
+    points.add(pos,i==4);
+  }
+
+  // Write and read the points and compare the bit patterns
+  std::string name="codec check";
+  std::string description="";
+  if (!points.write(filePath,name,description)) {
+    FATAL("can not write <%s>",filePath.c_str());
+    return;
+  }
+  NavigationPathPoints readPoints;
+  std::string readName,readDescription;
+  bool success=readPoints.read(filePath,readName,readDescription);
+  remove(filePath.c_str());
+  if (!success) {
+    FATAL("can not read <%s>",filePath.c_str());
+    return;
+  }
+  if ((readName!=name)||(readDescription!=description)||(readPoints.size()!=count)||
+      (memcmp(&readPoints.geoPoints[0],&points.geoPoints[0],count*sizeof(GeoPoint))!=0)||
+      (readPoints.flags!=points.flags)||
+      (readPoints.altitudes.size()!=count)||(memcmp(&readPoints.altitudes[0],&points.altitudes[0],count*sizeof(double))!=0)||
+      (readPoints.timestamps!=points.timestamps)||
+      (readPoints.bearings.size()!=points.bearings.size())||
+      (memcmp(&readPoints.bearings[0],&points.bearings[0],points.bearings.size()*sizeof(float))!=0)||
+      (readPoints.speeds.size()!=0)||(readPoints.accuracies.size()!=0)) {
+    FATAL("points do not survive the round trip",NULL);
+    return;
+  }
+}
+#endif
+
+}
@@ -0,0 +1,189 @@
+//============================================================================
+// Name        : NavigationPathPoints.h
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <MapPosition.h>
+
+#ifndef NAVIGATIONPATHPOINTS_H_
+#define NAVIGATIONPATHPOINTS_H_
+
+namespace GEODISCOVERER {
+
+// Attributes that can be set for a point of a path
+typedef enum { NavigationPathPointInterrupted=1, NavigationPathPointHasAltitude=2, NavigationPathPointIsWGS84Altitude=4,
+               NavigationPathPointHasTimestamp=8, NavigationPathPointHasBearing=16, NavigationPathPointHasSpeed=32,
+               NavigationPathPointHasAccuracy=64 } NavigationPathPointFlag;
+
+// Columns of the binary route file
+typedef enum { NavigationPathPointsColumnLat, NavigationPathPointsColumnLng, NavigationPathPointsColumnFlags,
+               NavigationPathPointsColumnAltitudes, NavigationPathPointsColumnTimestamps, NavigationPathPointsColumnBearings,
+               NavigationPathPointsColumnSpeeds, NavigationPathPointsColumnAccuracies, NavigationPathPointsColumnCount } NavigationPathPointsColumn;
+
+// Header at the start of the binary route file
+typedef struct NavigationPathPointsHeader {
+  char magic[8];                          // Identifies the file as a binary route
+  UInt version;                           // Version of the format
+  UInt byteOrder;                         // Stored as 1 to detect files written with a different byte order
+  UInt fileSize;                          // Size of the complete file in bytes
+  UInt checksum;                          // Adler-32 of everything behind the header
+  UInt pointCount;                        // Number of points
+  UInt nameSize;                          // Size of the path name in bytes
+  UInt descriptionSize;                   // Size of the path description in bytes
+  UInt columnSize[NavigationPathPointsColumnCount]; // Encoded size of each column (zero if the column is not used)
+} NavigationPathPointsHeader;
+
+// Compact storage of the points of a path
+// Coordinates are kept in one array, all other attributes in columns that only exist if a point uses them
+//
+// The binary route file consists of the header, the name, the description
+// and the columns. Coordinates, altitudes and timestamps are stored as the
+// zigzag encoded difference of their 64 bit pattern to the previous point
+// in variable length integers, which keeps the values exact. Flags, bearings,
+// speeds and accuracies are stored as they are.
+class NavigationPathPoints {
+
+protected:
+
+  std::vector<GeoPoint> geoPoints;                  // Coordinates of all points
+  std::vector<UByte> flags;                         // Attributes set for each point
+  std::vector<double> altitudes;                    // Altitude of each point (empty if no point has one)
+  std::vector<TimestampInMilliseconds> timestamps;  // Timestamp of each point (empty if no point has one)
+  std::vector<float> bearings;                      // Bearing of each point (empty if no point has one)
+  std::vector<float> speeds;                        // Speed of each point (empty if no point has one)
+  std::vector<float> accuracies;                    // Accuracy of each point (empty if no point has one)
+
+  // Sets the value of the last point in the given column and creates the column if necessary
+  template <class T> void setLastValue(std::vector<T> &column, T value, T defaultValue) {
+    if (column.size()==0)
+      column.resize(geoPoints.size(),defaultValue);
+    else
+      column.resize(geoPoints.size());
+    column.back()=value;
+  }
+
+  // Copies the given range of a column
+  template <class T> static void copyColumn(const std::vector<T> &src, Int start, Int end, std::vector<T> &dst) {
+    if (src.size()>0)
+      dst.assign(src.begin()+start,src.begin()+end);
+  }
+
+  // Identification and version of the binary route file
+  static const char magic[8];
+  static const UInt version;
+
+  // Appends a variable length integer
+  static void writeVarint(std::vector<UByte> &data, ULong value);
+
+  // Reads a variable length integer
+  static bool readVarint(const UByte *&data, const UByte *end, ULong &value);
+
+  // Appends 64 bit values as variable length differences to their predecessor
+  static void writeDeltaColumn(std::vector<UByte> &data, const UByte *values, Int count, Int stride);
+
+  // Reads 64 bit values stored as variable length differences to their predecessor
+  static bool readDeltaColumn(const UByte *data, UInt size, UByte *values, Int count, Int stride);
+
+  // Appends a column as it is
+  template <class T> static void writeRawColumn(std::vector<UByte> &data, const std::vector<T> &column) {
+    if (column.size()>0)
+      data.insert(data.end(),(const UByte*)&column[0],(const UByte*)&column[0]+column.size()*sizeof(T));
+  }
+
+  // Reads a column that is stored as it is
+  template <class T> static bool readRawColumn(const UByte *data, UInt size, Int count, std::vector<T> &column) {
+    if (size==0)
+      return true;
+    if (size!=count*sizeof(T))
+      return false;
+    column.resize(count);
+    memcpy(&column[0],data,size);
+    return true;
+  }
+
+public:
+
+  // Constructor
+  NavigationPathPoints();
+
+  // Destructor
+  virtual ~NavigationPathPoints();
+
+  // Adds a point to the end
+  void add(MapPosition &pos, bool interrupted);
+
+  // Returns the point at the given index
+  MapPosition get(Int index) const;
+
+  // Returns the points in the given range as map positions
+  std::vector<MapPosition> getMapPositions(Int start, Int end) const;
+
+  // Returns a copy of the points in the given range
+  NavigationPathPoints getRange(Int start, Int end) const;
+
+  // Removes all points
+  void clear();
+
+  // Removes all points from the given index on
+  void truncate(Int size);
+
+  // Reverses the order of the points
+  void reverse();
+
+  // Writes the points and the name and description of their path into a binary route file
+  bool write(std::string filePath, std::string name, std::string description) const;
+
+  // Reads the points and the name and description of their path from a binary route file
+  bool read(std::string filePath, std::string &name, std::string &description);
+
+#ifdef DEBUG_CHECKS_ENABLED
+  // Checks that the binary route file reproduces the points exactly
+  static void checkCodec(std::string filePath);
+#endif
+
+  // Getters and setters
+  Int size() const {
+    return geoPoints.size();
+  }
+
+  const GeoPoint *getGeoPoints() const {
+    return geoPoints.size()>0 ? &geoPoints[0] : NULL;
+  }
+
+  const GeoPoint &getGeoPoint(Int index) const {
+    return geoPoints[index];
+  }
+
+  bool isInterrupted(Int index) const {
+    return (flags[index]&NavigationPathPointInterrupted)!=0;
+  }
+
+  bool getHasAltitude(Int index) const {
+    return (flags[index]&NavigationPathPointHasAltitude)!=0;
+  }
+
+  double getAltitude(Int index) const {
+    return altitudes.size()>0 ? altitudes[index] : -std::numeric_limits<double>::max();
+  }
+};
+
+}
+
+#endif /* NAVIGATIONPATHPOINTS_H_ */
@@ -32,9 +32,11 @@ namespace GEODISCOVERER {
 NavigationPathVisualization::NavigationPathVisualization() {
   prevLinePoint=NavigationPath::getPathInterruptedPos();
   prevArrowPoint=NavigationPath::getPathInterruptedPos();
+  prevLineIndex=-1;
   lngScale=0;
   latScale=0;
   zoomLevel=0;
+  rank=0;
   colorOffset=0;
 }
 
@@ -139,13 +141,35 @@ MapCalibrator *NavigationPathVisualization::findCalibrator(MapPosition pos, bool
   return c;
 }
 
-// Adds a new point to the visualization
-void NavigationPathVisualization::addPoint(MapPosition pos) {
-  if (pos.getHasBearing()) {
+// Adds a new point to the visualization (index is -1 for an interruption)
+void NavigationPathVisualization::addPoint(MapPosition pos, Int index) {
+  if ((pos.getHasBearing())||(prevLinePoint==NavigationPath::getPathInterruptedPos())) {
     prevArrowPoint=pos;
   }
-  points.push_back(pos);
   prevLinePoint=pos;
+  prevLineIndex=index;
+}
+
+// Remembers that the point is not covered by a map and interrupts the line
+void NavigationPathVisualization::addUncoveredPoint(Int index) {
+  if ((uncoveredRanges.size()>0)&&(uncoveredRanges.back().second==index-1)) {
+    uncoveredRanges.back().second=index;
+  } else {
+    uncoveredRanges.push_back(NavigationPathUncoveredRange(index,index));
+  }
+  prevLinePoint=NavigationPath::getPathInterruptedPos();
+  prevLineIndex=-1;
+}
+
+// Returns the color offset of the arrow following the arrow with the given offset
+double NavigationPathVisualization::computeNextColorOffset(double colorOffset, bool reverse) {
+  double t=core->getNavigationEngine()->getColorOffsetDelta();
+  colorOffset += reverse ? -t : +t;
+  if (colorOffset>=1.0)
+    colorOffset=0;
+  if (colorOffset<0.0)
+    colorOffset=1.0;
+  return colorOffset;
 }
 
 // Resets the overlay graphic hash for all map containers
@@ -34,15 +34,25 @@ namespace GEODISCOVERER {
 typedef std::map<MapTile*, NavigationPathTileInfo*> NavigationPathTileInfoMap;
 typedef std::pair<MapTile*, NavigationPathTileInfo*> NavigationPathTileInfoPair;
 
+// Range of path points that are not covered by a map
+typedef std::pair<Int, Int> NavigationPathUncoveredRange;
+
+// Visualization of a path for one zoom level
+//
+// The points are not copied. The path keeps a rank for each point that tells
+// the coarsest level of the pyramid in which the point is used; the points of
+// this zoom level are all points whose rank is not coarser than its own level.
 class NavigationPathVisualization {
 
 protected:
 
   Int zoomLevel;                                  // Zoom level that is represented by this visualization
+  Int rank;                                       // Level of the zoom level in the pyramid (0 is the coarsest one)
   double colorOffset;                             // Current offset for animating the color of the arrow
   MapPosition prevLinePoint;                      // Last position used for creating the graphic line
+  Int prevLineIndex;                              // Index of the last position in the path (-1 if the line is interrupted)
   MapPosition prevArrowPoint;                     // Last position used for creating the direction arrow
-  std::vector<MapPosition> points;                // All used points
+  std::vector<NavigationPathUncoveredRange> uncoveredRanges; // Path points that lie outside of the maps of this zoom level
   NavigationPathTileInfoMap tileInfoMap;          // Hash that holds information for each map tile
   double latScale;                                // Approximated latitude scale
   double lngScale;                                // Approximated longitude scale
@@ -76,27 +86,19 @@ public:
   // Get the calibrator for the given position
   MapCalibrator *findCalibrator(MapPosition pos, bool &deleteCalibrator);
 
-  // Adds a new point to the visualization
-  void addPoint(MapPosition pos);
+  // Adds a new point to the visualization (index is -1 for an interruption)
+  void addPoint(MapPosition pos, Int index);
 
-  // Resets the overlay graphic hash for all map containers
-  void resetOverlayGraphicHash();
+  // Remembers that the point is not covered by a map and interrupts the line
+  void addUncoveredPoint(Int index);
 
-  // Stores the content into a file
-  void store(std::ofstream *ofs);
+  // Returns the color offset of the arrow following the arrow with the given offset
+  static double computeNextColorOffset(double colorOffset, bool reverse);
 
-  // Recreates the content from a binary file
-  void retrieve(char *&data, Int &size);
+  // Resets the overlay graphic hash for all map containers
+  void resetOverlayGraphicHash();
 
   // Getters and setters
-  MapPosition getPoint(Int index) {
-    return points[index];
-  }
-
-  Int getPointsSize() const {
-    return points.size();
-  }
-
   MapPosition getPrevArrowPoint() const
   {
       return prevArrowPoint;
@@ -117,8 +119,20 @@ public:
       this->zoomLevel = zoomLevel;
   }
 
-  std::vector<MapPosition> *getPoints() {
-    return &points;
+  Int getRank() const {
+    return rank;
+  }
+
+  void setRank(Int rank) {
+    this->rank = rank;
+  }
+
+  Int getPrevLineIndex() const {
+    return prevLineIndex;
+  }
+
+  const std::vector<NavigationPathUncoveredRange> *getUncoveredRanges() const {
+    return &uncoveredRanges;
   }
 
   double getLatScale() const {
@@ -142,12 +156,7 @@ public:
   }
 
   void updateColorOffset(bool reverse) {
-    double t=core->getNavigationEngine()->getColorOffsetDelta();
-    colorOffset += reverse ? -t : +t;
-    if (colorOffset>=1.0)
-      colorOffset=0;
-    if (colorOffset<0.0)
-      colorOffset=1.0;
+    colorOffset=computeNextColorOffset(colorOffset,reverse);
   }
 
 };
@@ -0,0 +1,635 @@
+//============================================================================
+// Name        : NavigationSpatialIndex.cpp
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <Core.h>
+#include <NavigationSpatialIndex.h>
+#include <NavigationPath.h>
+#include <MapSource.h>
+
+namespace GEODISCOVERER {
+
+const Int NavigationSpatialIndex::nodeCapacity = 16;
+const Int NavigationSpatialIndex::segmentsPerEntry = 16;
+const double NavigationSpatialIndex::distanceTolerance = 1.0;
+
+// Item in the queue of the nearest neighbor search
+typedef struct NavigationSpatialIndexQueueItem {
+  double distance;                          // Minimum distance to the item
+  NavigationSpatialIndexNode *node;         // Node to visit (NULL for entries)
+  NavigationSpatialIndexEntry *entry;       // Entry to report
+  bool operator<(const struct NavigationSpatialIndexQueueItem &rhs) const {
+    return distance>rhs.distance;
+  }
+} NavigationSpatialIndexQueueItem;
+
+// Constructor
+NavigationSpatialIndex::NavigationSpatialIndex() {
+  accessMutex=core->getThread()->createMutex("navigation spatial index access mutex");
+  root=new NavigationSpatialIndexNode();
+  if (!root) {
+    FATAL("can not create spatial index node",NULL);
+  }
+  root->isLeaf=true;
+  updateNode(root);
+}
+
+// Destructor
+NavigationSpatialIndex::~NavigationSpatialIndex() {
+  deleteNode(root);
+  for (std::map<NavigationPath*,NavigationSpatialIndexPath>::iterator i=paths.begin();i!=paths.end();i++) {
+    for (std::list<NavigationSpatialIndexEntry*>::iterator j=i->second.entries.begin();j!=i->second.entries.end();j++)
+      delete *j;
+  }
+  for (std::list<NavigationSpatialIndexEntry*>::iterator i=addressPoints.begin();i!=addressPoints.end();i++)
+    delete *i;
+  core->getThread()->destroyMutex(accessMutex);
+}
+
+// Returns empty bounds
+NavigationSpatialIndexBounds NavigationSpatialIndex::getEmptyBounds() {
+  NavigationSpatialIndexBounds bounds;
+  bounds.latSouth=std::numeric_limits<double>::max();
+  bounds.latNorth=-std::numeric_limits<double>::max();
+  bounds.lngWest=std::numeric_limits<double>::max();
+  bounds.lngEast=-std::numeric_limits<double>::max();
+  return bounds;
+}
+
+// Extends the bounds such that they include the other bounds
+void NavigationSpatialIndex::extendBounds(NavigationSpatialIndexBounds &bounds, const NavigationSpatialIndexBounds &other) {
+  if (other.latSouth<bounds.latSouth) bounds.latSouth=other.latSouth;
+  if (other.latNorth>bounds.latNorth) bounds.latNorth=other.latNorth;
+  if (other.lngWest<bounds.lngWest) bounds.lngWest=other.lngWest;
+  if (other.lngEast>bounds.lngEast) bounds.lngEast=other.lngEast;
+}
+
+// Returns the area of the bounds in square degrees
+double NavigationSpatialIndex::computeArea(const NavigationSpatialIndexBounds &bounds) {
+  if ((bounds.latSouth>bounds.latNorth)||(bounds.lngWest>bounds.lngEast))
+    return 0;
+  return (bounds.latNorth-bounds.latSouth)*(bounds.lngEast-bounds.lngWest);
+}
+
+// Indicates if the bounds contain the other bounds
+bool NavigationSpatialIndex::containsBounds(const NavigationSpatialIndexBounds &bounds, const NavigationSpatialIndexBounds &other) {
+  return (other.latSouth>=bounds.latSouth)&&(other.latNorth<=bounds.latNorth)&&(other.lngWest>=bounds.lngWest)&&(other.lngEast<=bounds.lngEast);
+}
+
+// Indicates if the bounds overlap the other bounds
+bool NavigationSpatialIndex::intersectsBounds(const NavigationSpatialIndexBounds &bounds, const NavigationSpatialIndexBounds &other) {
+  return (other.latSouth<=bounds.latNorth)&&(other.latNorth>=bounds.latSouth)&&(other.lngWest<=bounds.lngEast)&&(other.lngEast>=bounds.lngWest);
+}
+
+// Computes a lower bound of the distance in meters from the position to any point within the bounds
+double NavigationSpatialIndex::computeMinDistance(const GeoPoint &pos, const NavigationSpatialIndexBounds &bounds) {
+  if ((bounds.latSouth>bounds.latNorth)||(bounds.lngWest>bounds.lngEast))
+    return std::numeric_limits<double>::max();
+
+  // Find the smallest latitude and longitude difference to the bounds
+  double latGap=0;
+  if (pos.lat<bounds.latSouth)
+    latGap=bounds.latSouth-pos.lat;
+  if (pos.lat>bounds.latNorth)
+    latGap=pos.lat-bounds.latNorth;
+  double lngGap=0;
+  if ((pos.lng<bounds.lngWest)||(pos.lng>bounds.lngEast)) {
+    double westGap=fmod(bounds.lngWest-pos.lng+720.0,360.0);
+    double eastGap=fmod(pos.lng-bounds.lngEast+720.0,360.0);
+    lngGap=(westGap<eastGap) ? westGap : eastGap;
+    if (lngGap>180.0)
+      lngGap=180.0;
+  }
+
+  // Both terms of the haversine formula can only grow with the gaps
+  // The cosine of the target latitude is smallest at the bound farthest from the equator
+  double maxAbsLat=fabs(bounds.latSouth)>fabs(bounds.latNorth) ? fabs(bounds.latSouth) : fabs(bounds.latNorth);
+  double sinLat=sin(FloatingPoint::degree2rad(latGap)/2);
+  double sinLng=sin(FloatingPoint::degree2rad(lngGap)/2);
+  double a=sinLat*sinLat+cos(FloatingPoint::degree2rad(pos.lat))*cos(FloatingPoint::degree2rad(maxAbsLat))*sinLng*sinLng;
+  if (a<0) a=0;
+  if (a>1) a=1;
+  return 2*asin(sqrt(a))*MapPosition::getEarthRadius();
+}
+
+// Computes the bounds and the longest segment of the given points (false if all points are interruptions)
+bool NavigationSpatialIndex::computeBounds(const NavigationPathPoints &points, Int startIndex, Int endIndex, NavigationSpatialIndexBounds &bounds, double &maxSegmentLength) {
+  bool found=false;
+  bounds=getEmptyBounds();
+  maxSegmentLength=0;
+  for (Int i=startIndex;i<=endIndex;i++) {
+    const GeoPoint &p=points.getGeoPoint(i);
+    if (points.isInterrupted(i))
+      continue;
+    found=true;
+    if (p.lat<bounds.latSouth) bounds.latSouth=p.lat;
+    if (p.lat>bounds.latNorth) bounds.latNorth=p.lat;
+    if (p.lng<bounds.lngWest) bounds.lngWest=p.lng;
+    if (p.lng>bounds.lngEast) bounds.lngEast=p.lng;
+    if ((i>startIndex)&&(!points.isInterrupted(i-1))) {
+      double length=MapPosition::computeDistance(points.getGeoPoint(i-1),p);
+      if (length>maxSegmentLength)
+        maxSegmentLength=length;
+    }
+  }
+  return found;
+}
+
+// Recomputes the bounds of the node from its items
+void NavigationSpatialIndex::updateNode(NavigationSpatialIndexNode *node) {
+  node->bounds=getEmptyBounds();
+  node->maxSegmentLength=0;
+  for (std::vector<NavigationSpatialIndexNode*>::iterator i=node->children.begin();i!=node->children.end();i++) {
+    extendBounds(node->bounds,(*i)->bounds);
+    if ((*i)->maxSegmentLength>node->maxSegmentLength)
+      node->maxSegmentLength=(*i)->maxSegmentLength;
+  }
+  for (std::vector<NavigationSpatialIndexEntry*>::iterator i=node->entries.begin();i!=node->entries.end();i++) {
+    extendBounds(node->bounds,(*i)->bounds);
+    if ((*i)->maxSegmentLength>node->maxSegmentLength)
+      node->maxSegmentLength=(*i)->maxSegmentLength;
+  }
+}
+
+// Distributes the items of an overfull node on two nodes
+template <class T> void NavigationSpatialIndex::splitItems(std::vector<T*> &items, std::vector<T*> &otherItems) {
+
+  // Use the pair that would waste the most area as seeds of the two groups
+  Int seed1=0, seed2=1;
+  double worstWaste=-std::numeric_limits<double>::max();
+  for (Int i=0;i<items.size();i++) {
+    for (Int j=i+1;j<items.size();j++) {
+      NavigationSpatialIndexBounds b=items[i]->bounds;
+      extendBounds(b,items[j]->bounds);
+      double waste=computeArea(b)-computeArea(items[i]->bounds)-computeArea(items[j]->bounds);
+      if (waste>worstWaste) {
+        worstWaste=waste;
+        seed1=i;
+        seed2=j;
+      }
+    }
+  }
+  std::vector<T*> remaining;
+  std::vector<T*> group1;
+  std::vector<T*> group2;
+  for (Int i=0;i<items.size();i++) {
+    if (i==seed1)
+      group1.push_back(items[i]);
+    else if (i==seed2)
+      group2.push_back(items[i]);
+    else
+      remaining.push_back(items[i]);
+  }
+  NavigationSpatialIndexBounds bounds1=group1[0]->bounds;
+  NavigationSpatialIndexBounds bounds2=group2[0]->bounds;
+
+  // Assign the remaining items one by one, starting with the one that has the strongest preference
+  Int minCount=nodeCapacity*3/8;
+  while (remaining.size()>0) {
+
+    // Fill up a group if it would otherwise not get enough items
+    if (group1.size()+remaining.size()<=minCount) {
+      for (Int i=0;i<remaining.size();i++)
+        group1.push_back(remaining[i]);
+      break;
+    }
+    if (group2.size()+remaining.size()<=minCount) {
+      for (Int i=0;i<remaining.size();i++)
+        group2.push_back(remaining[i]);
+      break;
+    }
+
+    // Pick the item whose enlargement differs most between the groups
+    Int next=0;
+    double nextEnlargement1=0, nextEnlargement2=0;
+    double maxDifference=-1;
+    for (Int i=0;i<remaining.size();i++) {
+      NavigationSpatialIndexBounds b1=bounds1;
+      extendBounds(b1,remaining[i]->bounds);
+      NavigationSpatialIndexBounds b2=bounds2;
+      extendBounds(b2,remaining[i]->bounds);
+      double enlargement1=computeArea(b1)-computeArea(bounds1);
+      double enlargement2=computeArea(b2)-computeArea(bounds2);
+      double difference=fabs(enlargement1-enlargement2);
+      if (difference>maxDifference) {
+        maxDifference=difference;
+        next=i;
+        nextEnlargement1=enlargement1;
+        nextEnlargement2=enlargement2;
+      }
+    }
+    T *item=remaining[next];
+    remaining.erase(remaining.begin()+next);
+    bool useGroup1;
+    if (nextEnlargement1!=nextEnlargement2)
+      useGroup1=nextEnlargement1<nextEnlargement2;
+    else if (computeArea(bounds1)!=computeArea(bounds2))
+      useGroup1=computeArea(bounds1)<computeArea(bounds2);
+    else
+      useGroup1=group1.size()<=group2.size();
+    if (useGroup1) {
+      group1.push_back(item);
+      extendBounds(bounds1,item->bounds);
+    } else {
+      group2.push_back(item);
+      extendBounds(bounds2,item->bounds);
+    }
+  }
+  items=group1;
+  otherItems=group2;
+}
+
+// Inserts the entry below the given node and returns the new sibling if the node had to be split
+NavigationSpatialIndexNode *NavigationSpatialIndex::insertEntry(NavigationSpatialIndexNode *node, NavigationSpatialIndexEntry *entry) {
+
+  // Add the entry to the leaf or to the child that needs the least enlargement
+  if (node->isLeaf) {
+    node->entries.push_back(entry);
+  } else {
+    NavigationSpatialIndexNode *bestChild=NULL;
+    double bestEnlargement=0, bestArea=0;
+    for (std::vector<NavigationSpatialIndexNode*>::iterator i=node->children.begin();i!=node->children.end();i++) {
+      NavigationSpatialIndexBounds b=(*i)->bounds;
+      extendBounds(b,entry->bounds);
+      double area=computeArea((*i)->bounds);
+      double enlargement=computeArea(b)-area;
+      if ((!bestChild)||(enlargement<bestEnlargement)||((enlargement==bestEnlargement)&&(area<bestArea))) {
+        bestChild=*i;
+        bestEnlargement=enlargement;
+        bestArea=area;
+      }
+    }
+    NavigationSpatialIndexNode *sibling=insertEntry(bestChild,entry);
+    if (sibling)
+      node->children.push_back(sibling);
+  }
+
+  // Split the node if it is overfull
+  NavigationSpatialIndexNode *sibling=NULL;
+  if (node->children.size()+node->entries.size()>nodeCapacity) {
+    sibling=new NavigationSpatialIndexNode();
+    if (!sibling) {
+      FATAL("can not create spatial index node",NULL);
+    }
+    sibling->isLeaf=node->isLeaf;
+    if (node->isLeaf)
+      splitItems(node->entries,sibling->entries);
+    else
+      splitItems(node->children,sibling->children);
+    updateNode(sibling);
+  }
+  updateNode(node);
+  return sibling;
+}
+
+// Adds the entry to the tree
+void NavigationSpatialIndex::insertEntry(NavigationSpatialIndexEntry *entry) {
+  NavigationSpatialIndexNode *sibling=insertEntry(root,entry);
+  if (sibling) {
+    NavigationSpatialIndexNode *newRoot=new NavigationSpatialIndexNode();
+    if (!newRoot) {
+      FATAL("can not create spatial index node",NULL);
+    }
+    newRoot->isLeaf=false;
+    newRoot->children.push_back(root);
+    newRoot->children.push_back(sibling);
+    updateNode(newRoot);
+    root=newRoot;
+  }
+}
+
+// Removes the entry below the given node
+bool NavigationSpatialIndex::removeEntry(NavigationSpatialIndexNode *node, NavigationSpatialIndexEntry *entry) {
+  if (node->isLeaf) {
+    for (std::vector<NavigationSpatialIndexEntry*>::iterator i=node->entries.begin();i!=node->entries.end();i++) {
+      if (*i==entry) {
+        node->entries.erase(i);
+        updateNode(node);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Only descend into children that can contain the entry
+  for (std::vector<NavigationSpatialIndexNode*>::iterator i=node->children.begin();i!=node->children.end();i++) {
+    NavigationSpatialIndexNode *child=*i;
+    if (!containsBounds(child->bounds,entry->bounds))
+      continue;
+    if (removeEntry(child,entry)) {
+      if ((child->children.size()==0)&&(child->entries.size()==0)) {
+        node->children.erase(i);
+        delete child;
+      }
+      updateNode(node);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Removes the entry from the tree and frees it
+void NavigationSpatialIndex::removeEntry(NavigationSpatialIndexEntry *entry) {
+  if (!removeEntry(root,entry)) {
+    FATAL("entry not found in spatial index",NULL);
+    return;
+  }
+  delete entry;
+
+  // Shrink the tree if the root has only one child left
+  while ((!root->isLeaf)&&(root->children.size()<=1)) {
+    NavigationSpatialIndexNode *oldRoot=root;
+    if (root->children.size()==1) {
+      root=root->children.front();
+    } else {
+      root->isLeaf=true;
+      updateNode(root);
+      break;
+    }
+    oldRoot->children.clear();
+    delete oldRoot;
+  }
+}
+
+// Frees the node and all nodes below it
+void NavigationSpatialIndex::deleteNode(NavigationSpatialIndexNode *node) {
+  for (std::vector<NavigationSpatialIndexNode*>::iterator i=node->children.begin();i!=node->children.end();i++)
+    deleteNode(*i);
+  delete node;
+}
+
+// Creates entries for the points of the path that are not yet in the tree
+std::list<NavigationSpatialIndexEntry> NavigationSpatialIndex::getUnindexedEntries() {
+  std::list<NavigationSpatialIndexEntry> result;
+  for (std::map<NavigationPath*,NavigationSpatialIndexPath>::iterator i=paths.begin();i!=paths.end();i++) {
+    NavigationSpatialIndexPath &data=i->second;
+    Int lastIndex=data.pointCount-1;
+    if (lastIndex<=data.indexedEnd)
+      continue;
+    NavigationSpatialIndexEntry entry;
+    entry.type=NavigationSpatialIndexEntryTypePathSegments;
+    entry.path=i->first;
+    entry.startIndex=data.indexedEnd;
+    entry.endIndex=lastIndex;
+    entry.pos.lat=0;
+    entry.pos.lng=0;
+    if (computeBounds(i->first->getPathPoints(),entry.startIndex,entry.endIndex,entry.bounds,entry.maxSegmentLength))
+      result.push_back(entry);
+  }
+  return result;
+}
+
+// Adds the last point of the path
+void NavigationSpatialIndex::addPoint(NavigationPath *path) {
+  core->getMapSource()->lockAccess(__FILE__,__LINE__);
+  core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
+  std::map<NavigationPath*,NavigationSpatialIndexPath>::iterator i=paths.find(path);
+  if (i==paths.end()) {
+    NavigationSpatialIndexPath data;
+    data.pointCount=0;
+    data.indexedEnd=0;
+    i=paths.insert(std::pair<NavigationPath*,NavigationSpatialIndexPath>(path,data)).first;
+  }
+  NavigationSpatialIndexPath &data=i->second;
+  data.pointCount=path->getPathPoints().size();
+
+  // Add the segments to the tree as soon as they fill a run
+  // Neighboring runs share one point such that each segment belongs to exactly one run
+  Int lastIndex=data.pointCount-1;
+  if (lastIndex-data.indexedEnd>=segmentsPerEntry) {
+    NavigationSpatialIndexEntry *entry=new NavigationSpatialIndexEntry();
+    if (!entry) {
+      FATAL("can not create spatial index entry",NULL);
+    }
+    entry->type=NavigationSpatialIndexEntryTypePathSegments;
+    entry->path=path;
+    entry->startIndex=data.indexedEnd;
+    entry->endIndex=lastIndex;
+    entry->pos.lat=0;
+    entry->pos.lng=0;
+    if (computeBounds(path->getPathPoints(),entry->startIndex,entry->endIndex,entry->bounds,entry->maxSegmentLength)) {
+      insertEntry(entry);
+      data.entries.push_back(entry);
+    } else {
+      delete entry;
+    }
+    data.indexedEnd=lastIndex;
+  }
+  core->getThread()->unlockMutex(accessMutex);
+  core->getMapSource()->unlockAccess();
+}
+
+// Removes all points of the path
+void NavigationSpatialIndex::removePath(NavigationPath *path) {
+  core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
+  std::map<NavigationPath*,NavigationSpatialIndexPath>::iterator i=paths.find(path);
+  if (i!=paths.end()) {
+    for (std::list<NavigationSpatialIndexEntry*>::iterator j=i->second.entries.begin();j!=i->second.entries.end();j++)
+      removeEntry(*j);
+    paths.erase(i);
+  }
+  core->getThread()->unlockMutex(accessMutex);
+}
+
+// Adds an address point
+void NavigationSpatialIndex::addAddressPoint(std::string name, const GeoPoint &pos) {
+  NavigationSpatialIndexEntry *entry=new NavigationSpatialIndexEntry();
+  if (!entry) {
+    FATAL("can not create spatial index entry",NULL);
+  }
+  entry->type=NavigationSpatialIndexEntryTypeAddressPoint;
+  entry->path=NULL;
+  entry->startIndex=-1;
+  entry->endIndex=-1;
+  entry->name=name;
+  entry->pos=pos;
+  entry->bounds.latSouth=pos.lat;
+  entry->bounds.latNorth=pos.lat;
+  entry->bounds.lngWest=pos.lng;
+  entry->bounds.lngEast=pos.lng;
+  entry->maxSegmentLength=0;
+  core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
+  insertEntry(entry);
+  addressPoints.push_back(entry);
+  core->getThread()->unlockMutex(accessMutex);
+}
+
+// Removes all address points
+void NavigationSpatialIndex::clearAddressPoints() {
+  core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
+  for (std::list<NavigationSpatialIndexEntry*>::iterator i=addressPoints.begin();i!=addressPoints.end();i++)
+    removeEntry(*i);
+  addressPoints.clear();
+  core->getThread()->unlockMutex(accessMutex);
+}
+
+// Checks the segments of the path between the given points for the nearest one
+void NavigationSpatialIndex::findNearestSegment(NavigationPath *path, const NavigationPathPoints &points, Int startIndex, Int endIndex, MapPosition pos, double overlapInMeters, double &nearestDistance, NavigationPath *&nearestPath, MapPosition &normalPos, Int &index) {
+  MapPosition prevPos, curPos, curNormalPos;
+  for (Int i=startIndex+1;i<=endIndex;i++) {
+    if ((points.isInterrupted(i-1))||(points.isInterrupted(i)))
+      continue;
+    prevPos.setLat(points.getGeoPoint(i-1).lat);
+    prevPos.setLng(points.getGeoPoint(i-1).lng);
+    curPos.setLat(points.getGeoPoint(i).lat);
+    curPos.setLng(points.getGeoPoint(i).lng);
+    double distance=curPos.computeNormalDistance(prevPos,pos,overlapInMeters,true,false,&curNormalPos);
+    if (distance<nearestDistance) {
+      nearestDistance=distance;
+      nearestPath=path;
+      normalPos=curNormalPos;
+      index=i;
+    }
+  }
+}
+
+// Checks all segments below the node for the nearest one
+void NavigationSpatialIndex::findNearestSegment(NavigationSpatialIndexNode *node, MapPosition pos, double overlapInMeters, double &nearestDistance, NavigationPath *&nearestPath, MapPosition &normalPos, Int &index) {
+
+  // If the normal hits a segment, its length is at least half of the distances to both ends minus the segment length
+  // The normal may also hit the extension of the segment by the overlap
+  GeoPoint geoPos=pos.getGeoPoint();
+  if (computeMinDistance(geoPos,node->bounds)-node->maxSegmentLength/2-overlapInMeters-distanceTolerance>=nearestDistance)
+    return;
+  if (node->isLeaf) {
+    for (std::vector<NavigationSpatialIndexEntry*>::iterator i=node->entries.begin();i!=node->entries.end();i++) {
+      NavigationSpatialIndexEntry *entry=*i;
+      if (entry->type!=NavigationSpatialIndexEntryTypePathSegments)
+        continue;
+      if (computeMinDistance(geoPos,entry->bounds)-entry->maxSegmentLength/2-overlapInMeters-distanceTolerance>=nearestDistance)
+        continue;
+      findNearestSegment(entry->path,entry->path->getPathPoints(),entry->startIndex,entry->endIndex,pos,overlapInMeters,nearestDistance,nearestPath,normalPos,index);
+    }
+  } else {
+
+    // Visit the nearest children first to find a good match early
+    std::vector<std::pair<double,NavigationSpatialIndexNode*> > children;
+    for (std::vector<NavigationSpatialIndexNode*>::iterator i=node->children.begin();i!=node->children.end();i++)
+      children.push_back(std::pair<double,NavigationSpatialIndexNode*>(computeMinDistance(geoPos,(*i)->bounds),*i));
+    std::sort(children.begin(),children.end());
+    for (Int i=0;i<children.size();i++)
+      findNearestSegment(children[i].second,pos,overlapInMeters,nearestDistance,nearestPath,normalPos,index);
+  }
+}
+
+// Returns the path whose segment has the smallest normal distance to the position
+NavigationPath *NavigationSpatialIndex::findNearestPath(MapPosition pos, double maxDistance, double overlapInMeters, MapPosition &normalPos, Int &index) {
+  NavigationPath *nearestPath=NULL;
+  double nearestDistance=maxDistance;
+  core->getMapSource()->lockAccess(__FILE__,__LINE__);
+  core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
+  for (std::map<NavigationPath*,NavigationSpatialIndexPath>::iterator i=paths.begin();i!=paths.end();i++) {
+    NavigationSpatialIndexPath &data=i->second;
+    findNearestSegment(i->first,i->first->getPathPoints(),data.indexedEnd,data.pointCount-1,pos,overlapInMeters,nearestDistance,nearestPath,normalPos,index);
+  }
+  findNearestSegment(root,pos,overlapInMeters,nearestDistance,nearestPath,normalPos,index);
+  core->getThread()->unlockMutex(accessMutex);
+  core->getMapSource()->unlockAccess();
+  return nearestPath;
+}
+
+// Returns the k entries of the given type that are nearest to the position, ordered by distance
+void NavigationSpatialIndex::findNearest(const GeoPoint &pos, Int k, double maxDistance, NavigationSpatialIndexEntryType type, std::list<NavigationSpatialIndexEntry> &result) {
+  result.clear();
+  if (type==NavigationSpatialIndexEntryTypePathSegments)
+    core->getMapSource()->lockAccess(__FILE__,__LINE__);
+  core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
+
+  // Visit the nodes and entries in the order of their minimum distance
+  // An entry taken from the queue is nearer than everything that is left
+  std::priority_queue<NavigationSpatialIndexQueueItem> queue;
+  std::list<NavigationSpatialIndexEntry> unindexedEntries;
+  if (type==NavigationSpatialIndexEntryTypePathSegments)
+    unindexedEntries=getUnindexedEntries();
+  for (std::list<NavigationSpatialIndexEntry>::iterator i=unindexedEntries.begin();i!=unindexedEntries.end();i++) {
+    NavigationSpatialIndexQueueItem item;
+    item.distance=computeMinDistance(pos,i->bounds);
+    item.node=NULL;
+    item.entry=&(*i);
+    queue.push(item);
+  }
+  NavigationSpatialIndexQueueItem item;
+  item.distance=computeMinDistance(pos,root->bounds);
+  item.node=root;
+  item.entry=NULL;
+  queue.push(item);
+  while ((queue.size()>0)&&(result.size()<k)) {
+    item=queue.top();
+    queue.pop();
+    if (item.distance>maxDistance)
+      break;
+    if (item.entry) {
+      result.push_back(*item.entry);
+      continue;
+    }
+    NavigationSpatialIndexNode *node=item.node;
+    for (std::vector<NavigationSpatialIndexNode*>::iterator i=node->children.begin();i!=node->children.end();i++) {
+      item.distance=computeMinDistance(pos,(*i)->bounds);
+      item.node=*i;
+      item.entry=NULL;
+      queue.push(item);
+    }
+    for (std::vector<NavigationSpatialIndexEntry*>::iterator i=node->entries.begin();i!=node->entries.end();i++) {
+      if ((*i)->type!=type)
+        continue;
+      item.distance=computeMinDistance(pos,(*i)->bounds);
+      item.node=NULL;
+      item.entry=*i;
+      queue.push(item);
+    }
+  }
+  core->getThread()->unlockMutex(accessMutex);
+  if (type==NavigationSpatialIndexEntryTypePathSegments)
+    core->getMapSource()->unlockAccess();
+}
+
+// Collects all entries below the node that overlap the bounds
+void NavigationSpatialIndex::findEntries(NavigationSpatialIndexNode *node, const NavigationSpatialIndexBounds &bounds, NavigationSpatialIndexEntryType type, std::list<NavigationSpatialIndexEntry> &result) {
+  if (!intersectsBounds(node->bounds,bounds))
+    return;
+  for (std::vector<NavigationSpatialIndexNode*>::iterator i=node->children.begin();i!=node->children.end();i++)
+    findEntries(*i,bounds,type,result);
+  for (std::vector<NavigationSpatialIndexEntry*>::iterator i=node->entries.begin();i!=node->entries.end();i++) {
+    if (((*i)->type==type)&&(intersectsBounds((*i)->bounds,bounds)))
+      result.push_back(**i);
+  }
+}
+
+// Returns all entries of the given type that overlap the bounds
+void NavigationSpatialIndex::findEntries(const NavigationSpatialIndexBounds &bounds, NavigationSpatialIndexEntryType type, std::list<NavigationSpatialIndexEntry> &result) {
+  result.clear();
+  if (type==NavigationSpatialIndexEntryTypePathSegments)
+    core->getMapSource()->lockAccess(__FILE__,__LINE__);
+  core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
+  findEntries(root,bounds,type,result);
+  if (type==NavigationSpatialIndexEntryTypePathSegments) {
+    std::list<NavigationSpatialIndexEntry> unindexedEntries=getUnindexedEntries();
+    for (std::list<NavigationSpatialIndexEntry>::iterator i=unindexedEntries.begin();i!=unindexedEntries.end();i++) {
+      if (intersectsBounds(i->bounds,bounds))
+        result.push_back(*i);
+    }
+  }
+  core->getThread()->unlockMutex(accessMutex);
+  if (type==NavigationSpatialIndexEntryTypePathSegments)
+    core->getMapSource()->unlockAccess();
+}
+
+}
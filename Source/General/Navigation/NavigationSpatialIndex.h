@@ -0,0 +1,176 @@
+//============================================================================
+// Name        : NavigationSpatialIndex.h
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <MapPosition.h>
+
+#ifndef NAVIGATIONSPATIALINDEX_H_
+#define NAVIGATIONSPATIALINDEX_H_
+
+namespace GEODISCOVERER {
+
+class NavigationPath;
+class NavigationPathPoints;
+
+// Types of items stored in the index
+typedef enum { NavigationSpatialIndexEntryTypePathSegments, NavigationSpatialIndexEntryTypeAddressPoint } NavigationSpatialIndexEntryType;
+
+// Area in geographic coordinates
+typedef struct NavigationSpatialIndexBounds {
+  double latSouth;                          // Minimum latitude
+  double latNorth;                          // Maximum latitude
+  double lngWest;                           // Minimum longitude
+  double lngEast;                           // Maximum longitude
+} NavigationSpatialIndexBounds;
+
+// Item stored in the index
+typedef struct NavigationSpatialIndexEntry {
+  NavigationSpatialIndexEntryType type;     // Type of the item
+  NavigationPath *path;                     // Path the segments belong to
+  Int startIndex;                           // Index of the first point of the segments in the path
+  Int endIndex;                             // Index of the last point of the segments in the path
+  std::string name;                         // Name of the address point
+  GeoPoint pos;                             // Position of the address point
+  NavigationSpatialIndexBounds bounds;      // Area covered by the item
+  double maxSegmentLength;                  // Length of the longest segment in meters
+} NavigationSpatialIndexEntry;
+
+// Node of the tree
+typedef struct NavigationSpatialIndexNode {
+  NavigationSpatialIndexBounds bounds;                    // Area covered by all items below this node
+  double maxSegmentLength;                                // Length of the longest segment below this node
+  bool isLeaf;                                            // Indicates if the node holds entries or child nodes
+  std::vector<struct NavigationSpatialIndexNode*> children; // Child nodes
+  std::vector<NavigationSpatialIndexEntry*> entries;      // Entries of a leaf
+} NavigationSpatialIndexNode;
+
+// Points of a path known to the index
+typedef struct NavigationSpatialIndexPath {
+  Int pointCount;                                         // Number of points of the path that have been added to the index
+  std::list<NavigationSpatialIndexEntry*> entries;        // Entries of the path in the tree
+  Int indexedEnd;                                         // Last point that is covered by the entries in the tree
+} NavigationSpatialIndexPath;
+
+// R-tree over the segments of all paths and the address points
+// The segments of a path are added in runs of consecutive points
+// Points that do not yet fill a run are checked directly
+// The coordinates are read from the points of the path, so the map source
+// must be locked before the index whenever segments are accessed
+class NavigationSpatialIndex {
+
+protected:
+
+  NavigationSpatialIndexNode *root;                                   // Root of the tree
+  std::map<NavigationPath*,NavigationSpatialIndexPath> paths;         // Points of all paths in the index
+  std::list<NavigationSpatialIndexEntry*> addressPoints;              // Address points in the index
+  ThreadMutexInfo *accessMutex;                                       // Mutex for accessing the index
+  static const Int nodeCapacity;                                      // Maximum number of items in a node
+  static const Int segmentsPerEntry;                                  // Number of segments that are grouped into one entry
+  static const double distanceTolerance;                              // Tolerance in meters that covers rounding errors of the distance computations
+
+  // Returns empty bounds
+  static NavigationSpatialIndexBounds getEmptyBounds();
+
+  // Extends the bounds such that they include the other bounds
+  static void extendBounds(NavigationSpatialIndexBounds &bounds, const NavigationSpatialIndexBounds &other);
+
+  // Returns the area of the bounds in square degrees
+  static double computeArea(const NavigationSpatialIndexBounds &bounds);
+
+  // Indicates if the bounds contain the other bounds
+  static bool containsBounds(const NavigationSpatialIndexBounds &bounds, const NavigationSpatialIndexBounds &other);
+
+  // Indicates if the bounds overlap the other bounds
+  static bool intersectsBounds(const NavigationSpatialIndexBounds &bounds, const NavigationSpatialIndexBounds &other);
+
+  // Computes a lower bound of the distance in meters from the position to any point within the bounds
+  static double computeMinDistance(const GeoPoint &pos, const NavigationSpatialIndexBounds &bounds);
+
+  // Computes the bounds and the longest segment of the given points (false if all points are interruptions)
+  static bool computeBounds(const NavigationPathPoints &points, Int startIndex, Int endIndex, NavigationSpatialIndexBounds &bounds, double &maxSegmentLength);
+
+  // Recomputes the bounds of the node from its items
+  static void updateNode(NavigationSpatialIndexNode *node);
+
+  // Distributes the items of an overfull node on two nodes
+  template <class T> static void splitItems(std::vector<T*> &items, std::vector<T*> &otherItems);
+
+  // Inserts the entry below the given node and returns the new sibling if the node had to be split
+  NavigationSpatialIndexNode *insertEntry(NavigationSpatialIndexNode *node, NavigationSpatialIndexEntry *entry);
+
+  // Adds the entry to the tree
+  void insertEntry(NavigationSpatialIndexEntry *entry);
+
+  // Removes the entry below the given node
+  bool removeEntry(NavigationSpatialIndexNode *node, NavigationSpatialIndexEntry *entry);
+
+  // Removes the entry from the tree and frees it
+  void removeEntry(NavigationSpatialIndexEntry *entry);
+
+  // Frees the node and all nodes below it
+  void deleteNode(NavigationSpatialIndexNode *node);
+
+  // Creates entries for the points of the path that are not yet in the tree
+  std::list<NavigationSpatialIndexEntry> getUnindexedEntries();
+
+  // Checks the segments of the path between the given points for the nearest one
+  void findNearestSegment(NavigationPath *path, const NavigationPathPoints &points, Int startIndex, Int endIndex, MapPosition pos, double overlapInMeters, double &nearestDistance, NavigationPath *&nearestPath, MapPosition &normalPos, Int &index);
+
+  // Checks all segments below the node for the nearest one
+  void findNearestSegment(NavigationSpatialIndexNode *node, MapPosition pos, double overlapInMeters, double &nearestDistance, NavigationPath *&nearestPath, MapPosition &normalPos, Int &index);
+
+  // Collects all entries below the node that overlap the bounds
+  void findEntries(NavigationSpatialIndexNode *node, const NavigationSpatialIndexBounds &bounds, NavigationSpatialIndexEntryType type, std::list<NavigationSpatialIndexEntry> &result);
+
+public:
+
+  // Constructor
+  NavigationSpatialIndex();
+
+  // Destructor
+  virtual ~NavigationSpatialIndex();
+
+  // Adds the last point of the path
+  void addPoint(NavigationPath *path);
+
+  // Removes all points of the path
+  void removePath(NavigationPath *path);
+
+  // Adds an address point
+  void addAddressPoint(std::string name, const GeoPoint &pos);
+
+  // Removes all address points
+  void clearAddressPoints();
+
+  // Returns the path whose segment has the smallest normal distance to the position
+  // Only segments within the given distance are considered
+  NavigationPath *findNearestPath(MapPosition pos, double maxDistance, double overlapInMeters, MapPosition &normalPos, Int &index);
+
+  // Returns the k entries of the given type that are nearest to the position, ordered by distance
+  void findNearest(const GeoPoint &pos, Int k, double maxDistance, NavigationSpatialIndexEntryType type, std::list<NavigationSpatialIndexEntry> &result);
+
+  // Returns all entries of the given type that overlap the bounds
+  void findEntries(const NavigationSpatialIndexBounds &bounds, NavigationSpatialIndexEntryType type, std::list<NavigationSpatialIndexEntry> &result);
+};
+
+}
+
+#endif /* NAVIGATIONSPATIALINDEX_H_ */
@@ -228,12 +228,12 @@ void WidgetCursorInfo::onMapChange(bool widgetVisible, MapPosition pos) {
 void WidgetCursorInfo::onDataChange() {
 
   // Check if an address point was hit
-  GraphicPosition visPos=*(core->getDefaultGraphicEngine()->lockPos(__FILE__, __LINE__));
-  core->getDefaultGraphicEngine()->unlockPos();
+  MapPosition mapPos=*(core->getMapEngine()->lockMapPos(__FILE__, __LINE__));
+  core->getMapEngine()->unlockMapPos();
   infoKeepEndCharCount=-1;
   NavigationPoint addressPoint;
   std::string name;
-  if (core->getNavigationEngine()->getAddressPoint(visPos,addressPoint,true)) {
+  if (core->getNavigationEngine()->getAddressPoint(mapPos,addressPoint,true)) {
 
     // Address point found
     name=addressPoint.getName();
@@ -2472,43 +2472,16 @@ void WidgetEngine::updateNearestPath(MapPosition mapPos, std::list<MapTile*> *ce
   }
   //DEBUG("mapPos=(%f,%f) centerMapTiles.size()=%d",mapPos.getLat(),mapPos.getLng(),centerMapTiles->size());
 
-  // Find the nearest path in the currently visible map tile
+  // Find the nearest path in the neighborhood of the center tile
   NavigationPath *nearestPath=NULL;
   Int nearestPathIndex=0;
   MapPosition nearestPathMapPos;
-  double minDistance=std::numeric_limits<double>::max();
-  for(std::list<MapTile*>::iterator j=centerMapTiles->begin();j!=centerMapTiles->end();j++) {
-    std::list<NavigationPathSegment*> nearbyPathSegments;
-    nearbyPathSegments=(*j)->getCrossingNavigationPathSegments();
-    for(std::list<NavigationPathSegment*>::iterator i=nearbyPathSegments.begin();i!=nearbyPathSegments.end();i++) {
-      NavigationPathSegment *s=*i;
-      core->getMapSource()->lockAccess(__FILE__, __LINE__);
-      MapPosition prevVisPos=NavigationPath::getPathInterruptedPos();
-      Int startIndex=s->getStartIndex();
-      if (startIndex>0) startIndex--;
-      Int endIndex=s->getEndIndex();
-      if (endIndex<s->getVisualization()->getPointsSize()-1) endIndex++;
-      //DEBUG("startIndex=%d endIndex=%d pointsSize=%d",startIndex,endIndex,s->getVisualization()->getPointsSize());
-      for(Int j=startIndex;j<=endIndex;j++) {
-        MapPosition visPos=s->getVisualization()->getPoint(j);
-        if ((visPos!=NavigationPath::getPathInterruptedPos())&&(prevVisPos!=NavigationPath::getPathInterruptedPos())) {
-          //DEBUG("j=%d",j);
-          MapPosition normalPos;
-          double d=visPos.computeNormalDistance(prevVisPos,mapPos,overlapInMeters,true,false,&normalPos);   
-          //DEBUG("d=%f minDistance=%f",d,minDistance);         
-          if ((d!=std::numeric_limits<double>::max())&&(d<minDistance)) {
-            /*d=visPos.computeNormalDistance(prevVisPos,mapPos,overlapInMeters,true,true,&normalPos);           
-            DEBUG("d=%f",d); */
-            minDistance=d;
-            nearestPath=s->getPath();
-            nearestPathMapPos=normalPos;
-            nearestPathIndex=visPos.getIndex();
-          }
-        }
-        prevVisPos=visPos;
-      }
-      core->getMapSource()->unlockAccess();
-    }
+  GraphicPosition *visPos=core->getDefaultGraphicEngine()->lockPos(__FILE__, __LINE__);
+  double zoom=visPos->getZoom();
+  core->getDefaultGraphicEngine()->unlockPos();
+  double searchRadiusInMeters;
+  if ((centerMapTiles->size()>0)&&(core->getMapEngine()->calculateMaxDistanceInMeters(core->getMapSource()->getMapTileWidth()*zoom,searchRadiusInMeters))) {
+    nearestPath=core->getNavigationEngine()->getSpatialIndex()->findNearestPath(mapPos,searchRadiusInMeters,overlapInMeters,nearestPathMapPos,nearestPathIndex);
   }
 
   // Store the result
@@ -408,8 +408,8 @@ bool Screen::createScreenShot() {
       pixels=screenShotPixel;
     }
 
-    // Write the PNG
-    result = core->getImage()->writePNG((ImagePixel*)pixels,device,width,height,core->getImage()->getRGBPixelSize(),true);
+    // Send the changes to the device
+    result = device->sendFrame((ImagePixel*)pixels,width,height,core->getImage()->getRGBPixelSize(),true);
 
     // Clean up
     if (openglES30Supported) {
@@ -110,6 +110,7 @@ void Device::closeSocket() {
     close(socketfd);
     socketfd=-1;
   }
+  frameStreamOpen=false;
 }
 
 // Finds out the device details from a network device
@@ -164,13 +165,27 @@ bool Device::send(UByte *buffer, Int length) {
   //DEBUG("n=%d length=%d",n,length);
   if (n != length) {
     DEBUG("can not write to host %s:%d",host.c_str(),port);
-    close(socketfd);
-    socketfd=-1;
+    closeSocket();
     return false;
   }
   return true;
 }
 
+// Reads data from a network device
+bool Device::receive(UByte *buffer, Int length) {
+  Int received=0;
+  while (received<length) {
+    Int n = read(socketfd,&buffer[received],length-received);
+    if (n <= 0) {
+      DEBUG("can not read from host %s:%d",host.c_str(),port);
+      closeSocket();
+      return false;
+    }
+    received+=n;
+  }
+  return true;
+}
+
 // Informs the device that a PNG is sent
 bool Device::announcePNGImage() {
 
@@ -189,5 +204,102 @@ bool Device::announcePNGImage() {
   return true;
 }
 
+// Opens a persistent connection for sending frames
+bool Device::openFrameStream() {
+
+  // Tell the server that it will get a stream of frames
+  if (!openSocket())
+    return false;
+  UByte cmd=0x06;
+  if (!send(&cmd,1))
+    return false;
+
+  // Servers that do not know frame streams close the connection without an answer
+  UByte buffer[4];
+  Int n = read(socketfd,buffer,4);
+  if (n == 0) {
+    DEBUG("host %s:%d does not support frame streams, using PNG images",host.c_str(),port);
+    closeSocket();
+    frameStreamSupported=false;
+    return false;
+  }
+  if (n != 4) {
+    DEBUG("can not read from host %s:%d",host.c_str(),port);
+    closeSocket();
+    return false;
+  }
+  UInt version=ntohl(*((uint32_t*)&buffer[0]));
+  if (version!=1) {
+    DEBUG("host %s:%d uses unknown frame stream version %d, using PNG images",host.c_str(),port,version);
+    closeSocket();
+    frameStreamSupported=false;
+    return false;
+  }
+
+  // The server has no frame yet, so start with a key frame
+  frameEncoder->reset();
+  frameStreamOpen=true;
+  return true;
+}
+
+// Sends the changes of the screen to a network device
+bool Device::sendFrame(ImagePixel *pixels, Int width, Int height, UInt pixelSize, bool inverseRows) {
+
+  // Create the encoder if not yet done
+  if (!frameEncoder) {
+    Int tileSize=core->getConfigStore()->getIntValue("Cockpit/App/Dashboard","frameTileSize",__FILE__,__LINE__);
+    Int compressionLevel=core->getConfigStore()->getIntValue("Cockpit/App/Dashboard","frameCompressionLevel",__FILE__,__LINE__);
+    if (!(frameEncoder=new DeviceFrameEncoder(tileSize,compressionLevel))) {
+      FATAL("can not create frame encoder object",NULL);
+      return false;
+    }
+    if (core->getConfigStore()->getIntValue("Cockpit/App/Dashboard","verifyFrames",__FILE__,__LINE__)) {
+      if (!(frameVerifier=new DeviceFrameDecoder())) {
+        FATAL("can not create frame decoder object",NULL);
+        return false;
+      }
+    }
+  }
+
+  // Connect to the server if not yet done
+  if ((frameStreamSupported)&&(!frameStreamOpen)) {
+    if ((!openFrameStream())&&(frameStreamSupported))
+      return false;
+  }
+
+  // Send the complete screen as PNG if frame streams are not supported
+  if (!frameStreamSupported)
+    return core->getImage()->writePNG(pixels,this,width,height,pixelSize,inverseRows);
+
+  // Skip the frame if nothing has changed
+  if (!frameEncoder->encode(pixels,width,height,pixelSize,inverseRows))
+    return true;
+
+  // Check that the frame can be reconstructed exactly
+  if (frameVerifier) {
+    UInt frameNumber;
+    if ((!frameVerifier->decode(frameEncoder->getPacket(),frameEncoder->getPacketSize(),frameNumber))||(frameNumber!=frameEncoder->getFrameNumber())||(frameVerifier->getFrame()!=frameEncoder->getPendingFrame())) {
+      ERROR("frame %d for host %s:%d can not be reconstructed",frameEncoder->getFrameNumber(),host.c_str(),port);
+    } else {
+      DEBUG("frame %d for host %s:%d: %d tiles in %d bytes",frameEncoder->getFrameNumber(),host.c_str(),port,frameEncoder->getTileCount(),frameEncoder->getPacketSize());
+    }
+  }
+
+  // Send the frame and wait until the server has applied it
+  // If anything goes wrong, the next connection starts with a key frame
+  UByte buffer[4];
+  if ((!send((UByte*)frameEncoder->getPacket(),frameEncoder->getPacketSize()))||(!receive(buffer,4))) {
+    frameEncoder->reset();
+    return false;
+  }
+  if (ntohl(*((uint32_t*)&buffer[0]))!=frameEncoder->getFrameNumber()) {
+    DEBUG("host %s:%d acknowledged wrong frame",host.c_str(),port);
+    closeSocket();
+    frameEncoder->reset();
+    return false;
+  }
+  frameEncoder->acknowledge();
+  return true;
+}
 
 } /* namespace GEODISCOVERER */
@@ -0,0 +1,475 @@
+//============================================================================
+// Name        : DownloadEngine.cpp
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <Core.h>
+#include <DownloadEngine.h>
+#include <fcntl.h>
+
+namespace GEODISCOVERER {
+
+// Largest content length for which memory is reserved before the data arrives
+const size_t downloadEngineMaxPresizedBufferSize = 16*1024*1024;
+
+// Download engine transfer thread
+void *downloadEngineTransferThread(void *args) {
+  DownloadEngine *downloadEngine = (DownloadEngine*)args;
+  downloadEngine->transfer();
+  return NULL;
+}
+
+// Ensures that the buffer of the request can hold the given number of bytes
+static void downloadEngineReserveBuffer(DownloadRequest *request, size_t capacity) {
+  if (capacity <= request->capacity)
+    return;
+  if (!(request->data = (UByte*)realloc(request->data, capacity))) {
+    FATAL("can not reserve memory for downloaded data",NULL);
+    request->capacity = 0;
+    return;
+  }
+  request->capacity = capacity;
+}
+
+// Called by curl when data has been received
+static size_t downloadEngineWriteCallback(void *contents, size_t size, size_t nmemb, void *userp) {
+  size_t realsize = size * nmemb;
+  DownloadRequest *request = (DownloadRequest*)userp;
+  if (request->size + realsize + 1 > request->capacity) {
+    size_t capacity = request->capacity * 2;
+    if (capacity < request->size + realsize + 1)
+      capacity = request->size + realsize + 1;
+    downloadEngineReserveBuffer(request, capacity);
+    if (!request->data)
+      return 0;
+  }
+  memcpy(&(request->data[request->size]), contents, realsize);
+  request->size += realsize;
+  request->data[request->size] = 0;
+  return realsize;
+}
+
+// Returns the value of the header line if it has the given name
+static bool downloadEngineGetHeaderValue(const char *buffer, size_t size, const char *name, std::string &value) {
+  size_t nameLength = strlen(name);
+  if ((size <= nameLength) || (strncasecmp(buffer, name, nameLength) != 0))
+    return false;
+  size_t start = nameLength;
+  while ((start < size) && ((buffer[start] == ' ') || (buffer[start] == '\t')))
+    start++;
+  size_t end = size;
+  while ((end > start) && ((buffer[end - 1] == '\r') || (buffer[end - 1] == '\n') || (buffer[end - 1] == ' ')))
+    end--;
+  value = std::string(buffer + start, end - start);
+  return true;
+}
+
+// Called by curl for every line of the received header
+static size_t downloadEngineHeaderCallback(char *buffer, size_t size, size_t nitems, void *userp) {
+  size_t realsize = size * nitems;
+  DownloadRequest *request = (DownloadRequest*)userp;
+  std::string value;
+
+  // Forget the validators of a previous response (e.g., a redirect)
+  if ((realsize > 5) && (strncmp(buffer, "HTTP/", 5) == 0)) {
+    request->validators.eTag = "";
+    request->validators.lastModified = "";
+    request->validators.expires = 0;
+  }
+
+  // Reserve the memory for the body in one go if the server tells its size
+  if (downloadEngineGetHeaderValue(buffer, realsize, "content-length:", value)) {
+    size_t expectedSize = strtoul(value.c_str(), NULL, 10);
+    if ((expectedSize > 0) && (expectedSize <= downloadEngineMaxPresizedBufferSize))
+      downloadEngineReserveBuffer(request, request->size + expectedSize + 1);
+  }
+
+  // Remember the validators
+  if (downloadEngineGetHeaderValue(buffer, realsize, "etag:", value))
+    request->validators.eTag = value;
+  if (downloadEngineGetHeaderValue(buffer, realsize, "last-modified:", value))
+    request->validators.lastModified = value;
+  if (downloadEngineGetHeaderValue(buffer, realsize, "cache-control:", value)) {
+    size_t pos = value.find("max-age=");
+    if (pos != std::string::npos) {
+      long maxAge = strtol(value.c_str() + pos + 8, NULL, 10);
+      if (maxAge > 0)
+        request->validators.expires = core->getClock()->getSecondsSinceEpoch() + maxAge;
+    }
+  }
+  return realsize;
+}
+
+// Constructor
+DownloadEngine::DownloadEngine() {
+
+  // Get config
+  maxHostConnections=core->getConfigStore()->getIntValue("Map","downloadMaxHostConnections",__FILE__, __LINE__);
+  maxTotalConnections=core->getConfigStore()->getIntValue("Map","downloadMaxTotalConnections",__FILE__, __LINE__);
+  maxActiveTransfers=core->getConfigStore()->getIntValue("Map","downloadMaxActiveTransfers",__FILE__, __LINE__);
+
+  // Reset variables
+  quitTransferThread=false;
+  abortRequests=false;
+  requestsAborted=false;
+  completedTransfers=0;
+  openedConnections=0;
+  curl_version_info_data *versionInfo=curl_version_info(CURLVERSION_NOW);
+  multiplexingSupported=(versionInfo->features & CURL_VERSION_HTTP2)!=0;
+
+  // Create the multi handle that keeps the connections open between transfers
+  if (!(multi=curl_multi_init())) {
+    FATAL("can not initialize curl multi interface",NULL);
+    return;
+  }
+  if (multiplexingSupported)
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+  curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)maxHostConnections);
+  curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)maxTotalConnections);
+  curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long)maxTotalConnections);
+
+  // Create the pipe to wake up the transfer thread
+  if (pipe(wakeupPipe)!=0) {
+    FATAL("can not create wakeup pipe for download engine",NULL);
+    return;
+  }
+  fcntl(wakeupPipe[0], F_SETFL, fcntl(wakeupPipe[0], F_GETFL) | O_NONBLOCK);
+  fcntl(wakeupPipe[1], F_SETFL, fcntl(wakeupPipe[1], F_GETFL) | O_NONBLOCK);
+
+  // Start the transfer thread
+  accessMutex=core->getThread()->createMutex("download engine access mutex");
+  requestsAbortedSignal=core->getThread()->createSignal();
+  transferThreadInfo=core->getThread()->createThread("download engine transfer thread",downloadEngineTransferThread,(void*)this);
+}
+
+// Destructor
+DownloadEngine::~DownloadEngine() {
+
+  // Stop the transfer thread
+  core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+  quitTransferThread=true;
+  core->getThread()->unlockMutex(accessMutex);
+  wakeupTransferThread();
+  core->getThread()->waitForThread(transferThreadInfo);
+  core->getThread()->destroyThread(transferThreadInfo);
+
+  // Let the remaining requests fail
+  while (activeRequests.size()>0) {
+    DownloadRequest *request=activeRequests.front();
+    stopTransfer(request);
+    abortRequest(request);
+  }
+  for (std::list<DownloadRequest*>::iterator i=queuedRequests.begin();i!=queuedRequests.end();i++) {
+    abortRequest(*i);
+  }
+  queuedRequests.clear();
+
+  // Free all handles
+  for (std::list<CURL*>::iterator i=unusedHandles.begin();i!=unusedHandles.end();i++) {
+    curl_easy_cleanup(*i);
+  }
+  unusedHandles.clear();
+  curl_multi_cleanup(multi);
+  close(wakeupPipe[0]);
+  close(wakeupPipe[1]);
+  core->getThread()->destroySignal(requestsAbortedSignal);
+  core->getThread()->destroyMutex(accessMutex);
+}
+
+// Wakes up the transfer thread
+void DownloadEngine::wakeupTransferThread() {
+  char c=0;
+  if (write(wakeupPipe[1],&c,1)<0) {
+    // pipe is full, so the thread will wake up anyway
+  }
+}
+
+// Hands the request over to curl
+void DownloadEngine::startTransfer(DownloadRequest *request) {
+
+  // Reuse an easy handle of a previous transfer
+  CURL *curl;
+  if (unusedHandles.size()>0) {
+    curl=unusedHandles.front();
+    unusedHandles.pop_front();
+    curl_easy_reset(curl);
+  } else {
+    if (!(curl=curl_easy_init())) {
+      FATAL("can not initialize curl library",NULL);
+      return;
+    }
+  }
+  request->curl=curl;
+
+  // Configure the transfer
+  curl_easy_setopt(curl, CURLOPT_URL, request->url.c_str());
+  curl_easy_setopt(curl, CURLOPT_USERAGENT, "Geo Discoverer (build on "  __DATE__  ")");
+  if (request->header) curl_easy_setopt(curl, CURLOPT_HTTPHEADER, request->header);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, request);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, downloadEngineWriteCallback);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, request);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, downloadEngineHeaderCallback);
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, request->errorBuffer);
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, request);
+  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+  if (multiplexingSupported) {
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+  }
+
+  // Start it
+  activeRequests.push_back(request);
+  curl_multi_add_handle(multi, curl);
+}
+
+// Removes the request from curl
+void DownloadEngine::stopTransfer(DownloadRequest *request) {
+  curl_multi_remove_handle(multi, request->curl);
+  unusedHandles.push_back(request->curl);
+  request->curl=NULL;
+  activeRequests.remove(request);
+}
+
+// Informs the waiting thread that the request is over
+void DownloadEngine::completeRequest(DownloadRequest *request) {
+  if (request->header) {
+    curl_slist_free_all(request->header);
+    request->header=NULL;
+  }
+  core->getThread()->issueSignal(request->completedSignal);
+}
+
+// Lets the request fail without transferring it
+void DownloadEngine::abortRequest(DownloadRequest *request) {
+  request->curlResult=CURLE_ABORTED_BY_CALLBACK;
+  strcpy(request->errorBuffer,"download aborted");
+  completeRequest(request);
+}
+
+// Queues the URL for download
+DownloadRequest *DownloadEngine::submitRequest(std::string url, std::list<std::string> *httpHeader, const DownloadValidators *validators) {
+
+  // Create the request
+  DownloadRequest *request;
+  if (!(request=new DownloadRequest())) {
+    FATAL("can not create download request",NULL);
+    return NULL;
+  }
+  request->url=url;
+  request->header=NULL;
+  request->curl=NULL;
+  request->data=NULL;
+  request->size=0;
+  request->capacity=0;
+  request->errorBuffer[0]=0;
+  request->curlResult=CURLE_OK;
+  request->responseCode=0;
+  request->validators.expires=0;
+  request->completedSignal=core->getThread()->createSignal();
+  if (httpHeader) {
+    for (std::list<std::string>::iterator i=httpHeader->begin();i!=httpHeader->end();i++) {
+      request->header = curl_slist_append(request->header, (*i).c_str());
+    }
+  }
+  if (validators) {
+    if (validators->eTag!="")
+      request->header = curl_slist_append(request->header, ("If-None-Match: " + validators->eTag).c_str());
+    if (validators->lastModified!="")
+      request->header = curl_slist_append(request->header, ("If-Modified-Since: " + validators->lastModified).c_str());
+  }
+
+  // Queue it for the transfer thread
+  core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+  if (abortRequests) {
+    abortRequest(request);
+  } else {
+    queuedRequests.push_back(request);
+  }
+  core->getThread()->unlockMutex(accessMutex);
+  wakeupTransferThread();
+  return request;
+}
+
+// Waits until the request is over and returns the downloaded data
+UByte *DownloadEngine::waitForRequest(DownloadRequest *request, DownloadResult &result, UInt &size, bool generateMessages, bool ignoreFileNotFoundErrors, DownloadValidators *validators) {
+
+  // Wait until the transfer thread has finished the request
+  core->getThread()->waitForSignal(request->completedSignal);
+  UByte *data=request->data;
+  size_t dataSize=request->size;
+  std::string url=request->url;
+  std::string errorMessage=request->errorBuffer;
+  CURLcode curlResult=request->curlResult;
+  long responseCode=request->responseCode;
+  if (validators)
+    *validators=request->validators;
+  core->getThread()->destroySignal(request->completedSignal);
+  delete request;
+
+  // Handle errors
+  size=0;
+  switch(curlResult) {
+    case CURLE_REMOTE_FILE_NOT_FOUND:
+      result=DownloadResultFileNotFound;
+      break;
+    case CURLE_OK: {
+      switch (responseCode) {
+        case 200:
+          result=DownloadResultSuccess;
+          size=dataSize;
+          break;
+        case 304:
+          result=DownloadResultNotModified;
+          break;
+        case 404:
+          result=DownloadResultFileNotFound;
+          break;
+        default:
+          result=DownloadResultOtherFail;
+          break;
+      }
+      std::stringstream s;
+      s << "response code = " << responseCode;
+      errorMessage=s.str();
+      break;
+    }
+    default:
+      result=DownloadResultOtherFail;
+      break;
+  }
+  if (result!=DownloadResultSuccess) {
+
+    // Free the downloaded memory
+    if (data)
+      free(data);
+    data=NULL;
+
+    // Output warning
+    if ((generateMessages)&&(result!=DownloadResultNotModified)) {
+      if ((ignoreFileNotFoundErrors)&&(result==DownloadResultFileNotFound)) {
+        DEBUG("can not download url: %s (url=%s)",errorMessage.c_str(),url.c_str());
+      } else {
+        WARNING("can not download url: %s (url=%s)",errorMessage.c_str(),url.c_str());
+      }
+    }
+  }
+  return data;
+}
+
+// Lets all pending and future requests fail
+void DownloadEngine::abortAllRequests() {
+  core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+  abortRequests=true;
+  core->getThread()->unlockMutex(accessMutex);
+  wakeupTransferThread();
+  core->getThread()->waitForSignal(requestsAbortedSignal);
+}
+
+// Performs the transfers (called by the transfer thread)
+void DownloadEngine::transfer() {
+
+  // Set the priority
+  core->getThread()->setThreadPriority(threadPriorityBackgroundLow);
+
+  // Do an endless loop
+  while (1) {
+
+    // Take over the queued requests
+    core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+    if (quitTransferThread) {
+      core->getThread()->unlockMutex(accessMutex);
+      return;
+    }
+    if ((abortRequests)&&(!requestsAborted)) {
+
+      // Let all requests fail such that no waiting thread is woken up later
+      while (activeRequests.size()>0) {
+        DownloadRequest *request=activeRequests.front();
+        stopTransfer(request);
+        abortRequest(request);
+      }
+      for (std::list<DownloadRequest*>::iterator i=queuedRequests.begin();i!=queuedRequests.end();i++) {
+        abortRequest(*i);
+      }
+      queuedRequests.clear();
+      requestsAborted=true;
+      core->getThread()->issueSignal(requestsAbortedSignal);
+    }
+
+    // Only hand over as many requests as there are free transfer slots
+    // The remaining ones stay in the queue until a transfer is over
+    std::list<DownloadRequest*> newRequests;
+    while ((queuedRequests.size()>0)&&((Int)(activeRequests.size()+newRequests.size())<maxActiveTransfers)) {
+      newRequests.splice(newRequests.end(),queuedRequests,queuedRequests.begin());
+    }
+    core->getThread()->unlockMutex(accessMutex);
+    for (std::list<DownloadRequest*>::iterator i=newRequests.begin();i!=newRequests.end();i++) {
+      startTransfer(*i);
+    }
+
+    // Let curl do the work
+    int runningTransfers;
+    curl_multi_perform(multi, &runningTransfers);
+
+    // Hand over the finished requests
+    CURLMsg *msg;
+    int remainingMessages;
+    bool transfersCompleted=false;
+    while ((msg=curl_multi_info_read(multi, &remainingMessages))) {
+      if (msg->msg==CURLMSG_DONE) {
+        CURL *curl=msg->easy_handle;
+        CURLcode curlResult=msg->data.result;
+        DownloadRequest *request=NULL;
+        long newConnections=0;
+        curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char**)&request);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &request->responseCode);
+        curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &newConnections);
+        request->curlResult=curlResult;
+        stopTransfer(request);
+        core->getThread()->lockMutex(accessMutex,__FILE__, __LINE__);
+        completedTransfers++;
+        openedConnections+=newConnections;
+        completeRequest(request);
+        core->getThread()->unlockMutex(accessMutex);
+        transfersCompleted=true;
+      }
+    }
+
+    // Fill the free transfer slots right away
+    if (transfersCompleted)
+      continue;
+
+    // Wait until a connection has new data or a new request has arrived
+    struct curl_waitfd wakeupFd;
+    wakeupFd.fd=wakeupPipe[0];
+    wakeupFd.events=CURL_WAIT_POLLIN;
+    wakeupFd.revents=0;
+    curl_multi_wait(multi, &wakeupFd, 1, 1000, NULL);
+    if (wakeupFd.revents) {
+      char buffer[64];
+      while (read(wakeupPipe[0],buffer,sizeof(buffer))>0);
+    }
+  }
+}
+
+}
@@ -0,0 +1,124 @@
+//============================================================================
+// Name        : DownloadEngine.h
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#ifndef DOWNLOADENGINE_H_
+#define DOWNLOADENGINE_H_
+
+#include <curl/curl.h>
+
+namespace GEODISCOVERER {
+
+// HTTP validators that allow to check if a downloaded file has changed
+typedef struct DownloadValidators {
+  std::string eTag;                   // Entity tag of the file
+  std::string lastModified;           // Modification date of the file as reported by the server
+  TimestampInSeconds expires;         // Time until the file does not need to be checked again (0 if unknown)
+} DownloadValidators;
+
+// A single download handled by the engine
+typedef struct DownloadRequest {
+  std::string url;                    // URL to download
+  struct curl_slist *header;          // Additional lines for the HTTP header
+  CURL *curl;                         // Easy handle that performs the transfer
+  UByte *data;                        // Downloaded data
+  size_t size;                        // Number of bytes downloaded so far
+  size_t capacity;                    // Number of bytes reserved for the data
+  char errorBuffer[CURL_ERROR_SIZE];  // Error message of curl
+  CURLcode curlResult;                // Result of the transfer
+  long responseCode;                  // Response code of the server
+  DownloadValidators validators;      // Validators received from the server
+  ThreadSignalInfo *completedSignal;  // Issued when the transfer is over
+} DownloadRequest;
+
+// Downloads multiple URLs in parallel over reused connections
+class DownloadEngine {
+
+protected:
+
+  CURLM *multi;                                 // Multi handle that drives all transfers
+  std::list<CURL*> unusedHandles;               // Easy handles that can be used for the next transfer
+  std::list<DownloadRequest*> queuedRequests;   // Requests that have not been handed over to curl yet
+  std::list<DownloadRequest*> activeRequests;   // Requests that are currently transferred
+  ThreadMutexInfo *accessMutex;                 // Mutex to control access to the queue
+  ThreadInfo *transferThreadInfo;               // Thread that performs the transfers
+  ThreadSignalInfo *requestsAbortedSignal;      // Issued when all requests have been aborted
+  int wakeupPipe[2];                            // Used to wake up the transfer thread
+  bool quitTransferThread;                      // Indicates that the transfer thread shall exit
+  bool abortRequests;                           // Indicates that all requests shall fail
+  bool requestsAborted;                         // Indicates that the transfer thread has aborted all requests
+  bool multiplexingSupported;                   // Indicates if curl can multiplex transfers over one connection
+  Int maxHostConnections;                       // Maximum number of connections to the same server
+  Int maxTotalConnections;                      // Maximum number of connections to all servers
+  Int maxActiveTransfers;                       // Maximum number of requests that are handed over to curl at the same time
+  ULong completedTransfers;                     // Number of transfers that have been completed
+  ULong openedConnections;                      // Number of connections that had to be opened
+
+  // Wakes up the transfer thread
+  void wakeupTransferThread();
+
+  // Hands the request over to curl
+  void startTransfer(DownloadRequest *request);
+
+  // Removes the request from curl
+  void stopTransfer(DownloadRequest *request);
+
+  // Informs the waiting thread that the request is over
+  void completeRequest(DownloadRequest *request);
+
+  // Lets the request fail without transferring it
+  void abortRequest(DownloadRequest *request);
+
+public:
+
+  // Constructor
+  DownloadEngine();
+
+  // Destructor
+  virtual ~DownloadEngine();
+
+  // Queues the URL for download
+  // If validators are given, the file is only transferred if it has changed
+  DownloadRequest *submitRequest(std::string url, std::list<std::string> *httpHeader = NULL, const DownloadValidators *validators = NULL);
+
+  // Waits until the request is over and returns the downloaded data
+  // If validators are given, they are set to the ones received from the server
+  UByte *waitForRequest(DownloadRequest *request, DownloadResult &result, UInt &size, bool generateMessages, bool ignoreFileNotFoundErrors, DownloadValidators *validators = NULL);
+
+  // Lets all pending and future requests fail
+  void abortAllRequests();
+
+  // Performs the transfers (called by the transfer thread)
+  void transfer();
+
+  // Getters and setters
+  ULong getCompletedTransfers() const {
+    return completedTransfers;
+  }
+
+  ULong getOpenedConnections() const {
+    return openedConnections;
+  }
+};
+
+}
+
+#endif /* DOWNLOADENGINE_H_ */
@@ -110,6 +110,47 @@ bool ElevationEngine::init() {
     FATAL("cannot find hBand in DEM dataset",NULL);
     return false;
   }
+
+  // Setup the coordinate transformations for the native hillshade rendering
+  // No transformation is required if the DEM data is already in WGS84
+  double adfGeoTransformLowRes[6];
+  if (GDALGetGeoTransform(demDatasetLowRes[0], adfGeoTransformLowRes) != CE_None) {
+    FATAL("cannot create geo transformation",NULL);
+    return false;
+  }
+  if (!GDALInvGeoTransform(adfGeoTransformLowRes, adfInvGeoTransformLowRes)) {
+    FATAL("cannot create inverse geo transformation",NULL);
+    return false;
+  }
+  if (!(hCTFullRes=(DEMCoordinateTransformation*)malloc(workerCount*sizeof(DEMCoordinateTransformation)))) {
+    FATAL("no memory",NULL);
+    return false;
+  }
+  memset(hCTFullRes,0,workerCount*sizeof(DEMCoordinateTransformation));
+  if (!(hCTLowRes=(DEMCoordinateTransformation*)malloc(workerCount*sizeof(DEMCoordinateTransformation)))) {
+    FATAL("no memory",NULL);
+    return false;
+  }
+  memset(hCTLowRes,0,workerCount*sizeof(DEMCoordinateTransformation));
+  auto hTrgSRSLowRes = GDALGetSpatialRef( demDatasetLowRes[0] );
+  if (!hTrgSRSLowRes) {
+    FATAL("cannot create spatial reference ",NULL);
+    return false;
+  }
+  for (Int i=0;i<workerCount;i++) {
+    if (!OSRIsSame(hSrcSRS, hTrgSRS)) {
+      if (!(hCTFullRes[i] = OCTNewCoordinateTransformation( hSrcSRS, hTrgSRS ))) {
+        FATAL("cannot create coordinate transformator",NULL);
+        return false;
+      }
+    }
+    if (!OSRIsSame(hSrcSRS, hTrgSRSLowRes)) {
+      if (!(hCTLowRes[i] = OCTNewCoordinateTransformation( hSrcSRS, hTrgSRSLowRes ))) {
+        FATAL("cannot create coordinate transformator",NULL);
+        return false;
+      }
+    }
+  }
   
   // We are ready
   isInitialized=true;
@@ -178,6 +219,22 @@ void ElevationEngine::deinit() {
     OCTDestroyCoordinateTransformation(hCT);
     hCT=NULL;
   }
+  if (hCTFullRes) {
+    for (Int i=0;i<workerCount;i++) {
+      if (hCTFullRes[i])
+        OCTDestroyCoordinateTransformation(hCTFullRes[i]);
+    }
+    free(hCTFullRes);
+    hCTFullRes=NULL;
+  }
+  if (hCTLowRes) {
+    for (Int i=0;i<workerCount;i++) {
+      if (hCTLowRes[i])
+        OCTDestroyCoordinateTransformation(hCTLowRes[i]);
+    }
+    free(hCTLowRes);
+    hCTLowRes=NULL;
+  }
   // Blocks under Android for unknown reasons
   if (pszSourceSRS) {
     CPLFree(pszSourceSRS);
@@ -203,6 +260,7 @@ void ElevationEngine::deinit() {
     free(demDatasetBusy);
     demDatasetBusy=NULL;
   }
+  clearDEMBlockCache();
 }
 
 // Converts a tile y number into latitude
@@ -224,142 +282,110 @@ void ElevationEngine::resetDemDatasetBusy(Int workerNr) {
   core->getThread()->issueSignal(demDatasetReadySignal);
 }
 
-// Creates a hillshading for the given map area
-UByte *ElevationEngine::renderHillshadeTile(Int z, Int y, Int x, UInt &imageSize) {
+// Reads a block from the DEM dataset (each value is the average of 2^decimationLevel x 2^decimationLevel pixels)
+float *ElevationEngine::readDEMBlock(DEMDataset *demDataset, Int decimationLevel, Int blockX, Int blockY, Int &width, Int &height) {
+
+  // Compute the area of the block in the dataset
+  Int decimation=1<<decimationLevel;
+  Int srcX1=blockX*demBlockLength*decimation;
+  Int srcY1=blockY*demBlockLength*decimation;
+  Int srcX2=std::min(srcX1+demBlockLength*decimation,demDataset->GetRasterXSize());
+  Int srcY2=std::min(srcY1+demBlockLength*decimation,demDataset->GetRasterYSize());
+  width=(srcX2-srcX1+decimation-1)/decimation;
+  height=(srcY2-srcY1+decimation-1)/decimation;
+  if ((width<=0)||(height<=0))
+    return NULL;
 
-  // Do not work if not initialized anymore
-  if (!isInitialized)
+  // Read the block
+  float *elevations;
+  if (!(elevations=(float*)malloc(width*height*sizeof(float)))) {
+    FATAL("can not reserve memory",NULL);
+    return NULL;
+  }
+  GDALRasterBand *band=demDataset->GetRasterBand(1);
+  GDALRasterIOExtraArg extraArg;
+  INIT_RASTERIO_EXTRA_ARG(extraArg);
+  if (decimation>1)
+    extraArg.eResampleAlg=GRIORA_Average;
+  if (band->RasterIO(GF_Read, srcX1, srcY1, srcX2-srcX1, srcY2-srcY1, elevations, width, height, GDT_Float32, 0, 0, &extraArg)!=CE_None) {
+    DEBUG("can not read DEM data",NULL);
+    free(elevations);
     return NULL;
+  }
 
-  // Get the dataset to use
-  DEMDataset *demDatasetFullRes;
-  DEMDataset *demDatasetLowRes;
-  Int workerNr;
-  core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
-  while (true) {
-    bool found=false;
-    for (int i=0;i<workerCount;i++) {
-      if (!demDatasetBusy[i]) {
-        //DEBUG("using dem dataset %d",i);
-        demDatasetFullRes=this->demDatasetFullRes[i];
-        demDatasetLowRes=this->demDatasetLowRes[i];
-        demDatasetBusy[i]=true;
-        workerNr=i;
-        found=true;
-        break;
-      }
-    }
-    if (found) {
-      break;
-    } else {
-      //DEBUG("waiting for next available dem dataset",NULL);
-      core->getThread()->unlockMutex(accessMutex);
-      core->getThread()->waitForSignal(demDatasetReadySignal);
-      core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
+  // Mark missing data
+  int hasNoData=FALSE;
+  float noData=band->GetNoDataValue(&hasNoData);
+  if (hasNoData) {
+    for (Int i=0;i<width*height;i++) {
+      if (elevations[i]==noData)
+        elevations[i]=NAN;
     }
   }
+  return elevations;
+}
+
+// Renders the hillshade of the given mercator area with GDAL's warp and DEM processing tools
+ImagePixel *ElevationEngine::renderHillshadeWithGDAL(DEMDataset *demDataset, Int z, double mercatorX1, double mercatorY1, double mercatorX2, double mercatorY2, Int width, Int height) {
 
   // Decide on the filenames
+  core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
   std::stringstream imageFilenameStream;
-  imageFilenameStream << "/vsimem/hillshade_" << tileNumber << "_" << z << "_" << y << "_" << x <<".png";
+  imageFilenameStream << "/vsimem/hillshade_" << tileNumber << ".png";
   std::string imageFilename=imageFilenameStream.str();
   std::stringstream warpFilename;
-  warpFilename << "/vsimem/warp_" << tileNumber << "_" << z << "_" << y << "_" << x << ".tif";
+  warpFilename << "/vsimem/warp_" << tileNumber << ".tif";
   tileNumber++;
   core->getThread()->unlockMutex(accessMutex);
 
-  // Calculate the bounding box
-  double worldRes = pow(2.0, z);
-  double lonRes = 360.0 / worldRes;
-  double lon1 = tilex2lon(std::max(0, x-1), worldRes);
-  double lat1 = tiley2lat(std::max(0, y-1), worldRes);
-  double lat2 = tiley2lat(std::min(worldRes, (double)y+2), worldRes);
-  double lon2 = tilex2lon(std::min(worldRes, (double)x+2), worldRes);
-  double latMin = std::min(lat1, lat2);
-  double lonMin = std::min(lon1, lon2);
-  double latMax = std::max(lat1, lat2);
-  double lonMax = std::max(lon1, lon2);
-  Int imageWidth=256;
-  Int imageHeight=256;
-  Int renderWidth=imageWidth;
-  Int renderHeight=imageHeight;
-  Int cropX1=0;
-  Int cropY1=0;
-  if (x>0) {
-    cropX1=256;
-    renderWidth+=256;
-  }  
-  if (y>0) {
-    cropY1=256;
-    renderHeight+=256;
-  }
-  Int cropX2=renderWidth;
-  Int cropY2=renderHeight;
-  if (x<worldRes-1) {
-    renderWidth+=256;
-    cropX2=renderWidth-256;
-  }
-  if (y<worldRes-1) {
-    renderHeight+=256;
-    cropY2=renderHeight-256;
-  }
-
   // Convert variables to strings
-  std::stringstream lonMinStr,latMinStr,lonMaxStr,latMaxStr,widthStr,heightStr;
-  lonMinStr<<lonMin;
-  lonMaxStr<<lonMax;
-  latMinStr<<latMin;
-  latMaxStr<<latMax;
-  widthStr<<renderWidth;
-  heightStr<<renderHeight;
+  std::stringstream x1Str,y1Str,x2Str,y2Str,widthStr,heightStr;
+  x1Str<<std::setprecision(17)<<mercatorX1;
+  x2Str<<std::setprecision(17)<<mercatorX2;
+  y1Str<<std::setprecision(17)<<mercatorY1;
+  y2Str<<std::setprecision(17)<<mercatorY2;
+  widthStr<<width;
+  heightStr<<height;
 
   // Create the options for warping into the correct projection
   const char *interpolationAlgo="cubic";
   /*if (z<11)
     interpolationAlgo="near";*/
+  std::string x1=x1Str.str(), y1=y1Str.str(), x2=x2Str.str(), y2=y2Str.str(), w=widthStr.str(), h=heightStr.str();
   const char *warpArgs[] = {
     "-t_srs",
     "EPSG:3857",
     "-r",
     interpolationAlgo,
     "-te",
-    lonMinStr.str().c_str(),
-    latMinStr.str().c_str(),
-    lonMaxStr.str().c_str(),
-    latMaxStr.str().c_str(),
-    "-te_srs",
-    "EPSG:4326",
+    x1.c_str(),
+    y1.c_str(),
+    x2.c_str(),
+    y2.c_str(),
     "-ts",
-    widthStr.str().c_str(),
-    heightStr.str().c_str(),
+    w.c_str(),
+    h.c_str(),
     NULL
   };
   GDALWarpAppOptions *warpOptions = GDALWarpAppOptionsNew((char**)warpArgs,NULL);
   if (warpOptions==NULL) {
     FATAL("can not create warp options",NULL);
-    resetDemDatasetBusy(workerNr);
     return NULL;
   }
 
-  // Decide which data source to use
-  GDALDataset *srcDS[] = { demDatasetFullRes };
-  if (z<=lowResZoomLevel)
-    srcDS[0]=demDatasetLowRes;
-  
   // Abort here if quit is requested
   if (!isInitialized) {
     GDALWarpAppOptionsFree(warpOptions);
-    resetDemDatasetBusy(workerNr);
     return NULL;
   }
 
   // Warp the source data set into the correct projection
+  GDALDataset *srcDS[] = { demDataset };
   int usageError = FALSE;
   GDALDatasetH warpDS = GDALWarp(warpFilename.str().c_str(), NULL, 1, (GDALDatasetH*)srcDS, warpOptions, &usageError);
   GDALWarpAppOptionsFree(warpOptions);
   if ((usageError)||(warpDS==NULL)) {
     DEBUG("gdal warp operation failed",NULL);
-    resetDemDatasetBusy(workerNr);
     return NULL;
   }
 
@@ -383,7 +409,6 @@ UByte *ElevationEngine::renderHillshadeTile(Int z, Int y, Int x, UInt &imageSize
     FATAL("can not create hillshade options",NULL);
     GDALClose(warpDS);
     VSIUnlink(warpFilename.str().c_str());
-    resetDemDatasetBusy(workerNr);
     return NULL;
   }
 
@@ -392,7 +417,6 @@ UByte *ElevationEngine::renderHillshadeTile(Int z, Int y, Int x, UInt &imageSize
     GDALDEMProcessingOptionsFree(hillshadeOptions);
     GDALClose(warpDS);
     VSIUnlink(warpFilename.str().c_str());
-    resetDemDatasetBusy(workerNr);
     return NULL;
   }
 
@@ -403,7 +427,6 @@ UByte *ElevationEngine::renderHillshadeTile(Int z, Int y, Int x, UInt &imageSize
   VSIUnlink(warpFilename.str().c_str());
   if ((usageError)||(hillshadeDS==NULL)) {
     DEBUG("gdal hillshade operation failed",NULL);
-    resetDemDatasetBusy(workerNr);
     return NULL;
   }
   GDALClose(hillshadeDS);
@@ -412,7 +435,6 @@ UByte *ElevationEngine::renderHillshadeTile(Int z, Int y, Int x, UInt &imageSize
   if (!isInitialized) {
     VSIUnlink(imageFilename.c_str());
     VSIUnlink((imageFilename+".aux.xml").c_str());
-    resetDemDatasetBusy(workerNr);
     return NULL;
   }
 
@@ -420,58 +442,271 @@ UByte *ElevationEngine::renderHillshadeTile(Int z, Int y, Int x, UInt &imageSize
   vsi_l_offset size;
   GByte *data=VSIGetMemFileBuffer(imageFilename.c_str(), &size, true);  
   UInt pixelSize;
-  ImagePixel *hillshadePixels=core->getImage()->loadPNG((UByte*)data,size,renderWidth,renderHeight,pixelSize,false);
+  ImagePixel *hillshadePixels=core->getImage()->loadPNG((UByte*)data,size,width,height,pixelSize,NULL);
   VSIFree(data);
   VSIUnlink((imageFilename+".aux.xml").c_str());
   if ((!hillshadePixels)||(pixelSize!=Image::getRGBPixelSize())) {
     FATAL("can not read <%s>",imageFilename.c_str());
     if (hillshadePixels)
       free(hillshadePixels);
-    resetDemDatasetBusy(workerNr);
     return NULL;
   }
-  //DEBUG("renderWidth=%d renderHeight=%d pixelSize=%d",renderWidth,renderHeight,pixelSize);
+  //DEBUG("width=%d height=%d pixelSize=%d",width,height,pixelSize);
+
+  // Keep only one channel of the gray image
+  for (Int i=0;i<width*height;i++) {
+    hillshadePixels[i]=hillshadePixels[i*Image::getRGBPixelSize()];
+  }
+  return hillshadePixels;
+}
+
+// Renders the hillshade of the given mercator area directly from the DEM data
+ImagePixel *ElevationEngine::renderHillshadeNatively(DEMDataset *demDataset, bool lowRes, DEMCoordinateTransformation demTransform, double *demInvGeoTransform, Int z, double mercatorX1, double mercatorY1, double mercatorX2, double mercatorY2, Int width, Int height) {
+
+  // Reserve memory
+  Int count=width*height;
+  double *demX=(double*)malloc(count*sizeof(double));
+  double *demY=(double*)malloc(count*sizeof(double));
+  float *elevations=(float*)malloc(count*sizeof(float));
+  ImagePixel *hillshadePixels=(ImagePixel*)malloc(count);
+  if ((!demX)||(!demY)||(!elevations)||(!hillshadePixels)) {
+    FATAL("can not reserve memory",NULL);
+    return NULL;
+  }
+  float *dem=NULL;
+
+  // Compute the geographic position of all pixel centers
+  // Longitude only depends on the column and latitude only on the row
+  const double earthRadius=6378137.0;
+  double resolution=(mercatorX2-mercatorX1)/width;
+  for (Int y=0;y<height;y++) {
+    double lat=(2*atan(exp((mercatorY2-(y+0.5)*resolution)/earthRadius))-M_PI/2)*180.0/M_PI;
+    for (Int x=0;x<width;x++) {
+      demY[y*width+x]=lat;
+    }
+  }
+  for (Int x=0;x<width;x++) {
+    demX[x]=(mercatorX1+(x+0.5)*resolution)/earthRadius*180.0/M_PI;
+  }
+  for (Int y=1;y<height;y++) {
+    memcpy(&demX[y*width],demX,width*sizeof(double));
+  }
+
+  // Convert the positions into pixels of the DEM
+  if (demTransform) {
+    if (!OCTTransform(demTransform, count, demX, demY, nullptr)) {
+      DEBUG("cannot transform coordinates",NULL);
+      goto cleanup;
+    }
+  }
+  double minX,minY,maxX,maxY;
+  minX=minY=std::numeric_limits<double>::max();
+  maxX=maxY=-std::numeric_limits<double>::max();
+  for (Int i=0;i<count;i++) {
+    double lng=demX[i];
+    double lat=demY[i];
+    demX[i]=demInvGeoTransform[0]+demInvGeoTransform[1]*lng+demInvGeoTransform[2]*lat;
+    demY[i]=demInvGeoTransform[3]+demInvGeoTransform[4]*lng+demInvGeoTransform[5]*lat;
+    minX=std::min(minX,demX[i]);
+    minY=std::min(minY,demY[i]);
+    maxX=std::max(maxX,demX[i]);
+    maxY=std::max(maxY,demY[i]);
+  }
 
   // Abort here if quit is requested
-  if (!isInitialized) {
-    free(hillshadePixels);
-    resetDemDatasetBusy(workerNr);
+  if (!isInitialized)
+    goto cleanup;
+
+  // Get the required part of the DEM including the neighbors needed for interpolation
+  // If the DEM is much finer than the tile, a reduced resolution is used to save time
+  {
+    Int decimationLevel=0;
+    double scale=std::max((maxX-minX)/width,(maxY-minY)/height);
+    while ((decimationLevel<16)&&((double)(2<<decimationLevel)<=scale))
+      decimationLevel++;
+    double decimation=1<<decimationLevel;
+    Int demWidth=demDataset->GetRasterXSize();
+    Int demHeight=demDataset->GetRasterYSize();
+    Int windowX1=std::max((Int)floor(minX/decimation)-2,0);
+    Int windowY1=std::max((Int)floor(minY/decimation)-2,0);
+    Int windowX2=std::min((Int)ceil(maxX/decimation)+2,(Int)ceil(demWidth/decimation));
+    Int windowY2=std::min((Int)ceil(maxY/decimation)+2,(Int)ceil(demHeight/decimation));
+    if ((windowX1>=windowX2)||(windowY1>=windowY2)) {
+      DEBUG("area is outside the DEM dataset",NULL);
+      goto cleanup;
+    }
+    Int windowWidth=windowX2-windowX1;
+    Int windowHeight=windowY2-windowY1;
+    if (!(dem=(float*)malloc(windowWidth*windowHeight*sizeof(float)))) {
+      FATAL("can not reserve memory",NULL);
+      goto cleanup;
+    }
+    if (!copyDEMWindow(demDataset,lowRes,decimationLevel,demWidth,demHeight,windowX1,windowY1,windowX2,windowY2,dem)) {
+      DEBUG("can not read DEM data",NULL);
+      goto cleanup;
+    }
+
+    // Abort here if quit is requested
+    if (!isInitialized)
+      goto cleanup;
+
+    // Interpolate the elevation for each pixel
+    // Pixels outside of the DEM get no elevation and thus end up transparent
+    for (Int i=0;i<count;i++) {
+      demX[i]=demX[i]/decimation-windowX1;
+      demY[i]=demY[i]/decimation-windowY1;
+    }
+    resampleDEM(dem,windowWidth,windowHeight,-windowX1,-windowY1,demWidth/decimation-windowX1,demHeight/decimation-windowY1,demX,demY,count,elevations);
+  }
+
+  // Compute the hillshade
+  computeHillshade(elevations,width,height,resolution,z>=11,hillshadePixels);
+  free(dem);
+  free(elevations);
+  free(demY);
+  free(demX);
+  return hillshadePixels;
+
+cleanup:
+  if (dem)
+    free(dem);
+  free(elevations);
+  free(demY);
+  free(demX);
+  free(hillshadePixels);
+  return NULL;
+}
+
+// Creates a hillshading for the given map area
+UByte *ElevationEngine::renderHillshadeTile(Int z, Int y, Int x, UInt &imageSize) {
+
+  // Do not work if not initialized anymore
+  if (!isInitialized)
     return NULL;
+
+  // Get the dataset to use
+  DEMDataset *demDatasetFullRes;
+  DEMDataset *demDatasetLowRes;
+  Int workerNr;
+  core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
+  while (true) {
+    bool found=false;
+    for (int i=0;i<workerCount;i++) {
+      if (!demDatasetBusy[i]) {
+        //DEBUG("using dem dataset %d",i);
+        demDatasetFullRes=this->demDatasetFullRes[i];
+        demDatasetLowRes=this->demDatasetLowRes[i];
+        demDatasetBusy[i]=true;
+        workerNr=i;
+        found=true;
+        break;
+      }
+    }
+    if (found) {
+      break;
+    } else {
+      //DEBUG("waiting for next available dem dataset",NULL);
+      core->getThread()->unlockMutex(accessMutex);
+      core->getThread()->waitForSignal(demDatasetReadySignal);
+      core->getThread()->lockMutex(accessMutex,__FILE__,__LINE__);
+    }
+  }
+  core->getThread()->unlockMutex(accessMutex);
+
+  // Decide on the blur radius
+  double blurRadius=z-10;
+  if (z>=17) 
+    blurRadius=blurRadius*1.5;
+  //DEBUG("blurRadius=%f",blurRadius);
+
+  // Decide on the border around the tile that is rendered to avoid artifacts at the tile edges
+  // GDAL's tools render the neighboring tiles, the native renderer only what the blur filter reaches
+  Int border=256;
+  if ((nativeHillshadeRendering)&&(!compareHillshadeRenderers)) {
+    if (blurRadius>1)
+      border=std::min(256,(Int)ceil(3*3*blurRadius)+2);
+    else
+      border=2;
   }
 
-  // Copy this one in a RGBA image with alpha only
-  // Invert the pixels on the run
-  ImagePixel *filterPixels=(ImagePixel*)malloc(renderWidth*renderHeight);
+  // Calculate the bounding box
+  const double mercatorHalfWorldSize=20037508.342789244;
+  Int worldRes = 1 << z;
+  Int imageWidth=256;
+  Int imageHeight=256;
+  Int cropX1 = (x>0) ? border : 0;
+  Int cropY1 = (y>0) ? border : 0;
+  Int renderWidth=cropX1+imageWidth+((x<worldRes-1) ? border : 0);
+  Int renderHeight=cropY1+imageHeight+((y<worldRes-1) ? border : 0);
+  Int cropX2=cropX1+imageWidth;
+  Int cropY2=cropY1+imageHeight;
+  double resolution=2*mercatorHalfWorldSize/((double)imageWidth*worldRes);
+  double mercatorX1=-mercatorHalfWorldSize+((double)x*imageWidth-cropX1)*resolution;
+  double mercatorX2=mercatorX1+renderWidth*resolution;
+  double mercatorY2=mercatorHalfWorldSize-((double)y*imageHeight-cropY1)*resolution;
+  double mercatorY1=mercatorY2-renderHeight*resolution;
+
+  // Decide which data source to use
+  DEMDataset *demDataset=demDatasetFullRes;
+  DEMCoordinateTransformation demTransform=hCTFullRes[workerNr];
+  double *demInvGeoTransform=adfInvGeoTransform;
+  if (z<=lowResZoomLevel) {
+    demDataset=demDatasetLowRes;
+    demTransform=hCTLowRes[workerNr];
+    demInvGeoTransform=adfInvGeoTransformLowRes;
+  }
+
+  // Render the hillshade
+  ImagePixel *filterPixels;
+  if (nativeHillshadeRendering) {
+    filterPixels=renderHillshadeNatively(demDataset,z<=lowResZoomLevel,demTransform,demInvGeoTransform,z,mercatorX1,mercatorY1,mercatorX2,mercatorY2,renderWidth,renderHeight);
+
+    // Check the result against GDAL's tools if requested
+    if ((filterPixels)&&(compareHillshadeRenderers)) {
+      ImagePixel *referencePixels=renderHillshadeWithGDAL(demDataset,z,mercatorX1,mercatorY1,mercatorX2,mercatorY2,renderWidth,renderHeight);
+      if (referencePixels) {
+        Int maxDiff=0;
+        double meanDiff=0;
+        for (Int y=cropY1;y<cropY2;y++) {
+          for (Int x=cropX1;x<cropX2;x++) {
+            Int diff=abs((Int)filterPixels[y*renderWidth+x]-(Int)referencePixels[y*renderWidth+x]);
+            maxDiff=std::max(maxDiff,diff);
+            meanDiff+=diff;
+          }
+        }
+        meanDiff/=imageWidth*imageHeight;
+        DEBUG("hillshade tile %d/%d/%d differs from GDAL by %.2f on average and %d at most",z,x,y,meanDiff,maxDiff);
+        free(referencePixels);
+      }
+    }
+  } else {
+    filterPixels=renderHillshadeWithGDAL(demDataset,z,mercatorX1,mercatorY1,mercatorX2,mercatorY2,renderWidth,renderHeight);
+  }
   if (!filterPixels) {
-    FATAL("can not reserve memory",NULL);
-    free(hillshadePixels);
     resetDemDatasetBusy(workerNr);
     return NULL;
   }
+
+  // Abort here if quit is requested
+  if (!isInitialized) {
+    free(filterPixels);
+    resetDemDatasetBusy(workerNr);
+    return NULL;
+  }
+
+  // Invert the pixels
   for (Int i=0;i<renderWidth*renderHeight;i++) {
 
     // Invert the original pixels
     // Replace black pixels with pure transparent and lighten the pixels slightly
-    ImagePixel p=255-hillshadePixels[i*Image::getRGBPixelSize()];
+    ImagePixel p=255-filterPixels[i];
     if ((p==255)||(p<=74))
       filterPixels[i]=0;
     else 
       filterPixels[i]=p-74;
   }
-  free(hillshadePixels);
-
-  // Abort here if quit is requested
-  if (!isInitialized) {
-    free(filterPixels);
-    resetDemDatasetBusy(workerNr);
-    return NULL;
-  }
 
   // Now apply a blur filter
-  double blurRadius=z-10;
-  if (z>=17) 
-    blurRadius=blurRadius*1.5;
-  //DEBUG("blurRadius=%f",blurRadius);
   if (blurRadius>1) {
     core->getImage()->iirGaussFilter(filterPixels,renderWidth,renderHeight,1,3*blurRadius);
   }
@@ -494,13 +729,8 @@ UByte *ElevationEngine::renderHillshadeTile(Int z, Int y, Int x, UInt &imageSize
   Int t=0;
   //DEBUG("cropX1=%d cropX2=%d cropY1=%d cropY2=%d",cropX1,cropX2,cropY1,cropY2);
   for (int y=cropY1;y<cropY2;y++) {
-    for (int x=cropX1;x<cropX2;x++) {
-      imagePixels[t*Image::getRGBAPixelSize()+0]=0;
-      imagePixels[t*Image::getRGBAPixelSize()+1]=0;
-      imagePixels[t*Image::getRGBAPixelSize()+2]=0;
-      imagePixels[t*Image::getRGBAPixelSize()+3]=filterPixels[y*renderWidth+x];
-      t++;
-    }
+    core->getImage()->convertAlphaToRGBA(&filterPixels[y*renderWidth+cropX1],&imagePixels[t*Image::getRGBAPixelSize()],cropX2-cropX1);
+    t+=cropX2-cropX1;
   }
   free(filterPixels);
   //DEBUG("t=%d",t);
@@ -573,12 +803,12 @@ bool ElevationEngine::getElevation(MapPosition *pos) {
     return false;
   }
 
-  // Query the altitude from the DEM dataset
-  double adfPixel[2];
+  // Query the altitude from the DEM block cache
+  float altitude;
   bool result=false;
-  if (GDALRasterIO(hBand, GF_Read, iPixel, iLine, 1, 1, adfPixel, 1, 1, GDT_CFloat64, 0, 0) == CE_None) {
-    if (adfPixel[0]!=-32768) {
-      pos->setAltitude(adfPixel[0]);
+  if (copyDEMWindow(demDatasetFullRes[workerCount],false,0,GDALGetRasterXSize(demDatasetFullRes[workerCount]),GDALGetRasterYSize(demDatasetFullRes[workerCount]),iPixel,iLine,iPixel+1,iLine+1,&altitude)) {
+    if ((altitude==altitude)&&(altitude!=-32768)) {
+      pos->setAltitude(altitude);
       pos->setHasAltitude(true);
       //pos->setIsWGS84Altitude(true);
       //pos->toMSLHeight();
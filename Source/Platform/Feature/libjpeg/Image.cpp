@@ -107,7 +107,7 @@ cleanup:
 }
 
 // Loads a jpeg after initialization
-ImagePixel *Image::loadJPEG(struct jpeg_decompress_struct *cinfo, std::string imageDescription, Int &width, Int &height, UInt &pixelSize, bool calledByMapUpdateThread) {
+ImagePixel *Image::loadJPEG(struct jpeg_decompress_struct *cinfo, std::string imageDescription, Int &width, Int &height, UInt &pixelSize, const std::atomic<bool> *abortLoad) {
 
   ImagePixel *image=NULL,*scanline=NULL;
   UInt scanlineSize,imageSize;
@@ -149,12 +149,12 @@ ImagePixel *Image::loadJPEG(struct jpeg_decompress_struct *cinfo, std::string im
 
   // Do the decompression
   y=0;
-  while( cinfo->output_scanline < cinfo->output_height && ((!calledByMapUpdateThread)||(!abortLoad)) ) {
+  while( cinfo->output_scanline < cinfo->output_height && ((!abortLoad)||(!*abortLoad)) ) {
     //DEBUG("output_scanline: %d output_height: %d",cinfo.output_scanline,cinfo.output_height);
     jpeg_read_scanlines(cinfo, &scanline, 1);
     memcpy(&image[y*scanlineSize], scanline, scanlineSize);
     y++;
-    //if (calledByMapUpdateThread)
+    //if (abortLoad)
     //  core->interruptAllowedHere(__FILE__, __LINE__);
   }
   free(scanline);
@@ -162,7 +162,7 @@ ImagePixel *Image::loadJPEG(struct jpeg_decompress_struct *cinfo, std::string im
 }
 
 // Loads a jpeg from memory
-ImagePixel *Image::loadJPEG(UByte *imageData, UInt imageSize, Int &width, Int &height, UInt &pixelSize, bool calledByMapUpdateThread) {
+ImagePixel *Image::loadJPEG(UByte *imageData, UInt imageSize, Int &width, Int &height, UInt &pixelSize, const std::atomic<bool> *abortLoad) {
 
   struct jpeg_decompress_struct cinfo;
   ImagePixel *image=NULL;
@@ -171,7 +171,6 @@ ImagePixel *Image::loadJPEG(UByte *imageData, UInt imageSize, Int &width, Int &h
   //DEBUG("imageData=0x%08x imageSize=%d",imageData,imageSize);
 
   // Prepare the decompression
-  abortLoad=false;
   cinfo.err = jpeg_std_error(&jerr.mgr);
   jerr.mgr.error_exit=jpegErrorHandler;
   if (setjmp(jerr.setjmpBuffer)) {
@@ -184,14 +183,13 @@ ImagePixel *Image::loadJPEG(UByte *imageData, UInt imageSize, Int &width, Int &h
   jpeg_mem_src(&cinfo,imageData,imageSize);
 
   // Decompress the image
-  image = loadJPEG(&cinfo,"image",width,height,pixelSize,calledByMapUpdateThread);
+  image = loadJPEG(&cinfo,"image",width,height,pixelSize,abortLoad);
 
 cleanup:
-  if (calledByMapUpdateThread&&abortLoad) {
+  if (abortLoad&&*abortLoad) {
     jpeg_abort_decompress(&cinfo);
     if (image) free(image);
     image=NULL;
-    abortLoad=false;
   } else {
     if (image)
       jpeg_finish_decompress(&cinfo);
@@ -202,7 +200,7 @@ cleanup:
 }
 
 // Loads a jpeg from a file
-ImagePixel *Image::loadJPEG(std::string filepath, Int &width, Int &height, UInt &pixelSize, bool calledByMapUpdateThread) {
+ImagePixel *Image::loadJPEG(std::string filepath, Int &width, Int &height, UInt &pixelSize, const std::atomic<bool> *abortLoad) {
 
   FILE *file;
   struct jpeg_decompress_struct cinfo;
@@ -210,7 +208,6 @@ ImagePixel *Image::loadJPEG(std::string filepath, Int &width, Int &height, UInt
   struct jpegErrorHandlerInfo jerr;
 
   // Prepare the decompression
-  abortLoad=false;
   if ((file = fopen(filepath.c_str(), "rb")) == NULL) {
     DEBUG("can not open <%s> for reading",filepath.c_str());
     return NULL;
@@ -225,14 +222,13 @@ ImagePixel *Image::loadJPEG(std::string filepath, Int &width, Int &height, UInt
   jpeg_stdio_src(&cinfo, file);
 
   // Decompress the image
-  image = loadJPEG(&cinfo,"image <" + filepath + ">",width,height,pixelSize,calledByMapUpdateThread);
+  image = loadJPEG(&cinfo,"image <" + filepath + ">",width,height,pixelSize,abortLoad);
 
 cleanup:
-  if (calledByMapUpdateThread&&abortLoad) {
+  if (abortLoad&&*abortLoad) {
     jpeg_abort_decompress(&cinfo);
     if (image) free(image);
     image=NULL;
-    abortLoad=false;
   } else {
     jpeg_finish_decompress(&cinfo);
   }
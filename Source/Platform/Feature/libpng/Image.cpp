@@ -91,7 +91,7 @@ bool Image::initPNGRead(png_structp &png_ptr, png_infop &info_ptr) {
 }
 
 // Queries the dimension of the png from memory without loading it
-bool Image::queryPNG(UByte *imageData, UInt imageSize, Int &width, Int &height) {
+bool Image::queryPNG(UByte *imageData, UInt imageSize, Int &width, Int &height, bool *hasAlpha) {
   png_structp png_ptr=NULL;
   png_infop info_ptr=NULL;
   bool result=true;
@@ -121,6 +121,9 @@ bool Image::queryPNG(UByte *imageData, UInt imageSize, Int &width, Int &height)
   png_read_info(png_ptr, info_ptr);
   width = png_get_image_width(png_ptr, info_ptr);
   height = png_get_image_height(png_ptr, info_ptr);
+  if (hasAlpha) {
+    *hasAlpha = ((png_get_color_type(png_ptr, info_ptr)&PNG_COLOR_MASK_ALPHA)!=0)||(png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)!=0);
+  }
 
 cleanup:
 
@@ -179,7 +182,7 @@ cleanup:
 }
 
 // Loads a png after the library has been prepared
-ImagePixel *Image::loadPNG(png_structp png_ptr, png_infop info_ptr, std::string imageDescription, Int &width, Int &height, UInt &pixelSize, bool calledByMapUpdateThread) {
+ImagePixel *Image::loadPNG(png_structp png_ptr, png_infop info_ptr, std::string imageDescription, Int &width, Int &height, UInt &pixelSize, const std::atomic<bool> *abortLoad) {
 
   ImagePixel *image=NULL;
   Int number_of_passes;
@@ -235,21 +238,21 @@ ImagePixel *Image::loadPNG(png_structp png_ptr, png_infop info_ptr, std::string
   }
 
   // Read the image
-  for (Int i=0;(i<number_of_passes)&&((!calledByMapUpdateThread)||(!abortLoad));i++) {
-    for (Int y=0;(y<height)&&((!calledByMapUpdateThread)||(!abortLoad));y++) {
+  for (Int i=0;(i<number_of_passes)&&((!abortLoad)||(!*abortLoad));i++) {
+    for (Int y=0;(y<height)&&((!abortLoad)||(!*abortLoad));y++) {
       png_read_row(png_ptr, &image[pixelSize*width*y], NULL);
-      //if (calledByMapUpdateThread)
+      //if (abortLoad)
       //  core->interruptAllowedHere(__FILE__, __LINE__);
     }
   }
-  if (((!calledByMapUpdateThread)||(!abortLoad)))
+  if (((!abortLoad)||(!*abortLoad)))
     png_read_end(png_ptr, info_ptr);
 
   return image;
 }
 
 // Loads a png from a file
-ImagePixel *Image::loadPNG(std::string filepath, Int &width, Int &height, UInt &pixelSize, bool calledByMapUpdateThread) {
+ImagePixel *Image::loadPNG(std::string filepath, Int &width, Int &height, UInt &pixelSize, const std::atomic<bool> *abortLoad) {
 
   png_byte header[8]; // 8 is the maximum size that can be checked
   ImagePixel *image=NULL;
@@ -258,7 +261,6 @@ ImagePixel *Image::loadPNG(std::string filepath, Int &width, Int &height, UInt &
   Int number_of_passes;
 
   // Open file and test for it being a PNG
-  abortLoad=false;
   FILE *fp = fopen(filepath.c_str(), "rb");
   if (!fp) {
     DEBUG("can not open <%s> for reading",filepath.c_str());
@@ -281,16 +283,15 @@ ImagePixel *Image::loadPNG(std::string filepath, Int &width, Int &height, UInt &
   png_init_io(png_ptr, fp);
 
   // Read the pixel data
-  image = loadPNG(png_ptr,info_ptr,"image <"+filepath+">",width,height,pixelSize,calledByMapUpdateThread);
+  image = loadPNG(png_ptr,info_ptr,"image <"+filepath+">",width,height,pixelSize,abortLoad);
 
 cleanup:
 
   // Deinit
   //DEBUG("image=0x%08x",image);
-  if (calledByMapUpdateThread&&abortLoad) {
+  if (abortLoad&&*abortLoad) {
     if (image) free(image);
     image=NULL;
-    abortLoad=false;
   }
   if ((png_ptr)||(info_ptr)) {
     png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
@@ -303,7 +304,7 @@ cleanup:
 
 
 // Loads a png from memory
-ImagePixel *Image::loadPNG(UByte *imageData, UInt imageSize, Int &width, Int &height, UInt &pixelSize, bool calledByMapUpdateThread) {
+ImagePixel *Image::loadPNG(UByte *imageData, UInt imageSize, Int &width, Int &height, UInt &pixelSize, const std::atomic<bool> *abortLoad) {
 
   png_byte header[8]; // 8 is the maximum size that can be checked
   ImagePixel *image=NULL;
@@ -313,7 +314,6 @@ ImagePixel *Image::loadPNG(UByte *imageData, UInt imageSize, Int &width, Int &he
   Memory imageMemory;
 
   // Test memory for being a PNG
-  abortLoad=false;
   if (imageSize<8)
     return NULL;
   if (png_sig_cmp(imageData, 0, 8)) {
@@ -334,15 +334,14 @@ ImagePixel *Image::loadPNG(UByte *imageData, UInt imageSize, Int &width, Int &he
   png_set_read_fn(png_ptr, (png_voidp)&imageMemory, pngReadDataFromMemory);
 
   // Read the pixel data
-  image = loadPNG(png_ptr,info_ptr,"image",width,height,pixelSize,calledByMapUpdateThread);
+  image = loadPNG(png_ptr,info_ptr,"image",width,height,pixelSize,abortLoad);
 
 cleanup:
 
   // Deinit
-  if (calledByMapUpdateThread&&abortLoad) {
+  if (abortLoad&&*abortLoad) {
     if (image) free(image);
     image=NULL;
-    abortLoad=false;
   }
   if ((png_ptr)||(info_ptr)) {
     png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
@@ -416,7 +415,7 @@ ImagePixel *Image::loadPNGIcon(Screen *screen, std::string filename, Int &imageW
   }
 
   // Load the icon
-  ImagePixel *icon=loadPNG(bestIconPath,imageWidth,imageHeight,pixelSize,false);
+  ImagePixel *icon=loadPNG(bestIconPath,imageWidth,imageHeight,pixelSize,NULL);
   if (!icon)
     return NULL;
 
@@ -428,13 +427,13 @@ ImagePixel *Image::loadPNGIcon(Screen *screen, std::string filename, Int &imageW
 }
 
 // Writes a png to memory
-UByte *Image::writePNG(ImagePixel *image, Int width, Int height, UInt pixelSize, UInt &imageSize, bool inverseRows) {
+UByte *Image::writePNG(ImagePixel *image, Int width, Int height, UInt pixelSize, UInt &imageSize, bool inverseRows, Int compressionLevel, Int rowFilter) {
 
   // Call the internal function
   Memory imageMemory;
   imageMemory.data = (UByte*)malloc(1);
   imageMemory.size = 0;
-  bool result = writePNG(image,ImageOutputTargetTypeMemory,&imageMemory,width,height,pixelSize,inverseRows);
+  bool result = writePNG(image,ImageOutputTargetTypeMemory,&imageMemory,width,height,pixelSize,inverseRows,compressionLevel,rowFilter);
   imageSize = imageMemory.size;
 
   // Return result
@@ -469,7 +468,7 @@ bool Image::writePNG(ImagePixel *image, Device *device, Int width, Int height, U
 }
 
 // Writes a png to either a C file pointer or to Linux file descriptor
-bool Image::writePNG(ImagePixel *image, ImageOutputTargetType targetType, void *target, Int width, Int height, UInt pixelSize, bool inverseRows=false) {
+bool Image::writePNG(ImagePixel *image, ImageOutputTargetType targetType, void *target, Int width, Int height, UInt pixelSize, bool inverseRows, Int compressionLevel, Int rowFilter) {
 
   png_structp png_ptr=NULL;
   png_infop info_ptr=NULL;
@@ -515,6 +514,19 @@ bool Image::writePNG(ImagePixel *image, ImageOutputTargetType targetType, void *
   png_set_IHDR(png_ptr,info_ptr,width,height,8,color_type,PNG_INTERLACE_NONE,
   PNG_COMPRESSION_TYPE_DEFAULT,PNG_FILTER_TYPE_DEFAULT);
 
+  // Set the compression parameters if requested
+  if (compressionLevel>=0) {
+    png_set_compression_level(png_ptr,compressionLevel);
+  }
+  switch (rowFilter) {
+    case 0: png_set_filter(png_ptr,PNG_FILTER_TYPE_BASE,PNG_FILTER_NONE); break;
+    case 1: png_set_filter(png_ptr,PNG_FILTER_TYPE_BASE,PNG_FILTER_SUB); break;
+    case 2: png_set_filter(png_ptr,PNG_FILTER_TYPE_BASE,PNG_FILTER_UP); break;
+    case 3: png_set_filter(png_ptr,PNG_FILTER_TYPE_BASE,PNG_FILTER_AVG); break;
+    case 4: png_set_filter(png_ptr,PNG_FILTER_TYPE_BASE,PNG_FILTER_PAETH); break;
+    case 5: png_set_filter(png_ptr,PNG_FILTER_TYPE_BASE,PNG_ALL_FILTERS); break;
+  }
+
   // Set the image data
   if (!(rows=(png_bytepp)malloc(sizeof(*rows)*height))) {
     FATAL("can not reserve memory for the row pointers",NULL);
@@ -26,35 +26,82 @@
 
 namespace GEODISCOVERER {
 
-MapCalibratorProj::MapCalibratorProj(bool doNotDelete) : MapCalibrator(doNotDelete) {
+// Context used by the proj6 states created in the calling thread
+static thread_local PJ_CONTEXT *threadProjContext=NULL;
+
+MapCalibratorProj::MapCalibratorProj() : MapCalibrator() {
   type=MapCalibratorTypeProj;
   projState=NULL;
+  projMutex=core->getThread()->createMutex("map calibrator proj mutex");
 }
 
 MapCalibratorProj::~MapCalibratorProj() {
+  core->getThread()->destroyMutex(projMutex);
 }
 
 // Inits the calibrator
 void MapCalibratorProj::init() {
   MapCalibrator::init();
-  if (!(projState=proj_create(PJ_DEFAULT_CTX,args))) {
+
+  // Use the context of the thread such that calibrators can be created and used from multiple threads
+  // The state stays on this context until releaseThreadContext is called
+  PJ_CONTEXT *projContext=(threadProjContext) ? threadProjContext : PJ_DEFAULT_CTX;
+  if (!(projState=proj_create(projContext,args))) {
     ERROR("could not initialize map projection with arguments = \"%s\"", args);
   }
 }
 
 // Frees the calibrator
 void MapCalibratorProj::deinit() {
-  proj_destroy(projState);
+  if (projState)
+    proj_destroy(projState);
+  projState=NULL;
   MapCalibrator::deinit();
 }
 
+// Moves the proj6 state to the default context
+void MapCalibratorProj::releaseThreadContext() {
+  if (projState)
+    proj_assign_context(projState,PJ_DEFAULT_CTX);
+}
+
+// Creates the proj context of a thread
+MapCalibratorThreadContext *MapCalibratorProj::createThreadContext() {
+  MapCalibratorThreadContext *context=new MapCalibratorThreadContext();
+  if (!context) {
+    FATAL("can not create thread context",NULL);
+    return NULL;
+  }
+  if (!(context->projContext=proj_context_create())) {
+    FATAL("can not create proj context",NULL);
+    delete context;
+    return NULL;
+  }
+  return context;
+}
+
+// Frees the proj context of a thread
+// The states created with it must have been moved to the default context before
+void MapCalibratorProj::destroyThreadContext(MapCalibratorThreadContext *context) {
+  if (!context)
+    return;
+  proj_context_destroy(context->projContext);
+  delete context;
+}
+
+// Sets the proj context used by calibrators created in the calling thread
+void MapCalibratorProj::setThreadContext(MapCalibratorThreadContext *context) {
+  threadProjContext=(context) ? context->projContext : NULL;
+}
 
 // Convert the geographic longitude / latitude coordinates to cartesian X / Y coordinates
 void MapCalibratorProj::convertGeographicToCartesian(MapPosition &pos) {
   PJ_COORD p;
   p.uv.u=pos.getLngRad();
   p.uv.v=pos.getLatRad();
+  core->getThread()->lockMutex(projMutex,__FILE__, __LINE__);
   p = proj_trans(projState,PJ_FWD,p);
+  core->getThread()->unlockMutex(projMutex);
   //DEBUG("x=%f y=%f",p.uv.u,p.uv.v);
   pos.setCartesianX(p.uv.u);
   pos.setCartesianY(p.uv.v);
@@ -65,7 +112,9 @@ void MapCalibratorProj::convertCartesianToGeographic(MapPosition &pos) {
   PJ_COORD p;
   p.uv.u=pos.getCartesianX();
   p.uv.v=pos.getCartesianY();
+  core->getThread()->lockMutex(projMutex,__FILE__, __LINE__);
   p = proj_trans(projState,PJ_INV,p);
+  core->getThread()->unlockMutex(projMutex);
   //DEBUG("x=%f y=%f",p.uv.u,p.uv.v);
   pos.setLng(FloatingPoint::rad2degree(p.uv.u));
   pos.setLat(FloatingPoint::rad2degree(p.uv.v));
@@ -29,11 +29,17 @@
 
 namespace GEODISCOVERER {
 
+// Resources of a thread that creates calibrators in parallel
+struct MapCalibratorThreadContext {
+  PJ_CONTEXT *projContext; // Context for the proj6 states created by the thread
+};
+
 class MapCalibratorProj : public MapCalibrator {
 
 protected:
 
   PJ *projState; // Pointer to the proj6 state
+  ThreadMutexInfo *projMutex; // Mutex for using the proj6 state from multiple threads
 
   // Convert the geographic longitude / latitude coordinates to cartesian X / Y coordinates
   void convertGeographicToCartesian(MapPosition &pos);
@@ -44,7 +50,7 @@ protected:
 public:
 
   // Constructors and destructor
-  MapCalibratorProj(bool doNotDelete=false);
+  MapCalibratorProj();
   virtual ~MapCalibratorProj();
 
   // Inits the calibrator
@@ -53,6 +59,16 @@ public:
   // Frees the calibrator
   void deinit();
 
+  // Moves the proj6 state to the default context
+  void releaseThreadContext();
+
+  // Creates and frees the proj context of a thread
+  static MapCalibratorThreadContext *createThreadContext();
+  static void destroyThreadContext(MapCalibratorThreadContext *context);
+
+  // Sets the proj context used by calibrators created in the calling thread
+  static void setThreadContext(MapCalibratorThreadContext *context);
+
 };
 
 } /* namespace GEODISCOVERER */
@@ -172,34 +172,26 @@ bool MapContainer::readGDMCalibrationFile()
   std::string mapProjectionArgs;
   std::list<MapPosition> calibrationPoints;
   xmlChar *text;
-  void *buffer;
-  Int size;
-  std::list<ZipArchive*> *mapArchives;
+  void *buffer=NULL;
+  Int size=0;
+  ZipArchiveReader *mapArchiveReader, *temporaryMapArchiveReader;
   std::string t;
 
   // Init
   //xmlInitParser(); // already done by config store
 
   // Get the contents of the XML file
-  mapArchives = core->getMapSource()->lockMapArchives(__FILE__, __LINE__);
-  for (std::list<ZipArchive*>::iterator i=mapArchives->begin();i!=mapArchives->end();i++) {
-    size = (*i)->getEntrySize(calibrationFilePath);
-    if (size>0) {
-      if (!(buffer=malloc(size))) {
-        FATAL("can not allocate memory",NULL);
-        goto cleanup;
-      }
-      ZipArchiveEntry entry;
-      if (!(entry=(*i)->openEntry(calibrationFilePath))) {
-        ERROR("can not open file <%s> in map archive for reading map calibration",calibrationFilePath);
-        goto cleanup;
-      }
-      (*i)->readEntry(entry,buffer,size);
-      (*i)->closeEntry(entry);
-      break;
-    }
-  }
+  core->getMapSource()->lockMapArchives(__FILE__, __LINE__);
+  mapArchiveReader=core->getMapSource()->findMapArchiveReader(getArchiveFilePath(),calibrationFilePath,temporaryMapArchiveReader);
+  if (mapArchiveReader)
+    buffer=mapArchiveReader->exportEntry(calibrationFilePath,size);
   core->getMapSource()->unlockMapArchives();
+  if (temporaryMapArchiveReader)
+    delete temporaryMapArchiveReader;
+  if (buffer==NULL) {
+    ERROR("can not open file <%s> in map archive for reading map calibration",calibrationFilePath);
+    goto cleanup;
+  }
 
   // Read the XML file
   doc = xmlReadMemory((const char *)buffer,size,calibrationFilePath,NULL,0);
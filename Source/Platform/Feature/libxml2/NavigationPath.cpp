@@ -27,6 +27,7 @@
 #include <NavigationEngine.h>
 #include <NavigationPoint.h>
 #include <Commander.h>
+#include <libxml/xmlreader.h>
 
 namespace GEODISCOVERER {
 
@@ -44,6 +45,7 @@ void NavigationPath::writeGPXFile(bool forceStorage, bool skipBackup, bool onlyS
   // Set the location to use
   if (filepath=="")
     filepath=gpxFilefolder + "/" + gpxFilename;
+  bool isOwnFile=((filepath==gpxFilefolder + "/" + gpxFilename)&&(!onlySelectedPath));
   //DEBUG("filepath=%s",filepath.c_str());
 
   // Only store if it is initialized
@@ -65,16 +67,15 @@ void NavigationPath::writeGPXFile(bool forceStorage, bool skipBackup, bool onlyS
   if (name=="")
     name=this->name;
   std::string description=this->description;
-  std::vector<MapPosition> mapPositions;
+  NavigationPathPoints points;
   bool reverse=false;
   if (onlySelectedPath) {
     reverse=this->reverse;
-    mapPositions=getSelectedPoints();
-    if (reverse) {
-      std::reverse(mapPositions.begin(), mapPositions.end());
-    }
+    Int first, last;
+    getSelectedRange(first,last);
+    points=pathPoints.getRange(first,last+1);
   } else {
-    mapPositions=this->mapPositions;
+    points=pathPoints;
   }
   core->getMapSource()->unlockAccess();
 
@@ -180,11 +181,11 @@ void NavigationPath::writeGPXFile(bool forceStorage, bool skipBackup, bool onlyS
   xmlAddChild(pathNode,segmentNode);
 
   // Iterate through all points
-  for (std::vector<MapPosition>::iterator i=mapPositions.begin();i!=mapPositions.end();i++) {
-    MapPosition pos=*i;
+  for (Int i=0;i<points.size();i++) {
+    Int index=reverse ? points.size()-1-i : i;
 
     // Start of a new segment?
-    if (pos==NavigationPath::getPathInterruptedPos()) {
+    if (points.isInterrupted(index)) {
 
       // Create a new segment
       segmentNode = xmlNewNode(NULL, BAD_CAST "trkseg");
@@ -197,6 +198,7 @@ void NavigationPath::writeGPXFile(bool forceStorage, bool skipBackup, bool onlyS
     } else {
 
       // Add the point to the segment
+      MapPosition pos=points.get(index);
       pos.writeGPX(segmentNode,skipExtensions);
 
     }
@@ -220,6 +222,10 @@ void NavigationPath::writeGPXFile(bool forceStorage, bool skipBackup, bool onlyS
     rename(tempFilepath.c_str(),filepath.c_str());
     //DEBUG("path storing is complete",NULL);
 
+    // The journal only needs to keep the points added since the copy
+    if ((journal)&&(isOwnFile))
+      journal->compact(points.size());
+
     // Update the cache
     writeCache();
   }
@@ -228,102 +234,55 @@ void NavigationPath::writeGPXFile(bool forceStorage, bool skipBackup, bool onlyS
   xmlFreeDoc(doc);
   if (!errorOccured) {
     core->getMapSource()->lockAccess(__FILE__, __LINE__);
-    if (this->mapPositions.size()==mapPositions.size()) {
+    if (pathPoints.size()==points.size()) {
       isStored=true;
     }
     core->getMapSource()->unlockAccess();
   }
 }
 
-// Finds nodes in a xml tree
-std::list<XMLNode> NavigationPath::findNodes(XMLDocument document, XMLXPathContext xpathCtx, std::string path) {
-  std::list<XMLNode> result;
-  xmlXPathObjectPtr xpathObj=NULL;
-  xmlNodePtr node=NULL;
-  xmlNodeSetPtr nodes;
-  Int size;
-  bool found;
-  xpathObj = xmlXPathEvalExpression(BAD_CAST path.c_str(), xpathCtx);
-  if (xpathObj == NULL) {
-    xmlXPathFreeContext(xpathCtx);
-    FATAL("can not evaluate xpath expression",NULL);
-    return result;
-  }
-  nodes=xpathObj->nodesetval;
-  size = (nodes) ? nodes->nodeNr : 0;
-  found = false;
-  for(Int i = 0; i < size; ++i) {
-    if(nodes->nodeTab[i]->type == XML_ELEMENT_NODE) {
-      result.push_back(nodes->nodeTab[i]);
-    }
-  }
-  xmlXPathFreeObject(xpathObj);
-  return result;
-}
-
-// Extracts information about the path from the given node set
-void NavigationPath::extractInformation(std::list<XMLNode> nodes) {
+// Extracts information about the path from the given node
+void NavigationPath::extractInformation(XMLNode node) {
   std::string t;
-  for(std::list<XMLNode>::iterator i=nodes.begin();i!=nodes.end();i++) {
-    XMLNode node=*i;
-    std::string nodeName=(char*)node->name;
-    if (nodeName=="name") {
-      if (ConfigSection::getNodeText(node,t)) name=t;
-    }
-    if (nodeName=="desc") {
-      if (ConfigSection::getNodeText(node,t)) description=t;
-    }
+  std::string nodeName=(char*)node->name;
+  if (nodeName=="name") {
+    if (ConfigSection::getNodeText(node,t)) name=t;
+  }
+  if (nodeName=="desc") {
+    if (ConfigSection::getNodeText(node,t)) description=t;
   }
 }
 
 // Writes the cache to a file
 void NavigationPath::writeCache() {
-  std::string filepath=gpxFilefolder + "/" + gpxFilename;
   std::string cacheFilepath=gpxCacheFilefolder + "/" + gpxFilename;
   //DEBUG("cacheFilepath=%s",cacheFilepath.c_str());
-  std::ofstream ofs;
-  ofs.open(cacheFilepath.c_str(), std::ios::binary);
-  if (ofs.fail()) {
-    WARNING("can not open <%s> for writing", cacheFilepath.c_str());
+  if (!pathPoints.write(cacheFilepath,name,description))
     remove(cacheFilepath.c_str());
-  } else {
-    store(&ofs);
-    if (ofs.bad()) {
-      WARNING("can not store object into <%s>", cacheFilepath.c_str());
-      remove(cacheFilepath.c_str());
-    }
-    ofs.close();
-  }
 }
 
 // Reads the path contents from a gpx file
+// The file is parsed as a stream such that only the currently processed point is kept as a tree
 bool NavigationPath::readGPXFile() {
 
   std::string filepath=gpxFilefolder + "/" + gpxFilename;
   std::string cacheFilepath = gpxCacheFilefolder + "/" + gpxFilename;
   //DEBUG("cacheFilepath=%s",cacheFilepath.c_str());
-  XMLNode node;
-  XMLDocument doc=NULL;
-  XMLXPathContext xpathCtx=NULL;
-  bool GPX10=false;
-  bool GPX11=false;
-  std::string namespaceURI;
-  std::list<XMLNode> nodes;
-  std::string t;
-  Int numberOfSegments,numberOfPoints,totalNumberOfPoints,processedPoints;
+  xmlTextReaderPtr reader=NULL;
+  const char *gpxNamespace=NULL;
+  std::string parents[4];
+  Int trackCount=0, segmentCount=0, routeCount=0, waypointCount=0;
+  NavigationPathPoints routePoints;
+  std::string routeName, routeDescription, trackName, trackDescription;
+  bool routeNameFound=false, routeDescriptionFound=false, trackNameFound=false, trackDescriptionFound=false;
   Int processedPercentage, prevProcessedPercentage=-1;
-  std::list<XMLNode> trackNodes;
-  std::list<XMLNode> routeNodes;
-  std::list<XMLNode> waypointNodes;
-  bool loadTrack=false;
-  bool loadRoute=false;
   bool result=false;
   std::list<std::string> status;
   std::stringstream progress;
-  std::ofstream ofs;
-  std::ifstream ifs;
   bool cacheRetrieved;
   struct stat fileStat,cacheStat;
+  std::string configPath="Navigation/Route[@name='" + getGpxFilename() + "']";
+  int ret;
 
   // Check if we can use the cache
   cacheRetrieved=false;
@@ -340,245 +299,151 @@ bool NavigationPath::readGPXFile() {
       status.push_back("Loading path from cache (init):");
       status.push_back(getGpxFilename());
       core->getNavigationEngine()->setStatus(status, __FILE__, __LINE__);
-      ifs.open(cacheFilepath.c_str(),std::ios::binary);
-      if (ifs.fail()) {
-        remove(cacheFilepath.c_str());
-        WARNING("can not open <%s> for reading",cacheFilepath.c_str());
-      } else {
-
-        // Load the complete file into memory
-        if (cacheData!=NULL) free(cacheData);
-        if (!(cacheData=(char*)malloc(cacheStat.st_size+1))) {
-          FATAL("can not allocate memory for cache",NULL);
-          return false;
-        }
-        ifs.read(cacheData,cacheStat.st_size);
-        ifs.close();
-        cacheData[cacheStat.st_size]=0; // to prevent that strings never end
-        Int cacheSize=cacheStat.st_size;
-
-        // Retrieve the objects
-        char *cacheData2=cacheData;
-        bool success = NavigationPath::retrieve(this,cacheData2,cacheSize);
-        if ((cacheSize!=0)||(!success)) {
-          if (!core->getQuitCore()) {
-            remove(cacheFilepath.c_str());
-            WARNING("falling back to full gpx file read because cache is corrupted",NULL);
-          }
-        } else {
-          cacheRetrieved=true;
+      if (!NavigationPath::retrieve(this,cacheFilepath)) {
+        if (!core->getQuitCore()) {
+          remove(cacheFilepath.c_str());
+          WARNING("falling back to full gpx file read because cache is corrupted",NULL);
         }
+      } else {
+        cacheRetrieved=true;
       }
+      status.clear();
     }
   }
 
   // Load the gpx file if cache can not be used
   if ((!cacheRetrieved)&&(!core->getQuitCore())) {
 
-    // Read the document
+    // Open the document
     status.push_back("Loading path (Init):");
     status.push_back(getGpxFilename());
     core->getNavigationEngine()->setStatus(status, __FILE__, __LINE__);
-    doc = xmlReadFile(filepath.c_str(), NULL, 0);
-    if (!doc) {
+    reader = xmlReaderForFile(filepath.c_str(), NULL, 0);
+    if (!reader) {
       ERROR("can not read file <%s>",gpxFilename.c_str());
       goto cleanup;
     }
+    importWaypoints=(NavigationPatImportWaypointsType)core->getConfigStore()->getIntValue(configPath,"importWaypoints",__FILE__,__LINE__);
 
-    // Prepare xpath evaluation
-    xpathCtx = xmlXPathNewContext(doc);
-    if (xpathCtx == NULL) {
-      FATAL("can not create xpath context",NULL);
-      goto cleanup;
-    }
+    // Go through all elements
+    ret=xmlTextReaderRead(reader);
+    while (ret==1) {
 
-    // Check which version of gpx it is
-    namespaceURI="//*[namespace-uri()='" + std::string(GPX10Namespace) + "']";
-    nodes=findNodes(doc,xpathCtx,namespaceURI.c_str());
-    if (nodes.size()!=0) {
-      GPX10=true;
-    }
-    namespaceURI="//*[namespace-uri()='" + std::string(GPX11Namespace) + "']";
-    nodes=findNodes(doc,xpathCtx,namespaceURI.c_str());
-    if (nodes.size()!=0) {
-      GPX11=true;
-    }
-    if ((!GPX10)&&(!GPX11)) {
-      ERROR("file <%s> can not be parsed because it is not a V1.0 or V1.1 GPX file",gpxFilename.c_str());
-      goto cleanup;
-    }
-    if (GPX10&&GPX11) {
-      ERROR("file <%s> can not be parsed because it contains both V1.0 and V1.1 GPX elements",gpxFilename.c_str());
-      goto cleanup;
-    }
+      // Only elements are of interest
+      if (xmlTextReaderNodeType(reader)!=XML_READER_TYPE_ELEMENT) {
+        ret=xmlTextReaderRead(reader);
+        continue;
+      }
+      Int depth=xmlTextReaderDepth(reader);
+      const char *elementNamespace=(const char*)xmlTextReaderConstNamespaceUri(reader);
+      std::string elementName=(const char*)xmlTextReaderConstLocalName(reader);
+
+      // Check which version of gpx it is
+      if (depth==0) {
+        if ((elementNamespace)&&(strcmp(elementNamespace,GPX10Namespace)==0)) {
+          gpxNamespace=GPX10Namespace;
+        } else if ((elementNamespace)&&(strcmp(elementNamespace,GPX11Namespace)==0)) {
+          gpxNamespace=GPX11Namespace;
+        } else {
+          ERROR("file <%s> can not be parsed because it is not a V1.0 or V1.1 GPX file",gpxFilename.c_str());
+          goto cleanup;
+        }
+      }
 
-    // Register namespaces
-    if (GPX10) {
-      if(xmlXPathRegisterNs(xpathCtx, BAD_CAST "gpx", BAD_CAST GPX10Namespace) != 0) {
-        FATAL("can not register namespace",NULL);
+      // Skip elements that are not part of gpx
+      if ((elementName!="gpx")&&(depth==0)) {
+        ERROR("file <%s> can not be parsed because it is not a V1.0 or V1.1 GPX file",gpxFilename.c_str());
         goto cleanup;
       }
-    }
-    if (GPX11) {
-      if(xmlXPathRegisterNs(xpathCtx, BAD_CAST "gpx", BAD_CAST GPX11Namespace) != 0) {
-        FATAL("can not register namespace",NULL);
-        goto cleanup;
+      if ((depth>3)||(elementNamespace==NULL)||(strcmp(elementNamespace,gpxNamespace)!=0)) {
+        ret=xmlTextReaderNext(reader);
+        continue;
       }
-    }
-    if(xmlXPathRegisterNs(xpathCtx, BAD_CAST "gd", BAD_CAST GDNamespace) != 0) {
-      FATAL("can not register namespace",NULL);
-      goto cleanup;
-    }
-
-    // Decide which type to load (route or track)
-    trackNodes=findNodes(doc,xpathCtx,"/gpx:gpx/gpx:trk");
-    routeNodes=findNodes(doc,xpathCtx,"/gpx:gpx/gpx:rte");
-    if ((trackNodes.size()>0)&&(routeNodes.size()>0)) {
-      WARNING("file <%s> contains both a route and a track, loading the track only",gpxFilename.c_str());
-    }
-    if (trackNodes.size()>0) {
-      loadTrack=true;
-    } else {
-      if (routeNodes.size()>0) {
-        loadRoute=true;
-      } else {
-        WARNING("file <%s> contains waypoints only",gpxFilename.c_str());
+      parents[depth]=elementName;
+
+      // Extract data from the metadata section if it exists
+      if (((gpxNamespace==GPX11Namespace)&&(depth==2)&&(parents[1]=="metadata"))||
+          ((gpxNamespace==GPX10Namespace)&&(depth==1))) {
+        if ((elementName=="name")||(elementName=="desc")) {
+          XMLNode node=xmlTextReaderExpand(reader);
+          if (node) {
+            core->getMapSource()->lockAccess(__FILE__, __LINE__);
+            extractInformation(node);
+            core->getMapSource()->unlockAccess();
+          }
+          ret=xmlTextReaderNext(reader);
+          continue;
+        }
       }
-    }
-
-    // Extract data from the metadata section if it exists
-    if (GPX11) {
-      nodes=findNodes(doc,xpathCtx,"/gpx:gpx/gpx:metadata/*");
-      core->getMapSource()->lockAccess(__FILE__, __LINE__);
-      extractInformation(nodes);
-      core->getMapSource()->unlockAccess();
-    }
-    if (GPX10) {
-      nodes=findNodes(doc,xpathCtx,"/gpx:gpx/*");
-      core->getMapSource()->lockAccess(__FILE__, __LINE__);
-      extractInformation(nodes);
-      core->getMapSource()->unlockAccess();
-    }
 
-    // Load the points of the path
-    if (loadTrack) {
-      nodes=findNodes(doc,xpathCtx,"/gpx:gpx/gpx:trk/gpx:trkseg/gpx:trkpt");
-      totalNumberOfPoints=nodes.size();
-      processedPoints=0;
-      for (Int k=1;k<=trackNodes.size();k++) {
-        std::stringstream prefix;
-        prefix << "/gpx:gpx/gpx:trk["<<k<<"]";
-        if (trackNodes.size()==1) {
-          nodes=findNodes(doc,xpathCtx,prefix.str() + "/*");
-          extractInformation(nodes);
-        }
-        nodes=findNodes(doc,xpathCtx,prefix.str() + "/gpx:trkseg");
-        numberOfSegments=nodes.size();
-        for(Int i=1;i<=numberOfSegments;i++) {
-          std::stringstream trksegPath;
-          trksegPath<<prefix.str() + "/gpx:trkseg["<<i<<"]/gpx:trkpt";
-          nodes=findNodes(doc,xpathCtx,trksegPath.str());
-          numberOfPoints=nodes.size();
-          for(std::list<XMLNode>::iterator j=nodes.begin();j!=nodes.end();j++) {
-            XMLNode node=*j;
-            std::string error;
-            MapPosition pos;
-            if (pos.readGPX(node,error)) {
-              addEndPosition(pos);
-            } else {
-              error="file <%s> " + error;
-              ERROR(error.c_str(),gpxFilename.c_str());
-              goto cleanup;
-            }
-            processedPoints++;
-            processedPercentage=processedPoints*100/totalNumberOfPoints;
-            if (processedPercentage>prevProcessedPercentage) {
-              progress.str(""); progress << "Loading path (" << processedPercentage << "%):";
-              status.pop_front();
-              status.push_front(progress.str());
-              core->getNavigationEngine()->setStatus(status, __FILE__, __LINE__);
-            }
-            prevProcessedPercentage=processedPercentage;
-            if (core->getQuitCore())
-              goto cleanup;
-            //core->getThread()->reschedule();
+      // Remember the information of the first track and route
+      if ((depth==2)&&((parents[1]=="trk")||(parents[1]=="rte"))&&((elementName=="name")||(elementName=="desc"))) {
+        XMLNode node=xmlTextReaderExpand(reader);
+        std::string t;
+        if ((node)&&(ConfigSection::getNodeText(node,t))) {
+          if ((parents[1]=="trk")&&(trackCount==1)) {
+            if (elementName=="name") { trackName=t; trackNameFound=true; }
+            if (elementName=="desc") { trackDescription=t; trackDescriptionFound=true; }
           }
-          if (i!=numberOfSegments) {
-            addEndPosition(NavigationPath::getPathInterruptedPos());
+          if ((parents[1]=="rte")&&(routeCount==1)) {
+            if (elementName=="name") { routeName=t; routeNameFound=true; }
+            if (elementName=="desc") { routeDescription=t; routeDescriptionFound=true; }
           }
-          if (core->getQuitCore())
-            break;
         }
-        if (k!=trackNodes.size()) {
+        ret=xmlTextReaderNext(reader);
+        continue;
+      }
+
+      // Separate tracks, track segments and routes by an interruption
+      if ((depth==1)&&(elementName=="trk")) {
+        trackCount++;
+        segmentCount=0;
+        if (trackCount>1)
           addEndPosition(NavigationPath::getPathInterruptedPos());
-        }
       }
-    }
-    if (loadRoute) {
-      nodes=findNodes(doc,xpathCtx,"/gpx:gpx/gpx:rte/gpx:rtept");
-      totalNumberOfPoints=nodes.size();
-      processedPoints=0;
-      for (Int k=1;k<=routeNodes.size();k++) {
-        std::stringstream prefix;
-        prefix << "/gpx:gpx/gpx:rte["<<k<<"]";
-        nodes=findNodes(doc,xpathCtx,prefix.str() + "/*");
-        if (routeNodes.size()==1) {
-          extractInformation(nodes);
-        }
-        for(std::list<XMLNode>::iterator j=nodes.begin();j!=nodes.end();j++) {
-          XMLNode node=*j;
-          std::string error;
-          MapPosition pos;
-          if (pos.readGPX(node,error)) {
-            addEndPosition(pos);
-          } else {
-            error="file <%s> " + error;
-            ERROR(error.c_str(),gpxFilename.c_str());
-            goto cleanup;
-          }
-          processedPoints++;
-          processedPercentage=processedPoints*100/totalNumberOfPoints;
-          if (processedPercentage>prevProcessedPercentage) {
-            progress.str(""); progress << "Loading path (" << processedPercentage << "%):";
-            status.pop_front();
-            status.push_front(progress.str());
-            core->getNavigationEngine()->setStatus(status, __FILE__, __LINE__);
-          }
-          prevProcessedPercentage=processedPercentage;
-          if (core->getQuitCore())
-            break;
-          //core->getThread()->reschedule();
-        }
-        if (k!=routeNodes.size()) {
+      if ((depth==2)&&(parents[1]=="trk")&&(elementName=="trkseg")) {
+        segmentCount++;
+        if (segmentCount>1)
           addEndPosition(NavigationPath::getPathInterruptedPos());
+      }
+      if ((depth==1)&&(elementName=="rte")) {
+        routeCount++;
+        if (routeCount>1) {
+          MapPosition pos=NavigationPath::getPathInterruptedPos();
+          routePoints.add(pos,true);
         }
       }
-    }
 
-    // Load wayoints if gpx contains them
-    waypointNodes=findNodes(doc,xpathCtx,"/gpx:gpx/gpx:wpt");
-    totalNumberOfPoints=waypointNodes.size();
-    std::string configPath="Navigation/Route[@name='" + getGpxFilename() + "']";
-    importWaypoints=(NavigationPatImportWaypointsType)core->getConfigStore()->getIntValue(configPath,"importWaypoints",__FILE__,__LINE__);
-    if (importWaypoints==NavigationPathImportWaypointsUndecided) {
-      if (totalNumberOfPoints==0) {
-        importWaypoints=NavigationPathImportWaypointsNo;
-        core->getConfigStore()->setIntValue(configPath,"importWaypoints",(Int)importWaypoints,__FILE__,__LINE__);
-      } else {
-        std::stringstream cmd;
-        cmd << "decideWaypointImport(\"" << getGpxFilename() << "\"," << totalNumberOfPoints << ")";
-        core->getCommander()->dispatch(cmd.str());
-      }
-    } else {
-      if (importWaypoints==NavigationPathImportWaypointsYes) {
-        processedPoints=0;
-        for(std::list<XMLNode>::iterator i=waypointNodes.begin();i!=waypointNodes.end();i++) {
-          XMLNode node=*i;
+      // Add the points of tracks directly to the path
+      // Route points are only used if the file has no track
+      bool isTrackPoint=(depth==3)&&(parents[1]=="trk")&&(parents[2]=="trkseg")&&(elementName=="trkpt");
+      bool isRoutePoint=(depth==2)&&(parents[1]=="rte")&&(elementName=="rtept");
+      if ((isTrackPoint)||(isRoutePoint)) {
+        XMLNode node=xmlTextReaderExpand(reader);
+        std::string error;
+        MapPosition pos;
+        if ((node)&&(pos.readGPX(node,error))) {
+          if (isTrackPoint)
+            addEndPosition(pos);
+          else
+            routePoints.add(pos,false);
+        } else {
+          error="file <%s> " + error;
+          ERROR(error.c_str(),gpxFilename.c_str());
+          goto cleanup;
+        }
+        ret=xmlTextReaderNext(reader);
+      } else if ((depth==1)&&(elementName=="wpt")) {
+
+        // Import the waypoint if requested
+        waypointCount++;
+        if (importWaypoints==NavigationPathImportWaypointsYes) {
+          XMLNode node=xmlTextReaderExpand(reader);
           std::string error;
           std::stringstream defaultName;
-          defaultName << "Waypoint " << processedPoints+1;
+          defaultName << "Waypoint " << waypointCount;
           NavigationPoint point;
-          if (point.readGPX(node,getGpxFilename(),defaultName.str(),error)) {
+          if ((node)&&(point.readGPX(node,getGpxFilename(),defaultName.str(),error))) {
             core->getNavigationEngine()->addAddressPoint(point);
           } else {
             if (error!="contains a routing waypoint") {
@@ -586,20 +451,69 @@ bool NavigationPath::readGPXFile() {
               WARNING(error.c_str(),gpxFilename.c_str());
             }
           }
-          processedPoints++;
-          processedPercentage=processedPoints*100/totalNumberOfPoints;
-          if (processedPercentage>prevProcessedPercentage) {
-            progress.str(""); progress << "Loading wpts (" << processedPercentage << "%):";
-            status.pop_front();
-            status.push_front(progress.str());
-            core->getNavigationEngine()->setStatus(status, __FILE__, __LINE__);
-          }
+        }
+        ret=xmlTextReaderNext(reader);
+      } else {
+        ret=xmlTextReaderRead(reader);
+      }
+
+      // Update the status with the part of the file that has been read
+      if (fileStat.st_size>0) {
+        processedPercentage=(Int)(xmlTextReaderByteConsumed(reader)*100/fileStat.st_size);
+        if (processedPercentage>prevProcessedPercentage) {
+          progress.str(""); progress << "Loading path (" << processedPercentage << "%):";
+          status.pop_front();
+          status.push_front(progress.str());
+          core->getNavigationEngine()->setStatus(status, __FILE__, __LINE__);
           prevProcessedPercentage=processedPercentage;
-          if (core->getQuitCore())
-            break;
-          //core->getThread()->reschedule();
         }
       }
+      if (core->getQuitCore())
+        goto cleanup;
+    }
+    if (ret<0) {
+      ERROR("can not read file <%s>",gpxFilename.c_str());
+      goto cleanup;
+    }
+
+    // Decide which type to use (route or track)
+    if ((trackCount>0)&&(routeCount>0)) {
+      WARNING("file <%s> contains both a route and a track, loading the track only",gpxFilename.c_str());
+    }
+    if ((trackCount==0)&&(routeCount==0)) {
+      WARNING("file <%s> contains waypoints only",gpxFilename.c_str());
+    }
+    if (trackCount==0) {
+      for (Int i=0;i<routePoints.size();i++) {
+        addEndPosition(routePoints.get(i));
+        if (core->getQuitCore())
+          goto cleanup;
+      }
+    }
+    routePoints.clear();
+
+    // Use the information of the path if there is only one
+    core->getMapSource()->lockAccess(__FILE__, __LINE__);
+    if (trackCount==1) {
+      if (trackNameFound) name=trackName;
+      if (trackDescriptionFound) description=trackDescription;
+    }
+    if ((trackCount==0)&&(routeCount==1)) {
+      if (routeNameFound) name=routeName;
+      if (routeDescriptionFound) description=routeDescription;
+    }
+    core->getMapSource()->unlockAccess();
+
+    // Ask the user if waypoints shall be imported
+    if (importWaypoints==NavigationPathImportWaypointsUndecided) {
+      if (waypointCount==0) {
+        importWaypoints=NavigationPathImportWaypointsNo;
+        core->getConfigStore()->setIntValue(configPath,"importWaypoints",(Int)importWaypoints,__FILE__,__LINE__);
+      } else {
+        std::stringstream cmd;
+        cmd << "decideWaypointImport(\"" << getGpxFilename() << "\"," << waypointCount << ")";
+        core->getCommander()->dispatch(cmd.str());
+      }
     }
 
     // Write the cache
@@ -617,8 +531,7 @@ bool NavigationPath::readGPXFile() {
   else
     result=true;
 cleanup:
-  if (xpathCtx) xmlXPathFreeContext(xpathCtx);
-  if (doc) xmlFreeDoc(doc);
+  if (reader) xmlFreeTextReader(reader);
   core->getMapSource()->lockAccess(__FILE__, __LINE__);
   isStored=true;
   hasChanged=true;
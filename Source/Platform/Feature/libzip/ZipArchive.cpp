@@ -31,13 +31,27 @@ ZipArchive::ZipArchive(std::string archiveFolder, std::string archiveName) {
   this->archiveFolder=archiveFolder;
   this->archiveName=archiveName;
   this->last_error=0;
+  this->uncommittedEntries=0;
+  this->uncommittedBytes=0;
 }
 
 // Destructor
 ZipArchive::~ZipArchive() {
-  if (archive)
-    zip_close(archive);
+  if ((archive)&&(zip_close(archive)!=0)) {
+    DEBUG("zip_close of <%s> failed: %s",archiveName.c_str(),zip_strerror(archive));
+    discardChanges();
+  }
   archive=NULL;
+  freeBuffers();
+}
+
+// Frees the buffers of the added entries
+void ZipArchive::freeBuffers() {
+  for (std::list<void*>::iterator i=buffers.begin();i!=buffers.end();i++)
+    free(*i);
+  buffers.clear();
+  uncommittedEntries=0;
+  uncommittedBytes=0;
 }
 
 // Initializes the object
@@ -149,6 +163,8 @@ bool ZipArchive::addEntry(std::string filename, void *buffer, Int size) {
 
   // Remember that we need to free this buffer
   buffers.push_back(buffer);
+  uncommittedEntries++;
+  uncommittedBytes+=size;
   return true;
 }
 
@@ -226,16 +242,29 @@ bool ZipArchive::checkIntegrity() {
 }
 
 // Writes any changes within the archive to disk
-bool ZipArchive::writeChanges() {
-  Int result=zip_close(archive);
-  for (std::list<void*>::iterator i=buffers.begin();i!=buffers.end();i++)
-    free(*i);
-  buffers.clear();
-  init();
-  if (result!=0)
+// If this fails, the archive stays open with all changes such that they can be written again or discarded
+bool ZipArchive::writeChanges(bool reopen) {
+  if (zip_close(archive)!=0) {
+    DEBUG("zip_close of <%s> failed: %s",archiveName.c_str(),zip_strerror(archive));
     return false;
-  else
-    return true;
+  }
+  archive=NULL;
+  freeBuffers();
+  if (reopen)
+    return init();
+  return true;
+}
+
+// Drops all changes within the archive and closes it
+void ZipArchive::discardChanges() {
+  if (archive) {
+    zip_unchange_all(archive);
+    if (zip_close(archive)!=0) {
+      DEBUG("zip_close of <%s> failed: %s",archiveName.c_str(),zip_strerror(archive));
+    }
+    archive=NULL;
+  }
+  freeBuffers();
 }
 
 // Returns the size of the archive on disk
@@ -36,6 +36,11 @@ class ZipArchive {
   std::string archiveName;    // Name of the archive within the folder
   Int last_error;             // Last error number
   std::list<void*> buffers;   // List of buffers that need to be freed
+  Int uncommittedEntries;     // Number of entries added since the last write
+  Int uncommittedBytes;       // Number of bytes added since the last write
+
+  // Frees the buffers of the added entries
+  void freeBuffers();
 
 public:
 
@@ -79,7 +84,11 @@ public:
   UByte *exportEntry(std::string entryFilename, Int &size);
 
   // Writes any changes within the archive to disk
-  bool writeChanges();
+  // The archive is only opened again if reopen is set
+  bool writeChanges(bool reopen=true);
+
+  // Drops all changes within the archive and closes it
+  void discardChanges();
 
   // Returns the size of the archive on disk
   Int getUnchangedSize();
@@ -98,6 +107,14 @@ public:
   const std::string& getArchiveName() const {
     return archiveName;
   }
+
+  Int getUncommittedEntries() const {
+    return uncommittedEntries;
+  }
+
+  Int getUncommittedBytes() const {
+    return uncommittedBytes;
+  }
 };
 
 } /* namespace GEODISCOVERER */
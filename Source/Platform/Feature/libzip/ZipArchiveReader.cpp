@@ -0,0 +1,259 @@
+//============================================================================
+// Name        : ZipArchiveReader.cpp
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#include <Core.h>
+#include <ZipArchiveReader.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <zlib.h>
+
+namespace GEODISCOVERER {
+
+// Signatures and sizes of the zip records
+const UInt zipEndOfCentralDirectorySignature = 0x06054b50;
+const UInt zipCentralDirectorySignature = 0x02014b50;
+const UInt zipLocalHeaderSignature = 0x04034b50;
+const size_t zipEndOfCentralDirectorySize = 22;
+const size_t zipCentralDirectoryHeaderSize = 46;
+const size_t zipLocalHeaderSize = 30;
+const size_t zipMaxCommentSize = 65535;
+
+// Compression methods
+const UShort zipMethodStored = 0;
+const UShort zipMethodDeflated = 8;
+
+// Constructor
+ZipArchiveReader::ZipArchiveReader(std::string archiveFolder, std::string archiveName) {
+  this->archiveFolder=archiveFolder;
+  this->archiveName=archiveName;
+  mapping=NULL;
+  mappingSize=0;
+}
+
+// Destructor
+ZipArchiveReader::~ZipArchiveReader() {
+  if (mapping)
+    munmap(mapping,mappingSize);
+  mapping=NULL;
+}
+
+// Inits the object
+bool ZipArchiveReader::init() {
+
+  // Map the archive into memory
+  std::string archiveFilePath = archiveFolder + "/" + archiveName;
+  int fd=open(archiveFilePath.c_str(),O_RDONLY);
+  if (fd<0) {
+    DEBUG("can not open <%s>",archiveFilePath.c_str());
+    return false;
+  }
+  struct stat stat_buffer;
+  if ((fstat(fd,&stat_buffer)!=0)||(stat_buffer.st_size<(off_t)zipEndOfCentralDirectorySize)) {
+    DEBUG("<%s> is not a zip archive",archiveFilePath.c_str());
+    close(fd);
+    return false;
+  }
+  mappingSize=stat_buffer.st_size;
+  void *m=mmap(NULL,mappingSize,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if (m==MAP_FAILED) {
+    DEBUG("can not map <%s> into memory",archiveFilePath.c_str());
+    mappingSize=0;
+    return false;
+  }
+  mapping=(UByte*)m;
+
+  // Index the entries
+  if (!readCentralDirectory()) {
+    DEBUG("central directory of <%s> can not be read",archiveFilePath.c_str());
+    munmap(mapping,mappingSize);
+    mapping=NULL;
+    mappingSize=0;
+    entries.clear();
+    return false;
+  }
+  return true;
+}
+
+// Parses the central directory of the archive
+bool ZipArchiveReader::readCentralDirectory() {
+
+  // Search the end of central directory record backwards (it may be followed by a comment)
+  const UByte *endRecord=NULL;
+  size_t searchEnd=(mappingSize-zipEndOfCentralDirectorySize>zipMaxCommentSize) ? mappingSize-zipEndOfCentralDirectorySize-zipMaxCommentSize : 0;
+  for (size_t pos=mappingSize-zipEndOfCentralDirectorySize+1;pos>searchEnd;pos--) {
+    const UByte *p=mapping+pos-1;
+    if ((readUInt(p)==zipEndOfCentralDirectorySignature)&&(pos-1+zipEndOfCentralDirectorySize+readUShort(p+20)==mappingSize)) {
+      endRecord=p;
+      break;
+    }
+  }
+  if (!endRecord)
+    return false;
+
+  // Multi disk and zip64 archives are not supported
+  if ((readUShort(endRecord+4)!=0)||(readUShort(endRecord+6)!=0))
+    return false;
+  UShort entryCount=readUShort(endRecord+10);
+  UInt directorySize=readUInt(endRecord+12);
+  UInt directoryOffset=readUInt(endRecord+16);
+  if ((entryCount==0xFFFF)||(directoryOffset==0xFFFFFFFF))
+    return false;
+  if ((size_t)directoryOffset+directorySize>(size_t)(endRecord-mapping))
+    return false;
+
+  // Go through all entries
+  entries.reserve(entryCount);
+  const UByte *p=mapping+directoryOffset;
+  const UByte *directoryEnd=p+directorySize;
+  for (UShort i=0;i<entryCount;i++) {
+    if ((p+zipCentralDirectoryHeaderSize>directoryEnd)||(readUInt(p)!=zipCentralDirectorySignature))
+      return false;
+    UShort nameLength=readUShort(p+28);
+    UShort extraLength=readUShort(p+30);
+    UShort commentLength=readUShort(p+32);
+    if (p+zipCentralDirectoryHeaderSize+nameLength+extraLength+commentLength>directoryEnd)
+      return false;
+    ZipArchiveReaderEntry entry;
+    entry.compressionMethod=readUShort(p+10);
+    entry.compressedSize=readUInt(p+20);
+    entry.uncompressedSize=readUInt(p+24);
+    entry.localHeaderOffset=readUInt(p+42);
+
+    // Encrypted entries are skipped
+    if ((readUShort(p+8)&1)==0) {
+      entries[std::string((const char*)p+zipCentralDirectoryHeaderSize,nameLength)]=entry;
+    }
+    p+=zipCentralDirectoryHeaderSize+nameLength+extraLength+commentLength;
+  }
+  return true;
+}
+
+// Returns the start of the entry data within the mapping
+const UByte *ZipArchiveReader::getEntryStart(const ZipArchiveReaderEntry &entry) {
+  if ((size_t)entry.localHeaderOffset+zipLocalHeaderSize>mappingSize)
+    return NULL;
+  const UByte *p=mapping+entry.localHeaderOffset;
+  if (readUInt(p)!=zipLocalHeaderSignature)
+    return NULL;
+
+  // The local header may have a different extra field than the central directory
+  size_t dataOffset=(size_t)entry.localHeaderOffset+zipLocalHeaderSize+readUShort(p+26)+readUShort(p+28);
+  if (dataOffset+entry.compressedSize>mappingSize)
+    return NULL;
+  return mapping+dataOffset;
+}
+
+// Return the real size of the entry with the given filename
+Int ZipArchiveReader::getEntrySize(std::string filename) const {
+  std::unordered_map<std::string, ZipArchiveReaderEntry>::const_iterator i=entries.find(filename);
+  if (i==entries.end())
+    return 0;
+  return i->second.uncompressedSize;
+}
+
+// Returns the names of all entries
+std::list<std::string> ZipArchiveReader::getEntryFilenames() const {
+  std::list<std::string> filenames;
+  for (std::unordered_map<std::string, ZipArchiveReaderEntry>::const_iterator i=entries.begin();i!=entries.end();i++) {
+    filenames.push_back(i->first);
+  }
+  return filenames;
+}
+
+// Returns the content of the entry
+UByte *ZipArchiveReader::readEntry(std::string filename, Int &size, bool &copied) {
+  size=0;
+  copied=false;
+  std::unordered_map<std::string, ZipArchiveReaderEntry>::const_iterator i=entries.find(filename);
+  if (i==entries.end()) {
+    DEBUG("entry %s not found",filename.c_str());
+    return NULL;
+  }
+  const ZipArchiveReaderEntry &entry=i->second;
+  const UByte *data=getEntryStart(entry);
+  if (!data) {
+    DEBUG("entry %s in archive <%s/%s> is corrupt",filename.c_str(),archiveFolder.c_str(),archiveName.c_str());
+    return NULL;
+  }
+  switch(entry.compressionMethod) {
+
+    // Stored entries can be used directly
+    case zipMethodStored:
+      if (entry.compressedSize!=entry.uncompressedSize)
+        return NULL;
+      size=entry.uncompressedSize;
+      return (UByte*)data;
+
+    // Deflated entries are inflated in one go
+    case zipMethodDeflated: {
+      UByte *buffer;
+      if (!(buffer=(UByte*)malloc(entry.uncompressedSize+1))) {
+        FATAL("can not create buffer of length %d",entry.uncompressedSize);
+        return NULL;
+      }
+      z_stream stream;
+      memset(&stream,0,sizeof(stream));
+      if (inflateInit2(&stream,-MAX_WBITS)!=Z_OK) {
+        free(buffer);
+        return NULL;
+      }
+      stream.next_in=(Bytef*)data;
+      stream.avail_in=entry.compressedSize;
+      stream.next_out=buffer;
+      stream.avail_out=entry.uncompressedSize+1;
+      int result=inflate(&stream,Z_FINISH);
+      uLong inflatedSize=stream.total_out;
+      inflateEnd(&stream);
+      if ((result!=Z_STREAM_END)||(inflatedSize!=entry.uncompressedSize)) {
+        DEBUG("entry %s in archive <%s/%s> can not be inflated",filename.c_str(),archiveFolder.c_str(),archiveName.c_str());
+        free(buffer);
+        return NULL;
+      }
+      size=entry.uncompressedSize;
+      copied=true;
+      return buffer;
+    }
+
+    default:
+      DEBUG("compression method %d of entry %s is not supported",entry.compressionMethod,filename.c_str());
+      return NULL;
+  }
+}
+
+// Reads the entry into a new buffer
+UByte *ZipArchiveReader::exportEntry(std::string filename, Int &size) {
+  bool copied;
+  UByte *data=readEntry(filename,size,copied);
+  if ((data)&&(!copied)) {
+    UByte *buffer;
+    if (!(buffer=(UByte*)malloc(size))) {
+      FATAL("can not create buffer of length %d",size);
+      return NULL;
+    }
+    memcpy(buffer,data,size);
+    data=buffer;
+  }
+  return data;
+}
+
+} /* namespace GEODISCOVERER */
@@ -0,0 +1,106 @@
+//============================================================================
+// Name        : ZipArchiveReader.h
+// Author      : Matthias Gruenewald
+// Copyright   : Copyright 2010-2016 Matthias Gruenewald
+//
+// This file is part of GeoDiscoverer.
+//
+// GeoDiscoverer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GeoDiscoverer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with GeoDiscoverer.  If not, see <http://www.gnu.org/licenses/>.
+//
+//============================================================================
+
+#ifndef ZIPARCHIVEREADER_H_
+#define ZIPARCHIVEREADER_H_
+
+namespace GEODISCOVERER {
+
+// Location of an entry within the mapped archive
+typedef struct ZipArchiveReaderEntry {
+  UInt localHeaderOffset;     // Offset of the local file header
+  UInt compressedSize;        // Size of the entry within the archive
+  UInt uncompressedSize;      // Size of the entry after decompression
+  UShort compressionMethod;   // Method used to compress the entry
+} ZipArchiveReaderEntry;
+
+// Read-only access to a zip archive via a memory mapping of the file
+class ZipArchiveReader {
+
+protected:
+
+  std::string archiveFolder;                                      // Folder where the archive is stored in
+  std::string archiveName;                                        // Name of the archive within the folder
+  UByte *mapping;                                                 // Start of the memory mapped archive
+  size_t mappingSize;                                             // Size of the memory mapped archive
+  std::unordered_map<std::string, ZipArchiveReaderEntry> entries; // Central directory indexed by the entry name
+
+  // Reads little endian numbers from the mapping
+  static UShort readUShort(const UByte *p) {
+    return (UShort)p[0] | ((UShort)p[1]<<8);
+  }
+  static UInt readUInt(const UByte *p) {
+    return (UInt)p[0] | ((UInt)p[1]<<8) | ((UInt)p[2]<<16) | ((UInt)p[3]<<24);
+  }
+
+  // Parses the central directory of the archive
+  bool readCentralDirectory();
+
+  // Returns the start of the entry data within the mapping
+  const UByte *getEntryStart(const ZipArchiveReaderEntry &entry);
+
+public:
+
+  // Constructor
+  ZipArchiveReader(std::string archiveFolder, std::string archiveName);
+
+  // Destructor
+  virtual ~ZipArchiveReader();
+
+  // Inits the object
+  bool init();
+
+  // Checks if the archive contains the entry
+  bool hasEntry(std::string filename) const {
+    return entries.find(filename)!=entries.end();
+  }
+
+  // Return the real size of the entry with the given filename
+  Int getEntrySize(std::string filename) const;
+
+  // Returns the names of all entries
+  std::list<std::string> getEntryFilenames() const;
+
+  // Returns the content of the entry
+  // Stored entries are returned as a pointer into the mapping that stays valid as long as the reader exists
+  // Compressed entries are inflated into a new buffer and copied is set to indicate that it must be freed
+  UByte *readEntry(std::string filename, Int &size, bool &copied);
+
+  // Reads the entry into a new buffer
+  UByte *exportEntry(std::string filename, Int &size);
+
+  // Getters and setters
+  const std::string& getArchiveFolder() const {
+    return archiveFolder;
+  }
+
+  const std::string& getArchiveName() const {
+    return archiveName;
+  }
+
+  Int getEntryCount() const {
+    return entries.size();
+  }
+};
+
+} /* namespace GEODISCOVERER */
+#endif /* ZIPARCHIVEREADER_H_ */